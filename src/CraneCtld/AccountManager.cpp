@@ -638,7 +638,23 @@ AccountManager::Result AccountManager::ModifyQos(const std::string& name,
                                                  const std::string& value) {
   bool value_is_number{false};
   int64_t value_number;
-  if (item != Qos::FieldStringOfDescription()) {
+  bool preemptable;
+  crane::grpc::PreemptMode preempt_mode;
+  if (item == Qos::FieldStringOfPreemptable()) {
+    if (value == "true")
+      preemptable = true;
+    else if (value == "false")
+      preemptable = false;
+    else
+      return Result{false, "Preemptable should be true or false"};
+  } else if (item == Qos::FieldStringOfPreemptMode()) {
+    if (value == "requeue")
+      preempt_mode = crane::grpc::PREEMPT_REQUEUE;
+    else if (value == "cancel")
+      preempt_mode = crane::grpc::PREEMPT_CANCEL;
+    else
+      return Result{false, "Preempt mode should be requeue or cancel"};
+  } else if (item != Qos::FieldStringOfDescription()) {
     bool ok = util::ConvertStringToInt64(value, &value_number);
     if (!ok) return Result{false, "Failed to convert value to integer"};
 
@@ -661,6 +677,17 @@ AccountManager::Result AccountManager::ModifyQos(const std::string& name,
                                       name, item, value)) {
       return Result{false, "Fail to update the database"};
     }
+  } else if (item == Qos::FieldStringOfPreemptable()) {
+    if (!g_db_client->UpdateEntityOne(MongodbClient::EntityType::QOS, "$set",
+                                      name, item, preemptable)) {
+      return Result{false, "Fail to update the database"};
+    }
+  } else if (item == Qos::FieldStringOfPreemptMode()) {
+    if (!g_db_client->UpdateEntityOne(MongodbClient::EntityType::QOS, "$set",
+                                      name, item,
+                                      static_cast<int32_t>(preempt_mode))) {
+      return Result{false, "Fail to update the database"};
+    }
   } else {
     /* uint32 Type Stores data based on long(int64_t) */
     if (!g_db_client->UpdateEntityOne(MongodbClient::EntityType::QOS, "$set",
@@ -811,6 +838,8 @@ result::result<void, std::string> AccountManager::CheckAndApplyQosLimitOnTask(
     return result::fail(fmt::format("Unknown QOS '{}'", task->qos));
 
   task->qos_priority = qos_share_ptr->priority;
+  task->qos_preemptable = qos_share_ptr->preemptable;
+  task->qos_preempt_mode = qos_share_ptr->preempt_mode;
 
   if (task->time_limit >= absl::Seconds(kTaskMaxTimeLimitSec)) {
     task->time_limit = qos_share_ptr->max_time_limit_per_task;
@@ -32,6 +32,8 @@
 #include "CtldPublicDefs.h"
 #include "DbClient.h"
 #include "EmbeddedDbClient.h"
+#include "EventJournal.h"
+#include "ReservationManager.h"
 #include "TaskScheduler.h"
 #include "crane/Logger.h"
 #include "crane/Network.h"
@@ -252,6 +254,49 @@ void ParseConfig(int argc, char** argv) {
           g_config.PriorityConfig.Type = Ctld::Config::Priority::Basic;
       }
 
+      if (config["SelectType"]) {
+        std::string select_type = config["SelectType"].as<std::string>();
+        if (select_type == "select/bestfit")
+          g_config.NodeSelectionConfig.Type =
+              Ctld::Config::NodeSelection::BestFit;
+        else if (select_type == "select/minload")
+          g_config.NodeSelectionConfig.Type =
+              Ctld::Config::NodeSelection::MinLoadFirst;
+        else {
+          CRANE_ERROR("Unknown SelectType {}", select_type);
+          std::exit(1);
+        }
+      }
+
+      if (config["PreemptEnabled"])
+        g_config.PreemptionConfig.Enabled =
+            config["PreemptEnabled"].as<bool>();
+
+      if (config["PreemptWaitThreshold"])
+        g_config.PreemptionConfig.WaitThreshold =
+            absl::Seconds(config["PreemptWaitThreshold"].as<uint64_t>());
+      else
+        g_config.PreemptionConfig.WaitThreshold =
+            absl::Seconds(Ctld::kDefaultPreemptWaitThresholdSec);
+
+      if (config["PreemptGraceTime"])
+        g_config.PreemptionConfig.GraceTime =
+            absl::Seconds(config["PreemptGraceTime"].as<uint64_t>());
+      else
+        g_config.PreemptionConfig.GraceTime =
+            absl::Seconds(Ctld::kDefaultPreemptGraceTimeSec);
+
+      if (config["PreemptMinRunTime"])
+        g_config.PreemptionConfig.MinRunTime =
+            absl::Seconds(config["PreemptMinRunTime"].as<uint64_t>());
+      else
+        g_config.PreemptionConfig.MinRunTime =
+            absl::Seconds(Ctld::kDefaultPreemptMinRunTimeSec);
+
+      if (config["PreemptMaxPreemptorsPerCycle"])
+        g_config.PreemptionConfig.MaxPreemptorsPerCycle =
+            config["PreemptMaxPreemptorsPerCycle"].as<uint32_t>();
+
       if (config["PriorityFavorSmall"])
         g_config.PriorityConfig.FavorSmall =
             config["PriorityFavorSmall"].as<bool>();
@@ -316,6 +361,26 @@ void ParseConfig(int argc, char** argv) {
             Ctld::kDefaultRejectTasksBeyondCapacity;
       }
 
+      if (config["CranedRelayFanOut"]) {
+        g_config.CranedRelayFanOut =
+            config["CranedRelayFanOut"].as<uint32_t>();
+        if (g_config.CranedRelayFanOut == 1) {
+          CRANE_WARN(
+              "The value of 'CranedRelayFanOut' set in config file "
+              "turns the relay tree into a chain and has been reset to 2.");
+          g_config.CranedRelayFanOut = 2;
+        }
+      } else {
+        g_config.CranedRelayFanOut = Ctld::kDefaultCranedRelayFanOut;
+      }
+
+      if (config["CranedKeeperThreadNum"]) {
+        g_config.CranedKeeperCqThreadNum =
+            config["CranedKeeperThreadNum"].as<uint32_t>();
+      } else {
+        g_config.CranedKeeperCqThreadNum = 0;
+      }
+
       if (config["Nodes"]) {
         for (auto it = config["Nodes"].begin(); it != config["Nodes"].end();
              ++it) {
@@ -512,6 +577,92 @@ void ParseConfig(int argc, char** argv) {
         }
       }
 
+      if (config["Topology"]) {
+        for (auto it = config["Topology"].begin();
+             it != config["Topology"].end(); ++it) {
+          auto switch_node = it->as<YAML::Node>();
+          Ctld::Config::Switch sw;
+
+          if (switch_node["SwitchName"] &&
+              !switch_node["SwitchName"].IsNull()) {
+            sw.name = switch_node["SwitchName"].as<std::string>();
+          } else {
+            CRANE_ERROR("SwitchName not found in Topology");
+            std::exit(1);
+          }
+
+          if (switch_node["Switches"] && !switch_node["Switches"].IsNull()) {
+            auto switches = switch_node["Switches"].as<std::string>();
+            if (!util::ParseHostList(
+                    absl::StripAsciiWhitespace(switches).data(),
+                    &sw.switches)) {
+              CRANE_ERROR("Illegal switch name string format in switch {}.",
+                          sw.name);
+              std::exit(1);
+            }
+          }
+
+          if (switch_node["Nodes"] && !switch_node["Nodes"].IsNull()) {
+            auto nodes = switch_node["Nodes"].as<std::string>();
+            std::list<std::string> name_list;
+            if (!util::ParseHostList(absl::StripAsciiWhitespace(nodes).data(),
+                                     &name_list)) {
+              CRANE_ERROR("Illegal node name string format in switch {}.",
+                          sw.name);
+              std::exit(1);
+            }
+
+            for (auto&& node : name_list) {
+              if (g_config.Nodes.contains(node))
+                sw.nodes.emplace_back(std::move(node));
+              else
+                CRANE_ERROR(
+                    "Unknown node '{}' found in switch '{}'. It is ignored.",
+                    node, sw.name);
+            }
+          }
+
+          g_config.Topology.emplace_back(std::move(sw));
+        }
+      }
+
+      if (config["TopologyAwareSelection"])
+        g_config.TopologyAwareSelection =
+            config["TopologyAwareSelection"].as<bool>();
+
+      if (g_config.TopologyAwareSelection && g_config.Topology.empty()) {
+        CRANE_WARN(
+            "TopologyAwareSelection is set but no Topology is configured. "
+            "It is ignored.");
+        g_config.TopologyAwareSelection = false;
+      }
+
+      g_config.EventJournalConfig.FilePath =
+          g_config.CraneBaseDir + kDefaultCraneCtldEventJournalPath;
+      g_config.EventJournalConfig.MaxFileSize =
+          Ctld::kDefaultEventJournalMaxFileSizeMB * 1024 * 1024;
+      g_config.EventJournalConfig.MaxFileNum =
+          Ctld::kDefaultEventJournalMaxFileNum;
+      if (config["EventJournal"]) {
+        const auto& journal_config = config["EventJournal"];
+
+        if (journal_config["Enabled"])
+          g_config.EventJournalConfig.Enabled =
+              journal_config["Enabled"].as<bool>();
+
+        if (journal_config["File"])
+          g_config.EventJournalConfig.FilePath =
+              g_config.CraneBaseDir + journal_config["File"].as<std::string>();
+
+        if (journal_config["MaxFileSizeMB"])
+          g_config.EventJournalConfig.MaxFileSize =
+              journal_config["MaxFileSizeMB"].as<uint64_t>() * 1024 * 1024;
+
+        if (journal_config["MaxFileNum"])
+          g_config.EventJournalConfig.MaxFileNum =
+              journal_config["MaxFileNum"].as<uint32_t>();
+      }
+
       if (config["Plugin"]) {
         const auto& plugin_config = config["Plugin"];
 
@@ -527,6 +678,16 @@ void ParseConfig(int argc, char** argv) {
               fmt::format("unix://{}{}", g_config.CraneBaseDir,
                           kDefaultPlugindUnixSockPath);
         }
+
+        if (plugin_config["MaxQueuedTasks"])
+          g_config.Plugin.MaxQueuedTasks =
+              plugin_config["MaxQueuedTasks"].as<uint32_t>();
+        if (plugin_config["MaxInflightRpcs"])
+          g_config.Plugin.MaxInflightRpcs =
+              plugin_config["MaxInflightRpcs"].as<uint32_t>();
+        if (plugin_config["MaxBatchSize"])
+          g_config.Plugin.MaxBatchSize =
+              plugin_config["MaxBatchSize"].as<uint32_t>();
       }
     } catch (YAML::BadFile& e) {
       CRANE_CRITICAL("Can't open config file {}: {}", config_path, e.what());
@@ -625,6 +786,10 @@ void DestroyCtldGlobalVariables() {
 
   g_plugin_client.reset();
 
+  g_reservation_manager.reset();
+
+  g_event_journal.reset();
+
   // In case that spdlog is destructed before g_embedded_db_client->Close()
   // in which log function is called.
   g_embedded_db_client.reset();
@@ -662,10 +827,25 @@ void InitializeCtldGlobalVariables() {
     std::exit(1);
   }
 
+  if (g_config.EventJournalConfig.Enabled) {
+    g_event_journal = std::make_unique<Ctld::EventJournal>();
+    if (!g_event_journal->Init(g_config.EventJournalConfig.FilePath,
+                               g_config.EventJournalConfig.MaxFileSize,
+                               g_config.EventJournalConfig.MaxFileNum)) {
+      CRANE_ERROR("Failed to initialize the event journal.");
+      std::exit(1);
+    }
+  }
+
   if (g_config.Plugin.Enabled) {
     CRANE_INFO("[Plugin] Plugin module is enabled.");
     g_plugin_client = std::make_unique<plugin::PluginClient>();
-    g_plugin_client->InitChannelAndStub(g_config.Plugin.PlugindSockPath);
+    plugin::PluginClient::Options options{
+        .max_queued_tasks = g_config.Plugin.MaxQueuedTasks,
+        .max_inflight_rpcs = g_config.Plugin.MaxInflightRpcs,
+        .max_batch_size = g_config.Plugin.MaxBatchSize};
+    g_plugin_client->InitChannelAndStub(g_config.Plugin.PlugindSockPath,
+                                        options);
   }
 
   // Account manager must be initialized before Task Scheduler
@@ -686,7 +866,21 @@ void InitializeCtldGlobalVariables() {
     std::exit(1);
   }
 
-  g_craned_keeper = std::make_unique<CranedKeeper>(g_config.Nodes.size());
+  g_reservation_manager = std::make_unique<ReservationManager>();
+  ok = g_reservation_manager->Init();
+  if (!ok) {
+    CRANE_ERROR("Failed to initialize g_reservation_manager.");
+
+    DestroyCtldGlobalVariables();
+    std::exit(1);
+  }
+
+  std::list<CranedId> to_register_craned_list;
+  for (auto&& kv : g_config.Nodes) {
+    to_register_craned_list.emplace_back(kv.first);
+  }
+
+  g_craned_keeper = std::make_unique<CranedKeeper>(to_register_craned_list);
 
   g_craned_keeper->SetCranedIsUpCb([](const CranedId& craned_id) {
     CRANE_TRACE(
@@ -708,10 +902,10 @@ void InitializeCtldGlobalVariables() {
                                              ExitCode::kExitCodeCranedDown);
   });
 
-  std::list<CranedId> to_register_craned_list;
-  for (auto&& kv : g_config.Nodes) {
-    to_register_craned_list.emplace_back(kv.first);
-  }
+  g_craned_keeper->SetCranedHasRunningTasksCb([](const CranedId& craned_id) {
+    auto craned_meta = g_meta_container->GetCranedMetaPtr(craned_id);
+    return craned_meta && !craned_meta->running_task_resource_map.empty();
+  });
 
   using namespace std::chrono_literals;
 
@@ -775,6 +969,14 @@ void CreateFolders() {
     CRANE_ERROR("Failed to create folders for CraneCtld db files!");
     std::exit(1);
   }
+
+  if (g_config.EventJournalConfig.Enabled) {
+    ok = util::os::CreateFoldersForFile(g_config.EventJournalConfig.FilePath);
+    if (!ok) {
+      CRANE_ERROR("Failed to create folders for the event journal!");
+      std::exit(1);
+    }
+  }
 }
 
 int StartServer() {
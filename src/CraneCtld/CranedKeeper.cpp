@@ -62,7 +62,8 @@ std::vector<task_id_t> CranedStub::ExecuteTasks(
   return failed_task_ids;
 }
 
-CraneErr CranedStub::TerminateTasks(const std::vector<task_id_t> &task_ids) {
+CraneErr CranedStub::TerminateTasks(const std::vector<task_id_t> &task_ids,
+                                    uint32_t kill_grace_sec) {
   using crane::grpc::TerminateTasksReply;
   using crane::grpc::TerminateTasksRequest;
 
@@ -72,6 +73,7 @@ CraneErr CranedStub::TerminateTasks(const std::vector<task_id_t> &task_ids) {
   TerminateTasksReply reply;
 
   for (const auto &id : task_ids) request.add_task_id_list(id);
+  request.set_kill_grace_seconds(kill_grace_sec);
 
   status = m_stub_->TerminateTasks(&context, request, &reply);
   if (!status.ok()) {
@@ -325,13 +327,28 @@ crane::grpc::ExecuteTasksRequest CranedStub::NewExecuteTasksRequests(
   return request;
 }
 
-CranedKeeper::CranedKeeper(uint32_t node_num) : m_cq_closed_(false) {
+CranedKeeper::CranedKeeper(const std::list<CranedId> &craned_id_list)
+    : m_cq_closed_(false),
+      m_craned_stub_slots_(craned_id_list.size()),
+      m_reconnect_wheel_(absl::Milliseconds(kCranedReconnectTickMs),
+                         kCranedReconnectWheelSlots),
+      m_reconnect_rng_(std::random_device{}()) {
   m_pmr_pool_res_ = std::make_unique<std::pmr::synchronized_pool_resource>();
   m_tag_sync_allocator_ =
       std::make_unique<std::pmr::polymorphic_allocator<CqTag>>(
           m_pmr_pool_res_.get());
 
-  uint32_t thread_num = std::bit_ceil(node_num / kCompletionQueueCapacity);
+  for (const CranedId &craned_id : craned_id_list)
+    m_craned_slot_index_map_.emplace(craned_id,
+                                     m_craned_slot_index_map_.size());
+
+  uint32_t thread_num = g_config.CranedKeeperCqThreadNum;
+  if (thread_num == 0)
+    thread_num = std::max(
+        kDefaultCranedKeeperCqThreadNum,
+        std::bit_ceil(uint32_t(craned_id_list.size()) /
+                      kCompletionQueueCapacity));
+  CRANE_TRACE("CranedKeeper uses {} completion queue threads.", thread_num);
 
   m_cq_mtx_vec_ = std::vector<Mutex>(thread_num);
   m_cq_vec_ = std::vector<grpc::CompletionQueue>(thread_num);
@@ -341,15 +358,19 @@ CranedKeeper::CranedKeeper(uint32_t node_num) : m_cq_closed_(false) {
                                   i);
   }
 
-  m_period_connect_thread_ =
-      std::thread(&CranedKeeper::PeriodConnectCranedThreadFunc_, this);
+  m_reconnect_scheduler_thread_ =
+      std::thread(&CranedKeeper::ReconnectSchedulerThreadFunc_, this);
+  for (int i = 0; i < kCranedReconnectWorkerNum; i++)
+    m_reconnect_worker_thread_vec_.emplace_back(
+        &CranedKeeper::ReconnectWorkerThreadFunc_, this, i);
 }
 
 CranedKeeper::~CranedKeeper() {
   Shutdown();
 
   for (auto &cq_thread : m_cq_thread_vec_) cq_thread.join();
-  m_period_connect_thread_.join();
+  m_reconnect_scheduler_thread_.join();
+  for (auto &worker : m_reconnect_worker_thread_vec_) worker.join();
 
   CRANE_TRACE("CranedKeeper has been closed.");
 }
@@ -360,13 +381,17 @@ void CranedKeeper::Shutdown() {
   m_cq_closed_ = true;
 
   {
-    util::lock_guard l(m_connected_craned_mtx_);
-    for (auto &&[craned_id, stub] : m_connected_craned_id_stub_map_) {
-      stub->m_channel_.reset();
-    }
-    m_connected_craned_id_stub_map_.clear();
+    // Wake up the reconnect workers waiting on m_reconnect_mtx_.
+    util::lock_guard l(m_reconnect_mtx_);
   }
 
+  for (auto &slot : m_craned_stub_slots_) {
+    std::shared_ptr<CranedStub> stub =
+        std::atomic_exchange(&slot, std::shared_ptr<CranedStub>());
+    if (stub) stub->m_channel_.reset();
+  }
+  m_connected_craned_cnt_ = 0;
+
   for (int i = 0; i < m_cq_vec_.size(); i++) {
     util::lock_guard lock(m_cq_mtx_vec_[i]);
     m_cq_vec_[i].Shutdown();
@@ -378,9 +403,10 @@ void CranedKeeper::Shutdown() {
 
 void CranedKeeper::InitAndRegisterCraneds(
     const std::list<CranedId> &craned_id_list) {
-  WriterLock guard(&m_unavail_craned_set_mtx_);
+  util::lock_guard guard(m_reconnect_mtx_);
 
-  m_unavail_craned_set_.insert(craned_id_list.begin(), craned_id_list.end());
+  for (const CranedId &craned_id : craned_id_list)
+    ScheduleReconnect_(craned_id, absl::ZeroDuration(), true);
   CRANE_TRACE("Trying register all craneds...");
 }
 
@@ -467,8 +493,13 @@ void CranedKeeper::StateMonitorThreadFunc_(int thread_id) {
                 });
           }
 
-          WriterLock lock(&m_connected_craned_mtx_);
-          m_connected_craned_id_stub_map_.erase(craned->m_craned_id_);
+          // Only this thread writes the slot of the craned.
+          auto &slot = m_craned_stub_slots_[m_craned_slot_index_map_.at(
+              craned->m_craned_id_)];
+          if (std::atomic_load(&slot).get() == craned) {
+            std::atomic_store(&slot, std::shared_ptr<CranedStub>());
+            m_connected_craned_cnt_--;
+          }
         } else {
           CRANE_ERROR("Unknown tag type: {}", tag->type);
         }
@@ -494,15 +525,16 @@ CranedKeeper::CqTag *CranedKeeper::InitCranedStateMachine_(
       CRANE_TRACE("CONNECTING -> READY. New craned {} connected.",
                   craned->m_craned_id_);
 
-      WriterLock lock(&m_connected_craned_mtx_);
-      m_connected_craned_id_stub_map_.emplace(craned->m_craned_id_, craned);
       craned->m_invalid_ = false;
+      // A reconnection may arrive before the down event of the old stub,
+      // which is then replaced without being counted again.
+      auto &slot = m_craned_stub_slots_[m_craned_slot_index_map_.at(
+          craned->m_craned_id_)];
+      if (std::atomic_exchange(&slot, std::shared_ptr<CranedStub>(craned)) ==
+          nullptr)
+        m_connected_craned_cnt_++;
     }
-    {
-      util::lock_guard guard(m_unavail_craned_set_mtx_);
-      m_unavail_craned_set_.erase(craned->m_craned_id_);
-      m_connecting_craned_set_.erase(craned->m_craned_id_);
-    }
+    OnConnectSucceeded_(craned->m_craned_id_);
 
     if (m_craned_is_up_cb_)
       g_thread_pool->detach_task([this, craned_id = craned->m_craned_id_]() {
@@ -631,17 +663,33 @@ CranedKeeper::CqTag *CranedKeeper::EstablishedCranedStateMachine_(
 }
 
 uint32_t CranedKeeper::AvailableCranedCount() {
-  absl::ReaderMutexLock r_lock(&m_connected_craned_mtx_);
-  return m_connected_craned_id_stub_map_.size();
+  return m_connected_craned_cnt_.load(std::memory_order_relaxed);
 }
 
 std::shared_ptr<CranedStub> CranedKeeper::GetCranedStub(
     const CranedId &craned_id) {
-  ReaderLock lock(&m_connected_craned_mtx_);
-  auto iter = m_connected_craned_id_stub_map_.find(craned_id);
-  if (iter != m_connected_craned_id_stub_map_.end()) return iter->second;
+  auto iter = m_craned_slot_index_map_.find(craned_id);
+  if (iter == m_craned_slot_index_map_.end()) return nullptr;
 
-  return nullptr;
+  return std::atomic_load_explicit(&m_craned_stub_slots_[iter->second],
+                                   std::memory_order_acquire);
+}
+
+std::vector<CranedId> CranedKeeper::RelayToCraneds(
+    const google::protobuf::RepeatedPtrField<crane::grpc::RelayTarget>
+        &targets) {
+  crane::RelayTree relay_tree(
+      g_config.CranedRelayFanOut,
+      [this](const CranedId &craned_id)
+          -> std::shared_ptr<crane::grpc::Craned::Stub> {
+        std::shared_ptr<CranedStub> stub = GetCranedStub(craned_id);
+        if (!stub || stub->Invalid()) return nullptr;
+
+        // The grpc stub shares the lifetime of its CranedStub.
+        return {stub, stub->m_stub_.get()};
+      });
+
+  return relay_tree.Broadcast(targets);
 }
 
 void CranedKeeper::SetCranedIsUpCb(std::function<void(CranedId)> cb) {
@@ -652,36 +700,55 @@ void CranedKeeper::SetCranedIsDownCb(std::function<void(CranedId)> cb) {
   m_craned_is_down_cb_ = std::move(cb);
 }
 
+void CranedKeeper::SetCranedHasRunningTasksCb(
+    std::function<bool(const CranedId &)> cb) {
+  m_craned_has_running_tasks_cb_ = std::move(cb);
+}
+
 void CranedKeeper::PutNodeIntoUnavailList(const std::string &crane_id) {
   if (m_cq_closed_) return;
+  if (!m_craned_slot_index_map_.contains(crane_id)) {
+    CRANE_ERROR("Craned {} is not in the config file.", crane_id);
+    return;
+  }
 
-  util::lock_guard guard(m_unavail_craned_set_mtx_);
-  m_unavail_craned_set_.emplace(crane_id);
+  util::lock_guard guard(m_reconnect_mtx_);
+  ScheduleReconnect_(crane_id, absl::ZeroDuration(), true);
 }
 
-void CranedKeeper::ConnectCranedNode_(CranedId const &craned_id) {
-  static std::unordered_map<CranedId, std::variant<ipv4_t, ipv6_t>>
-      s_craned_id_to_ip_cache_map;
+absl::Duration CranedKeeper::LastFullReconnectDuration() {
+  util::lock_guard guard(m_reconnect_mtx_);
+  return m_last_full_reconnect_duration_;
+}
 
+void CranedKeeper::ConnectCranedNode_(CranedId const &craned_id) {
   std::string ip_addr;
 
-  auto it = s_craned_id_to_ip_cache_map.find(craned_id);
-  if (it != s_craned_id_to_ip_cache_map.end()) {
-    if (std::holds_alternative<ipv4_t>(it->second)) {  // Ipv4
-      ip_addr = crane::Ipv4ToStr(std::get<ipv4_t>(it->second));
+  std::optional<std::variant<ipv4_t, ipv6_t>> cached_ip;
+  {
+    util::lock_guard guard(m_craned_ip_cache_mtx_);
+    auto it = m_craned_ip_cache_map_.find(craned_id);
+    if (it != m_craned_ip_cache_map_.end()) cached_ip = it->second;
+  }
+
+  if (cached_ip.has_value()) {
+    if (std::holds_alternative<ipv4_t>(*cached_ip)) {  // Ipv4
+      ip_addr = crane::Ipv4ToStr(std::get<ipv4_t>(*cached_ip));
     } else {
-      CRANE_ASSERT(std::holds_alternative<ipv6_t>(it->second));
-      ip_addr = crane::Ipv6ToStr(std::get<ipv6_t>(it->second));
+      CRANE_ASSERT(std::holds_alternative<ipv6_t>(*cached_ip));
+      ip_addr = crane::Ipv6ToStr(std::get<ipv6_t>(*cached_ip));
     }
   } else {
     ipv4_t ipv4_addr;
     ipv6_t ipv6_addr;
     if (crane::ResolveIpv4FromHostname(craned_id, &ipv4_addr)) {
       ip_addr = crane::Ipv4ToStr(ipv4_addr);
-      s_craned_id_to_ip_cache_map.emplace(craned_id, ipv4_addr);
+      util::lock_guard guard(m_craned_ip_cache_mtx_);
+      m_craned_ip_cache_map_.emplace(craned_id, ipv4_addr);
     } else if (crane::ResolveIpv6FromHostname(craned_id, &ipv6_addr)) {
       ip_addr = crane::Ipv6ToStr(ipv6_addr);
-      s_craned_id_to_ip_cache_map.emplace(craned_id, ipv6_addr);
+      util::lock_guard guard(m_craned_ip_cache_mtx_);
+      m_craned_ip_cache_map_.emplace(craned_id, ipv6_addr);
     } else {
       // Just hostname. It should never happen,
       // but we add error handling here for robustness.
@@ -725,11 +792,7 @@ void CranedKeeper::ConnectCranedNode_(CranedId const &craned_id) {
   CqTag *tag = m_tag_sync_allocator_->new_object<CqTag>(
       CqTag{CqTag::kInitializingCraned, craned});
 
-  // Round-robin distribution here.
-  // Note: this function might be called from multiple thread.
-  //       Use atomic variable here.
-  static std::atomic<uint32_t> cur_cq_id = 0;
-  uint32_t thread_id = cur_cq_id++ % m_cq_vec_.size();
+  uint32_t thread_id = CqIndexOfCraned_(craned_id);
 
   util::lock_guard lock(m_cq_mtx_vec_[thread_id]);
   craned->m_channel_->NotifyOnStateChange(
@@ -739,43 +802,226 @@ void CranedKeeper::ConnectCranedNode_(CranedId const &craned_id) {
       &m_cq_vec_[thread_id], tag);
 }
 
+uint32_t CranedKeeper::CqIndexOfCraned_(const CranedId &craned_id) const {
+  return absl::Hash<CranedId>{}(craned_id) % m_cq_vec_.size();
+}
+
 void CranedKeeper::CranedChannelConnectFail_(CranedStub *stub) {
   CranedKeeper *craned_keeper = stub->m_craned_keeper_;
 
-  util::lock_guard guard(craned_keeper->m_unavail_craned_set_mtx_);
   craned_keeper->m_channel_count_.fetch_sub(1);
-  craned_keeper->m_connecting_craned_set_.erase(stub->m_craned_id_);
+  craned_keeper->OnCranedDisconnected_(stub->m_craned_id_);
 }
 
-void CranedKeeper::PeriodConnectCranedThreadFunc_() {
-  util::SetCurrentThreadName("PeriConnCraned");
+CranedKeeper::ReconnectTimerWheel::ReconnectTimerWheel(absl::Duration tick,
+                                                       size_t slot_num)
+    : m_tick_(tick), m_slots_(slot_num), m_cursor_time_(absl::Now()) {}
+
+void CranedKeeper::ReconnectTimerWheel::Schedule(const CranedId &craned_id,
+                                                 uint64_t generation,
+                                                 absl::Duration delay) {
+  // An entry is expired when the cursor moves onto its slot, so the delay
+  // is at least one tick.
+  uint64_t ticks = std::max<int64_t>(1, absl::Ceil(delay, m_tick_) / m_tick_);
+  size_t slot = (m_cursor_ + ticks) % m_slots_.size();
+  m_slots_[slot].emplace_back(
+      Entry{craned_id, generation, (ticks - 1) / m_slots_.size()});
+}
 
-  while (true) {
-    if (m_cq_closed_) break;
+void CranedKeeper::ReconnectTimerWheel::Advance(absl::Time now,
+                                                std::vector<Entry> *expired) {
+  while (m_cursor_time_ + m_tick_ <= now) {
+    m_cursor_ = (m_cursor_ + 1) % m_slots_.size();
+    m_cursor_time_ += m_tick_;
+
+    auto &slot = m_slots_[m_cursor_];
+    auto it = slot.begin();
+    while (it != slot.end()) {
+      if (it->rounds == 0) {
+        expired->emplace_back(std::move(*it));
+        *it = std::move(slot.back());
+        slot.pop_back();
+      } else {
+        it->rounds--;
+        ++it;
+      }
+    }
+  }
+}
+
+void CranedKeeper::ScheduleReconnect_(const CranedId &craned_id,
+                                      absl::Duration delay,
+                                      bool reset_backoff) {
+  if (m_reconnect_state_map_.empty()) {
+    m_reconnect_wave_start_ = absl::Now();
+    m_wave_connected_cnt_ = 0;
+    m_wave_given_up_cnt_ = 0;
+  }
+
+  ReconnectState &state = m_reconnect_state_map_[craned_id];
+  if (state.connecting) return;
+
+  if (reset_backoff) state.failure_cnt = 0;
+  state.generation++;
+  m_reconnect_wheel_.Schedule(craned_id, state.generation, delay);
+}
+
+absl::Duration CranedKeeper::ReconnectBackoff_(uint32_t failure_cnt) {
+  uint64_t delay_ms = kCranedReconnectMaxDelayMs;
+  if (failure_cnt <= 16)
+    delay_ms = std::min<uint64_t>(
+        kCranedReconnectMaxDelayMs,
+        uint64_t{kCranedReconnectBaseDelayMs} << (failure_cnt - 1));
+
+  // Randomize the delay so that the nodes dropped at the same time do not
+  // retry at the same time.
+  std::uniform_int_distribution<uint64_t> dist(delay_ms / 2, delay_ms);
+  return absl::Milliseconds(dist(m_reconnect_rng_));
+}
+
+void CranedKeeper::OnConnectSucceeded_(const CranedId &craned_id) {
+  util::lock_guard guard(m_reconnect_mtx_);
+
+  auto it = m_reconnect_state_map_.find(craned_id);
+  if (it == m_reconnect_state_map_.end() || !it->second.connecting) return;
+
+  m_connecting_craned_cnt_--;
+  SettleReconnect_(craned_id, true);
+}
+
+void CranedKeeper::OnCranedDisconnected_(const CranedId &craned_id) {
+  if (m_cq_closed_) return;
+
+  util::lock_guard guard(m_reconnect_mtx_);
+
+  auto it = m_reconnect_state_map_.find(craned_id);
+  if (it == m_reconnect_state_map_.end()) {
+    // An established connection is lost. The nodes lost at the same time,
+    // e.g., by a switch failure, are spread over the first backoff interval.
+    std::uniform_int_distribution<uint32_t> dist(0,
+                                                 kCranedReconnectBaseDelayMs);
+    ScheduleReconnect_(craned_id, absl::Milliseconds(dist(m_reconnect_rng_)),
+                       true);
+    return;
+  }
+
+  ReconnectState &state = it->second;
+  if (!state.connecting) return;
+
+  m_connecting_craned_cnt_--;
+  state.connecting = false;
+  if (++state.failure_cnt >= kCranedReconnectMaxAttempts) {
+    CRANE_TRACE("Failed to connect to {} for {} times. Waiting for it to "
+                "register itself.",
+                craned_id, state.failure_cnt);
+    SettleReconnect_(craned_id, false);
+    return;
+  }
+
+  ScheduleReconnect_(craned_id, ReconnectBackoff_(state.failure_cnt), false);
+}
+
+void CranedKeeper::SettleReconnect_(const CranedId &craned_id,
+                                    bool connected) {
+  m_reconnect_state_map_.erase(craned_id);
+  if (connected)
+    m_wave_connected_cnt_++;
+  else
+    m_wave_given_up_cnt_++;
+
+  if (!m_reconnect_state_map_.empty()) return;
+
+  m_last_full_reconnect_duration_ = absl::Now() - m_reconnect_wave_start_;
+  CRANE_INFO(
+      "Full reconnection of craned nodes took {:.3f}s. Connected: {}, "
+      "given up: {}.",
+      absl::ToDoubleSeconds(m_last_full_reconnect_duration_),
+      m_wave_connected_cnt_, m_wave_given_up_cnt_);
+}
+
+void CranedKeeper::ReconnectSchedulerThreadFunc_() {
+  util::SetCurrentThreadName("CranedReconSch");
+
+  std::vector<ReconnectTimerWheel::Entry> expired;
+  std::vector<bool> has_running_tasks;
+
+  while (!m_cq_closed_) {
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(kCranedReconnectTickMs));
 
-    // Use a window to limit the maximum number of connecting craned nodes.
     {
-      absl::ReaderMutexLock connected_reader_lock(&m_connected_craned_mtx_);
-      util::lock_guard guard(m_unavail_craned_set_mtx_);
-
-      uint32_t fetch_num =
-          kConcurrentStreamQuota - m_connecting_craned_set_.size();
-
-      auto it = m_unavail_craned_set_.begin();
-      while (it != m_unavail_craned_set_.end() && fetch_num > 0) {
-        if (!m_connecting_craned_set_.contains(*it) &&
-            !m_connected_craned_id_stub_map_.contains(*it)) {
-          m_connecting_craned_set_.emplace(*it);
-          g_thread_pool->detach_task(
-              [this, craned_id = *it]() { ConnectCranedNode_(craned_id); });
-          fetch_num--;
-        }
-        it = m_unavail_craned_set_.erase(it);
-      }
+      util::lock_guard guard(m_reconnect_mtx_);
+      m_reconnect_wheel_.Advance(absl::Now(), &expired);
+    }
+    if (expired.empty()) continue;
+
+    // The callback may take other locks, so it is called without
+    // m_reconnect_mtx_.
+    has_running_tasks.assign(expired.size(), false);
+    if (m_craned_has_running_tasks_cb_)
+      for (size_t i = 0; i < expired.size(); i++)
+        has_running_tasks[i] =
+            m_craned_has_running_tasks_cb_(expired[i].craned_id);
+
+    util::lock_guard guard(m_reconnect_mtx_);
+    for (size_t i = 0; i < expired.size(); i++) {
+      auto &entry = expired[i];
+      auto it = m_reconnect_state_map_.find(entry.craned_id);
+      if (it == m_reconnect_state_map_.end() ||
+          it->second.generation != entry.generation)
+        continue;
+
+      m_reconnect_ready_queues_[has_running_tasks[i] ? 0 : 1].emplace_back(
+          std::move(entry.craned_id), entry.generation);
+    }
+    expired.clear();
+  }
+}
+
+void CranedKeeper::ReconnectWorkerThreadFunc_(int worker_id) {
+  util::SetCurrentThreadName(fmt::format("CranedRecon{:0>2}", worker_id));
+
+  // The number of connecting nodes is limited to kConcurrentStreamQuota.
+  auto ready = [this]() {
+    if (m_cq_closed_) return true;
+    if (m_connecting_craned_cnt_ >= kConcurrentStreamQuota) return false;
+    return !m_reconnect_ready_queues_[0].empty() ||
+           !m_reconnect_ready_queues_[1].empty();
+  };
+
+  while (true) {
+    CranedId craned_id;
+    {
+      util::lock_guard guard(m_reconnect_mtx_);
+      m_reconnect_mtx_.Await(absl::Condition(&ready));
+      if (m_cq_closed_) break;
+
+      auto &queue = m_reconnect_ready_queues_[0].empty()
+                        ? m_reconnect_ready_queues_[1]
+                        : m_reconnect_ready_queues_[0];
+      auto [id, generation] = std::move(queue.front());
+      queue.pop_front();
+
+      auto it = m_reconnect_state_map_.find(id);
+      if (it == m_reconnect_state_map_.end() ||
+          it->second.generation != generation || it->second.connecting)
+        continue;
+
+      it->second.connecting = true;
+      m_connecting_craned_cnt_++;
+      craned_id = std::move(id);
+    }
+
+    // The node may have been connected by an earlier attempt.
+    // The stub must not be released with m_reconnect_mtx_ held since its
+    // destructor takes the lock.
+    if (GetCranedStub(craned_id) != nullptr) {
+      OnConnectSucceeded_(craned_id);
+      continue;
     }
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ConnectCranedNode_(craned_id);
   }
 }
 
-}  // namespace Ctld
\ No newline at end of file
+}  // namespace Ctld
@@ -19,8 +19,12 @@
 #include "CtldPublicDefs.h"
 // Precompiled header comes first!
 
+#include <deque>
+#include <random>
+
 #include "crane/Lock.h"
 #include "crane/Network.h"
+#include "crane/RelayTree.h"
 #include "protos/Crane.grpc.pb.h"
 #include "protos/Crane.pb.h"
 
@@ -48,7 +52,8 @@ class CranedStub {
   CraneErr ReleaseCgroupForTasks(
       const std::vector<std::pair<task_id_t, uid_t>> &task_uid_pairs);
 
-  CraneErr TerminateTasks(const std::vector<task_id_t> &task_ids);
+  CraneErr TerminateTasks(const std::vector<task_id_t> &task_ids,
+                          uint32_t kill_grace_sec = 0);
 
   CraneErr TerminateOrphanedTask(task_id_t task_id);
 
@@ -94,7 +99,11 @@ class CranedKeeper {
   using WriterLock = absl::WriterMutexLock;
 
  public:
-  explicit CranedKeeper(uint32_t node_num);
+  /**
+   * @param craned_id_list all the craneds in the config. Stubs of other
+   * craneds are never kept.
+   */
+  explicit CranedKeeper(const std::list<CranedId> &craned_id_list);
 
   ~CranedKeeper();
 
@@ -105,7 +114,8 @@ class CranedKeeper {
   uint32_t AvailableCranedCount();
 
   /**
-   * Get the pointer to CranedStub.
+   * Get the pointer to CranedStub. No mutex is taken, so it is cheap to call
+   * on every RPC.
    * @param craned_id the index of CranedStub
    * @return nullptr if index points to an invalid slot, the pointer to
    * CranedStub otherwise.
@@ -116,12 +126,33 @@ class CranedKeeper {
    */
   std::shared_ptr<CranedStub> GetCranedStub(const CranedId &craned_id);
 
+  /**
+   * Deliver the payload of each target to its craned through the relay tree
+   * of craneds with the fan-out of CranedRelayFanOut. Only the connected
+   * craneds are used as relays. Blocks until all the subtrees reply and
+   * the unconfirmed targets are retried directly.
+   * @return the ids of the craneds which did not confirm the delivery.
+   */
+  std::vector<CranedId> RelayToCraneds(
+      const google::protobuf::RepeatedPtrField<crane::grpc::RelayTarget>
+          &targets);
+
   void SetCranedIsUpCb(std::function<void(CranedId)> cb);
 
   void SetCranedIsDownCb(std::function<void(CranedId)> cb);
 
+  // Nodes for which cb returns true are reconnected before the others.
+  void SetCranedHasRunningTasksCb(std::function<bool(const CranedId &)> cb);
+
+  // Called when a craned registers itself. The node is connected on the next
+  // tick of the reconnect scheduler and its backoff is reset.
   void PutNodeIntoUnavailList(const std::string &crane_id);
 
+  // The time taken by the last reconnect wave, i.e., from the moment some
+  // nodes start waiting for reconnection while no node was waiting to the
+  // moment all of them are connected or given up.
+  absl::Duration LastFullReconnectDuration();
+
  private:
   struct CqTag {
     enum Type { kInitializingCraned, kEstablishedCraned };
@@ -129,21 +160,87 @@ class CranedKeeper {
     CranedStub *craned;
   };
 
+  /**
+   * A hashed timer wheel of craned ids waiting to be reconnected. Each slot
+   * covers one tick and delays longer than a round of the wheel are kept in
+   * their slots with the number of rounds left. Scheduling and expiring an
+   * id are O(1) regardless of the number of waiting nodes.
+   * Not thread-safe.
+   */
+  class ReconnectTimerWheel {
+   public:
+    struct Entry {
+      CranedId craned_id;
+      uint64_t generation;
+      uint64_t rounds;
+    };
+
+    ReconnectTimerWheel(absl::Duration tick, size_t slot_num);
+
+    void Schedule(const CranedId &craned_id, uint64_t generation,
+                  absl::Duration delay);
+
+    // Advance the wheel to now and append the expired entries to expired.
+    void Advance(absl::Time now, std::vector<Entry> *expired);
+
+   private:
+    absl::Duration m_tick_;
+    std::vector<std::vector<Entry>> m_slots_;
+    size_t m_cursor_{0};
+    absl::Time m_cursor_time_;
+  };
+
+  struct ReconnectState {
+    uint32_t failure_cnt{0};
+    // Bumped when the node is rescheduled. Entries of older generations in
+    // the timer wheel or the ready queues are dropped when they are popped.
+    uint64_t generation{0};
+    bool connecting{false};
+  };
+
   static void CranedChannelConnectFail_(CranedStub *stub);
 
   void ConnectCranedNode_(CranedId const &craned_id);
 
+  // Put the node into the timer wheel. A connecting node is left untouched.
+  void ScheduleReconnect_(const CranedId &craned_id, absl::Duration delay,
+                          bool reset_backoff)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(m_reconnect_mtx_);
+
+  // Exponential backoff with jitter for the given number of failures.
+  absl::Duration ReconnectBackoff_(uint32_t failure_cnt)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(m_reconnect_mtx_);
+
+  void OnConnectSucceeded_(const CranedId &craned_id);
+
+  // Called when a stub is destroyed, either after a failed connection
+  // attempt or after an established connection is lost.
+  void OnCranedDisconnected_(const CranedId &craned_id);
+
+  // Remove the node from the reconnect scheduler and end the current
+  // reconnect wave if no node is left.
+  void SettleReconnect_(const CranedId &craned_id, bool connected)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(m_reconnect_mtx_);
+
   CqTag *InitCranedStateMachine_(CranedStub *craned,
                                  grpc_connectivity_state new_state);
   CqTag *EstablishedCranedStateMachine_(CranedStub *craned,
                                         grpc_connectivity_state new_state);
 
+  // All the channel state events of a craned are handled by the same CQ
+  // thread, which is chosen by the hash of the craned id.
+  uint32_t CqIndexOfCraned_(const CranedId &craned_id) const;
+
   void StateMonitorThreadFunc_(int thread_id);
 
-  void PeriodConnectCranedThreadFunc_();
+  void ReconnectSchedulerThreadFunc_();
+
+  void ReconnectWorkerThreadFunc_(int worker_id);
 
   std::function<void(CranedId)> m_craned_is_up_cb_;
 
+  std::function<bool(const CranedId &)> m_craned_has_running_tasks_cb_;
+
   // Guarantee that the Craned will not be freed before this callback is
   // called.
   std::function<void(CranedId)> m_craned_is_down_cb_;
@@ -156,15 +253,35 @@ class CranedKeeper {
   std::unique_ptr<std::pmr::synchronized_pool_resource> m_pmr_pool_res_;
   std::unique_ptr<std::pmr::polymorphic_allocator<CqTag>> m_tag_sync_allocator_;
 
-  Mutex m_connected_craned_mtx_;
-  NodeHashMap<CranedId, std::shared_ptr<CranedStub>>
-      m_connected_craned_id_stub_map_ ABSL_GUARDED_BY(m_connected_craned_mtx_);
-
-  Mutex m_unavail_craned_set_mtx_;
-  std::unordered_set<CranedId> m_unavail_craned_set_
-      ABSL_GUARDED_BY(m_unavail_craned_set_mtx_);
-  std::unordered_set<CranedId> m_connecting_craned_set_
-      ABSL_GUARDED_BY(m_unavail_craned_set_mtx_);
+  // The slot index of each craned in the config. Built in the constructor
+  // and read-only afterwards, so it is read without a lock.
+  absl::flat_hash_map<CranedId, uint32_t> m_craned_slot_index_map_;
+  // The stub of a connected craned or nullptr. A slot is only written by the
+  // CQ thread which the craned is sharded to and by Shutdown(). Slots are
+  // accessed through std::atomic_load/std::atomic_store only, since
+  // std::atomic<std::shared_ptr> is not available before GCC 12.
+  std::vector<std::shared_ptr<CranedStub>> m_craned_stub_slots_;
+  std::atomic_uint32_t m_connected_craned_cnt_{0};
+
+  Mutex m_reconnect_mtx_;
+  ReconnectTimerWheel m_reconnect_wheel_ ABSL_GUARDED_BY(m_reconnect_mtx_);
+  absl::flat_hash_map<CranedId, ReconnectState> m_reconnect_state_map_
+      ABSL_GUARDED_BY(m_reconnect_mtx_);
+  // Nodes due for reconnection. Index 0 holds the nodes with running tasks.
+  std::array<std::deque<std::pair<CranedId, uint64_t /*generation*/>>, 2>
+      m_reconnect_ready_queues_ ABSL_GUARDED_BY(m_reconnect_mtx_);
+  uint32_t m_connecting_craned_cnt_ ABSL_GUARDED_BY(m_reconnect_mtx_){0};
+  std::mt19937 m_reconnect_rng_ ABSL_GUARDED_BY(m_reconnect_mtx_);
+
+  absl::Time m_reconnect_wave_start_ ABSL_GUARDED_BY(m_reconnect_mtx_);
+  uint32_t m_wave_connected_cnt_ ABSL_GUARDED_BY(m_reconnect_mtx_){0};
+  uint32_t m_wave_given_up_cnt_ ABSL_GUARDED_BY(m_reconnect_mtx_){0};
+  absl::Duration m_last_full_reconnect_duration_
+      ABSL_GUARDED_BY(m_reconnect_mtx_);
+
+  Mutex m_craned_ip_cache_mtx_;
+  std::unordered_map<CranedId, std::variant<ipv4_t, ipv6_t>>
+      m_craned_ip_cache_map_ ABSL_GUARDED_BY(m_craned_ip_cache_mtx_);
 
   std::vector<grpc::CompletionQueue> m_cq_vec_;
   std::vector<Mutex> m_cq_mtx_vec_;
@@ -172,7 +289,8 @@ class CranedKeeper {
 
   std::vector<std::thread> m_cq_thread_vec_;
 
-  std::thread m_period_connect_thread_;
+  std::thread m_reconnect_scheduler_thread_;
+  std::vector<std::thread> m_reconnect_worker_thread_vec_;
 
   std::atomic_uint64_t m_channel_count_{0};
 };
@@ -62,6 +62,10 @@ void CranedMetaContainer::CranedUp(const CranedId& craned_id) {
   node_meta->res_total.dedicated_res += node_meta->remote_meta.dres_in_node;
   node_meta->res_avail.dedicated_res += node_meta->remote_meta.dres_in_node;
 
+  topology_tree_.NodeUp(craned_id, node_meta->static_meta.res.allocatable_res);
+  if (!node_meta->drain && node_meta->running_task_resource_map.empty())
+    idle_node_index_.AddNode(craned_id, part_ids, node_meta->last_busy_time);
+
   for (auto& partition_meta : part_meta_ptrs) {
     PartitionGlobalMeta& part_global_meta =
         partition_meta->partition_global_meta;
@@ -95,6 +99,9 @@ void CranedMetaContainer::CranedDown(const CranedId& craned_id) {
   auto node_meta = craned_meta_map_[craned_id];
   node_meta->alive = false;
 
+  topology_tree_.NodeDown(craned_id, node_meta->res_avail.allocatable_res);
+  idle_node_index_.RemoveNode(craned_id);
+
   for (auto& partition_meta : part_meta_ptrs) {
     PartitionGlobalMeta& part_global_meta =
         partition_meta->partition_global_meta;
@@ -169,6 +176,9 @@ void CranedMetaContainer::MallocResourceFromNode(CranedId node_id,
   node_meta->res_avail -= task_node_res;
   node_meta->res_in_use += task_node_res;
 
+  topology_tree_.MallocResource(node_id, task_node_res.allocatable_res);
+  idle_node_index_.RemoveNode(node_id);
+
   for (auto& partition_meta : part_meta_ptrs) {
     PartitionGlobalMeta& part_global_meta =
         partition_meta->partition_global_meta;
@@ -217,6 +227,8 @@ void CranedMetaContainer::FreeResourceFromNode(CranedId node_id,
   node_meta->res_avail += resources;
   node_meta->res_in_use -= resources;
 
+  topology_tree_.FreeResource(node_id, resources.allocatable_res);
+
   for (auto& partition_meta : part_meta_ptrs) {
     PartitionGlobalMeta& part_global_meta =
         partition_meta->partition_global_meta;
@@ -226,6 +238,12 @@ void CranedMetaContainer::FreeResourceFromNode(CranedId node_id,
   }
 
   node_meta->running_task_resource_map.erase(resource_iter);
+
+  if (node_meta->running_task_resource_map.empty()) {
+    node_meta->last_busy_time = absl::Now();
+    if (!node_meta->drain)
+      idle_node_index_.AddNode(node_id, part_ids, node_meta->last_busy_time);
+  }
 }
 
 void CranedMetaContainer::InitFromConfig(const Config& config) {
@@ -297,6 +315,13 @@ void CranedMetaContainer::InitFromConfig(const Config& config) {
 
   craned_meta_map_.InitFromMap(std::move(craned_map));
   partition_metas_map_.InitFromMap(std::move(partition_map));
+
+  std::string reason;
+  if (!topology_tree_.Init(config.Topology, &reason)) {
+    CRANE_ERROR("Invalid topology: {} Topology-aware selection is disabled.",
+                reason);
+    g_config.TopologyAwareSelection = false;
+  }
 }
 
 crane::grpc::QueryCranedInfoReply CranedMetaContainer::QueryAllCranedInfo() {
@@ -551,11 +576,16 @@ crane::grpc::ModifyCranedStateReply CranedMetaContainer::ChangeNodeState(
       if (request.new_state() == crane::grpc::CranedControlState::CRANE_DRAIN) {
         craned_meta->drain = true;
         craned_meta->state_reason = request.reason();
+        idle_node_index_.RemoveNode(craned_id);
         reply.add_modified_nodes(craned_id);
       } else if (request.new_state() ==
                  crane::grpc::CranedControlState::CRANE_NONE) {
         craned_meta->drain = false;
         craned_meta->state_reason.clear();
+        if (craned_meta->running_task_resource_map.empty())
+          idle_node_index_.AddNode(craned_id,
+                                   craned_id_part_ids_map_.at(craned_id),
+                                   craned_meta->last_busy_time);
         reply.add_modified_nodes(craned_id);
       } else {
         reply.add_not_modified_nodes(craned_id);
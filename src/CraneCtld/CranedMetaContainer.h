@@ -19,6 +19,8 @@
 #include "CtldPublicDefs.h"
 // Precompiled header comes first!
 
+#include "IdleNodeIndex.h"
+#include "Topology.h"
 #include "crane/AtomicHashMap.h"
 #include "crane/Lock.h"
 #include "crane/Pointer.h"
@@ -111,6 +113,10 @@ class CranedMetaContainer final {
 
   void FreeResourceFromNode(CranedId craned_id, uint32_t task_id);
 
+  const TopologyTree& GetTopologyTree() const { return topology_tree_; }
+
+  const IdleNodeIndex& GetIdleNodeIndex() const { return idle_node_index_; }
+
  private:
   // In this part of code, the following lock sequence MUST be held
   // to avoid deadlock:
@@ -126,6 +132,13 @@ class CranedMetaContainer final {
   HashMap<CranedId /*craned hostname*/, std::list<PartitionId>>
       craned_id_part_ids_map_;
 
+  // Keeps the free capacity below each switch. It has its own lock and is
+  // updated while the craned meta lock is held.
+  TopologyTree topology_tree_;
+
+  // The nodes running no task. Updated like topology_tree_.
+  IdleNodeIndex idle_node_index_;
+
  private:  // Helper functions
   void SetGrpcCranedInfoByCranedMeta_(const CranedMeta& craned_meta,
                                       crane::grpc::CranedInfo* craned_info);
@@ -22,6 +22,8 @@
 #include "CranedKeeper.h"
 #include "CranedMetaContainer.h"
 #include "EmbeddedDbClient.h"
+#include "EventJournal.h"
+#include "ReservationManager.h"
 #include "TaskScheduler.h"
 #include "crane/String.h"
 
@@ -35,8 +37,9 @@ grpc::Status CraneCtldServiceImpl::SubmitBatchTask(
   task->SetFieldsByTaskToCtld(request->task());
 
   auto result = m_ctld_server_->SubmitTaskToScheduler(std::move(task));
+  task_id_t id = 0;
   if (result.has_value()) {
-    task_id_t id = result.value().get();
+    id = result.value().get();
     if (id != 0) {
       response->set_ok(true);
       response->set_task_id(id);
@@ -51,6 +54,11 @@ grpc::Status CraneCtldServiceImpl::SubmitBatchTask(
     response->set_reason(result.error());
   }
 
+  if (g_event_journal)
+    g_event_journal->RpcOutcome(
+        id, JournalRpcType::kSubmitBatchTask,
+        response->ok() ? CraneErr::kOk : CraneErr::kGenericFailure);
+
   return grpc::Status::OK;
 }
 
@@ -91,11 +99,35 @@ grpc::Status CraneCtldServiceImpl::TaskStatusChange(
 
   g_task_scheduler->TaskStatusChangeWithReasonAsync(
       request->task_id(), request->craned_id(), request->new_status(),
-      request->exit_code(), std::move(reason));
+      request->exit_code(), std::move(reason),
+      crane::grpc::TaskResourceUsage(request->resource_usage()));
   response->set_ok(true);
   return grpc::Status::OK;
 }
 
+grpc::Status CraneCtldServiceImpl::TaskStatusChangeBatch(
+    grpc::ServerContext *context,
+    const crane::grpc::TaskStatusChangeBatchRequest *request,
+    crane::grpc::TaskStatusChangeBatchReply *response) {
+  std::vector<TaskScheduler::TaskStatusChangeArg> args;
+  args.reserve(request->changes_size());
+
+  for (const auto &change : request->changes()) {
+    args.emplace_back(TaskScheduler::TaskStatusChangeArg{
+        .task_id = change.task_id(),
+        .exit_code = change.exit_code(),
+        .new_status = change.new_status(),
+        .craned_index = request->craned_id(),
+        .resource_usage = change.resource_usage()});
+  }
+
+  std::vector<task_id_t> acked_task_ids =
+      g_task_scheduler->TaskStatusChangeBatchAsync(std::move(args));
+  response->mutable_acked_task_id_list()->Assign(acked_task_ids.begin(),
+                                                 acked_task_ids.end());
+  return grpc::Status::OK;
+}
+
 grpc::Status CraneCtldServiceImpl::CranedRegister(
     grpc::ServerContext *context,
     const crane::grpc::CranedRegisterRequest *request,
@@ -120,6 +152,16 @@ grpc::Status CraneCtldServiceImpl::CancelTask(
     grpc::ServerContext *context, const crane::grpc::CancelTaskRequest *request,
     crane::grpc::CancelTaskReply *response) {
   *response = g_task_scheduler->CancelPendingOrRunningTask(*request);
+
+  if (g_event_journal) {
+    for (task_id_t task_id : response->cancelled_tasks())
+      g_event_journal->RpcOutcome(task_id, JournalRpcType::kCancelTask,
+                                  CraneErr::kOk);
+    for (task_id_t task_id : response->not_cancelled_tasks())
+      g_event_journal->RpcOutcome(task_id, JournalRpcType::kCancelTask,
+                                  CraneErr::kGenericFailure);
+  }
+
   return grpc::Status::OK;
 }
 
@@ -223,6 +265,15 @@ grpc::Status CraneCtldServiceImpl::ModifyTask(
     }
   }
 
+  if (g_event_journal) {
+    for (task_id_t task_id : response->modified_tasks())
+      g_event_journal->RpcOutcome(task_id, JournalRpcType::kModifyTask,
+                                  CraneErr::kOk);
+    for (task_id_t task_id : response->not_modified_tasks())
+      g_event_journal->RpcOutcome(task_id, JournalRpcType::kModifyTask,
+                                  CraneErr::kGenericFailure);
+  }
+
   return grpc::Status::OK;
 }
 
@@ -235,6 +286,69 @@ grpc::Status CraneCtldServiceImpl::ModifyNode(
   return grpc::Status::OK;
 }
 
+grpc::Status CraneCtldServiceImpl::CreateReservation(
+    grpc::ServerContext *context,
+    const crane::grpc::CreateReservationRequest *request,
+    crane::grpc::CreateReservationReply *response) {
+  auto res = g_account_manager->CheckUidIsAdmin(request->uid());
+  if (res.has_error()) {
+    response->set_ok(false);
+    response->set_reason(res.error());
+    return grpc::Status::OK;
+  }
+
+  auto create_res =
+      g_reservation_manager->CreateReservation(request->reservation());
+  response->set_ok(create_res.has_value());
+  if (create_res.has_error()) response->set_reason(create_res.error());
+
+  return grpc::Status::OK;
+}
+
+grpc::Status CraneCtldServiceImpl::DeleteReservation(
+    grpc::ServerContext *context,
+    const crane::grpc::DeleteReservationRequest *request,
+    crane::grpc::DeleteReservationReply *response) {
+  auto res = g_account_manager->CheckUidIsAdmin(request->uid());
+  if (res.has_error()) {
+    response->set_ok(false);
+    response->set_reason(res.error());
+    return grpc::Status::OK;
+  }
+
+  auto delete_res = g_reservation_manager->DeleteReservation(request->name());
+  response->set_ok(delete_res.has_value());
+  if (delete_res.has_error()) response->set_reason(delete_res.error());
+
+  return grpc::Status::OK;
+}
+
+grpc::Status CraneCtldServiceImpl::QueryReservationInfo(
+    grpc::ServerContext *context,
+    const crane::grpc::QueryReservationInfoRequest *request,
+    crane::grpc::QueryReservationInfoReply *response) {
+  auto res = g_account_manager->CheckUidIsAdmin(request->uid());
+  if (res.has_error()) {
+    response->set_ok(false);
+    response->set_reason(res.error());
+    return grpc::Status::OK;
+  }
+
+  g_reservation_manager->QueryReservations(
+      request->name(), response->mutable_reservation_list());
+  response->set_ok(true);
+
+  return grpc::Status::OK;
+}
+
+grpc::Status CraneCtldServiceImpl::QueryPendingReason(
+    grpc::ServerContext *context,
+    const crane::grpc::QueryPendingReasonRequest *request,
+    crane::grpc::QueryPendingReasonReply *response) {
+  g_task_scheduler->QueryPendingReason(*request, response);
+  return grpc::Status::OK;
+}
+
 grpc::Status CraneCtldServiceImpl::QueryTasksInfo(
     grpc::ServerContext *context,
     const crane::grpc::QueryTasksInfoRequest *request,
@@ -398,6 +512,8 @@ grpc::Status CraneCtldServiceImpl::AddQos(
       qos_info->priority() == 0 ? kDefaultQosPriority : qos_info->priority();
   qos.max_jobs_per_user = qos_info->max_jobs_per_user();
   qos.max_cpus_per_user = qos_info->max_cpus_per_user();
+  qos.preemptable = qos_info->preemptable();
+  qos.preempt_mode = qos_info->preempt_mode();
 
   int64_t sec = qos_info->max_time_limit_per_task();
   if (!CheckIfTimeLimitSecIsValid(sec)) {
@@ -840,6 +956,8 @@ grpc::Status CraneCtldServiceImpl::QueryEntityInfo(
       qos_info->set_max_cpus_per_user(qos.max_cpus_per_user);
       qos_info->set_max_time_limit_per_task(
           absl::ToInt64Seconds(qos.max_time_limit_per_task));
+      qos_info->set_preemptable(qos.preemptable);
+      qos_info->set_preempt_mode(qos.preempt_mode);
     }
   }
   default:
@@ -993,6 +1111,12 @@ grpc::Status CraneCtldServiceImpl::QueryClusterInfo(
     const crane::grpc::QueryClusterInfoRequest *request,
     crane::grpc::QueryClusterInfoReply *response) {
   *response = g_meta_container->QueryClusterInfo(*request);
+
+  absl::Duration reconnect = g_craned_keeper->LastFullReconnectDuration();
+  auto* duration = response->mutable_last_full_reconnect_duration();
+  duration->set_seconds(
+      absl::IDivDuration(reconnect, absl::Seconds(1), &reconnect));
+  duration->set_nanos(absl::ToInt64Nanoseconds(reconnect));
   return grpc::Status::OK;
 }
 
@@ -1276,6 +1400,11 @@ CtldServer::SubmitTaskToScheduler(std::unique_ptr<TaskInCtld> task) {
     err = g_task_scheduler->CheckTaskValidity(task.get());
 
   if (err == CraneErr::kOk) {
+    if (!task->reservation.empty()) {
+      auto rsv_res = g_reservation_manager->CheckTaskInReservation(*task);
+      if (rsv_res.has_error()) return result::fail(rsv_res.error());
+    }
+
     task->SetSubmitTime(absl::Now());
     std::future<task_id_t> future =
         g_task_scheduler->SubmitTaskAsync(std::move(task));
@@ -187,6 +187,11 @@ class CraneCtldServiceImpl final : public crane::grpc::CraneCtld::Service {
       const crane::grpc::TaskStatusChangeRequest *request,
       crane::grpc::TaskStatusChangeReply *response) override;
 
+  grpc::Status TaskStatusChangeBatch(
+      grpc::ServerContext *context,
+      const crane::grpc::TaskStatusChangeBatchRequest *request,
+      crane::grpc::TaskStatusChangeBatchReply *response) override;
+
   grpc::Status CranedRegister(
       grpc::ServerContext *context,
       const crane::grpc::CranedRegisterRequest *request,
@@ -220,6 +225,26 @@ class CraneCtldServiceImpl final : public crane::grpc::CraneCtld::Service {
       const crane::grpc::ModifyCranedStateRequest *request,
       crane::grpc::ModifyCranedStateReply *response) override;
 
+  grpc::Status CreateReservation(
+      grpc::ServerContext *context,
+      const crane::grpc::CreateReservationRequest *request,
+      crane::grpc::CreateReservationReply *response) override;
+
+  grpc::Status DeleteReservation(
+      grpc::ServerContext *context,
+      const crane::grpc::DeleteReservationRequest *request,
+      crane::grpc::DeleteReservationReply *response) override;
+
+  grpc::Status QueryReservationInfo(
+      grpc::ServerContext *context,
+      const crane::grpc::QueryReservationInfoRequest *request,
+      crane::grpc::QueryReservationInfoReply *response) override;
+
+  grpc::Status QueryPendingReason(
+      grpc::ServerContext *context,
+      const crane::grpc::QueryPendingReasonRequest *request,
+      crane::grpc::QueryPendingReasonReply *response) override;
+
   grpc::Status AddAccount(grpc::ServerContext *context,
                           const crane::grpc::AddAccountRequest *request,
                           crane::grpc::AddAccountReply *response) override;
@@ -51,9 +51,21 @@ constexpr uint32_t kTaskStatusChangeBatchNum = 1000;
 // CranedKeeper Constants
 constexpr uint32_t kConcurrentStreamQuota = 3000;
 constexpr uint32_t kCompletionQueueCapacity = 5000;
+constexpr uint32_t kDefaultCranedKeeperCqThreadNum = 4;
 constexpr uint16_t kCompletionQueueConnectingTimeoutSeconds = 3;
 constexpr uint16_t kCompletionQueueEstablishedTimeoutSeconds = 45;
 
+// Reconnection of craned nodes. The n-th retry after failures waits for a
+// random time in [d/2, d], where d = min(base * 2^(n-1), max). After
+// kCranedReconnectMaxAttempts failures, the node is connected again only when
+// it registers itself.
+constexpr uint32_t kCranedReconnectTickMs = 100;
+constexpr uint32_t kCranedReconnectWheelSlots = 1024;
+constexpr uint32_t kCranedReconnectBaseDelayMs = 1000;
+constexpr uint32_t kCranedReconnectMaxDelayMs = 60 * 1000;
+constexpr uint32_t kCranedReconnectMaxAttempts = 8;
+constexpr uint32_t kCranedReconnectWorkerNum = 4;
+
 // Since Unqlite has a limitation of about 900000 tasks per transaction,
 // we use this value to set the batch size of one dequeue action on
 // pending concurrent queue.
@@ -64,6 +76,17 @@ constexpr uint32_t kDefaultScheduledBatchSize = 100000;
 constexpr int64_t kCtldRpcTimeoutSeconds = 5;
 constexpr bool kDefaultRejectTasksBeyondCapacity = false;
 
+// 0 disables relaying and the RPCs are sent to every craned directly.
+constexpr uint32_t kDefaultCranedRelayFanOut = 0;
+
+constexpr int64_t kDefaultPreemptWaitThresholdSec = 600;
+constexpr int64_t kDefaultPreemptGraceTimeSec = 60;
+constexpr int64_t kDefaultPreemptMinRunTimeSec = 300;
+constexpr uint32_t kDefaultPreemptMaxPreemptorsPerCycle = 32;
+
+constexpr uint64_t kDefaultEventJournalMaxFileSizeMB = 64;
+constexpr uint32_t kDefaultEventJournalMaxFileNum = 4;
+
 struct Config {
   struct Node {
     uint32_t cpu;
@@ -81,6 +104,14 @@ struct Config {
     std::unordered_set<std::string> AllowAccounts;
   };
 
+  // A switch in the Topology section.
+  struct Switch {
+    std::string name;
+    // Names of the lower-level switches connected to this switch.
+    std::list<std::string> switches;
+    std::list<std::string> nodes;
+  };
+
   struct CraneCtldListenConf {
     std::string CraneCtldListenAddr;
     std::string CraneCtldListenPort;
@@ -104,9 +135,39 @@ struct Config {
     uint32_t WeightQOS;
   };
 
+  struct NodeSelection {
+    enum TypeEnum { MinLoadFirst, BestFit };
+    TypeEnum Type{MinLoadFirst};
+  };
+
+  struct Preemption {
+    bool Enabled{false};
+    // Pending tasks expected to wait longer than this preempt running tasks.
+    absl::Duration WaitThreshold;
+    // Preempted tasks still running GraceTime after SIGTERM are killed.
+    absl::Duration GraceTime;
+    // Running tasks are not preempted in the first MinRunTime of their run.
+    absl::Duration MinRunTime;
+    // At most this number of pending tasks of the highest priority try to
+    // preempt running tasks in one scheduling cycle.
+    uint32_t MaxPreemptorsPerCycle{kDefaultPreemptMaxPreemptorsPerCycle};
+  };
+
   struct PluginConfig {
     bool Enabled{false};
     std::string PlugindSockPath;
+    uint32_t MaxQueuedTasks{kDefaultPluginMaxQueuedTasks};
+    uint32_t MaxInflightRpcs{kDefaultPluginMaxInflightRpcs};
+    uint32_t MaxBatchSize{kDefaultPluginMaxBatchSize};
+  };
+
+  struct EventJournalConf {
+    bool Enabled{false};
+    std::string FilePath;
+    // The journal file is rotated when it exceeds MaxFileSize bytes.
+    // At most MaxFileNum files including the current one are kept.
+    uint64_t MaxFileSize;
+    uint32_t MaxFileNum;
   };
 
   bool CompressedRpc{};
@@ -128,6 +189,9 @@ struct Config {
   std::string DefaultPartition;
 
   Priority PriorityConfig;
+  NodeSelection NodeSelectionConfig;
+  Preemption PreemptionConfig;
+  EventJournalConf EventJournalConfig;
 
   // Database config
   std::string DbUser;
@@ -143,6 +207,12 @@ struct Config {
   uint32_t PendingQueueMaxSize;
   uint32_t ScheduledBatchSize;
   bool RejectTasksBeyondCapacity{false};
+  uint32_t CranedRelayFanOut{kDefaultCranedRelayFanOut};
+  // 0 means that the number is decided by the number of nodes.
+  uint32_t CranedKeeperCqThreadNum{0};
+
+  std::vector<Switch> Topology;
+  bool TopologyAwareSelection{false};
 };
 
 }  // namespace Ctld
@@ -234,7 +304,7 @@ struct InteractiveMetaInTask {
   std::function<void(task_id_t)> cb_task_cancel;
 
   // only for crun.
-  size_t status_change_cnt{0};
+  std::unordered_set<CranedId> status_changed_craned_ids;
 
   // ccancel for an interactive CALLOC task should call the front end to kill
   // the user's shell, let Cfored to inform CraneCtld of task completion rather
@@ -265,6 +335,145 @@ struct BatchMetaInTask {
   std::string error_file_pattern;
 };
 
+/**
+ * Why a pending task was not started in the last scheduling cycle which
+ * examined it. It is filled by the node selection algorithm and the reason
+ * codes are also used by the records of EventJournal.
+ */
+struct PendingDiagnosis {
+  enum NodeRejectReason : uint16_t {
+    kNotInPartition = 0,
+    kResourceExceedsNode,
+    kNotInNodeList,
+    kExcludedNode,
+    kNodeRejectReasonNum
+  };
+
+  enum NoStartReason : uint16_t {
+    kNotExamined = 0,
+    kStartLater,
+    kNotEnoughNodes,
+    kNoTimeWindow,
+    kResourceChanged,
+    kReservationInactive,
+    kNoStartReasonNum
+  };
+
+  absl::Time last_cycle_time{absl::InfinitePast()};
+  NoStartReason no_start_reason{kNotExamined};
+  // Valid only if no_start_reason is kStartLater.
+  absl::Time expected_start_time;
+  std::array<uint32_t, kNodeRejectReasonNum> rejected_node_cnt{};
+
+  void Reset(absl::Time cycle_time) {
+    last_cycle_time = cycle_time;
+    no_start_reason = kNotExamined;
+    rejected_node_cnt.fill(0);
+  }
+};
+
+/**
+ * The fields of a task shown in TaskInfo. TaskInfo is filled only from this
+ * struct, both for queries and for the snapshots sent to plugind, so a new
+ * field of TaskInfo needs to be added here only.
+ */
+struct TaskInfoFields {
+  crane::grpc::TaskType type;
+  task_id_t task_id;
+  std::string name;
+
+  std::string account;
+  PartitionId partition;
+  std::string qos;
+
+  absl::Duration time_limit;
+  google::protobuf::Timestamp submit_time;
+  google::protobuf::Timestamp start_time;
+  google::protobuf::Timestamp end_time;
+
+  uid_t uid;
+  gid_t gid;
+  std::string username;
+  uint32_t node_num;
+  std::string cmd_line;
+  std::string cwd;
+  std::vector<std::string> req_nodes;
+  std::vector<std::string> exclude_nodes;
+
+  std::string extra_attr;
+  std::string reservation;
+
+  bool held;
+  std::vector<CranedId> execution_nodes;
+  ResourceView res_view;
+
+  uint32_t exit_code;
+  double priority;
+
+  int32_t requeue_count;
+  task_id_t preempted_by_task_id;
+  google::protobuf::Timestamp preempted_time;
+
+  crane::grpc::TaskStatus status;
+  // Shown only if the task is pending.
+  std::string pending_reason;
+  // Shown only if the task is not pending.
+  std::string craned_list;
+
+  void MoveToTaskInfo(crane::grpc::TaskInfo* task_info) && {
+    task_info->set_type(type);
+    task_info->set_task_id(task_id);
+    task_info->set_name(std::move(name));
+
+    task_info->set_account(std::move(account));
+    task_info->set_partition(std::move(partition));
+    task_info->set_qos(std::move(qos));
+
+    task_info->mutable_time_limit()->set_seconds(ToInt64Seconds(time_limit));
+    *task_info->mutable_submit_time() = std::move(submit_time);
+    *task_info->mutable_start_time() = std::move(start_time);
+    *task_info->mutable_end_time() = std::move(end_time);
+
+    task_info->set_uid(uid);
+    task_info->set_gid(gid);
+    task_info->set_username(std::move(username));
+    task_info->set_node_num(node_num);
+    task_info->set_cmd_line(std::move(cmd_line));
+    task_info->set_cwd(std::move(cwd));
+    task_info->mutable_req_nodes()->Assign(
+        std::make_move_iterator(req_nodes.begin()),
+        std::make_move_iterator(req_nodes.end()));
+    task_info->mutable_exclude_nodes()->Assign(
+        std::make_move_iterator(exclude_nodes.begin()),
+        std::make_move_iterator(exclude_nodes.end()));
+
+    task_info->set_extra_attr(std::move(extra_attr));
+    task_info->set_reservation(std::move(reservation));
+
+    task_info->set_held(held);
+    task_info->mutable_execution_node()->Assign(
+        std::make_move_iterator(execution_nodes.begin()),
+        std::make_move_iterator(execution_nodes.end()));
+
+    *task_info->mutable_res_view() =
+        static_cast<crane::grpc::ResourceView>(res_view);
+
+    task_info->set_exit_code(exit_code);
+    task_info->set_priority(priority);
+
+    task_info->set_requeue_count(requeue_count);
+    task_info->set_preempted_by_task_id(preempted_by_task_id);
+    *task_info->mutable_preempted_time() = std::move(preempted_time);
+
+    task_info->set_status(status);
+    if (status == crane::grpc::Pending) {
+      task_info->set_pending_reason(std::move(pending_reason));
+    } else {
+      task_info->set_craned_list(std::move(craned_list));
+    }
+  }
+};
+
 struct TaskInCtld {
   /* -------- [1] Fields that are set at the submission time. ------- */
   absl::Duration time_limit;
@@ -290,6 +499,10 @@ struct TaskInCtld {
 
   bool requeue_if_failed{false};
   bool get_user_env{false};
+  // Run on whole idle nodes and get all the resource of them.
+  bool exclusive{false};
+  // The reservation to run in. Empty if none.
+  std::string reservation;
 
   std::string cmd_line;
   std::unordered_map<std::string, std::string> env;
@@ -315,7 +528,7 @@ struct TaskInCtld {
    * -------------------------------- */
   int32_t requeue_count{0};
   std::list<CranedId> craned_ids;
-  crane::grpc::TaskStatus status;
+  crane::grpc::TaskStatus status{crane::grpc::Invalid};
   uint32_t exit_code;
   bool held{false};
 
@@ -326,6 +539,10 @@ struct TaskInCtld {
   absl::Time start_time;
   absl::Time end_time;
 
+  // The task which preempted this task last time. 0 if none.
+  task_id_t preempted_by_task_id{0};
+  absl::Time preempted_time;
+
   // Might change at each scheduling cycle.
   ResourceV2 resources;
 
@@ -347,6 +564,8 @@ struct TaskInCtld {
   // Set in TaskScheduler->AcquireAttributes()
   uint32_t partition_priority{0};
   uint32_t qos_priority{0};
+  bool qos_preemptable{false};
+  crane::grpc::PreemptMode qos_preempt_mode{crane::grpc::PREEMPT_REQUEUE};
 
   /* -----------
    * Fields that may change at run time.
@@ -365,6 +584,13 @@ struct TaskInCtld {
   double mandated_priority{0.0};
   double cached_priority{0.0};
 
+  // Set when the task is running and TerminateTasks has been sent to
+  // preempt it.
+  bool being_preempted{false};
+
+  // Updated by the scheduling thread under the pending task map lock.
+  PendingDiagnosis pending_diagnosis;
+
   // Helper function
  public:
   crane::grpc::TaskToCtld const& TaskToCtld() const { return task_to_ctld; }
@@ -411,6 +637,21 @@ struct TaskInCtld {
     *runtime_attr.mutable_craned_ids()->Add() = i;
   }
 
+  void SetRequeueCount(int32_t val) {
+    requeue_count = val;
+    runtime_attr.set_requeue_count(val);
+  }
+  int32_t RequeueCount() const { return requeue_count; }
+
+  void SetPreemptedBy(task_id_t id, absl::Time const& time) {
+    preempted_by_task_id = id;
+    preempted_time = time;
+    runtime_attr.set_preempted_by_task_id(id);
+    runtime_attr.mutable_preempted_time()->set_seconds(ToUnixSeconds(time));
+  }
+  task_id_t PreemptedByTaskId() const { return preempted_by_task_id; }
+  absl::Time const& PreemptedTime() const { return preempted_time; }
+
   void SetStatus(crane::grpc::TaskStatus val) {
     status = val;
     runtime_attr.set_status(val);
@@ -423,6 +664,19 @@ struct TaskInCtld {
   }
   uint32_t ExitCode() const { return exit_code; }
 
+  // Accumulate the usage reported by one of the craned nodes of this task.
+  void MergeResourceUsage(crane::grpc::TaskResourceUsage const& val) {
+    auto* usage = runtime_attr.mutable_resource_usage();
+    usage->set_cpu_time_usec(usage->cpu_time_usec() + val.cpu_time_usec());
+    usage->set_mem_peak_bytes(
+        std::max(usage->mem_peak_bytes(), val.mem_peak_bytes()));
+    usage->set_io_read_bytes(usage->io_read_bytes() + val.io_read_bytes());
+    usage->set_io_write_bytes(usage->io_write_bytes() + val.io_write_bytes());
+  }
+  crane::grpc::TaskResourceUsage const& ResourceUsage() const {
+    return runtime_attr.resource_usage();
+  }
+
   void SetSubmitTime(absl::Time const& val) {
     submit_time = val;
     runtime_attr.mutable_submit_time()->set_seconds(ToUnixSeconds(submit_time));
@@ -514,6 +768,8 @@ struct TaskInCtld {
     qos = val.qos();
 
     get_user_env = val.get_user_env();
+    exclusive = val.exclusive();
+    reservation = val.reservation();
 
     extra_attr = val.extra_attr();
   }
@@ -532,6 +788,11 @@ struct TaskInCtld {
     status = runtime_attr.status();
     held = runtime_attr.held();
 
+    requeue_count = runtime_attr.requeue_count();
+    preempted_by_task_id = runtime_attr.preempted_by_task_id();
+    preempted_time =
+        absl::FromUnixSeconds(runtime_attr.preempted_time().seconds());
+
     if (status != crane::grpc::TaskStatus::Pending) {
       craned_ids.assign(runtime_attr.craned_ids().begin(),
                         runtime_attr.craned_ids().end());
@@ -561,49 +822,48 @@ struct TaskInCtld {
   // Helper function to set the fields of TaskInfo using info in
   // TaskInCtld. Note that mutable_elapsed_time() is not set here for
   // performance reason. The caller should set it manually.
-  void SetFieldsOfTaskInfo(crane::grpc::TaskInfo* task_info) {
-    task_info->set_type(type);
-    task_info->set_task_id(task_id);
-    task_info->set_name(name);
-
-    task_info->set_account(account);
-    task_info->set_partition(partition_id);
-    task_info->set_qos(qos);
-
-    task_info->mutable_time_limit()->set_seconds(ToInt64Seconds(time_limit));
-    task_info->mutable_submit_time()->CopyFrom(runtime_attr.submit_time());
-    task_info->mutable_start_time()->CopyFrom(runtime_attr.start_time());
-    task_info->mutable_end_time()->CopyFrom(runtime_attr.end_time());
-
-    task_info->set_uid(uid);
-    task_info->set_gid(gid);
-    task_info->set_username(username);
-    task_info->set_node_num(node_num);
-    task_info->set_cmd_line(cmd_line);
-    task_info->set_cwd(cwd);
-    task_info->mutable_req_nodes()->Assign(included_nodes.begin(),
-                                           included_nodes.end());
-    task_info->mutable_exclude_nodes()->Assign(excluded_nodes.begin(),
-                                               excluded_nodes.end());
-
-    task_info->set_extra_attr(extra_attr);
-
-    task_info->set_held(held);
-    task_info->mutable_execution_node()->Assign(executing_craned_ids.begin(),
-                                                executing_craned_ids.end());
-
-    *task_info->mutable_res_view() =
-        static_cast<crane::grpc::ResourceView>(requested_node_res_view);
-
-    task_info->set_exit_code(runtime_attr.exit_code());
-    task_info->set_priority(cached_priority);
+  TaskInfoFields GetTaskInfoFields() const {
+    return TaskInfoFields{
+        .type = type,
+        .task_id = task_id,
+        .name = name,
+        .account = account,
+        .partition = partition_id,
+        .qos = qos,
+        .time_limit = time_limit,
+        .submit_time = runtime_attr.submit_time(),
+        .start_time = runtime_attr.start_time(),
+        .end_time = runtime_attr.end_time(),
+        .uid = uid,
+        .gid = gid,
+        .username = username,
+        .node_num = node_num,
+        .cmd_line = cmd_line,
+        .cwd = cwd,
+        .req_nodes = {included_nodes.begin(), included_nodes.end()},
+        .exclude_nodes = {excluded_nodes.begin(), excluded_nodes.end()},
+        .extra_attr = extra_attr,
+        .reservation = reservation,
+        .held = held,
+        .execution_nodes = executing_craned_ids,
+        .res_view = requested_node_res_view,
+        .exit_code = runtime_attr.exit_code(),
+        .priority = cached_priority,
+        .requeue_count = requeue_count,
+        .preempted_by_task_id = preempted_by_task_id,
+        .preempted_time = runtime_attr.preempted_time(),
+        .status = status,
+        // Only one of them is shown in TaskInfo.
+        .pending_reason =
+            status == crane::grpc::Pending ? pending_reason : std::string(),
+        .craned_list = status == crane::grpc::Pending
+                           ? std::string()
+                           : allocated_craneds_regex,
+    };
+  }
 
-    task_info->set_status(status);
-    if (Status() == crane::grpc::Pending) {
-      task_info->set_pending_reason(pending_reason);
-    } else {
-      task_info->set_craned_list(allocated_craneds_regex);
-    }
+  void SetFieldsOfTaskInfo(crane::grpc::TaskInfo* task_info) const {
+    GetTaskInfoFields().MoveToTaskInfo(task_info);
   }
 };
 
@@ -618,6 +878,10 @@ struct Qos {
   absl::Duration max_time_limit_per_task;
   uint32_t max_cpus_per_user;
   uint32_t max_cpus_per_account;
+  // Whether the running tasks of this qos can be preempted by the tasks of a
+  // qos with higher priority.
+  bool preemptable{false};
+  crane::grpc::PreemptMode preempt_mode{crane::grpc::PREEMPT_REQUEUE};
 
   static constexpr const char* FieldStringOfDeleted() { return "deleted"; }
   static constexpr const char* FieldStringOfName() { return "name"; }
@@ -640,6 +904,12 @@ struct Qos {
   static constexpr const char* FieldStringOfMaxCpusPerAccount() {
     return "max_cpus_per_account";
   }
+  static constexpr const char* FieldStringOfPreemptable() {
+    return "preemptable";
+  }
+  static constexpr const char* FieldStringOfPreemptMode() {
+    return "preempt_mode";
+  }
 };
 
 struct Account {
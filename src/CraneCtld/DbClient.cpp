@@ -300,7 +300,8 @@ bool MongodbClient::FetchJobRecords(
   // 15 priority      time_eligible  time_start    time_end    time_suspended
   // 20 script        state          timelimit     time_submit work_dir
   // 25 submit_line   exit_code      username       qos        get_user_env
-  // 30 type          extra_attr
+  // 30 type          extra_attr    cpu_time_usec  mem_peak    io_read_bytes
+  // 35 io_write_bytes requeue_count preempted_by  time_preempted
 
   try {
     for (auto view : cursor) {
@@ -348,6 +349,22 @@ bool MongodbClient::FetchJobRecords(
       task->set_type((crane::grpc::TaskType)view["type"].get_int32().value);
 
       task->set_extra_attr(view["extra_attr"].get_string().value.data());
+
+      // Records inserted by older versions have no usage.
+      if (view["cpu_time_usec"]) {
+        auto* usage = task->mutable_resource_usage();
+        usage->set_cpu_time_usec(view["cpu_time_usec"].get_int64().value);
+        usage->set_mem_peak_bytes(view["mem_peak"].get_int64().value);
+        usage->set_io_read_bytes(view["io_read_bytes"].get_int64().value);
+        usage->set_io_write_bytes(view["io_write_bytes"].get_int64().value);
+      }
+
+      if (view["preempted_by"]) {
+        task->set_requeue_count(view["requeue_count"].get_int32().value);
+        task->set_preempted_by_task_id(view["preempted_by"].get_int32().value);
+        task->mutable_preempted_time()->set_seconds(
+            view["time_preempted"].get_int64().value);
+      }
     }
   } catch (const bsoncxx::exception& e) {
     PrintError_(e.what());
@@ -776,6 +793,14 @@ void MongodbClient::ViewToQos_(const bsoncxx::document::view& qos_view,
         qos_view[Qos::FieldStringOfMaxCpusPerUser()].get_int64().value;
     qos->max_time_limit_per_task = absl::Seconds(
         qos_view[Qos::FieldStringOfMaxTimeLimitPerTask()].get_int64().value);
+
+    // Qos inserted by older versions is not preemptable.
+    if (qos_view[Qos::FieldStringOfPreemptable()]) {
+      qos->preemptable =
+          qos_view[Qos::FieldStringOfPreemptable()].get_bool().value;
+      qos->preempt_mode = static_cast<crane::grpc::PreemptMode>(
+          qos_view[Qos::FieldStringOfPreemptMode()].get_int32().value);
+    }
   } catch (const bsoncxx::exception& e) {
     PrintError_(e.what());
   }
@@ -783,7 +808,7 @@ void MongodbClient::ViewToQos_(const bsoncxx::document::view& qos_view,
 
 bsoncxx::builder::basic::document MongodbClient::QosToDocument_(
     const Ctld::Qos& qos) {
-  std::array<std::string, 8> fields{
+  std::array<std::string, 10> fields{
       Qos::FieldStringOfDeleted(),
       Qos::FieldStringOfName(),
       Qos::FieldStringOfDescription(),
@@ -792,9 +817,11 @@ bsoncxx::builder::basic::document MongodbClient::QosToDocument_(
       Qos::FieldStringOfMaxJobsPerUser(),
       Qos::FieldStringOfMaxCpusPerUser(),
       Qos::FieldStringOfMaxTimeLimitPerTask(),
+      Qos::FieldStringOfPreemptable(),
+      Qos::FieldStringOfPreemptMode(),
   };
   std::tuple<bool, std::string, std::string, int, int64_t, int64_t, int64_t,
-             int64_t>
+             int64_t, bool, int32_t>
       values{false,
              qos.name,
              qos.description,
@@ -802,7 +829,9 @@ bsoncxx::builder::basic::document MongodbClient::QosToDocument_(
              qos.priority,
              qos.max_jobs_per_user,
              qos.max_cpus_per_user,
-             absl::ToInt64Seconds(qos.max_time_limit_per_task)};
+             absl::ToInt64Seconds(qos.max_time_limit_per_task),
+             qos.preemptable,
+             static_cast<int32_t>(qos.preempt_mode)};
 
   return DocumentConstructor_(fields, values);
 }
@@ -825,10 +854,11 @@ MongodbClient::document MongodbClient::TaskInEmbeddedDbToDocument_(
   // 15 priority      time_eligible  time_start    time_end    time_suspended
   // 20 script        state          timelimit     time_submit work_dir
   // 25 submit_line   exit_code      username       qos        get_user_env
-  // 30 type          extra_attr
+  // 30 type          extra_attr    cpu_time_usec  mem_peak    io_read_bytes
+  // 35 io_write_bytes requeue_count preempted_by  time_preempted
 
   // clang-format off
-  std::array<std::string, 32> fields{
+  std::array<std::string, 39> fields{
     // 0 - 4
     "task_id",  "task_db_id", "mod_time",    "deleted",  "account",
     // 5 - 9
@@ -841,8 +871,10 @@ MongodbClient::document MongodbClient::TaskInEmbeddedDbToDocument_(
     "script", "state", "timelimit", "time_submit", "work_dir",
     // 25 - 29
     "submit_line", "exit_code",  "username", "qos", "get_user_env",
-    // 30 - 31
-    "type", "extra_attr", 
+    // 30 - 34
+    "type", "extra_attr", "cpu_time_usec", "mem_peak", "io_read_bytes",
+    // 35 - 38
+    "io_write_bytes", "requeue_count", "preempted_by", "time_preempted",
   };
   // clang-format on
 
@@ -852,7 +884,8 @@ MongodbClient::document MongodbClient::TaskInEmbeddedDbToDocument_(
              int64_t, int64_t, int64_t, int64_t, int64_t,          /*15-19*/
              std::string, int32_t, int64_t, int64_t, std::string,  /*20-24*/
              std::string, int32_t, std::string, std::string, bool, /*25-29*/
-             int32_t, std::string>                                 /*30-31*/
+             int32_t, std::string, int64_t, int64_t, int64_t,      /*30-34*/
+             int64_t, int32_t, int32_t, int64_t>                   /*35-38*/
       values{
           // 0-4
           static_cast<int32_t>(runtime_attr.task_id()),
@@ -879,8 +912,16 @@ MongodbClient::document MongodbClient::TaskInEmbeddedDbToDocument_(
           task_to_ctld.cmd_line(), runtime_attr.exit_code(),
           runtime_attr.username(), task_to_ctld.qos(),
           task_to_ctld.get_user_env(),
-          // 30-31
-          task_to_ctld.type(), task_to_ctld.extra_attr()};
+          // 30-34
+          task_to_ctld.type(), task_to_ctld.extra_attr(),
+          static_cast<int64_t>(runtime_attr.resource_usage().cpu_time_usec()),
+          static_cast<int64_t>(runtime_attr.resource_usage().mem_peak_bytes()),
+          static_cast<int64_t>(runtime_attr.resource_usage().io_read_bytes()),
+          // 35-38
+          static_cast<int64_t>(runtime_attr.resource_usage().io_write_bytes()),
+          runtime_attr.requeue_count(),
+          static_cast<int32_t>(runtime_attr.preempted_by_task_id()),
+          runtime_attr.preempted_time().seconds()};
 
   return DocumentConstructor_(fields, values);
 }
@@ -903,10 +944,11 @@ MongodbClient::document MongodbClient::TaskInCtldToDocument_(TaskInCtld* task) {
   // 15 priority      time_eligible  time_start    time_end    time_suspended
   // 20 script        state          timelimit     time_submit work_dir
   // 25 submit_line   exit_code      username       qos        get_user_env
-  // 30 type          extra_attr
+  // 30 type          extra_attr    cpu_time_usec  mem_peak    io_read_bytes
+  // 35 io_write_bytes requeue_count preempted_by  time_preempted
 
   // clang-format off
-  std::array<std::string, 32> fields{
+  std::array<std::string, 39> fields{
       // 0 - 4
       "task_id",  "task_db_id", "mod_time",    "deleted",  "account",
       // 5 - 9
@@ -919,8 +961,10 @@ MongodbClient::document MongodbClient::TaskInCtldToDocument_(TaskInCtld* task) {
       "script", "state", "timelimit", "time_submit", "work_dir",
       // 25 - 29
       "submit_line", "exit_code",  "username", "qos", "get_user_env",
-      // 30 - 31
-      "type", "extra_attr",
+      // 30 - 34
+      "type", "extra_attr", "cpu_time_usec", "mem_peak", "io_read_bytes",
+      // 35 - 38
+      "io_write_bytes", "requeue_count", "preempted_by", "time_preempted",
   };
   // clang-format on
 
@@ -930,7 +974,8 @@ MongodbClient::document MongodbClient::TaskInCtldToDocument_(TaskInCtld* task) {
              int64_t, int64_t, int64_t, int64_t, int64_t,          /*15-19*/
              std::string, int32_t, int64_t, int64_t, std::string,  /*20-24*/
              std::string, int32_t, std::string, std::string, bool, /*25-29*/
-             int32_t, std::string>                                 /*30-31*/
+             int32_t, std::string, int64_t, int64_t, int64_t,      /*30-34*/
+             int64_t, int32_t, int32_t, int64_t>                   /*35-38*/
       values{                                                      // 0-4
              static_cast<int32_t>(task->TaskId()), task->TaskDbId(),
              absl::ToUnixSeconds(absl::Now()), false, task->account,
@@ -950,8 +995,16 @@ MongodbClient::document MongodbClient::TaskInCtldToDocument_(TaskInCtld* task) {
              // 25-29
              task->cmd_line, task->ExitCode(), task->Username(), task->qos,
              task->get_user_env,
-             // 30-31
-             task->type, task->extra_attr};
+             // 30-34
+             task->type, task->extra_attr,
+             static_cast<int64_t>(task->ResourceUsage().cpu_time_usec()),
+             static_cast<int64_t>(task->ResourceUsage().mem_peak_bytes()),
+             static_cast<int64_t>(task->ResourceUsage().io_read_bytes()),
+             // 35-38
+             static_cast<int64_t>(task->ResourceUsage().io_write_bytes()),
+             task->RequeueCount(),
+             static_cast<int32_t>(task->PreemptedByTaskId()),
+             absl::ToUnixSeconds(task->PreemptedTime())};
 
   return DocumentConstructor_(fields, values);
 }
@@ -712,4 +712,39 @@ bool EmbeddedDbClient::PurgeEndedTasks(const std::vector<db_id_t>& db_ids) {
   return true;
 }
 
+bool EmbeddedDbClient::StoreReservations(
+    crane::grpc::ReservationList const& reservations) {
+  txn_id_t txn_id;
+
+  if (!BeginDbTransaction_(m_variable_db_.get(), &txn_id)) return false;
+  auto res = StoreTypeIntoDb_(m_variable_db_.get(), txn_id,
+                              s_reservations_str_, &reservations);
+  if (res.has_error()) {
+    CRANE_ERROR("Failed to store reservations. Error code: {}",
+                int(res.error()));
+    return false;
+  }
+  return CommitDbTransaction_(m_variable_db_.get(), txn_id);
+}
+
+bool EmbeddedDbClient::FetchReservations(
+    crane::grpc::ReservationList* reservations) {
+  txn_id_t txn_id;
+  size_t n_bytes{0};
+
+  reservations->Clear();
+  if (!BeginDbTransaction_(m_variable_db_.get(), &txn_id)) return false;
+
+  auto res =
+      m_variable_db_->Fetch(txn_id, s_reservations_str_, nullptr, &n_bytes);
+  if (res.has_error() && res.error() == DbErrorCode::kNotFound)
+    return CommitDbTransaction_(m_variable_db_.get(), txn_id);
+
+  if (FetchTypeFromDb_(m_variable_db_.get(), txn_id, s_reservations_str_,
+                       reservations)
+          .has_error())
+    return false;
+  return CommitDbTransaction_(m_variable_db_.get(), txn_id);
+}
+
 }  // namespace Ctld
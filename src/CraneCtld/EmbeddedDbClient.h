@@ -204,6 +204,15 @@ class EmbeddedDbClient {
 
   bool PurgeEndedTasks(const std::vector<db_id_t>& db_ids);
 
+  /**
+   * Reservations are kept as a whole in one entry of the variable db whose
+   * key does not end with 'S', so they are not taken as task data.
+   */
+  bool StoreReservations(crane::grpc::ReservationList const& reservations);
+
+  // An empty list is returned if no reservation has ever been stored.
+  bool FetchReservations(crane::grpc::ReservationList* reservations);
+
   bool UpdateRuntimeAttrOfTask(
       txn_id_t txn_id, db_id_t db_id,
       crane::grpc::RuntimeAttrOfTask const& runtime_attr) {
@@ -476,6 +485,7 @@ class EmbeddedDbClient {
 
   inline static std::string const s_next_task_db_id_str_{"NDI"};
   inline static std::string const s_next_task_id_str_{"NI"};
+  inline static std::string const s_reservations_str_{"RSV"};
 
   inline static task_id_t s_next_task_id_;
   inline static db_id_t s_next_task_db_id_;
@@ -0,0 +1,429 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "EventJournal.h"
+
+namespace Ctld {
+
+namespace {
+
+constexpr std::array<std::string_view, PendingDiagnosis::kNodeRejectReasonNum>
+    kNodeRejectReasonStrArr = {
+        "NotInPartition", "ResourceExceedsNode", "NotInNodeList",
+        "ExcludedNode"};
+
+constexpr std::array<std::string_view, PendingDiagnosis::kNoStartReasonNum>
+    kNoStartReasonStrArr = {
+        "NotExamined",  "StartLater",      "NotEnoughNodes",
+        "NoTimeWindow", "ResourceChanged", "ReservationInactive"};
+
+constexpr std::array<std::string_view, size_t(JournalEventType::kEventTypeNum)>
+    kEventTypeStrArr = {
+        "NodeRejected",  "StartTimeChosen", "ResourceReserved",
+        "NotStarted",    "StatusChanged",   "RpcOutcome",
+        "RecordsDropped"};
+
+constexpr std::array<std::string_view, size_t(JournalRpcType::kRpcTypeNum)>
+    kRpcTypeStrArr = {"SubmitBatchTask", "CancelTask", "ModifyTask"};
+
+template <size_t N>
+std::string_view StrOrUnknown(const std::array<std::string_view, N>& arr,
+                              uint64_t index) {
+  return index < N ? arr[index] : "Unknown";
+}
+
+std::string TaskStatusStr(int64_t status) {
+  if (!crane::grpc::TaskStatus_IsValid(status)) return "Unknown";
+  return crane::grpc::TaskStatus_Name(
+      static_cast<crane::grpc::TaskStatus>(status));
+}
+
+std::string JsonEscape(std::string_view text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped.push_back('\\');
+      escaped.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      escaped.append(fmt::format("\\u{:04x}", static_cast<int>(c)));
+    } else {
+      escaped.push_back(c);
+    }
+  }
+  return escaped;
+}
+
+std::string FormatUnixSeconds(int64_t secs) {
+  return absl::FormatTime("%Y-%m-%d %H:%M:%S", absl::FromUnixSeconds(secs),
+                          absl::LocalTimeZone());
+}
+
+}  // namespace
+
+std::string_view NodeRejectReasonStr(
+    PendingDiagnosis::NodeRejectReason reason) {
+  return StrOrUnknown(kNodeRejectReasonStrArr, reason);
+}
+
+std::string_view NoStartReasonStr(PendingDiagnosis::NoStartReason reason) {
+  return StrOrUnknown(kNoStartReasonStrArr, reason);
+}
+
+result::result<std::vector<JournalRecord>, std::string> ReadJournalFile(
+    const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return result::fail(fmt::format("Failed to open {}", path));
+
+  JournalFileHeader header{};
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      memcmp(header.magic, JournalFileHeader::kMagic, sizeof(header.magic)) !=
+          0)
+    return result::fail(fmt::format("{} is not a journal file", path));
+
+  if (header.version != JournalFileHeader::kVersion ||
+      header.record_size != sizeof(JournalRecord))
+    return result::fail(
+        fmt::format("Unsupported journal version {} or record size {} in {}",
+                    header.version, header.record_size, path));
+
+  std::vector<JournalRecord> records;
+  JournalRecord record;
+  // A partially written record at the end is ignored.
+  while (file.read(reinterpret_cast<char*>(&record), sizeof(record)))
+    records.emplace_back(record);
+
+  return records;
+}
+
+std::string FormatJournalRecord(const JournalRecord& record, bool json) {
+  auto type = static_cast<size_t>(record.type);
+  std::string_view type_str = StrOrUnknown(kEventTypeStrArr, type);
+
+  // Fields of the record in order as (key, text, quoted in json).
+  std::vector<std::tuple<std::string_view, std::string, bool>> fields;
+  switch (record.type) {
+  case JournalEventType::kNodeRejected:
+    fields.emplace_back("craned", record.CranedId(), true);
+    fields.emplace_back("reason",
+                        StrOrUnknown(kNodeRejectReasonStrArr, record.reason),
+                        true);
+    break;
+  case JournalEventType::kStartTimeChosen:
+    fields.emplace_back("start_time", FormatUnixSeconds(record.arg0), true);
+    fields.emplace_back("node_num", std::to_string(record.arg1), false);
+    break;
+  case JournalEventType::kResourceReserved:
+    fields.emplace_back("craned", record.CranedId(), true);
+    fields.emplace_back("start_time", FormatUnixSeconds(record.arg0), true);
+    fields.emplace_back("end_time", FormatUnixSeconds(record.arg1), true);
+    break;
+  case JournalEventType::kNotStarted:
+    fields.emplace_back("reason",
+                        StrOrUnknown(kNoStartReasonStrArr, record.reason),
+                        true);
+    break;
+  case JournalEventType::kStatusChanged:
+    fields.emplace_back("from", TaskStatusStr(record.arg0), true);
+    fields.emplace_back("to", TaskStatusStr(record.arg1), true);
+    break;
+  case JournalEventType::kRpcOutcome:
+    fields.emplace_back("rpc", StrOrUnknown(kRpcTypeStrArr, record.reason),
+                        true);
+    fields.emplace_back(
+        "result", StrOrUnknown(Internal::CraneErrStrArr, record.arg0), true);
+    break;
+  case JournalEventType::kRecordsDropped:
+    fields.emplace_back("count", std::to_string(record.arg0), false);
+    break;
+  default:
+    break;
+  }
+
+  absl::Time time = absl::FromUnixNanos(record.time_ns);
+  if (json) {
+    std::string str = fmt::format(
+        R"({{"time_ns":{},"task_id":{},"event":"{}")", record.time_ns,
+        record.task_id, type_str);
+    for (const auto& [key, text, quoted] : fields) {
+      if (quoted)
+        str.append(fmt::format(R"(,"{}":"{}")", key, JsonEscape(text)));
+      else
+        str.append(fmt::format(R"(,"{}":{})", key, text));
+    }
+    str.push_back('}');
+    return str;
+  }
+
+  std::string str = fmt::format(
+      "{} #{} {}",
+      absl::FormatTime("%Y-%m-%d %H:%M:%E6S", time, absl::LocalTimeZone()),
+      record.task_id, type_str);
+  for (const auto& [key, text, quoted] : fields)
+    str.append(fmt::format(" {}={}", key, text));
+  return str;
+}
+
+EventJournal::EventJournal()
+    : m_instance_id_([] {
+        static std::atomic<uint64_t> next_id{1};
+        return next_id.fetch_add(1, std::memory_order_relaxed);
+      }()) {}
+
+EventJournal::~EventJournal() {
+  m_thread_stop_ = true;
+  if (m_flush_thread_.joinable()) m_flush_thread_.join();
+
+  absl::MutexLock lock_guard(&m_file_mtx_);
+  DrainNoLock_();
+  if (m_file_ == nullptr) return;
+  fclose(m_file_);
+  m_file_ = nullptr;
+}
+
+bool EventJournal::Init(const std::string& path, uint64_t max_file_size,
+                        uint32_t max_file_num) {
+  {
+    absl::MutexLock lock_guard(&m_file_mtx_);
+    m_path_ = path;
+    m_max_file_size_ = max_file_size;
+    m_max_file_num_ = std::max(max_file_num, 1U);
+    if (!OpenFileNoLock_()) return false;
+  }
+
+  m_flush_thread_ = std::thread([this] { FlushThread_(); });
+  return true;
+}
+
+void EventJournal::NodeRejected(task_id_t task_id, const CranedId& craned_id,
+                                PendingDiagnosis::NodeRejectReason reason) {
+  Append_(JournalEventType::kNodeRejected, task_id, reason, 0, 0, craned_id);
+}
+
+void EventJournal::StartTimeChosen(task_id_t task_id, absl::Time start_time,
+                                   uint32_t node_num) {
+  Append_(JournalEventType::kStartTimeChosen, task_id, 0,
+          ToUnixSeconds(start_time), node_num);
+}
+
+void EventJournal::ResourceReserved(task_id_t task_id,
+                                    const CranedId& craned_id,
+                                    absl::Time start_time,
+                                    absl::Time end_time) {
+  Append_(JournalEventType::kResourceReserved, task_id, 0,
+          ToUnixSeconds(start_time), ToUnixSeconds(end_time), craned_id);
+}
+
+void EventJournal::NotStarted(task_id_t task_id,
+                              PendingDiagnosis::NoStartReason reason) {
+  Append_(JournalEventType::kNotStarted, task_id, reason, 0, 0);
+}
+
+void EventJournal::StatusChanged(task_id_t task_id,
+                                 crane::grpc::TaskStatus old_status,
+                                 crane::grpc::TaskStatus new_status) {
+  Append_(JournalEventType::kStatusChanged, task_id, 0, old_status,
+          new_status);
+}
+
+void EventJournal::RpcOutcome(task_id_t task_id, JournalRpcType type,
+                              CraneErr err) {
+  Append_(JournalEventType::kRpcOutcome, task_id, uint16_t(type),
+          uint16_t(err), 0);
+}
+
+void EventJournal::Flush() {
+  absl::MutexLock lock_guard(&m_file_mtx_);
+  DrainNoLock_();
+}
+
+size_t EventJournal::ThreadRingNum() {
+  absl::MutexLock lock_guard(&m_rings_mtx_);
+  return m_rings_.size();
+}
+
+void EventJournal::Append_(JournalEventType type, task_id_t task_id,
+                           uint16_t reason, int64_t arg0, int64_t arg1,
+                           std::string_view craned_id) {
+  ThreadRing* ring = LocalRing_();
+
+  uint64_t head = ring->head.load(std::memory_order_relaxed);
+  if (head - ring->tail.load(std::memory_order_acquire) >= kRingCapacity) {
+    ring->dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  JournalRecord& record = ring->records[head & (kRingCapacity - 1)];
+  record.time_ns = absl::ToUnixNanos(absl::Now());
+  record.task_id = task_id;
+  record.type = type;
+  record.reason = reason;
+  record.arg0 = arg0;
+  record.arg1 = arg1;
+  size_t len = std::min(craned_id.size(), sizeof(record.craned_id));
+  memcpy(record.craned_id, craned_id.data(), len);
+  memset(record.craned_id + len, 0, sizeof(record.craned_id) - len);
+
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+EventJournal::ThreadRing* EventJournal::LocalRing_() {
+  // Retires the ring when the thread exits, so that the flush thread frees
+  // it after writing its remaining records.
+  struct RingHolder {
+    // Keyed by the instance id so that a thread never uses the ring of a
+    // destroyed journal.
+    uint64_t instance_id = 0;
+    std::shared_ptr<ThreadRing> ring;
+
+    ~RingHolder() {
+      if (ring) ring->retired.store(true, std::memory_order_release);
+    }
+  };
+  thread_local RingHolder holder;
+
+  if (holder.instance_id != m_instance_id_) {
+    if (holder.ring)
+      holder.ring->retired.store(true, std::memory_order_release);
+    holder.ring = std::make_shared<ThreadRing>();
+    holder.instance_id = m_instance_id_;
+
+    absl::MutexLock lock_guard(&m_rings_mtx_);
+    m_rings_.emplace_back(holder.ring);
+  }
+  return holder.ring.get();
+}
+
+void EventJournal::FlushThread_() {
+  util::SetCurrentThreadName("EventJournal");
+
+  while (!m_thread_stop_) {
+    std::this_thread::sleep_for(absl::ToChronoMilliseconds(kFlushInterval));
+    Flush();
+  }
+}
+
+void EventJournal::DrainNoLock_() {
+  std::vector<std::shared_ptr<ThreadRing>> rings;
+  {
+    absl::MutexLock lock_guard(&m_rings_mtx_);
+    rings = m_rings_;
+  }
+
+  std::vector<ThreadRing*> drained_retired_rings;
+  for (const auto& ring : rings) {
+    // Loaded before head, so a retired ring is empty after the drain below.
+    bool retired = ring->retired.load(std::memory_order_acquire);
+    uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+
+    // The records between tail and head may wrap around the end.
+    while (tail != head) {
+      uint64_t begin = tail & (kRingCapacity - 1);
+      uint64_t num = std::min(head - tail, kRingCapacity - begin);
+      if (!WriteNoLock_(&ring->records[begin], num)) return;
+      tail += num;
+      ring->tail.store(tail, std::memory_order_release);
+    }
+
+    uint64_t dropped = ring->dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0) {
+      JournalRecord record{};
+      record.time_ns = absl::ToUnixNanos(absl::Now());
+      record.type = JournalEventType::kRecordsDropped;
+      record.arg0 = static_cast<int64_t>(dropped);
+      if (!WriteNoLock_(&record, 1)) return;
+    }
+
+    if (retired) drained_retired_rings.emplace_back(ring.get());
+  }
+
+  if (!drained_retired_rings.empty()) {
+    absl::MutexLock lock_guard(&m_rings_mtx_);
+    std::erase_if(m_rings_, [&](const auto& ring) {
+      return std::ranges::find(drained_retired_rings, ring.get()) !=
+             drained_retired_rings.end();
+    });
+  }
+
+  if (m_file_ != nullptr) fflush(m_file_);
+}
+
+bool EventJournal::WriteNoLock_(const JournalRecord* records, size_t num) {
+  size_t bytes = num * sizeof(JournalRecord);
+  if ((m_file_ == nullptr || m_file_size_ + bytes > m_max_file_size_) &&
+      !OpenFileNoLock_())
+    return false;
+
+  if (fwrite(records, sizeof(JournalRecord), num, m_file_) != num) {
+    CRANE_ERROR("Failed to write event journal {}: {}", m_path_,
+                strerror(errno));
+    return false;
+  }
+  m_file_size_ += bytes;
+  return true;
+}
+
+// Rotate the non-empty file at <path>, if any, to <path>.1, <path>.1 to
+// <path>.2 and so on, and start a new file at <path>. The records of the
+// last run of CraneCtld are kept in this way as well. On failure, m_file_
+// is left null and the open is retried by the next write.
+bool EventJournal::OpenFileNoLock_() {
+  if (m_file_ != nullptr) {
+    fclose(m_file_);
+    m_file_ = nullptr;
+  }
+
+  std::error_code ec;
+  if (std::filesystem::file_size(m_path_, ec) > 0 && !ec) {
+    for (uint32_t i = m_max_file_num_ - 1; i > 0; i--) {
+      std::string from =
+          i == 1 ? m_path_ : fmt::format("{}.{}", m_path_, i - 1);
+      std::filesystem::rename(from, fmt::format("{}.{}", m_path_, i), ec);
+    }
+  }
+
+  m_file_ = fopen(m_path_.c_str(), "wb");
+  if (m_file_ == nullptr) {
+    if (!m_open_failed_)
+      CRANE_ERROR("Failed to open event journal {}: {}. Retry later.",
+                  m_path_, strerror(errno));
+    m_open_failed_ = true;
+    return false;
+  }
+
+  JournalFileHeader header{};
+  memcpy(header.magic, JournalFileHeader::kMagic, sizeof(header.magic));
+  header.version = JournalFileHeader::kVersion;
+  header.record_size = sizeof(JournalRecord);
+  if (fwrite(&header, sizeof(header), 1, m_file_) != 1) {
+    if (!m_open_failed_)
+      CRANE_ERROR("Failed to write event journal {}: {}. Retry later.",
+                  m_path_, strerror(errno));
+    m_open_failed_ = true;
+    fclose(m_file_);
+    m_file_ = nullptr;
+    return false;
+  }
+  m_file_size_ = sizeof(header);
+
+  if (m_open_failed_) {
+    CRANE_INFO("Event journal {} is reopened.", m_path_);
+    m_open_failed_ = false;
+  }
+  return true;
+}
+
+}  // namespace Ctld
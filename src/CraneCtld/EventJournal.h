@@ -0,0 +1,187 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#pragma once
+
+#include "CtldPublicDefs.h"
+// Precompiled header comes first!
+
+namespace Ctld {
+
+enum class JournalEventType : uint16_t {
+  // craned_id is rejected for the task. reason: NodeRejectReason.
+  kNodeRejected = 0,
+  // arg0: expected start time in unix seconds. arg1: number of nodes.
+  kStartTimeChosen,
+  // The resource on craned_id is held in the timeline for the task which
+  // starts later. arg0, arg1: start and end time in unix seconds.
+  kResourceReserved,
+  // The task is not started. reason: NoStartReason.
+  kNotStarted,
+  // arg0: old TaskStatus. arg1: new TaskStatus.
+  kStatusChanged,
+  // reason: JournalRpcType. arg0: CraneErr of the outcome.
+  kRpcOutcome,
+  // arg0: number of records dropped because the ring buffer was full.
+  kRecordsDropped,
+  kEventTypeNum
+};
+
+enum class JournalRpcType : uint16_t {
+  kSubmitBatchTask = 0,
+  kCancelTask,
+  kModifyTask,
+  kRpcTypeNum
+};
+
+/**
+ * The on-disk record of EventJournal. A journal file is a JournalFileHeader
+ * followed by records in host byte order.
+ */
+struct JournalRecord {
+  int64_t time_ns;
+  task_id_t task_id;
+  JournalEventType type;
+  uint16_t reason;
+  int64_t arg0;
+  int64_t arg1;
+  // Not NUL-terminated if the craned id is 32 bytes or longer. Longer ids
+  // are truncated.
+  char craned_id[32];
+
+  std::string_view CranedId() const {
+    return {craned_id, strnlen(craned_id, sizeof(craned_id))};
+  }
+};
+
+static_assert(sizeof(JournalRecord) == 64);
+static_assert(std::is_trivially_copyable_v<JournalRecord>);
+
+struct JournalFileHeader {
+  static constexpr char kMagic[8] = {'C', 'R', 'N', 'J', 'R', 'N', 'L', 0};
+  static constexpr uint32_t kVersion = 1;
+
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+};
+
+std::string_view NodeRejectReasonStr(PendingDiagnosis::NodeRejectReason reason);
+std::string_view NoStartReasonStr(PendingDiagnosis::NoStartReason reason);
+
+// Read all the records in a journal file.
+result::result<std::vector<JournalRecord>, std::string> ReadJournalFile(
+    const std::string& path);
+
+// Format a record as a line of text or as a JSON object.
+std::string FormatJournalRecord(const JournalRecord& record, bool json);
+
+/**
+ * A low-overhead binary journal of scheduling decisions, task status
+ * changes and RPC outcomes.
+ *
+ * Each thread appends fixed-size records to its own single-producer ring
+ * buffer without any lock. A flush thread drains the rings into a file
+ * which is rotated by size. When a ring is full, records are dropped and
+ * counted instead of blocking the caller. The ring of an exited thread is
+ * freed once its records are flushed. If the file can not be opened, the
+ * records are kept in the rings and the open is retried on the next flush.
+ */
+class EventJournal {
+ public:
+  EventJournal();
+  ~EventJournal();
+
+  bool Init(const std::string& path, uint64_t max_file_size,
+            uint32_t max_file_num);
+
+  void NodeRejected(task_id_t task_id, const CranedId& craned_id,
+                    PendingDiagnosis::NodeRejectReason reason);
+
+  void StartTimeChosen(task_id_t task_id, absl::Time start_time,
+                       uint32_t node_num);
+
+  void ResourceReserved(task_id_t task_id, const CranedId& craned_id,
+                        absl::Time start_time, absl::Time end_time);
+
+  void NotStarted(task_id_t task_id, PendingDiagnosis::NoStartReason reason);
+
+  void StatusChanged(task_id_t task_id, crane::grpc::TaskStatus old_status,
+                     crane::grpc::TaskStatus new_status);
+
+  void RpcOutcome(task_id_t task_id, JournalRpcType type, CraneErr err);
+
+  // Write all the records appended so far to the file.
+  void Flush();
+
+  // The number of rings which are not freed yet.
+  size_t ThreadRingNum();
+
+ private:
+  static constexpr uint64_t kRingCapacity = 4096;
+  static_assert((kRingCapacity & (kRingCapacity - 1)) == 0);
+
+  static constexpr absl::Duration kFlushInterval = absl::Milliseconds(100);
+
+  struct ThreadRing {
+    std::array<JournalRecord, kRingCapacity> records;
+    // Written only by the owner thread.
+    alignas(64) std::atomic<uint64_t> head{0};
+    // Written only by the flushing thread.
+    alignas(64) std::atomic<uint64_t> tail{0};
+    std::atomic<uint64_t> dropped{0};
+    // Set when the owner thread exits. No record is appended afterwards.
+    std::atomic_bool retired{false};
+  };
+
+  void Append_(JournalEventType type, task_id_t task_id, uint16_t reason,
+               int64_t arg0, int64_t arg1, std::string_view craned_id = {});
+
+  ThreadRing* LocalRing_();
+
+  void FlushThread_();
+
+  void DrainNoLock_() ABSL_EXCLUSIVE_LOCKS_REQUIRED(m_file_mtx_);
+
+  bool WriteNoLock_(const JournalRecord* records, size_t num)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(m_file_mtx_);
+
+  bool OpenFileNoLock_() ABSL_EXCLUSIVE_LOCKS_REQUIRED(m_file_mtx_);
+
+  const uint64_t m_instance_id_;
+
+  // Shared with the owner threads. A retired ring is removed after it is
+  // drained.
+  absl::Mutex m_rings_mtx_;
+  std::vector<std::shared_ptr<ThreadRing>> m_rings_
+      ABSL_GUARDED_BY(m_rings_mtx_);
+
+  absl::Mutex m_file_mtx_;
+  std::string m_path_ ABSL_GUARDED_BY(m_file_mtx_);
+  uint64_t m_max_file_size_ ABSL_GUARDED_BY(m_file_mtx_){0};
+  uint32_t m_max_file_num_ ABSL_GUARDED_BY(m_file_mtx_){0};
+  FILE* m_file_ ABSL_GUARDED_BY(m_file_mtx_){nullptr};
+  uint64_t m_file_size_ ABSL_GUARDED_BY(m_file_mtx_){0};
+  // Only the first failure of a series of retries is logged.
+  bool m_open_failed_ ABSL_GUARDED_BY(m_file_mtx_){false};
+
+  std::thread m_flush_thread_;
+  std::atomic_bool m_thread_stop_{false};
+};
+
+}  // namespace Ctld
+
+inline std::unique_ptr<Ctld::EventJournal> g_event_journal;
@@ -0,0 +1,54 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "FreeResourceIndex.h"
+
+namespace Ctld {
+
+FreeResourceIndex::Key FreeResourceIndex::KeyOf(
+    const ResourceInNode& res_avail) {
+  uint64_t slot_num = 0;
+  for (const auto& [name, type_slots_map] :
+       res_avail.dedicated_res.name_type_slots_map)
+    for (const auto& [type, slots] : type_slots_map.type_slots_map)
+      slot_num += slots.size();
+
+  return {res_avail.allocatable_res.cpu_count,
+          res_avail.allocatable_res.memory_bytes, slot_num};
+}
+
+void FreeResourceIndex::Insert(const CranedId& craned_id,
+                               const ResourceInNode& res_avail) {
+  Key key = KeyOf(res_avail);
+  m_key_node_set_.emplace(key, craned_id);
+  m_node_key_map_.emplace(craned_id, key);
+}
+
+void FreeResourceIndex::Update(const CranedId& craned_id,
+                               const ResourceInNode& res_avail) {
+  Erase(craned_id);
+  Insert(craned_id, res_avail);
+}
+
+void FreeResourceIndex::Erase(const CranedId& craned_id) {
+  auto key_it = m_node_key_map_.find(craned_id);
+  if (key_it == m_node_key_map_.end()) return;
+
+  m_key_node_set_.erase({key_it->second, craned_id});
+  m_node_key_map_.erase(key_it);
+}
+
+}  // namespace Ctld
@@ -0,0 +1,82 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#pragma once
+
+#include "CtldPublicDefs.h"
+// Precompiled header comes first!
+
+namespace Ctld {
+
+/**
+ * Nodes ordered by their free resource in ascending order, i.e., by cpu
+ * first, then memory and then the number of free device slots.
+ *
+ * Used by BestFit to visit the nodes which leave the least resource after
+ * placing a task first. The nodes with less cpu than requested are skipped
+ * without being visited. Nodes with the same free resource are visited in
+ * the order of their ids.
+ */
+class FreeResourceIndex {
+ public:
+  // cpu, memory, device slot num
+  using Key = std::tuple<cpu_t, uint64_t, uint64_t>;
+
+  static Key KeyOf(const ResourceInNode& res_avail);
+
+  void Insert(const CranedId& craned_id, const ResourceInNode& res_avail);
+
+  // Insert the node if it is not in the index yet.
+  void Update(const CranedId& craned_id, const ResourceInNode& res_avail);
+
+  void Erase(const CranedId& craned_id);
+
+  size_t Size() const { return m_node_key_map_.size(); }
+
+  /**
+   * Call fn(craned_id, res_key) on the nodes with at least cpu free, from the
+   * node with the least free resource, until fn returns false.
+   */
+  template <typename Fn>
+  void ForEachFromLeast(cpu_t cpu, Fn&& fn) const {
+    for (auto it = m_key_node_set_.lower_bound({Key{cpu, 0, 0}, CranedId{}});
+         it != m_key_node_set_.end(); ++it)
+      if (!fn(it->second, it->first)) return;
+  }
+
+  /**
+   * Append at most limit nodes with at least cpu free on which runnable
+   * returns true to selected, from the node with the least free resource.
+   * This is how BestFit picks the nodes of a task which can run now.
+   */
+  template <typename Pred>
+  void SelectFromLeast(cpu_t cpu, size_t limit, Pred&& runnable,
+                       std::vector<CranedId>* selected) const {
+    if (selected->size() >= limit) return;
+    ForEachFromLeast(cpu, [&](const CranedId& craned_id, const Key& /*key*/) {
+      if (runnable(craned_id)) selected->emplace_back(craned_id);
+      return selected->size() < limit;
+    });
+  }
+
+ private:
+  // The node id is a part of the key, so that a node is erased by one
+  // lookup even if many nodes have the same free resource.
+  absl::btree_set<std::pair<Key, CranedId>> m_key_node_set_;
+  absl::flat_hash_map<CranedId, Key> m_node_key_map_;
+};
+
+}  // namespace Ctld
@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "IdleNodeIndex.h"
+
+namespace Ctld {
+
+void IdleNodeIndex::AddNode(const CranedId& craned_id,
+                            const std::list<PartitionId>& part_ids,
+                            absl::Time idle_since) {
+  absl::MutexLock lock_guard(&m_mtx_);
+  if (!m_node_entries_.emplace(craned_id, NodeEntry{idle_since, part_ids})
+           .second)
+    return;
+
+  for (const auto& part_id : part_ids)
+    m_part_idle_nodes_[part_id].emplace(idle_since, craned_id);
+}
+
+void IdleNodeIndex::RemoveNode(const CranedId& craned_id) {
+  absl::MutexLock lock_guard(&m_mtx_);
+  auto it = m_node_entries_.find(craned_id);
+  if (it == m_node_entries_.end()) return;
+
+  for (const auto& part_id : it->second.part_ids)
+    m_part_idle_nodes_[part_id].erase({it->second.idle_since, craned_id});
+  m_node_entries_.erase(it);
+}
+
+bool IdleNodeIndex::Contains(const CranedId& craned_id) const {
+  absl::ReaderMutexLock lock_guard(&m_mtx_);
+  return m_node_entries_.contains(craned_id);
+}
+
+std::vector<CranedId> IdleNodeIndex::GetIdleNodes(
+    const PartitionId& partition_id, size_t limit) const {
+  std::vector<CranedId> craned_ids;
+
+  absl::ReaderMutexLock lock_guard(&m_mtx_);
+  auto part_it = m_part_idle_nodes_.find(partition_id);
+  if (part_it == m_part_idle_nodes_.end()) return craned_ids;
+
+  for (const auto& [idle_since, craned_id] : part_it->second) {
+    if (craned_ids.size() >= limit) break;
+    craned_ids.emplace_back(craned_id);
+  }
+  return craned_ids;
+}
+
+size_t IdleNodeIndex::IdleNodeNum(const PartitionId& partition_id) const {
+  absl::ReaderMutexLock lock_guard(&m_mtx_);
+  auto part_it = m_part_idle_nodes_.find(partition_id);
+  return part_it == m_part_idle_nodes_.end() ? 0 : part_it->second.size();
+}
+
+}  // namespace Ctld
@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#pragma once
+
+#include "CtldPublicDefs.h"
+// Precompiled header comes first!
+
+namespace Ctld {
+
+/**
+ * The alive and undrained nodes running no task, per partition, ordered by
+ * the time since which they have been idle. Exclusive tasks take whole nodes
+ * from here without walking the resource timeline of every node.
+ *
+ * It is kept up to date by CranedMetaContainer while the craned meta lock is
+ * held, so its own lock comes after the craned meta lock.
+ */
+class IdleNodeIndex {
+ public:
+  IdleNodeIndex() = default;
+
+  /**
+   * Add a node into the index of every partition in part_ids. A node
+   * already in the index is kept with its original idle time.
+   */
+  void AddNode(const CranedId& craned_id,
+               const std::list<PartitionId>& part_ids, absl::Time idle_since);
+
+  void RemoveNode(const CranedId& craned_id);
+
+  bool Contains(const CranedId& craned_id) const;
+
+  /**
+   * @return at most limit idle nodes of the partition, the ones idle for
+   * the longest time first.
+   */
+  std::vector<CranedId> GetIdleNodes(const PartitionId& partition_id,
+                                     size_t limit) const;
+
+  size_t IdleNodeNum(const PartitionId& partition_id) const;
+
+ private:
+  using Key = std::pair<absl::Time /*idle since*/, CranedId>;
+
+  struct NodeEntry {
+    absl::Time idle_since;
+    std::list<PartitionId> part_ids;
+  };
+
+  mutable absl::Mutex m_mtx_;
+  absl::flat_hash_map<PartitionId, absl::btree_set<Key>> m_part_idle_nodes_
+      ABSL_GUARDED_BY(m_mtx_);
+  absl::flat_hash_map<CranedId, NodeEntry> m_node_entries_
+      ABSL_GUARDED_BY(m_mtx_);
+};
+
+}  // namespace Ctld
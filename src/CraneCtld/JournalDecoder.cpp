@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+// Decode the event journal files written by CraneCtld, e.g.,
+//   cranectld_journal_decoder --task 42 journal.bin.1 journal.bin
+
+#include "CtldPublicDefs.h"
+// Precompiled header comes first!
+
+#include <cxxopts.hpp>
+
+#include "EventJournal.h"
+
+int main(int argc, char** argv) {
+  cxxopts::Options options("cranectld_journal_decoder",
+                           "Decode the event journal of CraneCtld");
+
+  // clang-format off
+  options.add_options()
+      ("j,json", "Print one JSON object per line")
+      ("t,task", "Only print the records of the task",
+       cxxopts::value<task_id_t>())
+      ("files", "Journal files", cxxopts::value<std::vector<std::string>>())
+      ("h,help", "Display help")
+      ;
+  // clang-format on
+  options.parse_positional({"files"});
+  options.positional_help("FILE...");
+
+  cxxopts::ParseResult parsed_args;
+  try {
+    parsed_args = options.parse(argc, argv);
+  } catch (cxxopts::OptionException& e) {
+    fmt::print(stderr, "{}\n{}\n", e.what(), options.help());
+    return 1;
+  }
+
+  if (parsed_args.count("help") > 0 || parsed_args.count("files") == 0) {
+    fmt::print("{}\n", options.help());
+    return 0;
+  }
+
+  std::vector<Ctld::JournalRecord> records;
+  for (const auto& path :
+       parsed_args["files"].as<std::vector<std::string>>()) {
+    auto result = Ctld::ReadJournalFile(path);
+    if (result.has_error()) {
+      fmt::print(stderr, "{}\n", result.error());
+      return 1;
+    }
+    records.insert(records.end(), result.value().begin(),
+                   result.value().end());
+  }
+
+  // Records are flushed thread by thread and thus are not in time order.
+  std::ranges::stable_sort(records, {}, &Ctld::JournalRecord::time_ns);
+
+  bool json = parsed_args.count("json") > 0;
+  bool filter_task = parsed_args.count("task") > 0;
+  task_id_t task_id = filter_task ? parsed_args["task"].as<task_id_t>() : 0;
+
+  for (const auto& record : records) {
+    if (filter_task && record.task_id != task_id) continue;
+    fmt::print("{}\n", Ctld::FormatJournalRecord(record, json));
+  }
+
+  return 0;
+}
@@ -0,0 +1,61 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "Preemption.h"
+
+namespace Ctld {
+
+bool SelectPreemptionVictimsInNode(const ResourceInNode& avail_res,
+                                   const ResourceView& request,
+                                   std::vector<PreemptCandidate> candidates,
+                                   std::vector<task_id_t>* victims) {
+  victims->clear();
+  if (request <= avail_res) return true;
+
+  std::ranges::sort(candidates, [](const PreemptCandidate& lhs,
+                                   const PreemptCandidate& rhs) {
+    if (lhs.qos_priority != rhs.qos_priority)
+      return lhs.qos_priority < rhs.qos_priority;
+    return lhs.start_time > rhs.start_time;
+  });
+
+  ResourceInNode res = avail_res;
+  size_t chosen_num = 0;
+  while (!(request <= res)) {
+    if (chosen_num == candidates.size()) return false;
+    res += candidates[chosen_num].res;
+    chosen_num++;
+  }
+
+  // The last chosen task is always needed. Try to spare the others, the
+  // ones of higher priority first.
+  std::vector<bool> spared(chosen_num, false);
+  for (size_t i = chosen_num - 1; i-- > 0;) {
+    ResourceInNode res_without = res;
+    res_without -= candidates[i].res;
+    if (request <= res_without) {
+      res = std::move(res_without);
+      spared[i] = true;
+    }
+  }
+
+  for (size_t i = 0; i < chosen_num; i++)
+    if (!spared[i]) victims->emplace_back(candidates[i].task_id);
+
+  return true;
+}
+
+}  // namespace Ctld
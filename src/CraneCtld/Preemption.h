@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#pragma once
+
+#include "CtldPublicDefs.h"
+// Precompiled header comes first!
+
+namespace Ctld {
+
+// A running task on a node which may be preempted.
+struct PreemptCandidate {
+  task_id_t task_id;
+  uint32_t qos_priority;
+  absl::Time start_time;
+  // The resource of the task on this node.
+  ResourceInNode res;
+};
+
+/**
+ * Choose the tasks to preempt on a node so that the request fits into
+ * avail_res plus the resource of the chosen tasks.
+ *
+ * Candidates of lower qos priority are chosen first and, among the same
+ * priority, the ones started later, which lose less work. Chosen tasks that
+ * turn out to be unnecessary are dropped afterward, so no task in victims
+ * can be spared.
+ * @return false if the request doesn't fit even when all candidates are
+ * preempted.
+ */
+bool SelectPreemptionVictimsInNode(const ResourceInNode& avail_res,
+                                   const ResourceView& request,
+                                   std::vector<PreemptCandidate> candidates,
+                                   std::vector<task_id_t>* victims);
+
+}  // namespace Ctld
@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "Reservation.h"
+
+namespace Ctld {
+
+namespace {
+
+using Timeline = std::map<absl::Time, ResourceInNode>;
+
+// Make time a time point of the timeline if it is in the range of the
+// timeline, so that the intervals before and after it can differ.
+void SplitTimelineAt(absl::Time time, Timeline* timeline) {
+  if (time <= timeline->begin()->first || timeline->contains(time)) return;
+
+  auto prev_it = std::prev(timeline->upper_bound(time));
+  timeline->emplace(time, prev_it->second);
+}
+
+}  // namespace
+
+void SubtractAllocatableResSaturated(const AllocatableResource& rhs,
+                                     AllocatableResource* lhs) {
+  lhs->cpu_count = lhs->cpu_count > rhs.cpu_count
+                       ? lhs->cpu_count - rhs.cpu_count
+                       : cpu_t{0};
+  lhs->memory_bytes = lhs->memory_bytes > rhs.memory_bytes
+                          ? lhs->memory_bytes - rhs.memory_bytes
+                          : 0;
+  lhs->memory_sw_bytes = lhs->memory_sw_bytes > rhs.memory_sw_bytes
+                             ? lhs->memory_sw_bytes - rhs.memory_sw_bytes
+                             : 0;
+}
+
+void BlockReservationInTimeline(const Reservation& reservation, absl::Time now,
+                                Timeline* timeline) {
+  absl::Time start = std::max(reservation.start_time, now);
+  absl::Time end = reservation.end_time;
+  if (end <= start) return;
+
+  SplitTimelineAt(start, timeline);
+  SplitTimelineAt(end, timeline);
+
+  for (auto it = timeline->lower_bound(start);
+       it != timeline->end() && it->first < end; ++it) {
+    if (reservation.whole_node)
+      it->second.SetToZero();
+    else
+      SubtractAllocatableResSaturated(reservation.res_per_node,
+                                      &it->second.allocatable_res);
+  }
+}
+
+void RestrictTimelineToReservation(
+    const Reservation& reservation, absl::Time now,
+    const std::vector<std::pair<absl::Time, AllocatableResource>>&
+        task_usages,
+    Timeline* timeline) {
+  absl::Time start = std::max(reservation.start_time, now);
+  absl::Time end = reservation.end_time;
+
+  SplitTimelineAt(start, timeline);
+  SplitTimelineAt(end, timeline);
+  if (!reservation.whole_node) {
+    for (const auto& [task_end_time, res] : task_usages)
+      if (start < task_end_time && task_end_time < end)
+        SplitTimelineAt(task_end_time, timeline);
+  }
+
+  for (auto& [time, res] : *timeline) {
+    if (time < start || time >= end) {
+      res.SetToZero();
+      continue;
+    }
+    // Other tasks are kept out of a whole node by the reservation, so the
+    // timeline is already what the tasks in it can use.
+    if (reservation.whole_node) continue;
+
+    AllocatableResource cap = reservation.res_per_node;
+    for (const auto& [task_end_time, task_res] : task_usages)
+      if (task_end_time > time) SubtractAllocatableResSaturated(task_res, &cap);
+
+    res.allocatable_res.cpu_count =
+        std::min(res.allocatable_res.cpu_count, cap.cpu_count);
+    res.allocatable_res.memory_bytes =
+        std::min(res.allocatable_res.memory_bytes, cap.memory_bytes);
+    res.allocatable_res.memory_sw_bytes =
+        std::min(res.allocatable_res.memory_sw_bytes, cap.memory_sw_bytes);
+    res.dedicated_res.SetToZero();
+  }
+}
+
+bool RestrictPreemptionNodesByReservations(
+    const std::string& task_reservation, absl::Duration time_limit,
+    absl::Time now, const std::vector<Reservation>& reservations,
+    std::unordered_set<CranedId>* craned_ids) {
+  if (!task_reservation.empty()) {
+    auto rsv_it = std::ranges::find_if(
+        reservations, [&](const Reservation& reservation) {
+          return reservation.name == task_reservation;
+        });
+    if (rsv_it == reservations.end() || now < rsv_it->start_time ||
+        now >= rsv_it->end_time)
+      return false;
+
+    std::erase_if(*craned_ids, [&](const CranedId& craned_id) {
+      return !rsv_it->craned_ids.contains(craned_id);
+    });
+    return true;
+  }
+
+  absl::Time end = now + time_limit;
+  for (const auto& reservation : reservations) {
+    if (reservation.end_time <= now || reservation.start_time >= end)
+      continue;
+    for (const auto& craned_id : reservation.craned_ids)
+      craned_ids->erase(craned_id);
+  }
+  return true;
+}
+
+}  // namespace Ctld
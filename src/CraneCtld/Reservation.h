@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#pragma once
+
+#include "CtldPublicDefs.h"
+// Precompiled header comes first!
+
+namespace Ctld {
+
+/**
+ * An advance reservation. During [start_time, end_time), the reserved
+ * resource on craned_ids can only be used by the tasks submitted to the
+ * reservation by the allowed users and accounts.
+ */
+struct Reservation {
+  std::string name;
+  PartitionId partition_id;
+  std::unordered_set<CranedId> craned_ids;
+
+  // If false, only res_per_node is reserved on each node and the rest of
+  // the node is still open to other tasks. Devices can only be reserved
+  // with the whole node.
+  bool whole_node{true};
+  AllocatableResource res_per_node;
+
+  absl::Time start_time;
+  absl::Time end_time;
+
+  std::unordered_set<std::string> allowed_users;
+  std::unordered_set<std::string> allowed_accounts;
+
+  crane::grpc::ReservationInfo info;
+};
+
+/**
+ * The functions below modify the timeline of the available resource on a
+ * node in the reservation, i.e., the TimeAvailResMap of MinLoadFirst whose
+ * first time point is now.
+ */
+
+/**
+ * Block the reservation in the timeline seen by the tasks outside of it.
+ * The resource of the running tasks in the reservation is expected to be
+ * already added back to the timeline since it is a part of the reserved
+ * resource. Tasks may still be backfilled before start_time.
+ */
+void BlockReservationInTimeline(const Reservation& reservation, absl::Time now,
+                                std::map<absl::Time, ResourceInNode>* timeline);
+
+/**
+ * Restrict the timeline to what the tasks in the reservation can use: zero
+ * outside of the reservation and, for a partial reservation, no more than
+ * res_per_node minus the resource held by the running tasks in it.
+ * @param task_usages the end time and the resource of the running tasks of
+ * the reservation on this node.
+ */
+void RestrictTimelineToReservation(
+    const Reservation& reservation, absl::Time now,
+    const std::vector<std::pair<absl::Time, AllocatableResource>>&
+        task_usages,
+    std::map<absl::Time, ResourceInNode>* timeline);
+
+/**
+ * Restrict craned_ids to the nodes on which a pending task may preempt other
+ * tasks now. A task in a reservation can only start on the nodes of the
+ * reservation while it is active. Other tasks can't start on the nodes
+ * reserved at any time of [now, now + time_limit), so preempting tasks there
+ * frees nothing for them. Partial reservations exclude their nodes as well
+ * since the resource freed may be a part of the reserved one.
+ * @param task_reservation the reservation of the task. Empty if none.
+ * @return false if the task can't preempt any task now.
+ */
+bool RestrictPreemptionNodesByReservations(
+    const std::string& task_reservation, absl::Duration time_limit,
+    absl::Time now, const std::vector<Reservation>& reservations,
+    std::unordered_set<CranedId>* craned_ids);
+
+// Subtract rhs from lhs. The components smaller than that of rhs become 0.
+void SubtractAllocatableResSaturated(const AllocatableResource& rhs,
+                                     AllocatableResource* lhs);
+
+}  // namespace Ctld
@@ -0,0 +1,220 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "ReservationManager.h"
+
+#include "EmbeddedDbClient.h"
+
+namespace Ctld {
+
+bool ReservationManager::Init() {
+  crane::grpc::ReservationList list;
+  if (!g_embedded_db_client->FetchReservations(&list)) {
+    CRANE_ERROR("Failed to fetch reservations from the embedded db.");
+    return false;
+  }
+
+  absl::MutexLock lock_guard(&m_mtx_);
+  for (const auto& info : list.reservations()) {
+    auto result = BuildReservation_(info);
+    if (result.has_error()) {
+      CRANE_ERROR("Drop invalid reservation '{}': {}", info.name(),
+                  result.error());
+      continue;
+    }
+    m_reservations_.emplace(info.name(), std::move(result.value()));
+  }
+
+  CRANE_INFO("{} reservation(s) recovered.", m_reservations_.size());
+  return true;
+}
+
+result::result<void, std::string> ReservationManager::CreateReservation(
+    const crane::grpc::ReservationInfo& info) {
+  auto result = BuildReservation_(info);
+  if (result.has_error()) return result::fail(result.error());
+
+  Reservation& reservation = result.value();
+  if (reservation.end_time <= absl::Now())
+    return result::fail("The reservation has already ended.");
+
+  absl::MutexLock lock_guard(&m_mtx_);
+  if (m_reservations_.contains(reservation.name))
+    return result::fail(
+        fmt::format("Reservation '{}' already exists.", reservation.name));
+
+  for (const auto& [name, other] : m_reservations_) {
+    if (other.end_time <= reservation.start_time ||
+        reservation.end_time <= other.start_time)
+      continue;
+
+    for (const auto& craned_id : reservation.craned_ids) {
+      if (other.craned_ids.contains(craned_id))
+        return result::fail(fmt::format(
+            "Node {} is reserved by '{}' in the same period.", craned_id,
+            name));
+    }
+  }
+
+  std::string name = reservation.name;
+  m_reservations_.emplace(name, std::move(reservation));
+  if (!PersistNoLock_()) {
+    m_reservations_.erase(name);
+    return result::fail("Failed to persist the reservation.");
+  }
+
+  CRANE_INFO("Reservation '{}' is created.", name);
+  return {};
+}
+
+result::result<void, std::string> ReservationManager::DeleteReservation(
+    const std::string& name) {
+  absl::MutexLock lock_guard(&m_mtx_);
+
+  auto it = m_reservations_.find(name);
+  if (it == m_reservations_.end())
+    return result::fail(fmt::format("Reservation '{}' not found.", name));
+
+  Reservation reservation = std::move(it->second);
+  m_reservations_.erase(it);
+  if (!PersistNoLock_()) {
+    m_reservations_.emplace(name, std::move(reservation));
+    return result::fail("Failed to persist the deletion.");
+  }
+
+  CRANE_INFO("Reservation '{}' is deleted.", name);
+  return {};
+}
+
+void ReservationManager::QueryReservations(
+    const std::string& name,
+    google::protobuf::RepeatedPtrField<crane::grpc::ReservationInfo>* list) {
+  absl::MutexLock lock_guard(&m_mtx_);
+
+  for (const auto& [rsv_name, reservation] : m_reservations_) {
+    if (!name.empty() && rsv_name != name) continue;
+    *list->Add() = reservation.info;
+  }
+}
+
+std::vector<Reservation> ReservationManager::GetReservations(absl::Time now) {
+  std::vector<Reservation> reservations;
+  bool removed = false;
+
+  absl::MutexLock lock_guard(&m_mtx_);
+  for (auto it = m_reservations_.begin(); it != m_reservations_.end();) {
+    if (it->second.end_time <= now) {
+      CRANE_INFO("Reservation '{}' has ended.", it->first);
+      it = m_reservations_.erase(it);
+      removed = true;
+      continue;
+    }
+    reservations.emplace_back(it->second);
+    ++it;
+  }
+
+  if (removed && !PersistNoLock_())
+    CRANE_ERROR("Failed to persist the removal of ended reservations.");
+
+  return reservations;
+}
+
+result::result<void, std::string> ReservationManager::CheckTaskInReservation(
+    const TaskInCtld& task) {
+  absl::MutexLock lock_guard(&m_mtx_);
+
+  auto it = m_reservations_.find(task.reservation);
+  if (it == m_reservations_.end())
+    return result::fail(
+        fmt::format("Reservation '{}' not found.", task.reservation));
+
+  const Reservation& reservation = it->second;
+  if (reservation.partition_id != task.partition_id)
+    return result::fail(
+        fmt::format("Reservation '{}' is in partition '{}'.", task.reservation,
+                    reservation.partition_id));
+
+  bool open_to_all = reservation.allowed_users.empty() &&
+                     reservation.allowed_accounts.empty();
+  if (!open_to_all && !reservation.allowed_users.contains(task.Username()) &&
+      !reservation.allowed_accounts.contains(task.account))
+    return result::fail(
+        fmt::format("User '{}' with account '{}' can't use reservation '{}'.",
+                    task.Username(), task.account, task.reservation));
+
+  absl::Time start = std::max(reservation.start_time, absl::Now());
+  if (reservation.end_time - start < task.time_limit)
+    return result::fail(fmt::format(
+        "The time limit exceeds the rest of reservation '{}'.",
+        task.reservation));
+
+  return {};
+}
+
+result::result<Reservation, std::string> ReservationManager::BuildReservation_(
+    const crane::grpc::ReservationInfo& info) {
+  Reservation reservation;
+
+  if (info.name().empty()) return result::fail("Empty reservation name.");
+  reservation.name = info.name();
+
+  auto part_it = g_config.Partitions.find(info.partition());
+  if (part_it == g_config.Partitions.end())
+    return result::fail(
+        fmt::format("Partition '{}' doesn't exist.", info.partition()));
+  reservation.partition_id = info.partition();
+
+  std::list<std::string> host_list;
+  if (!util::ParseHostList(info.nodelist(), &host_list) || host_list.empty())
+    return result::fail(
+        fmt::format("Invalid node list '{}'.", info.nodelist()));
+  for (auto& host : host_list) {
+    if (!part_it->second.nodes.contains(host))
+      return result::fail(fmt::format("Node {} is not in partition '{}'.",
+                                      host, info.partition()));
+    reservation.craned_ids.emplace(std::move(host));
+  }
+
+  if (info.has_res_per_node()) {
+    reservation.whole_node = false;
+    reservation.res_per_node = AllocatableResource(info.res_per_node());
+    if (reservation.res_per_node.IsZero())
+      return result::fail("Empty resource per node.");
+  }
+
+  reservation.start_time = absl::FromUnixSeconds(info.start_time().seconds());
+  reservation.end_time = absl::FromUnixSeconds(info.end_time().seconds());
+  if (reservation.end_time <= reservation.start_time)
+    return result::fail("The end time must be later than the start time.");
+
+  reservation.allowed_users.insert(info.allowed_users().begin(),
+                                   info.allowed_users().end());
+  reservation.allowed_accounts.insert(info.allowed_accounts().begin(),
+                                      info.allowed_accounts().end());
+
+  reservation.info = info;
+  return reservation;
+}
+
+bool ReservationManager::PersistNoLock_() {
+  crane::grpc::ReservationList list;
+  for (const auto& [name, reservation] : m_reservations_)
+    *list.add_reservations() = reservation.info;
+
+  return g_embedded_db_client->StoreReservations(list);
+}
+
+}  // namespace Ctld
@@ -0,0 +1,70 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#pragma once
+
+#include "CtldPublicDefs.h"
+// Precompiled header comes first!
+
+#include "Reservation.h"
+
+namespace Ctld {
+
+/**
+ * Keeps the advance reservations created by administrators. Reservations
+ * are persisted in the embedded db and removed once they end.
+ */
+class ReservationManager {
+ public:
+  ReservationManager() = default;
+
+  // Load the reservations stored in the embedded db.
+  bool Init();
+
+  result::result<void, std::string> CreateReservation(
+      const crane::grpc::ReservationInfo& info);
+
+  result::result<void, std::string> DeleteReservation(const std::string& name);
+
+  // Query all the reservations if name is empty.
+  void QueryReservations(
+      const std::string& name,
+      google::protobuf::RepeatedPtrField<crane::grpc::ReservationInfo>* list);
+
+  // Get the reservations which have not ended before now. The ended ones
+  // are removed.
+  std::vector<Reservation> GetReservations(absl::Time now);
+
+  /**
+   * Check whether the task is allowed to use the reservation it names and
+   * can finish before the reservation ends.
+   */
+  result::result<void, std::string> CheckTaskInReservation(
+      const TaskInCtld& task);
+
+ private:
+  static result::result<Reservation, std::string> BuildReservation_(
+      const crane::grpc::ReservationInfo& info);
+
+  bool PersistNoLock_() ABSL_EXCLUSIVE_LOCKS_REQUIRED(m_mtx_);
+
+  absl::Mutex m_mtx_;
+  std::map<std::string, Reservation> m_reservations_ ABSL_GUARDED_BY(m_mtx_);
+};
+
+}  // namespace Ctld
+
+inline std::unique_ptr<Ctld::ReservationManager> g_reservation_manager;
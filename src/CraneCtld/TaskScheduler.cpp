@@ -26,12 +26,35 @@
 #include "CranedMetaContainer.h"
 #include "CtldPublicDefs.h"
 #include "EmbeddedDbClient.h"
+#include "EventJournal.h"
+#include "Preemption.h"
+#include "ReservationManager.h"
 #include "crane/PluginClient.h"
 #include "crane/PublicHeader.h"
 #include "protos/PublicDefs.pb.h"
 
 namespace Ctld {
 
+namespace {
+
+// The TaskInfo fields of a task copied on the scheduling thread and turned
+// into TaskInfo on the plugin thread, since the task may be changed or freed
+// after the hook is called.
+class TaskInfoSnapshot final : public plugin::PluginClient::TaskSnapshot {
+ public:
+  explicit TaskInfoSnapshot(TaskInCtld const& task)
+      : m_fields_(task.GetTaskInfoFields()) {}
+
+  void MoveToTaskInfo(crane::grpc::TaskInfo* task_info) override {
+    std::move(m_fields_).MoveToTaskInfo(task_info);
+  }
+
+ private:
+  TaskInfoFields m_fields_;
+};
+
+}  // namespace
+
 TaskScheduler::TaskScheduler() {
   if (g_config.PriorityConfig.Type == Config::Priority::Basic) {
     CRANE_INFO("basic priority sorter is selected.");
@@ -41,8 +64,15 @@ TaskScheduler::TaskScheduler() {
     m_priority_sorter_ = std::make_unique<MultiFactorPriority>();
   }
 
-  m_node_selection_algo_ =
-      std::make_unique<MinLoadFirst>(m_priority_sorter_.get());
+  if (g_config.NodeSelectionConfig.Type == Config::NodeSelection::BestFit) {
+    CRANE_INFO("best fit node selection algorithm is selected.");
+    m_node_selection_algo_ =
+        std::make_unique<BestFit>(m_priority_sorter_.get());
+  } else {
+    CRANE_INFO("min load first node selection algorithm is selected.");
+    m_node_selection_algo_ =
+        std::make_unique<MinLoadFirst>(m_priority_sorter_.get());
+  }
 }
 
 TaskScheduler::~TaskScheduler() {
@@ -279,23 +309,7 @@ bool TaskScheduler::Init() {
       }
     }
 
-    absl::BlockingCounter bl(craned_cgroups_map.size());
-    for (const auto& [craned_id, cgroups] : craned_cgroups_map) {
-      g_thread_pool->detach_task([&bl, &craned_id, &cgroups]() {
-        auto stub = g_craned_keeper->GetCranedStub(craned_id);
-
-        // If the craned is down, just ignore it.
-        if (stub && !stub->Invalid()) {
-          CraneErr err = stub->ReleaseCgroupForTasks(cgroups);
-          if (err != CraneErr::kOk) {
-            CRANE_ERROR("Failed to Release cgroup RPC for {} tasks on Node {}",
-                        cgroups.size(), craned_id);
-          }
-        }
-        bl.DecrementCount();
-      });
-    }
-    bl.Wait();
+    ReleaseCgroupOnCraneds_(craned_cgroups_map);
   }
 
   // Process the pending tasks in the embedded pending queue.
@@ -643,6 +657,7 @@ void TaskScheduler::ScheduleThread_() {
     // m_pending_task_map_mtx_ needs to be acquired. Deadlock may happen under
     // such a situation.
     m_pending_task_map_mtx_.Lock();
+
     if (!m_pending_task_map_.empty()) {  // all_part_metas is locked here.
       // Running map must be locked before g_meta_container's lock.
       // Otherwise, DEADLOCK may happen because TaskStatusChange() locks running
@@ -659,6 +674,22 @@ void TaskScheduler::ScheduleThread_() {
       m_node_selection_algo_->NodeSelect(
           m_running_task_map_, &m_pending_task_map_, &selection_result_list);
 
+      if (g_config.PreemptionConfig.Enabled) PreemptForPendingTasksNoLock_();
+
+      // The reservation of these tasks has ended or been deleted, so they
+      // can never start. Fail them instead of keeping them pending.
+      std::vector<std::unique_ptr<TaskInCtld>> rsv_ended_tasks;
+      for (auto it = m_pending_task_map_.begin();
+           it != m_pending_task_map_.end();) {
+        if (it->second->pending_diagnosis.no_start_reason !=
+            PendingDiagnosis::kReservationInactive) {
+          ++it;
+          continue;
+        }
+        rsv_ended_tasks.emplace_back(std::move(it->second));
+        it = m_pending_task_map_.erase(it);
+      }
+
       // Update cached pending map size
       m_pending_map_cached_size_.store(m_pending_task_map_.size(),
                                        std::memory_order::release);
@@ -666,6 +697,9 @@ void TaskScheduler::ScheduleThread_() {
       m_running_task_map_mtx_.Unlock();
       m_pending_task_map_mtx_.Unlock();
 
+      if (!rsv_ended_tasks.empty())
+        FailTasksOfEndedReservations_(rsv_ended_tasks);
+
       num_tasks_single_execution = selection_result_list.size();
 
       end = std::chrono::steady_clock::now();
@@ -679,7 +713,7 @@ void TaskScheduler::ScheduleThread_() {
         auto& task = it.first;
         PartitionId const& partition_id = task->partition_id;
 
-        task->SetStatus(crane::grpc::TaskStatus::Running);
+        SetTaskStatus_(task.get(), crane::grpc::TaskStatus::Running);
         task->SetCranedIds(std::move(it.second));
         task->nodes_alloc = task->CranedIds().size();
 
@@ -826,17 +860,16 @@ void TaskScheduler::ScheduleThread_() {
       // running queue before we call stub->ExecuteTasks().
       HashMap<CranedId, std::vector<TaskInCtld*>>
           craned_task_to_exec_raw_ptrs_map;
-      std::vector<crane::grpc::TaskInfo> tasks_post_start;
+      std::vector<plugin::PluginClient::TaskSnapshotPtr> tasks_post_start;
       for (auto& it : selection_result_list) {
         auto& task = it.first;
 
         // We need to copy TaskInCtld here since the ownership of task will be
-        // transferred before we call StartHook.
-        if (g_config.Plugin.Enabled) {
-          crane::grpc::TaskInfo task_info;
-          task->SetFieldsOfTaskInfo(&task_info);
-          tasks_post_start.emplace_back(std::move(task_info));
-        }
+        // transferred before we call StartHook. TaskInfo is built from the
+        // copy later on the plugin thread.
+        if (g_config.Plugin.Enabled)
+          tasks_post_start.emplace_back(
+              std::make_unique<TaskInfoSnapshot>(*task));
 
         for (const auto& craned_id : task->executing_craned_ids)
           craned_task_to_exec_raw_ptrs_map[craned_id].emplace_back(task.get());
@@ -905,6 +938,14 @@ void TaskScheduler::ScheduleThread_() {
             post_sched_time_point;
       }
 
+      // StartHook is called before ExecuteTasks RPC is sent, since the
+      // EndHook of a task may be triggered by its status change as soon as
+      // it is executed. PluginClient keeps the order in which they are
+      // called.
+      if (g_config.Plugin.Enabled && !tasks_post_start.empty()) {
+        g_plugin_client->StartHookAsync(std::move(tasks_post_start));
+      }
+
       HashSet<std::pair<CranedId, task_id_t>> failed_to_exec_task_id_set;
       for (auto const& [craned_id, tasks] : craned_exec_requests_map) {
         auto stub = g_craned_keeper->GetCranedStub(craned_id);
@@ -921,13 +962,6 @@ void TaskScheduler::ScheduleThread_() {
           failed_to_exec_task_id_set.emplace(craned_id, task_id);
       }
 
-      // After sending ExecuteTasks RPC, StartHook is called.
-      // This must before checking failed tasks as TaskStatusChangeAsync may
-      // trigger EndHook.
-      if (g_config.Plugin.Enabled && !tasks_post_start.empty()) {
-        g_plugin_client->StartHookAsync(std::move(tasks_post_start));
-      }
-
       // If any task failed during this stage,
       // call TaskStatusChangeAsync since the ownership of tasks
       // has been transferred.
@@ -998,7 +1032,7 @@ void TaskScheduler::ScheduleThread_() {
           auto& task = it.first;
           failed_task_raw_ptrs.emplace_back(task.get());
 
-          task->SetStatus(crane::grpc::Failed);
+          SetTaskStatus_(task.get(), crane::grpc::Failed);
           task->SetExitCode(ExitCode::kExitCodeCgroupError);
           task->SetEndTime(absl::Now());
         }
@@ -1119,6 +1153,42 @@ CraneErr TaskScheduler::ChangeTaskPriority(task_id_t task_id, double priority) {
   return CraneErr::kOk;
 }
 
+void TaskScheduler::QueryPendingReason(
+    const crane::grpc::QueryPendingReasonRequest& request,
+    crane::grpc::QueryPendingReasonReply* response) {
+  LockGuard pending_guard(&m_pending_task_map_mtx_);
+
+  auto pd_iter = m_pending_task_map_.find(request.task_id());
+  if (pd_iter == m_pending_task_map_.end()) {
+    response->set_ok(false);
+    response->set_reason(
+        fmt::format("Task #{} is not in pending queue.", request.task_id()));
+    return;
+  }
+
+  const TaskInCtld& task = *pd_iter->second;
+  const PendingDiagnosis& diagnosis = task.pending_diagnosis;
+
+  response->set_ok(true);
+  response->set_pending_reason(task.pending_reason);
+  response->set_not_started_reason(
+      std::string(NoStartReasonStr(diagnosis.no_start_reason)));
+  if (diagnosis.last_cycle_time != absl::InfinitePast())
+    response->mutable_last_cycle_time()->set_seconds(
+        ToUnixSeconds(diagnosis.last_cycle_time));
+  if (diagnosis.no_start_reason == PendingDiagnosis::kStartLater)
+    response->mutable_expected_start_time()->set_seconds(
+        ToUnixSeconds(diagnosis.expected_start_time));
+
+  for (uint16_t i = 0; i < PendingDiagnosis::kNodeRejectReasonNum; i++) {
+    if (diagnosis.rejected_node_cnt[i] == 0) continue;
+    auto* rejected_nodes = response->add_rejected_nodes();
+    rejected_nodes->set_reason(std::string(
+        NodeRejectReasonStr(PendingDiagnosis::NodeRejectReason(i))));
+    rejected_nodes->set_count(diagnosis.rejected_node_cnt[i]);
+  }
+}
+
 CraneErr TaskScheduler::SetHoldForTaskInRamAndDb_(task_id_t task_id,
                                                   bool hold) {
   m_pending_task_map_mtx_.Lock();
@@ -1162,7 +1232,8 @@ CraneErr TaskScheduler::TerminateRunningTaskNoLock_(TaskInCtld* task) {
   if (need_to_be_terminated) {
     for (CranedId const& craned_id : task->executing_craned_ids) {
       m_cancel_task_queue_.enqueue(
-          CancelRunningTaskQueueElem{task_id, craned_id});
+          CancelRunningTaskQueueElem{task_id, craned_id,
+                                     task->being_preempted});
       m_cancel_task_async_handle_->send();
     }
   }
@@ -1170,6 +1241,245 @@ CraneErr TaskScheduler::TerminateRunningTaskNoLock_(TaskInCtld* task) {
   return CraneErr::kOk;
 }
 
+void TaskScheduler::FailTasksOfEndedReservations_(
+    const std::vector<std::unique_ptr<TaskInCtld>>& tasks) {
+  std::vector<TaskInCtld*> task_raw_ptrs;
+  for (const auto& task : tasks) {
+    CRANE_INFO(
+        "Pending task #{} failed since its reservation '{}' has ended or "
+        "been deleted.",
+        task->TaskId(), task->reservation);
+
+    SetTaskStatus_(task.get(), crane::grpc::Failed);
+    task->SetExitCode(ExitCode::kExitCodeReservationEnded);
+    task->SetEndTime(absl::Now());
+
+    if (task->type == crane::grpc::Interactive) {
+      auto& meta = std::get<InteractiveMetaInTask>(task->meta);
+      g_thread_pool->detach_task([cb = meta.cb_task_cancel,
+                                  task_id = task->TaskId()] { cb(task_id); });
+    }
+
+    task_raw_ptrs.emplace_back(task.get());
+  }
+
+  ProcessFinalTasks_(task_raw_ptrs);
+}
+
+void TaskScheduler::PreemptForPendingTasksNoLock_() {
+  absl::Time now = absl::Now();
+  absl::Time wait_deadline = now + g_config.PreemptionConfig.WaitThreshold;
+
+  // The running tasks which may be preempted, indexed by node. It is built
+  // once for all the preemptors of this round, so that the nodes without
+  // any of them are never locked.
+  struct NodeVictims {
+    std::vector<PreemptCandidate> candidates;
+    // The resource of the tasks being preempted, which will be freed soon.
+    ResourceInNode releasing_res;
+  };
+  HashMap<CranedId, NodeVictims> victim_index;
+  uint32_t min_victim_priority = std::numeric_limits<uint32_t>::max();
+
+  for (const auto& [task_id, task] : m_running_task_map_) {
+    const auto& node_res_map = task->Resources().EachNodeResMap();
+    if (task->being_preempted) {
+      for (const auto& [craned_id, res] : node_res_map)
+        victim_index[craned_id].releasing_res += res;
+      continue;
+    }
+
+    if (task->type != crane::grpc::Batch || !task->qos_preemptable ||
+        now - task->StartTime() < g_config.PreemptionConfig.MinRunTime)
+      continue;
+
+    min_victim_priority = std::min(min_victim_priority, task->qos_priority);
+    for (const auto& [craned_id, res] : node_res_map)
+      victim_index[craned_id].candidates.emplace_back(
+          PreemptCandidate{.task_id = task_id,
+                           .qos_priority = task->qos_priority,
+                           .start_time = task->StartTime(),
+                           .res = res});
+  }
+  if (min_victim_priority == std::numeric_limits<uint32_t>::max()) return;
+
+  // The expected start time of pending tasks is set by NodeSelect.
+  std::vector<TaskInCtld*> preemptors;
+  for (auto& [task_id, task] : m_pending_task_map_) {
+    if (task->Held() || task->exclusive) continue;
+    if (task->StartTime() <= wait_deadline) continue;
+    // No running task has a lower priority than this one.
+    if (task->qos_priority <= min_victim_priority) continue;
+    preemptors.emplace_back(task.get());
+  }
+  if (preemptors.empty()) return;
+
+  std::ranges::stable_sort(preemptors, [](TaskInCtld* lhs, TaskInCtld* rhs) {
+    return lhs->qos_priority > rhs->qos_priority;
+  });
+  if (preemptors.size() > g_config.PreemptionConfig.MaxPreemptorsPerCycle)
+    preemptors.resize(g_config.PreemptionConfig.MaxPreemptorsPerCycle);
+
+  std::vector<Reservation> reservations =
+      g_reservation_manager->GetReservations(now);
+
+  // The resource on each node promised to the preemptors in this round.
+  HashMap<CranedId, ResourceInNode> claimed_res_map;
+
+  auto all_partitions_meta_map =
+      g_meta_container->GetAllPartitionsMetaMapConstPtr();
+  auto craned_meta_map = g_meta_container->GetCranedMetaMapConstPtr();
+
+  // The nodes of each partition with preemptable tasks and the lowest
+  // priority of these tasks. Built when a partition is first met.
+  struct PartitionVictims {
+    std::unordered_set<CranedId> craned_ids;
+    uint32_t min_priority{std::numeric_limits<uint32_t>::max()};
+  };
+  HashMap<PartitionId, PartitionVictims> part_victims_map;
+
+  struct NodePlan {
+    CranedId craned_id;
+    std::vector<task_id_t> victims;
+    ResourceInNode res_after_preemption;
+  };
+
+  auto plan_on_node = [&](TaskInCtld* task, const CranedId& craned_id,
+                          std::vector<NodePlan>* plans) {
+    if (!task->included_nodes.empty() &&
+        !task->included_nodes.contains(craned_id))
+      return;
+    if (task->excluded_nodes.contains(craned_id)) return;
+
+    auto craned_meta = craned_meta_map->at(craned_id).GetExclusivePtr();
+    if (!craned_meta->alive || craned_meta->drain) return;
+
+    ResourceInNode avail_res = craned_meta->res_avail;
+    std::vector<PreemptCandidate> candidates;
+    auto victims_it = victim_index.find(craned_id);
+    if (victims_it != victim_index.end()) {
+      avail_res += victims_it->second.releasing_res;
+      for (const PreemptCandidate& candidate : victims_it->second.candidates)
+        if (candidate.qos_priority < task->qos_priority)
+          candidates.emplace_back(candidate);
+    }
+
+    auto claimed_it = claimed_res_map.find(craned_id);
+    if (claimed_it != claimed_res_map.end()) {
+      if (!(claimed_it->second <= avail_res)) return;
+      avail_res -= claimed_it->second;
+    }
+
+    HashMap<task_id_t, ResourceInNode> candidate_res_map;
+    for (const PreemptCandidate& candidate : candidates)
+      candidate_res_map.emplace(candidate.task_id, candidate.res);
+
+    NodePlan plan{.craned_id = craned_id};
+    if (!SelectPreemptionVictimsInNode(avail_res,
+                                       task->requested_node_res_view,
+                                       std::move(candidates), &plan.victims))
+      return;
+
+    plan.res_after_preemption = std::move(avail_res);
+    for (task_id_t victim_id : plan.victims)
+      plan.res_after_preemption += candidate_res_map.at(victim_id);
+    plans->emplace_back(std::move(plan));
+  };
+
+  for (TaskInCtld* task : preemptors) {
+    auto part_it = all_partitions_meta_map->find(task->partition_id);
+    if (part_it == all_partitions_meta_map->end()) continue;
+
+    auto [part_victims_it, inserted] =
+        part_victims_map.try_emplace(task->partition_id);
+    PartitionVictims& part_victims = part_victims_it->second;
+    if (inserted) {
+      auto part_meta = part_it->second.GetExclusivePtr();
+      for (const auto& [craned_id, node_victims] : victim_index) {
+        if (node_victims.candidates.empty() ||
+            !part_meta->craned_ids.contains(craned_id))
+          continue;
+        part_victims.craned_ids.emplace(craned_id);
+        for (const PreemptCandidate& candidate : node_victims.candidates)
+          part_victims.min_priority =
+              std::min(part_victims.min_priority, candidate.qos_priority);
+      }
+    }
+    // Nothing in this partition can be preempted by the task.
+    if (task->qos_priority <= part_victims.min_priority) continue;
+
+    std::unordered_set<CranedId> victim_craned_ids = part_victims.craned_ids;
+    // A task waiting for its reservation to begin is not delayed by the
+    // running tasks.
+    if (!RestrictPreemptionNodesByReservations(
+            task->reservation, task->time_limit, now, reservations,
+            &victim_craned_ids))
+      continue;
+
+    std::vector<NodePlan> plans;
+    for (const CranedId& craned_id : victim_craned_ids)
+      plan_on_node(task, craned_id, &plans);
+    if (plans.empty()) continue;
+
+    // The other nodes of a multi-node task may be ones without preemptable
+    // tasks but with enough resource. They are only looked for when some
+    // node can be freed by preemption.
+    if (plans.size() < task->node_num) {
+      std::unordered_set<CranedId> other_craned_ids =
+          part_it->second.GetExclusivePtr()->craned_ids;
+      if (RestrictPreemptionNodesByReservations(task->reservation,
+                                                task->time_limit, now,
+                                                reservations,
+                                                &other_craned_ids)) {
+        for (const CranedId& craned_id : other_craned_ids) {
+          if (plans.size() >= task->node_num) break;
+          if (victim_craned_ids.contains(craned_id)) continue;
+          plan_on_node(task, craned_id, &plans);
+        }
+      }
+    }
+
+    if (plans.size() < task->node_num) continue;
+
+    // Preempt on the nodes needing the fewest victims.
+    std::ranges::sort(plans, [](const NodePlan& lhs, const NodePlan& rhs) {
+      return lhs.victims.size() < rhs.victims.size();
+    });
+    plans.resize(task->node_num);
+
+    HashSet<task_id_t> victim_ids;
+    for (NodePlan& plan : plans) {
+      ResourceInNode feasible_res;
+      task->requested_node_res_view.GetFeasibleResourceInNode(
+          plan.res_after_preemption, &feasible_res);
+      claimed_res_map[plan.craned_id] += feasible_res;
+
+      victim_ids.insert(plan.victims.begin(), plan.victims.end());
+    }
+
+    for (task_id_t victim_id : victim_ids) {
+      TaskInCtld* victim = m_running_task_map_.at(victim_id).get();
+      CRANE_INFO("Preempt task #{} of qos {} for pending task #{} of qos {}.",
+                 victim_id, victim->qos, task->TaskId(), task->qos);
+
+      victim->being_preempted = true;
+      victim->SetPreemptedBy(task->TaskId(), now);
+      TerminateRunningTaskNoLock_(victim);
+
+      // The resource of the victim is freed soon for the later preemptors.
+      for (const auto& [craned_id, res] :
+           victim->Resources().EachNodeResMap()) {
+        NodeVictims& node_victims = victim_index.at(craned_id);
+        std::erase_if(node_victims.candidates,
+                      [&](const PreemptCandidate& candidate) {
+                        return candidate.task_id == victim_id;
+                      });
+        node_victims.releasing_res += res;
+      }
+    }
+  }
+}
+
 crane::grpc::CancelTaskReply TaskScheduler::CancelPendingOrRunningTask(
     const crane::grpc::CancelTaskRequest& request) {
   crane::grpc::CancelTaskReply reply;
@@ -1291,6 +1601,9 @@ crane::grpc::CancelTaskReply TaskScheduler::CancelPendingOrRunningTask(
       if (is_calloc) {
         reply.add_cancelled_tasks(task_id);
       } else {
+        // A task cancelled by the user is not requeued even if it is being
+        // preempted.
+        task->being_preempted = false;
         CraneErr err = TerminateRunningTaskNoLock_(task);
         if (err == CraneErr::kOk) {
           reply.add_cancelled_tasks(task_id);
@@ -1422,6 +1735,7 @@ void TaskScheduler::CleanCancelQueueCb_() {
   // Carry the ownership of TaskInCtld for automatic destruction.
   std::vector<std::unique_ptr<TaskInCtld>> pending_task_ptr_vec;
   HashMap<CranedId, std::vector<task_id_t>> running_task_craned_id_map;
+  HashMap<CranedId, std::vector<task_id_t>> preempted_task_craned_id_map;
 
   size_t actual_size = m_cancel_task_queue_.try_dequeue_bulk(
       tasks_to_cancel.begin(), approximate_size);
@@ -1436,27 +1750,51 @@ void TaskScheduler::CleanCancelQueueCb_() {
               pending_task_ptr_vec.emplace_back(std::move(pd_elem.task));
             },
             [&](CancelRunningTaskQueueElem& rn_elem) {
-              running_task_craned_id_map[rn_elem.craned_id].emplace_back(
-                  rn_elem.task_id);
+              auto& craned_id_map = rn_elem.preempted
+                                        ? preempted_task_craned_id_map
+                                        : running_task_craned_id_map;
+              craned_id_map[rn_elem.craned_id].emplace_back(rn_elem.task_id);
             }},
         elem);
   }
 
-  for (auto&& [craned_id, task_ids] : running_task_craned_id_map) {
-    g_thread_pool->detach_task(
-        [id = craned_id, task_ids_to_cancel = task_ids]() {
-          CRANE_TRACE("Craned {} is going to cancel tasks {}.", id,
-                      absl::StrJoin(task_ids_to_cancel, ","));
-          auto stub = g_craned_keeper->GetCranedStub(id);
-          if (stub && !stub->Invalid())
-            stub->TerminateTasks(task_ids_to_cancel);
-        });
-  }
+  auto terminate_running_tasks =
+      [](HashMap<CranedId, std::vector<task_id_t>>&& craned_task_ids_map,
+         uint32_t kill_grace_sec) {
+        if (UseCranedRelay_(craned_task_ids_map.size())) {
+          g_thread_pool->detach_task(
+              [craned_task_ids_map = std::move(craned_task_ids_map),
+               kill_grace_sec] {
+                TerminateTasksOnCranedsByRelay_(craned_task_ids_map,
+                                                kill_grace_sec);
+              });
+          return;
+        }
+
+        for (auto&& [craned_id, task_ids] : craned_task_ids_map) {
+          g_thread_pool->detach_task([id = craned_id,
+                                      task_ids_to_cancel = task_ids,
+                                      kill_grace_sec]() {
+            CRANE_TRACE("Craned {} is going to cancel tasks {}.", id,
+                        absl::StrJoin(task_ids_to_cancel, ","));
+            auto stub = g_craned_keeper->GetCranedStub(id);
+            if (stub && !stub->Invalid())
+              stub->TerminateTasks(task_ids_to_cancel, kill_grace_sec);
+          });
+        }
+      };
+
+  if (!running_task_craned_id_map.empty())
+    terminate_running_tasks(std::move(running_task_craned_id_map), 0);
+  if (!preempted_task_craned_id_map.empty())
+    terminate_running_tasks(
+        std::move(preempted_task_craned_id_map),
+        absl::ToInt64Seconds(g_config.PreemptionConfig.GraceTime));
 
   if (pending_task_ptr_vec.empty()) return;
 
   for (auto& task : pending_task_ptr_vec) {
-    task->SetStatus(crane::grpc::Cancelled);
+    SetTaskStatus_(task.get(), crane::grpc::Cancelled);
     task->SetEndTime(absl::Now());
 
     if (task->type == crane::grpc::Interactive) {
@@ -1524,7 +1862,7 @@ void TaskScheduler::CleanSubmitQueueCb_() {
       uint32_t pos = accepted_tasks.size() - 1 - i;
       auto* task = accepted_tasks[pos].first.get();
       // Add the task to the pending task queue.
-      task->SetStatus(crane::grpc::Pending);
+      SetTaskStatus_(task, crane::grpc::Pending);
       accepted_task_ptrs.emplace_back(task);
     }
 
@@ -1566,13 +1904,57 @@ void TaskScheduler::CleanSubmitQueueCb_() {
   } while (false);
 }
 
-void TaskScheduler::TaskStatusChangeAsync(uint32_t task_id,
-                                          const CranedId& craned_index,
-                                          crane::grpc::TaskStatus new_status,
-                                          uint32_t exit_code) {
+void TaskScheduler::TaskStatusChangeAsync(
+    uint32_t task_id, const CranedId& craned_index,
+    crane::grpc::TaskStatus new_status, uint32_t exit_code,
+    crane::grpc::TaskResourceUsage&& usage) {
   m_task_status_change_queue_.enqueue(
-      {task_id, exit_code, new_status, craned_index});
+      {task_id, exit_code, new_status, craned_index, std::move(usage)});
+  m_task_status_change_async_handle_->send();
+}
+
+std::vector<task_id_t> TaskScheduler::TaskStatusChangeBatchAsync(
+    std::vector<TaskStatusChangeArg>&& args) {
+  std::vector<task_id_t> acked_task_ids;
+
+  // The changes will be resent to CraneCtld after it restarts.
+  if (m_thread_stop_) return acked_task_ids;
+
+  acked_task_ids.reserve(args.size());
+
+  // Craned only reports the end of tasks. Other changes are acked and
+  // dropped, since resending them will never make them accepted.
+  std::erase_if(args, [&](const TaskStatusChangeArg& arg) {
+    switch (arg.new_status) {
+    case crane::grpc::Completed:
+    case crane::grpc::Failed:
+    case crane::grpc::ExceedTimeLimit:
+    case crane::grpc::Cancelled:
+      return false;
+    default:
+      CRANE_WARN("Dropping status change of task #{} to {} from {}.",
+                 arg.task_id, int(arg.new_status), arg.craned_index);
+      acked_task_ids.emplace_back(arg.task_id);
+      return true;
+    }
+  });
+  if (args.empty()) return acked_task_ids;
+
+  std::vector<task_id_t> queued_task_ids;
+  queued_task_ids.reserve(args.size());
+  for (const auto& arg : args) queued_task_ids.emplace_back(arg.task_id);
+
+  if (!m_task_status_change_queue_.enqueue_bulk(
+          std::make_move_iterator(args.begin()), args.size())) {
+    CRANE_ERROR("Failed to queue {} task status changes.", args.size());
+    return acked_task_ids;
+  }
+
   m_task_status_change_async_handle_->send();
+
+  acked_task_ids.insert(acked_task_ids.end(), queued_task_ids.begin(),
+                        queued_task_ids.end());
+  return acked_task_ids;
 }
 
 void TaskScheduler::TaskStatusChangeTimerCb_() {
@@ -1605,10 +1987,33 @@ void TaskScheduler::CleanTaskStatusChangeQueueCb_() {
   std::unordered_map<CranedId, std::vector<std::pair<task_id_t, uid_t>>>
       craned_cgroups_map;
 
+  // Preempted tasks which go back to the pending queue.
+  std::vector<std::unique_ptr<TaskInCtld>> requeued_tasks;
+
+  // A craned resends the changes whose acknowledgement is lost, so the same
+  // change may be dequeued more than once. The craned id is part of the key
+  // since every craned of a Crun task reports the same change.
+  HashSet<std::tuple<task_id_t, crane::grpc::TaskStatus, CranedId>>
+      seen_changes;
+
+  // Preempted tasks are moved back to the pending map in the same critical
+  // section, so cancelling and querying never miss them. The pending map
+  // must be locked before the running map. Tasks are only preempted with
+  // preemption enabled.
+  std::optional<LockGuard> pending_guard;
+  if (g_config.PreemptionConfig.Enabled)
+    pending_guard.emplace(&m_pending_task_map_mtx_);
   LockGuard running_guard(&m_running_task_map_mtx_);
   LockGuard indexes_guard(&m_task_indexes_mtx_);
 
-  for (const auto& [task_id, exit_code, new_status, craned_index] : args) {
+  for (const auto& [task_id, exit_code, new_status, craned_index,
+                    resource_usage] : args) {
+    if (!seen_changes.emplace(task_id, new_status, craned_index).second) {
+      CRANE_TRACE("Ignoring duplicate status change of task #{} from {}.",
+                  task_id, craned_index);
+      continue;
+    }
+
     auto iter = m_running_task_map_.find(task_id);
     if (iter == m_running_task_map_.end()) {
       CRANE_WARN(
@@ -1620,10 +2025,13 @@ void TaskScheduler::CleanTaskStatusChangeQueueCb_() {
     std::unique_ptr<TaskInCtld>& task = iter->second;
 
     if (task->type == crane::grpc::Batch) {
-      task->SetStatus(new_status);
+      SetTaskStatus_(task.get(), new_status);
+      task->MergeResourceUsage(resource_usage);
     } else {
       auto& meta = std::get<InteractiveMetaInTask>(task->meta);
       if (meta.interactive_type == crane::grpc::Calloc) {
+        task->MergeResourceUsage(resource_usage);
+
         // TaskStatusChange may indicate the time limit has been reached and
         // the task has been terminated. No more TerminateTask RPC should be
         // sent to the craned node if any further CancelTask or
@@ -1634,21 +2042,26 @@ void TaskScheduler::CleanTaskStatusChangeQueueCb_() {
             exit_code == ExitCode::kExitCodeCranedDown) {
           meta.has_been_cancelled_on_front_end = true;
           meta.cb_task_cancel(task->TaskId());
-          task->SetStatus(new_status);
+          SetTaskStatus_(task.get(), new_status);
         } else {
-          task->SetStatus(crane::grpc::Completed);
+          SetTaskStatus_(task.get(), crane::grpc::Completed);
         }
         meta.cb_task_completed(task->TaskId());
       } else {  // Crun
-        if (++meta.status_change_cnt < task->node_num) {
+        // A craned may resend a status change whose acknowledgement was
+        // lost. Count each craned only once.
+        if (meta.status_changed_craned_ids.emplace(craned_index).second)
+          task->MergeResourceUsage(resource_usage);
+        if (meta.status_changed_craned_ids.size() < task->node_num) {
           CRANE_TRACE(
               "{}/{} TaskStatusChanges of Crun task #{} were received. "
               "Keep waiting...",
-              meta.status_change_cnt, task->node_num, task->TaskId());
+              meta.status_changed_craned_ids.size(), task->node_num,
+              task->TaskId());
           continue;
         }
 
-        task->SetStatus(new_status);
+        SetTaskStatus_(task.get(), new_status);
         meta.cb_task_completed(task->TaskId());
       }
     }
@@ -1675,6 +2088,27 @@ void TaskScheduler::CleanTaskStatusChangeQueueCb_() {
       g_meta_container->FreeResourceFromNode(craned_id, task_id);
     }
 
+    // A preempted task finishing by itself is not requeued.
+    if (pending_guard && task->being_preempted &&
+        task->qos_preempt_mode == crane::grpc::PREEMPT_REQUEUE &&
+        new_status != crane::grpc::Completed) {
+      CRANE_TRACE("Requeue preempted task #{}.", task_id);
+
+      task->being_preempted = false;
+      SetTaskStatus_(task.get(), crane::grpc::Pending);
+      task->SetExitCode(0);
+      task->SetRequeueCount(task->RequeueCount() + 1);
+
+      task->nodes_alloc = 0;
+      task->allocated_craneds_regex.clear();
+      task->CranedIdsClear();
+      task->executing_craned_ids.clear();
+
+      requeued_tasks.emplace_back(std::move(task));
+      m_running_task_map_.erase(iter);
+      continue;
+    }
+
     task_raw_ptr_vec.emplace_back(task.get());
     task_ptr_vec.emplace_back(std::move(task));
 
@@ -1687,23 +2121,26 @@ void TaskScheduler::CleanTaskStatusChangeQueueCb_() {
     m_running_task_map_.erase(iter);
   }
 
-  absl::BlockingCounter bl(craned_cgroups_map.size());
-  for (const auto& [craned_id, cgroups] : craned_cgroups_map) {
-    g_thread_pool->detach_task([&bl, &craned_id, &cgroups]() {
-      auto stub = g_craned_keeper->GetCranedStub(craned_id);
+  ReleaseCgroupOnCraneds_(craned_cgroups_map);
 
-      // If the craned is down, just ignore it.
-      if (stub && !stub->Invalid()) {
-        CraneErr err = stub->ReleaseCgroupForTasks(cgroups);
-        if (err != CraneErr::kOk) {
-          CRANE_ERROR("Failed to Release cgroup RPC for {} tasks on Node {}",
-                      cgroups.size(), craned_id);
-        }
-      }
-      bl.DecrementCount();
-    });
+  if (!requeued_tasks.empty()) {
+    txn_id_t txn_id;
+    g_embedded_db_client->BeginVariableDbTransaction(&txn_id);
+    for (const auto& task : requeued_tasks) {
+      if (!g_embedded_db_client->UpdateRuntimeAttrOfTask(
+              txn_id, task->TaskDbId(), task->RuntimeAttr()))
+        CRANE_ERROR("Failed to call UpdateRuntimeAttrOfTask() for task #{}",
+                    task->TaskId());
+    }
+    g_embedded_db_client->CommitVariableDbTransaction(txn_id);
+
+    for (auto& task : requeued_tasks) {
+      task_id_t task_id = task->TaskId();
+      m_pending_task_map_.emplace(task_id, std::move(task));
+    }
+    m_pending_map_cached_size_.store(m_pending_task_map_.size(),
+                                     std::memory_order::release);
   }
-  bl.Wait();
 
   ProcessFinalTasks_(task_raw_ptr_vec);
 }
@@ -1845,6 +2282,8 @@ void MinLoadFirst::CalculateNodeSelectionInfoOfPartition_(
     absl::Time now, const PartitionId& partition_id,
     const std::unordered_set<CranedId> craned_ids,
     const CranedMetaContainer::CranedMetaRawMap& craned_meta_map,
+    const std::vector<Reservation>& reservations,
+    const Reservation* inside_reservation,
     NodeSelectionInfo* node_selection_info) {
   NodeSelectionInfo& node_selection_info_ref = *node_selection_info;
 
@@ -1858,6 +2297,20 @@ void MinLoadFirst::CalculateNodeSelectionInfoOfPartition_(
     // Sort all running task in this node by ending time.
     std::vector<std::pair<absl::Time, uint32_t>> end_time_task_id_vec;
 
+    // The reservations to block on this node.
+    std::vector<const Reservation*> node_reservations;
+    if (inside_reservation == nullptr) {
+      for (const auto& reservation : reservations)
+        if (reservation.craned_ids.contains(craned_id))
+          node_reservations.emplace_back(&reservation);
+    }
+
+    // The resource of the running tasks in the blocked reservations, which
+    // is counted in the blocked resource instead.
+    ResourceInNode reserved_task_res;
+    // The running tasks in inside_reservation.
+    std::vector<std::pair<absl::Time, AllocatableResource>> task_usages;
+
     node_selection_info_ref.task_num_node_id_map.emplace(
         craned_meta->running_task_resource_map.size(), craned_id);
 
@@ -1874,6 +2327,24 @@ void MinLoadFirst::CalculateNodeSelectionInfoOfPartition_(
       // res_avail = 0 and will cause a severe error where res_avail < 0.
       absl::Time end_time = std::max(task->StartTime() + task->time_limit,
                                      now + absl::Seconds(1));
+
+      if (!task->reservation.empty()) {
+        if (inside_reservation != nullptr &&
+            task->reservation == inside_reservation->name) {
+          task_usages.emplace_back(end_time, res.allocatable_res);
+        } else {
+          auto rsv_it = std::ranges::find_if(
+              node_reservations, [&](const Reservation* reservation) {
+                return reservation->name == task->reservation;
+              });
+          if (rsv_it != node_reservations.end() &&
+              end_time <= (*rsv_it)->end_time) {
+            reserved_task_res += res;
+            continue;
+          }
+        }
+      }
+
       end_time_task_id_vec.emplace_back(end_time, task_id);
 
       running_task_ids_str.emplace_back(std::to_string(task_id));
@@ -1909,6 +2380,7 @@ void MinLoadFirst::CalculateNodeSelectionInfoOfPartition_(
     // Insert [now, inf) interval and thus guarantee time_avail_res_map is not
     // null.
     time_avail_res_map[now] = craned_meta->res_avail;
+    time_avail_res_map[now] += reserved_task_res;
 
     if constexpr (kAlgoTraceOutput) {
       CRANE_TRACE("Craned {} initial res_avail now: cpu: {}, mem: {}, gres: {}",
@@ -1965,6 +2437,14 @@ void MinLoadFirst::CalculateNodeSelectionInfoOfPartition_(
         }
       }
 
+      if (inside_reservation != nullptr) {
+        RestrictTimelineToReservation(*inside_reservation, now, task_usages,
+                                      &time_avail_res_map);
+      } else {
+        for (const Reservation* reservation : node_reservations)
+          BlockReservationInTimeline(*reservation, now, &time_avail_res_map);
+      }
+
       if constexpr (kAlgoTraceOutput) {
         std::string str;
         str.append(fmt::format("Node ({}, {}): ", partition_id, craned_id));
@@ -1990,6 +2470,10 @@ void MinLoadFirst::CalculateNodeSelectionInfoOfPartition_(
         CRANE_TRACE("{}", str);
       }
     }
+
+    if (node_selection_info_ref.pack_nodes)
+      node_selection_info_ref.free_res_index.Insert(
+          craned_id, time_avail_res_map.begin()->second);
   }
 }
 
@@ -2004,25 +2488,33 @@ bool MinLoadFirst::CalculateRunningNodesAndStartTime_(
   bool first_pass{true};
 
   std::list<CranedId> craned_indexes_;
+  PendingDiagnosis& diagnosis = task->pending_diagnosis;
+
+  // Rejected nodes are counted only when `diagnose` is true, so that each
+  // node is counted at most once.
+  auto reject_node = [&](const CranedId& craned_index,
+                         PendingDiagnosis::NodeRejectReason reason,
+                         bool diagnose) {
+    if (!diagnose) return false;
+    diagnosis.rejected_node_cnt[reason]++;
+    if (g_event_journal)
+      g_event_journal->NodeRejected(task->TaskId(), craned_index, reason);
+    return false;
+  };
 
-  auto task_num_node_id_it = node_selection_info.task_num_node_id_map.begin();
-  while (selected_node_cnt < task->node_num &&
-         task_num_node_id_it !=
-             node_selection_info.task_num_node_id_map.end()) {
-    auto craned_index = task_num_node_id_it->second;
+  // If any of the follow `if` is true, skip this node.
+  auto node_is_eligible = [&](const CranedId& craned_index,
+                              bool diagnose = false) {
     if (!partition_meta_ptr.GetExclusivePtr()->craned_ids.contains(
             craned_index)) {
       // Todo: Performance issue! We can use cached available node set
       //  for the task when checking task validity in TaskScheduler.
-      ++task_num_node_id_it;
-      continue;
+      return reject_node(craned_index, PendingDiagnosis::kNotInPartition,
+                         diagnose);
     }
 
-    auto& time_avail_res_map =
-        node_selection_info.node_time_avail_res_map.at(craned_index);
     auto craned_meta = craned_meta_map.at(craned_index).GetExclusivePtr();
 
-    // If any of the follow `if` is true, skip this node.
     if (!(task->requested_node_res_view <= craned_meta->res_total)) {
       if constexpr (kAlgoTraceOutput) {
         CRANE_TRACE(
@@ -2030,28 +2522,78 @@ bool MinLoadFirst::CalculateRunningNodesAndStartTime_(
             "Skipping this craned.",
             task->TaskId(), craned_index);
       }
-    } else if (!task->included_nodes.empty() &&
-               !task->included_nodes.contains(craned_index)) {
+      return reject_node(craned_index, PendingDiagnosis::kResourceExceedsNode,
+                         diagnose);
+    }
+    if (!task->included_nodes.empty() &&
+        !task->included_nodes.contains(craned_index)) {
       if constexpr (kAlgoTraceOutput) {
         CRANE_TRACE(
             "Craned {} is not in the nodelist of task #{}. "
             "Skipping this craned.",
             craned_index, task->TaskId());
       }
-    } else if (!task->excluded_nodes.empty() &&
-               task->excluded_nodes.contains(craned_index)) {
+      return reject_node(craned_index, PendingDiagnosis::kNotInNodeList,
+                         diagnose);
+    }
+    if (!task->excluded_nodes.empty() &&
+        task->excluded_nodes.contains(craned_index)) {
       if constexpr (kAlgoTraceOutput) {
         CRANE_TRACE("Task #{} excludes craned {}. Skipping this craned.",
                     task->TaskId(), craned_index);
       }
-    } else {
+      return reject_node(craned_index, PendingDiagnosis::kExcludedNode,
+                         diagnose);
+    }
+    return true;
+  };
+
+  auto runnable_now = [&](const CranedId& craned_index) {
+    if (!node_is_eligible(craned_index)) return false;
+
+    auto& time_avail_res_map =
+        node_selection_info.node_time_avail_res_map.at(craned_index);
+    return task->requested_node_res_view <= time_avail_res_map.begin()->second;
+  };
+
+  // For multi-node tasks, try to pick the nodes which can run the task now
+  // below the smallest switch first. The switches are walked from the
+  // smallest one and the walk stops at the first switch which has enough
+  // runnable nodes.
+  const TopologyTree& topology_tree = g_meta_container->GetTopologyTree();
+  if (g_config.TopologyAwareSelection && task->node_num > 1 &&
+      topology_tree.SelectInSmallestSwitch(
+          task->node_num, task->requested_node_res_view.GetAllocatableRes(),
+          runnable_now, &craned_indexes_)) {
+    selected_node_cnt = craned_indexes_.size();
+  } else if (node_selection_info.pack_nodes) {
+    std::vector<CranedId> candidates;
+    node_selection_info.free_res_index.SelectFromLeast(
+        task->requested_node_res_view.GetAllocatableRes().cpu_count,
+        task->node_num, runnable_now, &candidates);
+
+    if (candidates.size() == task->node_num) {
+      craned_indexes_.assign(candidates.begin(), candidates.end());
+      selected_node_cnt = task->node_num;
+    }
+  }
+
+  auto task_num_node_id_it = node_selection_info.task_num_node_id_map.begin();
+  while (selected_node_cnt < task->node_num &&
+         task_num_node_id_it !=
+             node_selection_info.task_num_node_id_map.end()) {
+    auto craned_index = task_num_node_id_it->second;
+    if (node_is_eligible(craned_index, true)) {
       craned_indexes_.emplace_back(craned_index);
       ++selected_node_cnt;
     }
     ++task_num_node_id_it;
   }
 
-  if (selected_node_cnt < task->node_num) return false;
+  if (selected_node_cnt < task->node_num) {
+    diagnosis.no_start_reason = PendingDiagnosis::kNotEnoughNodes;
+    return false;
+  }
   CRANE_ASSERT_MSG(selected_node_cnt == task->node_num,
                    "selected_node_cnt != task->node_num");
 
@@ -2069,6 +2611,7 @@ bool MinLoadFirst::CalculateRunningNodesAndStartTime_(
           "Task #{} needs more resource than that of craned {}. "
           "Craned resource might have been changed.",
           task->TaskId(), craned_id);
+      diagnosis.no_start_reason = PendingDiagnosis::kResourceChanged;
       return false;
     }
 
@@ -2356,6 +2899,7 @@ bool MinLoadFirst::CalculateRunningNodesAndStartTime_(
     }
   }
 
+  diagnosis.no_start_reason = PendingDiagnosis::kNoTimeWindow;
   return false;
 }
 
@@ -2370,6 +2914,11 @@ void MinLoadFirst::NodeSelect(
   // We use the time now as the base time across the whole algorithm.
   absl::Time now = absl::FromUnixSeconds(ToUnixSeconds(absl::Now()));
 
+  // The NodeSelectionInfo seen by the tasks in each reservation.
+  std::unordered_map<std::string, NodeSelectionInfo> rsv_node_info_map;
+  std::vector<Reservation> reservations =
+      g_reservation_manager->GetReservations(now);
+
   {
     auto all_partitions_meta_map =
         g_meta_container->GetAllPartitionsMetaMapConstPtr();
@@ -2382,10 +2931,32 @@ void MinLoadFirst::NodeSelect(
 
       NodeSelectionInfo& node_info_in_a_partition =
           part_id_node_info_map[partition_id];
+      node_info_in_a_partition.pack_nodes = m_pack_nodes_;
+
+      CalculateNodeSelectionInfoOfPartition_(
+          running_tasks, now, partition_id, craned_ids, *craned_meta_map,
+          reservations, nullptr, &node_info_in_a_partition);
+    }
+
+    for (const auto& reservation : reservations) {
+      std::unordered_set<CranedId> craned_ids;
+      {
+        auto part_meta_ptr =
+            all_partitions_meta_map->at(reservation.partition_id)
+                .GetExclusivePtr();
+        for (const auto& craned_id : reservation.craned_ids)
+          if (part_meta_ptr->craned_ids.contains(craned_id))
+            craned_ids.emplace(craned_id);
+      }
+
+      NodeSelectionInfo& node_info_in_a_reservation =
+          rsv_node_info_map[reservation.name];
+      node_info_in_a_reservation.pack_nodes = m_pack_nodes_;
 
-      CalculateNodeSelectionInfoOfPartition_(running_tasks, now, partition_id,
-                                             craned_ids, *craned_meta_map,
-                                             &node_info_in_a_partition);
+      CalculateNodeSelectionInfoOfPartition_(
+          running_tasks, now, reservation.partition_id, craned_ids,
+          *craned_meta_map, reservations, &reservation,
+          &node_info_in_a_reservation);
     }
   }
 
@@ -2403,8 +2974,29 @@ void MinLoadFirst::NodeSelect(
     auto& task = pending_task_it->second;
 
     PartitionId part_id = task->partition_id;
+    PendingDiagnosis& diagnosis = task->pending_diagnosis;
+    diagnosis.Reset(now);
 
-    NodeSelectionInfo& node_info = part_id_node_info_map[part_id];
+    auto not_started = [&](PendingDiagnosis::NoStartReason reason) {
+      diagnosis.no_start_reason = reason;
+      if (g_event_journal) g_event_journal->NotStarted(task_id, reason);
+    };
+
+    NodeSelectionInfo* node_info_ptr;
+    if (task->reservation.empty()) {
+      node_info_ptr = &part_id_node_info_map[part_id];
+    } else {
+      // The reservation has ended or been deleted. The task is failed by
+      // the scheduling thread after this round.
+      auto rsv_it = rsv_node_info_map.find(task->reservation);
+      if (rsv_it == rsv_node_info_map.end()) {
+        not_started(PendingDiagnosis::kReservationInactive);
+        continue;
+      }
+      node_info_ptr = &rsv_it->second;
+    }
+
+    NodeSelectionInfo& node_info = *node_info_ptr;
     std::list<CranedId> craned_ids;
     absl::Time expected_start_time;
     std::unordered_map<PartitionId, std::list<CranedId>> involved_part_craned;
@@ -2417,11 +3009,29 @@ void MinLoadFirst::NodeSelect(
       const util::Synchronized<PartitionMeta>& part_meta =
           all_partitions_meta_map->at(part_id);
 
-      // Note! ok should always be true.
-      bool ok = CalculateRunningNodesAndStartTime_(
-          node_info, part_meta, *craned_meta_map, task.get(), now, &craned_ids,
-          &expected_start_time);
+      bool ok;
+      if (task->exclusive) {
+        ok = SelectIdleNodesForExclusiveTask_(node_info, *craned_meta_map,
+                                              task.get(), now, &craned_ids);
+        expected_start_time = now;
+        // Hold the earliest window of enough free nodes, so that the task
+        // is not starved by smaller tasks started before it.
+        if (!ok)
+          ok = PlanExclusiveTaskInFuture_(node_info, *craned_meta_map,
+                                          task.get(), now, &craned_ids,
+                                          &expected_start_time);
+      } else {
+        // Note! ok should always be true.
+        ok = CalculateRunningNodesAndStartTime_(node_info, part_meta,
+                                                *craned_meta_map, task.get(),
+                                                now, &craned_ids,
+                                                &expected_start_time);
+      }
       if (!ok) {
+        // Exclusive tasks fail only for the lack of nodes.
+        not_started(diagnosis.no_start_reason == PendingDiagnosis::kNotExamined
+                        ? PendingDiagnosis::kNotEnoughNodes
+                        : diagnosis.no_start_reason);
         continue;
       }
 
@@ -2439,6 +3049,10 @@ void MinLoadFirst::NodeSelect(
             absl::ToInt64Seconds(expected_start_time + task->time_limit - now));
       }
 
+      if (g_event_journal)
+        g_event_journal->StartTimeChosen(task_id, expected_start_time,
+                                         craned_ids.size());
+
       // The start time and craned ids have been determined.
       // Modify the corresponding NodeSelectionInfo now.
       // Note: Since a craned node may belong to multiple partition,
@@ -2454,10 +3068,27 @@ void MinLoadFirst::NodeSelect(
       }
     }
 
-    for (const auto& [partition_id, part_craned_ids] : involved_part_craned) {
-      SubtractTaskResourceNodeSelectionInfo_(
-          expected_start_time, task->time_limit, task->Resources(),
-          part_craned_ids, &part_id_node_info_map.at(partition_id));
+    // The resource of the tasks in a reservation is already blocked in the
+    // NodeSelectionInfo of the partitions.
+    if (task->reservation.empty()) {
+      for (const auto& [partition_id, part_craned_ids] :
+           involved_part_craned) {
+        SubtractTaskResourceNodeSelectionInfo_(
+            expected_start_time, task->time_limit, task->Resources(),
+            part_craned_ids, false, &part_id_node_info_map.at(partition_id));
+      }
+    }
+
+    for (auto& [rsv_name, rsv_node_info] : rsv_node_info_map) {
+      std::list<CranedId> rsv_craned_ids;
+      for (const CranedId& craned_id : craned_ids)
+        if (rsv_node_info.node_time_avail_res_map.contains(craned_id))
+          rsv_craned_ids.emplace_back(craned_id);
+
+      if (!rsv_craned_ids.empty())
+        SubtractTaskResourceNodeSelectionInfo_(
+            expected_start_time, task->time_limit, task->Resources(),
+            rsv_craned_ids, true, &rsv_node_info);
     }
 
     if (expected_start_time == now) {
@@ -2487,16 +3118,195 @@ void MinLoadFirst::NodeSelect(
       // partition_pending_task_map and move to the next element
       pending_task_map->erase(pending_task_it);
     } else {
-      // The task can't be started now. Move to the next pending task.
+      // The task can't be started now. Its resource is held in the timeline
+      // from the expected start time. Move to the next pending task.
+      diagnosis.no_start_reason = PendingDiagnosis::kStartLater;
+      diagnosis.expected_start_time = expected_start_time;
+      if (g_event_journal) {
+        for (const CranedId& craned_id : craned_ids)
+          g_event_journal->ResourceReserved(
+              task_id, craned_id, expected_start_time,
+              expected_start_time + task->time_limit);
+      }
       continue;
     }
   }
 }
 
+bool MinLoadFirst::SelectIdleNodesForExclusiveTask_(
+    const NodeSelectionInfo& node_selection_info,
+    const CranedMetaContainer::CranedMetaRawMap& craned_meta_map,
+    TaskInCtld* task, absl::Time now, std::list<CranedId>* craned_ids) {
+  const IdleNodeIndex& idle_node_index = g_meta_container->GetIdleNodeIndex();
+  absl::Time end_time = now + task->time_limit;
+
+  auto node_is_eligible = [&](const CranedId& craned_id) {
+    if (!task->included_nodes.empty() &&
+        !task->included_nodes.contains(craned_id))
+      return false;
+    if (task->excluded_nodes.contains(craned_id)) return false;
+
+    // Nodes planned to run tasks in this round are not idle any more.
+    auto time_avail_res_it =
+        node_selection_info.node_time_avail_res_map.find(craned_id);
+    if (time_avail_res_it == node_selection_info.node_time_avail_res_map.end())
+      return false;
+
+    auto craned_meta = craned_meta_map.at(craned_id).GetExclusivePtr();
+    if (!craned_meta->running_task_resource_map.empty() ||
+        !(task->requested_node_res_view <= craned_meta->res_total))
+      return false;
+
+    for (const auto& [time, res] : time_avail_res_it->second) {
+      if (time >= end_time) break;
+      if (!(craned_meta->res_total <= res)) return false;
+    }
+    return true;
+  };
+
+  // Usually the first node_num idle nodes are eligible. Look at all of them
+  // only if some are not.
+  std::vector<CranedId> selected;
+  size_t limit = task->node_num;
+  while (true) {
+    std::vector<CranedId> idle_craned_ids =
+        idle_node_index.GetIdleNodes(task->partition_id, limit);
+
+    selected.clear();
+    for (const auto& craned_id : idle_craned_ids) {
+      if (!node_is_eligible(craned_id)) continue;
+      selected.emplace_back(craned_id);
+      if (selected.size() == task->node_num) break;
+    }
+
+    if (selected.size() == task->node_num) break;
+    if (idle_craned_ids.size() < limit) return false;
+    limit = std::numeric_limits<size_t>::max();
+  }
+
+  ResourceV2 allocated_res;
+  task->allocated_res_view.SetToZero();
+  for (const auto& craned_id : selected) {
+    auto craned_meta = craned_meta_map.at(craned_id).GetExclusivePtr();
+    allocated_res.AddResourceInNode(craned_id, craned_meta->res_total);
+    task->allocated_res_view += craned_meta->res_total;
+  }
+  task->SetResources(std::move(allocated_res));
+
+  craned_ids->assign(selected.begin(), selected.end());
+  return true;
+}
+
+bool MinLoadFirst::PlanExclusiveTaskInFuture_(
+    const NodeSelectionInfo& node_selection_info,
+    const CranedMetaContainer::CranedMetaRawMap& craned_meta_map,
+    TaskInCtld* task, absl::Time now, std::list<CranedId>* craned_ids,
+    absl::Time* start_time) {
+  // For every eligible node, the ranges [first, last] of the times at which
+  // the task may start on the node, i.e., the node is fully free from then
+  // on for the time limit of the task.
+  struct StartRange {
+    absl::Time first;
+    absl::Time last;
+    size_t node_idx;
+  };
+  std::vector<CranedId> nodes;
+  std::vector<ResourceInNode> node_res_totals;
+  std::vector<StartRange> ranges;
+
+  for (const auto& [craned_id, time_avail_res_map] :
+       node_selection_info.node_time_avail_res_map) {
+    if (!task->included_nodes.empty() &&
+        !task->included_nodes.contains(craned_id))
+      continue;
+    if (task->excluded_nodes.contains(craned_id)) continue;
+
+    ResourceInNode res_total =
+        craned_meta_map.at(craned_id).GetExclusivePtr()->res_total;
+    if (!(task->requested_node_res_view <= res_total)) continue;
+
+    size_t node_idx = nodes.size();
+    bool has_range = false;
+    std::optional<absl::Time> free_since;
+    for (auto it = time_avail_res_map.begin(); it != time_avail_res_map.end();
+         ++it) {
+      bool free = res_total <= it->second;
+      if (free && !free_since) free_since = it->first;
+      if (free && std::next(it) != time_avail_res_map.end()) continue;
+
+      if (free_since) {
+        absl::Time free_until = free ? absl::InfiniteFuture() : it->first;
+        if (free_until - *free_since >= task->time_limit) {
+          ranges.emplace_back(StartRange{.first = *free_since,
+                                         .last = free_until - task->time_limit,
+                                         .node_idx = node_idx});
+          has_range = true;
+        }
+        free_since.reset();
+      }
+    }
+
+    if (has_range) {
+      nodes.emplace_back(craned_id);
+      node_res_totals.emplace_back(std::move(res_total));
+    }
+  }
+  if (nodes.size() < task->node_num) return false;
+
+  // Sweep over the start ranges. The earliest time covered by node_num
+  // ranges is the first of one of them. The ranges of a node never overlap.
+  std::vector<std::pair<absl::Time, int>> events;
+  events.reserve(ranges.size() * 2);
+  for (const StartRange& range : ranges) {
+    events.emplace_back(range.first, 1);
+    if (range.last != absl::InfiniteFuture())
+      events.emplace_back(range.last, -1);
+  }
+  // Ranges are closed, so a range starting at the time another one ends is
+  // counted together with it.
+  std::ranges::sort(events, [](const auto& lhs, const auto& rhs) {
+    if (lhs.first != rhs.first) return lhs.first < rhs.first;
+    return lhs.second > rhs.second;
+  });
+
+  std::optional<absl::Time> earliest;
+  uint32_t covered = 0;
+  for (const auto& [time, delta] : events) {
+    covered += delta;
+    if (covered >= task->node_num) {
+      earliest = time;
+      break;
+    }
+  }
+  // Enough nodes free now are picked from the idle node index only.
+  if (!earliest || *earliest <= now) return false;
+
+  std::vector<size_t> selected;
+  for (const StartRange& range : ranges) {
+    if (range.first <= *earliest && *earliest <= range.last)
+      selected.emplace_back(range.node_idx);
+    if (selected.size() == task->node_num) break;
+  }
+
+  ResourceV2 allocated_res;
+  task->allocated_res_view.SetToZero();
+  craned_ids->clear();
+  for (size_t node_idx : selected) {
+    allocated_res.AddResourceInNode(nodes[node_idx],
+                                    node_res_totals[node_idx]);
+    task->allocated_res_view += node_res_totals[node_idx];
+    craned_ids->emplace_back(nodes[node_idx]);
+  }
+  task->SetResources(std::move(allocated_res));
+
+  *start_time = *earliest;
+  return true;
+}
+
 void MinLoadFirst::SubtractTaskResourceNodeSelectionInfo_(
     const absl::Time& expected_start_time, const absl::Duration& duration,
     const ResourceV2& resources, std::list<CranedId> const& craned_ids,
-    MinLoadFirst::NodeSelectionInfo* node_selection_info) {
+    bool saturated, MinLoadFirst::NodeSelectionInfo* node_selection_info) {
   NodeSelectionInfo& node_info = *node_selection_info;
   bool ok;
 
@@ -2516,6 +3326,28 @@ void MinLoadFirst::SubtractTaskResourceNodeSelectionInfo_(
     TimeAvailResMap& time_avail_res_map =
         node_info.node_time_avail_res_map[craned_id];
 
+    // In the timeline restricted to a reservation, there may be less
+    // resource left than a task outside of it uses. The task then takes what
+    // is left.
+    auto subtract_task_res = [&task_res_in_node,
+                              saturated](ResourceInNode* avail_res) {
+      if (!saturated) {
+        CRANE_ASSERT(task_res_in_node <= *avail_res);
+        *avail_res -= task_res_in_node;
+        return;
+      }
+      if (task_res_in_node <= *avail_res) {
+        *avail_res -= task_res_in_node;
+        return;
+      }
+      SubtractAllocatableResSaturated(task_res_in_node.allocatable_res,
+                                      &avail_res->allocatable_res);
+      if (task_res_in_node.dedicated_res <= avail_res->dedicated_res)
+        avail_res->dedicated_res -= task_res_in_node.dedicated_res;
+      else
+        avail_res->dedicated_res.SetToZero();
+    };
+
     absl::Time task_end_time = expected_start_time + duration;
 
     auto task_duration_begin_it =
@@ -2553,16 +3385,14 @@ void MinLoadFirst::SubtractTaskResourceNodeSelectionInfo_(
 
       if (task_duration_begin_it->first == expected_start_time) {
         // Situation #1
-        CRANE_ASSERT(task_res_in_node <= task_duration_begin_it->second);
-        task_duration_begin_it->second -= task_res_in_node;
+        subtract_task_res(&task_duration_begin_it->second);
       } else {
         // Situation #2
         std::tie(inserted_it, ok) = time_avail_res_map.emplace(
             expected_start_time, task_duration_begin_it->second);
         CRANE_ASSERT_MSG(ok == true, "Insertion must be successful.");
 
-        CRANE_ASSERT(task_res_in_node <= inserted_it->second);
-        inserted_it->second -= task_res_in_node;
+        subtract_task_res(&inserted_it->second);
       }
     } else {
       --task_duration_begin_it;
@@ -2603,8 +3433,7 @@ void MinLoadFirst::SubtractTaskResourceNodeSelectionInfo_(
       // Subtract the required resources within the interval.
       for (auto in_duration_it = task_duration_begin_it;
            in_duration_it != task_duration_end_it; in_duration_it++) {
-        CRANE_ASSERT(task_res_in_node <= in_duration_it->second);
-        in_duration_it->second -= task_res_in_node;
+        subtract_task_res(&in_duration_it->second);
       }
 
       // Check if we need to insert a time point at
@@ -2626,11 +3455,86 @@ void MinLoadFirst::SubtractTaskResourceNodeSelectionInfo_(
             task_end_time, task_duration_end_it->second);
         CRANE_ASSERT_MSG(ok == true, "Insertion must be successful.");
 
-        CRANE_ASSERT(task_res_in_node <= task_duration_end_it->second);
-        task_duration_end_it->second -= task_res_in_node;
+        subtract_task_res(&task_duration_end_it->second);
       }
     }
+
+    if (node_info.pack_nodes)
+      node_info.free_res_index.Update(craned_id,
+                                      time_avail_res_map.begin()->second);
+  }
+}
+
+bool TaskScheduler::UseCranedRelay_(size_t craned_num) {
+  return g_config.CranedRelayFanOut != 0 &&
+         craned_num > g_config.CranedRelayFanOut;
+}
+
+void TaskScheduler::TerminateTasksOnCranedsByRelay_(
+    HashMap<CranedId, std::vector<task_id_t>> const& craned_task_ids_map,
+    uint32_t kill_grace_sec) {
+  google::protobuf::RepeatedPtrField<crane::grpc::RelayTarget> targets;
+  for (const auto& [craned_id, task_ids] : craned_task_ids_map) {
+    auto* target = targets.Add();
+    target->set_craned_id(craned_id);
+    auto* request = target->mutable_terminate_tasks();
+    request->mutable_task_id_list()->Assign(task_ids.begin(), task_ids.end());
+    request->set_kill_grace_seconds(kill_grace_sec);
+  }
+
+  CRANE_TRACE("Cancel tasks on {} craneds by relay.", targets.size());
+  std::vector<CranedId> failed_ids = g_craned_keeper->RelayToCraneds(targets);
+  if (!failed_ids.empty())
+    CRANE_DEBUG("TerminateTasks RPC failed on Node {}",
+                absl::StrJoin(failed_ids, ","));
+}
+
+void TaskScheduler::ReleaseCgroupOnCraneds_(
+    std::unordered_map<CranedId, std::vector<std::pair<task_id_t, uid_t>>>
+        const& craned_cgroups_map) {
+  if (UseCranedRelay_(craned_cgroups_map.size())) {
+    google::protobuf::RepeatedPtrField<crane::grpc::RelayTarget> targets;
+    for (const auto& [craned_id, cgroups] : craned_cgroups_map) {
+      auto* target = targets.Add();
+      target->set_craned_id(craned_id);
+      auto* request = target->mutable_release_cgroup();
+      for (const auto& [task_id, uid] : cgroups) {
+        request->add_task_id_list(task_id);
+        request->add_uid_list(uid);
+      }
+    }
+
+    std::vector<CranedId> failed_ids = g_craned_keeper->RelayToCraneds(targets);
+    if (!failed_ids.empty())
+      CRANE_ERROR("Failed to Release cgroup RPC on Node {}",
+                  absl::StrJoin(failed_ids, ","));
+    return;
+  }
+
+  absl::BlockingCounter bl(craned_cgroups_map.size());
+  for (const auto& [craned_id, cgroups] : craned_cgroups_map) {
+    g_thread_pool->detach_task([&bl, &craned_id, &cgroups]() {
+      auto stub = g_craned_keeper->GetCranedStub(craned_id);
+
+      // If the craned is down, just ignore it.
+      if (stub && !stub->Invalid()) {
+        CraneErr err = stub->ReleaseCgroupForTasks(cgroups);
+        if (err != CraneErr::kOk) {
+          CRANE_ERROR("Failed to Release cgroup RPC for {} tasks on Node {}",
+                      cgroups.size(), craned_id);
+        }
+      }
+      bl.DecrementCount();
+    });
   }
+  bl.Wait();
+}
+
+void TaskScheduler::SetTaskStatus_(TaskInCtld* task,
+                                   crane::grpc::TaskStatus new_status) {
+  if (g_event_journal)
+    g_event_journal->StatusChanged(task->TaskId(), task->Status(), new_status);
+  task->SetStatus(new_status);
 }
 
 void TaskScheduler::ProcessFinalTasks_(const std::vector<TaskInCtld*>& tasks) {
@@ -2641,12 +3545,10 @@ void TaskScheduler::ProcessFinalTasks_(const std::vector<TaskInCtld*>& tasks) {
 void TaskScheduler::CallPluginHookForFinalTasks_(
     std::vector<TaskInCtld*> const& tasks) {
   if (g_config.Plugin.Enabled && !tasks.empty()) {
-    std::vector<crane::grpc::TaskInfo> tasks_post_comp;
-    for (TaskInCtld* task : tasks) {
-      crane::grpc::TaskInfo t;
-      task->SetFieldsOfTaskInfo(&t);
-      tasks_post_comp.emplace_back(std::move(t));
-    }
+    std::vector<plugin::PluginClient::TaskSnapshotPtr> tasks_post_comp;
+    tasks_post_comp.reserve(tasks.size());
+    for (TaskInCtld* task : tasks)
+      tasks_post_comp.emplace_back(std::make_unique<TaskInfoSnapshot>(*task));
     g_plugin_client->EndHookAsync(std::move(tasks_post_comp));
   }
 }
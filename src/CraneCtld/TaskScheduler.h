@@ -21,6 +21,8 @@
 
 #include "CranedMetaContainer.h"
 #include "DbClient.h"
+#include "FreeResourceIndex.h"
+#include "Reservation.h"
 #include "crane/Lock.h"
 #include "protos/Crane.pb.h"
 
@@ -128,7 +130,7 @@ class INodeSelectionAlgo {
 class MinLoadFirst : public INodeSelectionAlgo {
  public:
   explicit MinLoadFirst(IPrioritySorter* priority_sorter)
-      : m_priority_sorter_(priority_sorter) {}
+      : MinLoadFirst(priority_sorter, false) {}
 
   void NodeSelect(
       const absl::flat_hash_map<task_id_t, std::unique_ptr<TaskInCtld>>&
@@ -136,6 +138,15 @@ class MinLoadFirst : public INodeSelectionAlgo {
       absl::btree_map<task_id_t, std::unique_ptr<TaskInCtld>>* pending_task_map,
       std::list<NodeSelectionResult>* selection_result_list) override;
 
+ protected:
+  /**
+   * @param pack_nodes If true, the nodes which can run a task now are tried
+   * in ascending order of their free resource instead of the number of
+   * running tasks.
+   */
+  MinLoadFirst(IPrioritySorter* priority_sorter, bool pack_nodes)
+      : m_priority_sorter_(priority_sorter), m_pack_nodes_(pack_nodes) {}
+
  private:
   static constexpr bool kAlgoTraceOutput = false;
 
@@ -168,14 +179,27 @@ class MinLoadFirst : public INodeSelectionAlgo {
     std::multimap<uint32_t /* # of running tasks */, CranedId>
         task_num_node_id_map;
     std::unordered_map<CranedId, TimeAvailResMap> node_time_avail_res_map;
+
+    // Only filled if pack_nodes is true. Indexes the resource available
+    // now, i.e., the first entry in node_time_avail_res_map of each node.
+    bool pack_nodes{false};
+    FreeResourceIndex free_res_index;
   };
 
+  /**
+   * @param reservations are blocked in the timelines if inside_reservation
+   * is null.
+   * @param inside_reservation if not null, the timelines are restricted to
+   * what the tasks in this reservation can use.
+   */
   static void CalculateNodeSelectionInfoOfPartition_(
       const absl::flat_hash_map<uint32_t, std::unique_ptr<TaskInCtld>>&
           running_tasks,
       absl::Time now, const PartitionId& partition_id,
       const std::unordered_set<CranedId> craned_ids,
       const CranedMetaContainer::CranedMetaRawMap& craned_meta_map,
+      const std::vector<Reservation>& reservations,
+      const Reservation* inside_reservation,
       NodeSelectionInfo* node_selection_info);
 
   // Input should guarantee that provided nodes in `node_selection_info` has
@@ -187,12 +211,56 @@ class MinLoadFirst : public INodeSelectionAlgo {
       TaskInCtld* task, absl::Time now, std::list<CranedId>* craned_ids,
       absl::Time* start_time);
 
+  /**
+   * For exclusive tasks. Take node_num nodes from the idle node index which
+   * stay idle in node_selection_info during the time limit of the task, and
+   * allocate all the resource of the nodes to the task.
+   * @return false if there are not enough such nodes now.
+   */
+  static bool SelectIdleNodesForExclusiveTask_(
+      const NodeSelectionInfo& node_selection_info,
+      const CranedMetaContainer::CranedMetaRawMap& craned_meta_map,
+      TaskInCtld* task, absl::Time now, std::list<CranedId>* craned_ids);
+
+  /**
+   * For exclusive tasks which can't start now. Find the earliest time from
+   * which node_num nodes stay fully free in node_selection_info during the
+   * time limit of the task, and allocate all the resource of the nodes to
+   * the task, so that the window is held in the timeline as it is for other
+   * tasks starting later.
+   * @return false if no such time exists.
+   */
+  static bool PlanExclusiveTaskInFuture_(
+      const NodeSelectionInfo& node_selection_info,
+      const CranedMetaContainer::CranedMetaRawMap& craned_meta_map,
+      TaskInCtld* task, absl::Time now, std::list<CranedId>* craned_ids,
+      absl::Time* start_time);
+
+  /**
+   * @param saturated if true, a timeline point with less resource left than
+   * the task uses drops to zero instead of failing the assertion. Only the
+   * NodeSelectionInfo restricted to a reservation needs it.
+   */
   static void SubtractTaskResourceNodeSelectionInfo_(
       absl::Time const& expected_start_time, absl::Duration const& duration,
       ResourceV2 const& resources, std::list<CranedId> const& craned_ids,
-      NodeSelectionInfo* node_selection_info);
+      bool saturated, NodeSelectionInfo* node_selection_info);
 
   IPrioritySorter* m_priority_sorter_;
+  bool m_pack_nodes_;
+};
+
+/**
+ * Multi-resource best-fit packing. A task is put on the nodes which have the
+ * least cpu, memory and device slots left among the nodes which can run it
+ * now. Small tasks fill up partially used nodes and more nodes stay idle for
+ * large and whole-node tasks. Tasks which can't run now are handled in the
+ * same way as MinLoadFirst.
+ */
+class BestFit final : public MinLoadFirst {
+ public:
+  explicit BestFit(IPrioritySorter* priority_sorter)
+      : MinLoadFirst(priority_sorter, true) {}
 };
 
 class TaskScheduler {
@@ -212,6 +280,14 @@ class TaskScheduler {
   using HashSet = absl::flat_hash_set<K>;
 
  public:
+  struct TaskStatusChangeArg {
+    uint32_t task_id;
+    uint32_t exit_code;
+    crane::grpc::TaskStatus new_status;
+    CranedId craned_index;
+    crane::grpc::TaskResourceUsage resource_usage;
+  };
+
   TaskScheduler();
 
   ~TaskScheduler();
@@ -234,14 +310,24 @@ class TaskScheduler {
                                        const CranedId& craned_index,
                                        crane::grpc::TaskStatus new_status,
                                        uint32_t exit_code,
-                                       std::optional<std::string>&& reason) {
+                                       std::optional<std::string>&& reason,
+                                       crane::grpc::TaskResourceUsage&& usage) {
     // Todo: Add reason implementation here!
-    TaskStatusChangeAsync(task_id, craned_index, new_status, exit_code);
+    TaskStatusChangeAsync(task_id, craned_index, new_status, exit_code,
+                          std::move(usage));
   }
 
   void TaskStatusChangeAsync(uint32_t task_id, const CranedId& craned_index,
                              crane::grpc::TaskStatus new_status,
-                             uint32_t exit_code);
+                             uint32_t exit_code,
+                             crane::grpc::TaskResourceUsage&& usage = {});
+
+  // Enqueue all status changes reported by one TaskStatusChangeBatch RPC
+  // at once so that they are handled in the same cleaning round.
+  // Return the task ids of the changes which are queued or permanently
+  // rejected. Craned resends the others.
+  std::vector<task_id_t> TaskStatusChangeBatchAsync(
+      std::vector<TaskStatusChangeArg>&& args);
 
   void TerminateTasksOnCraned(const CranedId& craned_id, uint32_t exit_code);
 
@@ -252,6 +338,11 @@ class TaskScheduler {
   crane::grpc::CancelTaskReply CancelPendingOrRunningTask(
       const crane::grpc::CancelTaskRequest& request);
 
+  // Tell why a task is still pending, from the last scheduling cycle which
+  // examined it.
+  void QueryPendingReason(const crane::grpc::QueryPendingReasonRequest& request,
+                          crane::grpc::QueryPendingReasonReply* response);
+
   CraneErr TerminatePendingOrRunningTask(uint32_t task_id) {
     LockGuard pending_guard(&m_pending_task_map_mtx_);
     LockGuard running_guard(&m_running_task_map_mtx_);
@@ -297,6 +388,11 @@ class TaskScheduler {
 
   void PutRecoveredTaskIntoRunningQueueLock_(std::unique_ptr<TaskInCtld> task);
 
+  // Set the status of a task at run time and record the transition in the
+  // event journal.
+  static void SetTaskStatus_(TaskInCtld* task,
+                             crane::grpc::TaskStatus new_status);
+
   static void ProcessFinalTasks_(std::vector<TaskInCtld*> const& tasks);
 
   static void CallPluginHookForFinalTasks_(
@@ -305,8 +401,31 @@ class TaskScheduler {
   static void PersistAndTransferTasksToMongodb_(
       std::vector<TaskInCtld*> const& tasks);
 
+  // Whether the RPCs to the given number of craneds go through the relay tree
+  // of craneds instead of being sent to each craned directly.
+  static bool UseCranedRelay_(size_t craned_num);
+
+  static void TerminateTasksOnCranedsByRelay_(
+      HashMap<CranedId, std::vector<task_id_t>> const& craned_task_ids_map,
+      uint32_t kill_grace_sec);
+
+  // Block until the cgroups are released or the RPCs fail.
+  static void ReleaseCgroupOnCraneds_(
+      std::unordered_map<CranedId, std::vector<std::pair<task_id_t, uid_t>>>
+          const& craned_cgroups_map);
+
   CraneErr TerminateRunningTaskNoLock_(TaskInCtld* task);
 
+  // Preempt running tasks of lower qos priority for the pending tasks which
+  // are expected to wait longer than the threshold. Both the pending map lock
+  // and the running map lock must be held.
+  void PreemptForPendingTasksNoLock_();
+
+  // Fail the pending tasks whose reservation has ended or been deleted.
+  // Called without any task map lock held.
+  void FailTasksOfEndedReservations_(
+      const std::vector<std::unique_ptr<TaskInCtld>>& tasks);
+
   CraneErr SetHoldForTaskInRamAndDb_(task_id_t task_id, bool hold);
 
   std::unique_ptr<INodeSelectionAlgo> m_node_selection_algo_;
@@ -376,6 +495,8 @@ class TaskScheduler {
   struct CancelRunningTaskQueueElem {
     task_id_t task_id;
     CranedId craned_id;
+    // Preempted tasks are killed by craned if they outlive the grace time.
+    bool preempted{false};
   };
 
   using CancelTaskQueueElem =
@@ -405,13 +526,6 @@ class TaskScheduler {
 
   std::shared_ptr<uvw::async_handle> m_task_status_change_async_handle_;
 
-  struct TaskStatusChangeArg {
-    uint32_t task_id;
-    uint32_t exit_code;
-    crane::grpc::TaskStatus new_status;
-    CranedId craned_index;
-  };
-
   ConcurrentQueue<TaskStatusChangeArg> m_task_status_change_queue_;
   void TaskStatusChangeAsyncCb_();
 
@@ -0,0 +1,218 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "Topology.h"
+
+namespace Ctld {
+
+bool TopologyTree::Init(const std::vector<Config::Switch>& switches,
+                        std::string* reason) {
+  std::vector<Switch> tree(switches.size());
+  absl::flat_hash_map<std::string, int> index_map;
+  absl::flat_hash_map<CranedId, int> node_switch_map;
+
+  for (int i = 0; i < switches.size(); i++) {
+    tree[i].name = switches[i].name;
+    if (!index_map.emplace(switches[i].name, i).second) {
+      *reason = fmt::format("Switch {} is defined twice.", switches[i].name);
+      return false;
+    }
+  }
+
+  for (int i = 0; i < switches.size(); i++) {
+    for (const auto& child_name : switches[i].switches) {
+      auto it = index_map.find(child_name);
+      if (it == index_map.end()) {
+        *reason = fmt::format("Unknown switch {} connected to switch {}.",
+                              child_name, tree[i].name);
+        return false;
+      }
+      if (tree[it->second].parent != -1) {
+        *reason = fmt::format("Switch {} is connected to more than one switch.",
+                              child_name);
+        return false;
+      }
+      tree[it->second].parent = i;
+    }
+
+    for (const auto& node : switches[i].nodes) {
+      if (!node_switch_map.emplace(node, i).second) {
+        *reason = fmt::format("Node {} is connected to more than one switch.",
+                              node);
+        return false;
+      }
+    }
+  }
+
+  // A chain longer than the number of switches must contain a cycle.
+  for (int i = 0; i < tree.size(); i++) {
+    int depth = 0;
+    for (int cur = tree[i].parent; cur != -1; cur = tree[cur].parent) {
+      if (++depth > tree.size()) {
+        *reason = fmt::format("Switch {} is in a cycle.", tree[i].name);
+        return false;
+      }
+    }
+  }
+
+  for (int i = 0; i < switches.size(); i++) {
+    for (const auto& node : switches[i].nodes) {
+      for (int cur = i; cur != -1; cur = tree[cur].parent) {
+        tree[cur].node_num++;
+        tree[cur].nodes.emplace_back(node);
+      }
+    }
+  }
+
+  std::vector<int> order(tree.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int lhs, int rhs) {
+    return tree[lhs].node_num < tree[rhs].node_num;
+  });
+
+  std::vector<int> new_index(tree.size());
+  for (int i = 0; i < order.size(); i++) new_index[order[i]] = i;
+
+  m_switches_.resize(tree.size());
+  for (int i = 0; i < order.size(); i++) {
+    Switch& sw = m_switches_[i];
+    sw = std::move(tree[order[i]]);
+    if (sw.parent != -1) sw.parent = new_index[sw.parent];
+    m_switch_index_map_.emplace(sw.name, i);
+  }
+
+  for (const auto& [node, leaf] : node_switch_map)
+    m_node_switch_map_.emplace(node, new_index[leaf]);
+
+  absl::MutexLock lock_guard(&m_aggregate_mtx_);
+  m_aggregates_.resize(m_switches_.size());
+
+  return true;
+}
+
+void TopologyTree::NodeUp(const CranedId& craned_id,
+                          const AllocatableResource& res_avail) {
+  auto it = m_node_switch_map_.find(craned_id);
+  if (it == m_node_switch_map_.end()) return;
+
+  absl::MutexLock lock_guard(&m_aggregate_mtx_);
+  for (int cur = it->second; cur != -1; cur = m_switches_[cur].parent) {
+    m_aggregates_[cur].alive_node_num++;
+    m_aggregates_[cur].res_avail += res_avail;
+  }
+}
+
+void TopologyTree::NodeDown(const CranedId& craned_id,
+                            const AllocatableResource& res_avail) {
+  auto it = m_node_switch_map_.find(craned_id);
+  if (it == m_node_switch_map_.end()) return;
+
+  absl::MutexLock lock_guard(&m_aggregate_mtx_);
+  for (int cur = it->second; cur != -1; cur = m_switches_[cur].parent) {
+    m_aggregates_[cur].alive_node_num--;
+    m_aggregates_[cur].res_avail -= res_avail;
+  }
+}
+
+void TopologyTree::MallocResource(const CranedId& craned_id,
+                                  const AllocatableResource& res) {
+  auto it = m_node_switch_map_.find(craned_id);
+  if (it == m_node_switch_map_.end()) return;
+
+  absl::MutexLock lock_guard(&m_aggregate_mtx_);
+  for (int cur = it->second; cur != -1; cur = m_switches_[cur].parent)
+    m_aggregates_[cur].res_avail -= res;
+}
+
+void TopologyTree::FreeResource(const CranedId& craned_id,
+                                const AllocatableResource& res) {
+  auto it = m_node_switch_map_.find(craned_id);
+  if (it == m_node_switch_map_.end()) return;
+
+  absl::MutexLock lock_guard(&m_aggregate_mtx_);
+  for (int cur = it->second; cur != -1; cur = m_switches_[cur].parent)
+    m_aggregates_[cur].res_avail += res;
+}
+
+bool TopologyTree::SwitchMayFit_(int switch_idx, uint32_t node_num,
+                                 const AllocatableResource& node_res) const {
+  const SwitchAggregate& aggregate = m_aggregates_[switch_idx];
+  if (aggregate.alive_node_num < node_num) return false;
+
+  AllocatableResource total_res = node_res;
+  total_res *= node_num;
+  return total_res <= aggregate.res_avail;
+}
+
+bool TopologyTree::AnySwitchMayFit(uint32_t node_num,
+                                   const AllocatableResource& node_res) const {
+  absl::ReaderMutexLock lock_guard(&m_aggregate_mtx_);
+  for (int i = 0; i < m_switches_.size(); i++)
+    if (SwitchMayFit_(i, node_num, node_res)) return true;
+
+  return false;
+}
+
+bool TopologyTree::SelectInSmallestSwitch(
+    uint32_t node_num, const AllocatableResource& node_res,
+    const std::function<bool(const CranedId&)>& node_runnable,
+    std::list<CranedId>* selected) const {
+  // Switches are sorted by the number of nodes below them.
+  std::vector<int> fitting_switches;
+  {
+    absl::ReaderMutexLock lock_guard(&m_aggregate_mtx_);
+    for (int i = 0; i < m_switches_.size(); i++)
+      if (SwitchMayFit_(i, node_num, node_res))
+        fitting_switches.emplace_back(i);
+  }
+
+  // A node below a smaller switch is also below its ancestors, so remember
+  // the result of each node to check it only once.
+  absl::flat_hash_map<CranedId, bool> runnable_cache;
+  std::vector<CranedId> picked;
+
+  for (int idx : fitting_switches) {
+    const std::vector<CranedId>& nodes = m_switches_[idx].nodes;
+    picked.clear();
+
+    for (size_t i = 0; i < nodes.size() && picked.size() < node_num; i++) {
+      // Stop early if the remaining nodes can not make up node_num.
+      if (picked.size() + (nodes.size() - i) < node_num) break;
+
+      auto [it, inserted] = runnable_cache.try_emplace(nodes[i], false);
+      if (inserted) it->second = node_runnable(nodes[i]);
+      if (it->second) picked.emplace_back(nodes[i]);
+    }
+
+    if (picked.size() == node_num) {
+      selected->insert(selected->end(), picked.begin(), picked.end());
+      return true;
+    }
+  }
+
+  return false;
+}
+
+std::optional<TopologyTree::SwitchAggregate> TopologyTree::GetSwitchAggregate(
+    const std::string& switch_name) const {
+  auto it = m_switch_index_map_.find(switch_name);
+  if (it == m_switch_index_map_.end()) return std::nullopt;
+
+  absl::ReaderMutexLock lock_guard(&m_aggregate_mtx_);
+  return m_aggregates_[it->second];
+}
+
+}  // namespace Ctld
@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#pragma once
+
+#include "CtldPublicDefs.h"
+// Precompiled header comes first!
+
+namespace Ctld {
+
+/**
+ * The switch tree of the cluster described in the Topology section of the
+ * config file, like topology.conf of Slurm. Each switch connects some nodes
+ * and/or some lower-level switches.
+ *
+ * For every switch, the number of alive nodes and the sum of the available
+ * allocatable resource of the nodes below it are kept up to date by
+ * CranedMetaContainer. They are used to skip the switches which can never
+ * hold a multi-node job without looking at the nodes.
+ */
+class TopologyTree {
+ public:
+  struct SwitchAggregate {
+    uint32_t alive_node_num{0};
+    AllocatableResource res_avail;
+  };
+
+  TopologyTree() = default;
+
+  /**
+   * Build the tree. MUST be called before any other function and only once.
+   * @param[out] reason is set if the description is invalid, e.g., an
+   * unknown switch is referred, a switch has two parents, the switches form
+   * a cycle or a node is connected to two switches.
+   */
+  bool Init(const std::vector<Config::Switch>& switches, std::string* reason);
+
+  bool Empty() const { return m_switches_.empty(); }
+
+  void NodeUp(const CranedId& craned_id, const AllocatableResource& res_avail);
+  void NodeDown(const CranedId& craned_id,
+                const AllocatableResource& res_avail);
+
+  void MallocResource(const CranedId& craned_id,
+                      const AllocatableResource& res);
+  void FreeResource(const CranedId& craned_id, const AllocatableResource& res);
+
+  /**
+   * Check the aggregates only.
+   * @return true if some switch may hold node_num nodes each of which has
+   * node_res available.
+   */
+  bool AnySwitchMayFit(uint32_t node_num,
+                       const AllocatableResource& node_res) const;
+
+  /**
+   * Pick node_num nodes below the switch with the fewest nodes which has
+   * node_num runnable nodes. Switches are walked from the smallest one, and
+   * those whose aggregates can not hold node_num nodes each of which has
+   * node_res available are skipped without looking at their nodes. The walk
+   * stops at the first switch which gathers node_num runnable nodes.
+   * @param node_runnable checks whether the task can run on a node now. It
+   * is called at most once for each node and without any lock of the tree
+   * held.
+   * @param[out] selected the picked nodes in the order of the config. It is
+   * left untouched if false is returned.
+   * @return false if no switch is connected to enough runnable nodes.
+   */
+  bool SelectInSmallestSwitch(
+      uint32_t node_num, const AllocatableResource& node_res,
+      const std::function<bool(const CranedId&)>& node_runnable,
+      std::list<CranedId>* selected) const;
+
+  std::optional<SwitchAggregate> GetSwitchAggregate(
+      const std::string& switch_name) const;
+
+ private:
+  struct Switch {
+    std::string name;
+    // The number of the nodes below this switch.
+    uint32_t node_num{0};
+    // All the nodes below this switch in the order of the config.
+    std::vector<CranedId> nodes;
+    // The index of the parent switch in m_switches_ or -1.
+    int parent{-1};
+  };
+
+  bool SwitchMayFit_(int switch_idx, uint32_t node_num,
+                     const AllocatableResource& node_res) const
+      ABSL_SHARED_LOCKS_REQUIRED(m_aggregate_mtx_);
+
+  // Sorted by node_num in ascending order, so the first switch which fits is
+  // the smallest one.
+  std::vector<Switch> m_switches_;
+  absl::flat_hash_map<std::string, int> m_switch_index_map_;
+  // The switch to which each node is directly connected.
+  absl::flat_hash_map<CranedId, int> m_node_switch_map_;
+
+  mutable absl::Mutex m_aggregate_mtx_;
+  std::vector<SwitchAggregate> m_aggregates_ ABSL_GUARDED_BY(m_aggregate_mtx_);
+};
+
+}  // namespace Ctld
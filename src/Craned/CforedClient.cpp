@@ -35,38 +35,92 @@ void CforedClient::InitChannelAndStub(const std::string& cfored_name) {
   m_fwd_thread_ = std::thread([this] { AsyncSendRecvThread_(); });
 }
 
+bool CforedClient::CollectOutput_(
+    std::vector<StreamCforedTaskIORequest>* requests,
+    std::vector<task_id_t>* resumed_tasks) {
+  absl::MutexLock lock(&m_output_mtx_);
+
+  bool stopped;
+  while (true) {
+    stopped = m_stopped_.load(std::memory_order::acquire);
+    if (stopped || m_output_pending_bytes_ >= kTaskOutputFlushBytes) break;
+
+    // Without pending output, wake up periodically to check m_stopped_.
+    absl::Duration timeout = absl::Milliseconds(75);
+    if (m_output_pending_bytes_ > 0) {
+      absl::Time oldest = absl::InfiniteFuture();
+      for (const auto& [task_id, buf] : m_task_output_map_)
+        if (!buf->ring.Empty())
+          oldest = std::min(oldest, buf->first_pending_time);
+
+      timeout = oldest + kTaskOutputFlushLatency - absl::Now();
+      if (timeout <= absl::ZeroDuration()) break;
+    }
+    m_output_cv_.WaitWithTimeout(&m_output_mtx_, timeout);
+  }
+
+  for (auto it = m_task_output_map_.begin(); it != m_task_output_map_.end();) {
+    task_id_t task_id = it->first;
+    TaskOutputBuffer& buf = *it->second;
+    m_output_pending_bytes_ -=
+        buf.ring.DrainInChunks(kTaskOutputMaxMsgBytes, [&] {
+          StreamCforedTaskIORequest& request = requests->emplace_back();
+          request.set_type(StreamCforedTaskIORequest::CRANED_TASK_OUTPUT);
+
+          auto* payload = request.mutable_payload_task_output_req();
+          payload->set_task_id(task_id);
+          return payload->mutable_msg();
+        });
+
+    if (buf.paused) {
+      buf.paused = false;
+      resumed_tasks->emplace_back(task_id);
+    }
+
+    // The output of a finished task is never read again.
+    if (buf.finished)
+      m_task_output_map_.erase(it++);
+    else
+      ++it;
+  }
+
+  return !(stopped && requests->empty());
+}
+
 void CforedClient::CleanOutputQueueAndWriteToStreamThread_(
     ClientAsyncReaderWriter<StreamCforedTaskIORequest, StreamCforedTaskIOReply>*
         stream,
     std::atomic<bool>* write_pending) {
   CRANE_TRACE("CleanOutputQueueThread started.");
-  std::pair<task_id_t, std::string> output;
-  bool ok = m_output_queue_.try_dequeue(output);
+  std::vector<StreamCforedTaskIORequest> requests;
+  std::vector<task_id_t> resumed_tasks;
 
   // Make sure before exit all output has been drained.
-  while (!m_stopped_ || ok) {
-    if (!ok) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(75));
-      ok = m_output_queue_.try_dequeue(output);
-      continue;
+  while (CollectOutput_(&requests, &resumed_tasks)) {
+    if (m_output_resume_cb_)
+      for (task_id_t task_id : resumed_tasks) m_output_resume_cb_(task_id);
+
+    // Only one write may be in flight on the stream. Writes except the last
+    // one are buffered by gRPC, so that the outputs collected in one round
+    // are sent to cfored together.
+    for (size_t i = 0; i < requests.size(); i++) {
+      write_pending->wait(true, std::memory_order::acquire);
+      if (m_stream_ended_.load(std::memory_order::acquire)) break;
+
+      grpc::WriteOptions options;
+      if (i + 1 < requests.size()) options.set_buffer_hint();
+
+      CRANE_TRACE("Writing output...");
+      write_pending->store(true, std::memory_order::release);
+      stream->Write(requests[i], options, (void*)Tag::Write);
     }
 
-    StreamCforedTaskIORequest request;
-    request.set_type(StreamCforedTaskIORequest::CRANED_TASK_OUTPUT);
-
-    auto* payload = request.mutable_payload_task_output_req();
-    payload->set_msg(output.second), payload->set_task_id(output.first);
-
-    while (write_pending->load(std::memory_order::acquire))
-      std::this_thread::sleep_for(std::chrono::milliseconds(25));
-
-    CRANE_TRACE("Writing output...");
-    write_pending->store(true, std::memory_order::release);
-    stream->Write(request, (void*)Tag::Write);
-
-    ok = m_output_queue_.try_dequeue(output);
+    requests.clear();
+    resumed_tasks.clear();
+    if (m_stream_ended_.load(std::memory_order::acquire)) break;
   }
 
+  m_output_drained_.store(true, std::memory_order::release);
   CRANE_TRACE("CleanOutputQueueThread exited.");
 }
 
@@ -112,7 +166,12 @@ void CforedClient::AsyncSendRecvThread_() {
         // No need to switch to Unregistering state if already switched.
         if (state == State::Unregistering) continue;
         // Wait for forwarding thread to drain output queue and stop.
-        if (output_clean_thread.joinable()) output_clean_thread.join();
+        // The acks of its writes are handled by this thread, so it is joined
+        // only after it has exited by itself.
+        if (output_clean_thread.joinable()) {
+          if (!m_output_drained_.load(std::memory_order::acquire)) continue;
+          output_clean_thread.join();
+        }
         // If some writes are pending, let state machine clean them up.
         if (write_pending.load(std::memory_order::acquire)) continue;
 
@@ -191,6 +250,7 @@ void CforedClient::AsyncSendRecvThread_() {
       // Do nothing for acknowledgements of successful writes in Forward State.
       if (tag == Tag::Write) {
         write_pending.store(false, std::memory_order::release);
+        write_pending.notify_one();
         break;
       }
 
@@ -241,6 +301,11 @@ void CforedClient::AsyncSendRecvThread_() {
 
     case State::End:
       m_stopped_ = true;
+      // Wake up the forwarding thread if it is waiting for a write which
+      // will never complete.
+      m_stream_ended_.store(true, std::memory_order::release);
+      write_pending.store(false, std::memory_order::release);
+      write_pending.notify_one();
       if (output_clean_thread.joinable()) output_clean_thread.join();
       break;
     }
@@ -252,11 +317,68 @@ void CforedClient::AsyncSendRecvThread_() {
 
 void CforedClient::InitTaskFwdAndSetInputCb(
     task_id_t task_id, std::function<bool(const std::string&)> task_input_cb) {
+  {
+    absl::MutexLock lock(&m_output_mtx_);
+    m_task_output_map_[task_id] = std::make_unique<TaskOutputBuffer>();
+  }
+
   absl::MutexLock lock(&m_mtx_);
   m_task_fwd_meta_map_[task_id].input_cb = std::move(task_input_cb);
 }
 
+CforedClient::OutputReadResult CforedClient::TaskOutputReadFrom(
+    task_id_t task_id, int fd) {
+  TaskOutputBuffer* buf;
+  iovec iov[2];
+  int iov_cnt;
+  {
+    absl::MutexLock lock(&m_output_mtx_);
+    auto it = m_task_output_map_.find(task_id);
+    if (it == m_task_output_map_.end()) return OutputReadResult::kError;
+
+    buf = it->second.get();
+    iov_cnt = buf->ring.FreeSpans(iov);
+    if (iov_cnt == 0) {
+      buf->paused = true;
+      return OutputReadResult::kBufferFull;
+    }
+  }
+
+  // The buffer is not erased before the output is finished, and the free
+  // spans are not touched by the forwarding thread.
+  ssize_t n = readv(fd, iov, iov_cnt);
+  if (n == 0) return OutputReadResult::kEof;
+  if (n == -1) {
+    if (errno == EAGAIN || errno == EINTR) return OutputReadResult::kOk;
+    return OutputReadResult::kError;
+  }
+
+  absl::MutexLock lock(&m_output_mtx_);
+  if (buf->ring.Empty()) buf->first_pending_time = absl::Now();
+  buf->ring.Commit(n);
+
+  // Wake up the forwarding thread to start the latency timer or to flush.
+  size_t prev_pending_bytes = m_output_pending_bytes_;
+  m_output_pending_bytes_ += n;
+  if (prev_pending_bytes == 0 ||
+      (prev_pending_bytes < kTaskOutputFlushBytes &&
+       m_output_pending_bytes_ >= kTaskOutputFlushBytes))
+    m_output_cv_.Signal();
+
+  if (buf->ring.Full()) {
+    buf->paused = true;
+    return OutputReadResult::kBufferFull;
+  }
+  return OutputReadResult::kOk;
+}
+
 bool CforedClient::TaskOutputFinish(task_id_t task_id) {
+  {
+    absl::MutexLock lock(&m_output_mtx_);
+    auto it = m_task_output_map_.find(task_id);
+    if (it != m_task_output_map_.end()) it->second->finished = true;
+  }
+
   absl::MutexLock lock(&m_mtx_);
   auto& task_fwd_meta = m_task_fwd_meta_map_.at(task_id);
   task_fwd_meta.output_stopped = true;
@@ -270,12 +392,6 @@ bool CforedClient::TaskProcessStop(task_id_t task_id) {
   return task_fwd_meta.output_stopped && task_fwd_meta.proc_stopped;
 };
 
-void CforedClient::TaskOutPutForward(task_id_t task_id,
-                                     const std::string& msg) {
-  CRANE_TRACE("Receive TaskOutputForward for task #{}: {}", task_id, msg);
-  m_output_queue_.enqueue({task_id, msg});
-}
-
 bool CforedManager::Init() {
   m_loop_ = uvw::loop::create();
 
@@ -291,6 +407,12 @@ bool CforedManager::Init() {
   m_unregister_handle_->on<uvw::async_event>(
       [this](const uvw::async_event&, uvw::async_handle&) { UnregisterCb_(); });
 
+  m_output_resume_handle_ = m_loop_->resource<uvw::async_handle>();
+  m_output_resume_handle_->on<uvw::async_event>(
+      [this](const uvw::async_event&, uvw::async_handle&) {
+        OutputResumeCb_();
+      });
+
   m_ev_loop_thread_ = std::thread([=, this]() { EvLoopThread_(m_loop_); });
 
   return true;
@@ -346,6 +468,11 @@ void CforedManager::RegisterCb_() {
       m_cfored_client_ref_count_map_[elem.cfored]++;
     } else {
       auto cfored_client = std::make_shared<CforedClient>();
+      cfored_client->SetOutputResumeCb(
+          [this, cfored = elem.cfored](task_id_t task_id) {
+            m_output_resume_queue_.enqueue({cfored, task_id});
+            m_output_resume_handle_->send();
+          });
       cfored_client->InitChannelAndStub(elem.cfored);
 
       m_cfored_client_map_[elem.cfored] = std::move(cfored_client);
@@ -375,42 +502,59 @@ void CforedManager::RegisterCb_() {
                                          uvw::poll_handle& h) {
       CRANE_TRACE("Detect task #{} output.", elem.task_id);
 
-      constexpr int MAX_BUF_SIZE = 4096;
-      char buf[MAX_BUF_SIZE];
+      using Result = CforedClient::OutputReadResult;
+      Result result = m_cfored_client_map_[elem.cfored]->TaskOutputReadFrom(
+          elem.task_id, elem.out_fd);
+      if (result == Result::kOk) return;
 
-      auto ret = read(elem.out_fd, buf, MAX_BUF_SIZE);
-      if (ret == 0) {
-        CRANE_TRACE("Task #{} to cfored {} finished its output.", elem.task_id,
-                    elem.cfored);
-        h.close();
-        close(elem.out_fd);
-
-        bool ok_to_free =
-            m_cfored_client_map_[elem.cfored]->TaskOutputFinish(elem.task_id);
-        if (ok_to_free) {
-          CRANE_TRACE("It's ok to unregister task #{} on {}", elem.task_id,
-                      elem.cfored);
-          UnregisterIOForward_(elem.cfored, elem.task_id);
-        }
+      if (result == Result::kBufferFull) {
+        // Cfored falls behind. Stop reading until the output is sent.
+        CRANE_TRACE("Output buffer of task #{} is full. Pause reading.",
+                    elem.task_id);
+        h.stop();
         return;
       }
 
-      if (ret == -1)
-        CRANE_ERROR("Error when reading task #{} output", elem.task_id);
+      if (result == Result::kError)
+        CRANE_ERROR("Error when reading task #{} output: {}", elem.task_id,
+                    strerror(errno));
 
-      std::string output(buf, ret);
-      CRANE_TRACE("Fwd to task #{}: {}", elem.task_id, output);
-      m_cfored_client_map_[elem.cfored]->TaskOutPutForward(elem.task_id,
-                                                           output);
+      CRANE_TRACE("Task #{} to cfored {} finished its output.", elem.task_id,
+                  elem.cfored);
+      m_task_output_poll_handle_map_.erase(elem.task_id);
+      h.close();
+      close(elem.out_fd);
+
+      bool ok_to_free =
+          m_cfored_client_map_[elem.cfored]->TaskOutputFinish(elem.task_id);
+      if (ok_to_free) {
+        CRANE_TRACE("It's ok to unregister task #{} on {}", elem.task_id,
+                    elem.cfored);
+        UnregisterIOForward_(elem.cfored, elem.task_id);
+      }
     });
     int ret = poll_handle->start(uvw::poll_handle::poll_event_flags::READABLE);
     if (ret < 0)
       CRANE_ERROR("poll_handle->start() error: {}", uv_strerror(ret));
+    m_task_output_poll_handle_map_[p.first.task_id] = std::move(poll_handle);
 
     p.second.set_value(true);
   }
 }
 
+void CforedManager::OutputResumeCb_() {
+  std::pair<std::string, task_id_t> elem;
+  while (m_output_resume_queue_.try_dequeue(elem)) {
+    auto it = m_task_output_poll_handle_map_.find(elem.second);
+    if (it == m_task_output_poll_handle_map_.end()) continue;
+
+    CRANE_TRACE("Resume reading the output of task #{}.", elem.second);
+    int ret = it->second->start(uvw::poll_handle::poll_event_flags::READABLE);
+    if (ret < 0)
+      CRANE_ERROR("poll_handle->start() error: {}", uv_strerror(ret));
+  }
+}
+
 void CforedManager::TaskProcOnCforedStopped(std::string const& cfored,
                                             task_id_t task_id) {
   TaskStopElem elem{.cfored = cfored, .task_id = task_id};
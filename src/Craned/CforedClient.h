@@ -6,6 +6,7 @@
 #include <uvw.hpp>
 
 #include "TaskManager.h"
+#include "TaskOutputRing.h"
 
 namespace Craned {
 
@@ -14,6 +15,18 @@ using grpc::Channel;
 using grpc::ClientAsyncReaderWriter;
 using grpc::CompletionQueue;
 
+// Output of a task waiting to be sent to cfored is kept in a ring buffer of
+// this size. The output fd of the task is not polled while it is full.
+inline constexpr size_t kTaskOutputBufferSize = 256 * 1024;
+
+// Pending output is sent once it exceeds kTaskOutputFlushBytes in total or
+// kTaskOutputFlushLatency has passed since the oldest byte was read.
+inline constexpr size_t kTaskOutputFlushBytes = 16 * 1024;
+inline constexpr absl::Duration kTaskOutputFlushLatency = absl::Milliseconds(5);
+
+// Upper bound of the output carried by a single CranedTaskOutputReq.
+inline constexpr size_t kTaskOutputMaxMsgBytes = 64 * 1024;
+
 using crane::grpc::CraneForeD;
 using crane::grpc::StreamCforedTaskIOReply;
 using crane::grpc::StreamCforedTaskIORequest;
@@ -33,7 +46,21 @@ class CforedClient {
   void InitTaskFwdAndSetInputCb(
       task_id_t task_id, std::function<bool(const std::string&)> task_input_cb);
 
-  void TaskOutPutForward(task_id_t task_id, const std::string& msg);
+  // Called from the forwarding thread when the output buffer of a paused
+  // task has been drained and the output fd should be polled again.
+  void SetOutputResumeCb(std::function<void(task_id_t)> cb) {
+    m_output_resume_cb_ = std::move(cb);
+  }
+
+  enum class OutputReadResult : uint8_t {
+    kOk = 0,
+    kBufferFull,  // Stop polling the fd until the resume callback is called.
+    kEof,
+    kError,
+  };
+
+  // Read the output of the task from fd into its output buffer.
+  OutputReadResult TaskOutputReadFrom(task_id_t task_id, int fd);
 
   bool TaskOutputFinish(task_id_t task_id);
 
@@ -47,14 +74,38 @@ class CforedClient {
     bool proc_stopped{false};
   };
 
+  struct TaskOutputBuffer {
+    TaskOutputRing ring{kTaskOutputBufferSize};
+    absl::Time first_pending_time;
+    bool paused{false};
+    bool finished{false};
+  };
+
   void CleanOutputQueueAndWriteToStreamThread_(
       ClientAsyncReaderWriter<StreamCforedTaskIORequest,
                               StreamCforedTaskIOReply>* stream,
       std::atomic<bool>* write_pending);
 
-  ConcurrentQueue<std::pair<task_id_t, std::string /*msg*/>> m_output_queue_;
+  // Wait until the pending output should be flushed and pack it into
+  // requests. Tasks whose buffers are no longer full are put into
+  // resumed_tasks.
+  // @return false if the client is stopped and all output has been packed.
+  bool CollectOutput_(std::vector<StreamCforedTaskIORequest>* requests,
+                      std::vector<task_id_t>* resumed_tasks);
+
   std::thread m_fwd_thread_;
   std::atomic<bool> m_stopped_{false};
+  // Set when the stream ends, after which the pending output is dropped.
+  std::atomic<bool> m_stream_ended_{false};
+  // Set when the forwarding thread has sent all output and exited.
+  std::atomic<bool> m_output_drained_{false};
+
+  absl::Mutex m_output_mtx_;
+  absl::CondVar m_output_cv_;
+  absl::flat_hash_map<task_id_t, std::unique_ptr<TaskOutputBuffer>>
+      m_task_output_map_ ABSL_GUARDED_BY(m_output_mtx_);
+  size_t m_output_pending_bytes_ ABSL_GUARDED_BY(m_output_mtx_){0};
+  std::function<void(task_id_t)> m_output_resume_cb_;
 
   std::string m_cfored_name_;
   std::shared_ptr<Channel> m_cfored_channel_;
@@ -121,6 +172,16 @@ class CforedManager {
   ConcurrentQueue<UnregisterElem> m_unregister_queue_;
   void UnregisterCb_();
 
+  std::shared_ptr<uvw::async_handle> m_output_resume_handle_;
+  ConcurrentQueue<std::pair<std::string /*cfored*/, task_id_t>>
+      m_output_resume_queue_;
+  void OutputResumeCb_();
+
+  // Poll handles of the output fds of tasks, used to pause and resume
+  // reading the output.
+  std::unordered_map<task_id_t, std::shared_ptr<uvw::poll_handle>>
+      m_task_output_poll_handle_map_;
+
   std::unordered_map<std::string /*cfored name*/, std::shared_ptr<CforedClient>>
       m_cfored_client_map_;
 
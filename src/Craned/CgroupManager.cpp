@@ -22,6 +22,8 @@
 #include "CgroupManager.h"
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
 #include <libcgroup.h>
 
 #include "CranedPublicDefs.h"
@@ -32,6 +34,81 @@
 
 namespace Craned {
 
+namespace {
+
+bool WriteCgroupFile(int dir_fd, const char *file, std::string_view value) {
+  int fd = openat(dir_fd, file, O_WRONLY | O_CLOEXEC);
+  if (fd == -1) return false;
+
+  ssize_t n;
+  do {
+    n = write(fd, value.data(), value.size());
+  } while (n == -1 && errno == EINTR);
+
+  int saved_errno = errno;
+  close(fd);
+  errno = saved_errno;
+  return n == static_cast<ssize_t>(value.size());
+}
+
+bool ReadCgroupProcs(int dir_fd, std::vector<pid_t> *pids) {
+  int fd = openat(dir_fd, CgroupConstant::kCgroupProcsFile,
+                  O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return false;
+
+  std::string content;
+  char buf[4096];
+  ssize_t n;
+  while (true) {
+    n = read(fd, buf, sizeof(buf));
+    if (n > 0) {
+      content.append(buf, n);
+    } else if (n == -1 && errno == EINTR) {
+      continue;
+    } else {
+      break;
+    }
+  }
+  close(fd);
+  if (n == -1) return false;
+
+  for (absl::string_view line :
+       absl::StrSplit(content, '\n', absl::SkipEmpty())) {
+    pid_t pid;
+    if (std::from_chars(line.data(), line.data() + line.size(), pid).ec ==
+        std::errc())
+      pids->push_back(pid);
+  }
+  return true;
+}
+
+// Read the whole file from the beginning without moving the file offset, so
+// that the fd can be reused for later samples.
+bool PreadFile(int fd, std::string *content) {
+  char buf[4096];
+  off_t offset = 0;
+  content->clear();
+  while (true) {
+    ssize_t n = pread(fd, buf, sizeof(buf), offset);
+    if (n > 0) {
+      content->append(buf, n);
+      offset += n;
+    } else if (n == -1 && errno == EINTR) {
+      continue;
+    } else {
+      return n == 0;
+    }
+  }
+}
+
+uint64_t ParseUint64(absl::string_view str) {
+  uint64_t value = 0;
+  std::from_chars(str.data(), str.data() + str.size(), value);
+  return value;
+}
+
+}  // namespace
+
 /*
  * Initialize libcgroup and mount the controllers Condor will use (if possible)
  *
@@ -112,6 +189,12 @@ int CgroupManager::Init() {
             (info.hierarchy != 0)
                 ? ControllerFlags{Controller::DEVICES_CONTROLLER}
                 : NO_CONTROLLERS;
+      } else if (info.name ==
+                 GetControllerStringView(Controller::CPUSET_CONTROLLER)) {
+        m_mounted_controllers_ |=
+            (info.hierarchy != 0)
+                ? ControllerFlags{Controller::CPUSET_CONTROLLER}
+                : NO_CONTROLLERS;
       }
       ret = cgroup_get_all_controller_next(&handle, &info);
     }
@@ -183,6 +266,21 @@ int CgroupManager::Init() {
     CRANE_WARN("Error Cgroup version is not supported");
     return -1;
   }
+  if (m_cpu_binding_) {
+    bool cpuset_mounted =
+        cg_version_ == CgroupConstant::CgroupVersion::CGROUP_V1
+            ? Mounted(Controller::CPUSET_CONTROLLER)
+            : Mounted(Controller::CPUSET_CONTROLLER_V2);
+    if (!cpuset_mounted) {
+      CRANE_WARN("Cgroup controller for cpuset is not available. "
+                 "Cpu binding is disabled.");
+      m_cpu_binding_ = false;
+    } else if (!m_cpuset_allocator_.Init()) {
+      CRANE_WARN("Failed to read the cpu topology. Cpu binding is disabled.");
+      m_cpu_binding_ = false;
+    }
+  }
+
   if (cg_version_ == CgroupConstant::CgroupVersion::CGROUP_V1) {
     RmAllTaskCgroups_();
   } else if (cg_version_ == CgroupConstant::CgroupVersion::CGROUP_V2) {
@@ -190,15 +288,111 @@ int CgroupManager::Init() {
   } else {
     CRANE_WARN("Error Cgroup version is not supported");
   }
+
+  if (cg_backend_ == CgroupConstant::CgroupBackend::CGROUPFS &&
+      !InitCgroupFs_()) {
+    CRANE_WARN(
+        "Failed to initialize cgroupfs backend. Fall back to libcgroup.");
+    cg_backend_ = CgroupConstant::CgroupBackend::LIBCGROUP;
+  }
+
+  if (m_pool_enabled_) {
+    {
+      absl::MutexLock lock_guard(&m_pool_mtx_);
+      m_pool_target_size_ = m_pool_min_size_;
+      m_pool_window_start_ = absl::Now();
+    }
+    RefillCgroupPool_();
+  }
+
+  if (cg_version_ == CgroupConstant::CgroupVersion::CGROUP_V2) {
+    m_teardown_inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_teardown_inotify_fd_ == -1)
+      CRANE_WARN("Failed to create inotify fd for cgroup teardown: {}",
+                 strerror(errno));
+  }
   return 0;
 }
 
+bool CgroupManager::InitCgroupFs_() {
+  using CgroupConstant::Controller;
+  using CgroupConstant::GetControllerStringView;
+
+  m_root_dir_fds_.fill(-1);
+
+  if (cg_version_ == CgroupConstant::CgroupVersion::CGROUP_V1) {
+    for (Controller controller :
+         {Controller::MEMORY_CONTROLLER, Controller::FREEZE_CONTROLLER,
+          Controller::CPU_CONTROLLER, Controller::DEVICES_CONTROLLER,
+          Controller::CPUSET_CONTROLLER}) {
+      if (!Mounted(controller)) continue;
+
+      // The directory may be a symbolic link to a co-mounted hierarchy,
+      // e.g. cpu -> cpu,cpuacct.
+      std::string path =
+          fmt::format("{}/{}", CgroupConstant::RootCgroupFullPath,
+                      GetControllerStringView(controller));
+      int fd = open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (fd == -1) {
+        CRANE_ERROR("Failed to open cgroup hierarchy {}: {}", path,
+                    strerror(errno));
+        for (int &root_fd : m_root_dir_fds_)
+          if (root_fd != -1) close(root_fd);
+        m_root_dir_fds_.fill(-1);
+        return false;
+      }
+      m_root_dir_fds_[static_cast<size_t>(controller)] = fd;
+    }
+    return true;
+  }
+
+  if (cg_version_ == CgroupConstant::CgroupVersion::CGROUP_V2) {
+    int fd = open(CgroupConstant::RootCgroupFullPath,
+                  O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) {
+      CRANE_ERROR("Failed to open {}: {}", CgroupConstant::RootCgroupFullPath,
+                  strerror(errno));
+      return false;
+    }
+
+    for (Controller controller :
+         {Controller::MEMORY_CONTORLLER_V2, Controller::CPU_CONTROLLER_V2,
+          Controller::IO_CONTROLLER_V2, Controller::CPUSET_CONTROLLER_V2,
+          Controller::PIDS_CONTROLLER_V2})
+      if (Mounted(controller))
+        m_root_dir_fds_[static_cast<size_t>(controller)] = fd;
+
+    // Enable the controllers for task cgroups, which is done by libcgroup
+    // in cgroup_create_cgroup() for the other backend. The io controller is
+    // only enabled for io.stat.
+    for (Controller controller :
+         {Controller::CPU_CONTROLLER_V2, Controller::MEMORY_CONTORLLER_V2,
+          Controller::IO_CONTROLLER_V2, Controller::CPUSET_CONTROLLER_V2}) {
+      if (!Mounted(controller)) continue;
+      if (controller == Controller::CPUSET_CONTROLLER_V2 && !m_cpu_binding_)
+        continue;
+      std::string value =
+          fmt::format("+{}", GetControllerStringView(controller));
+      if (!WriteCgroupFile(fd, CgroupConstant::kCgroupSubtreeControlFile,
+                           value))
+        CRANE_WARN("Failed to enable {} in {}: {}", value,
+                   CgroupConstant::kCgroupSubtreeControlFile, strerror(errno));
+    }
+    return true;
+  }
+
+  return false;
+}
+
 void CgroupManager::RmAllTaskCgroups_() {
   RmAllTaskCgroupsUnderController_(CgroupConstant::Controller::CPU_CONTROLLER);
   RmAllTaskCgroupsUnderController_(
       CgroupConstant::Controller::MEMORY_CONTROLLER);
   RmAllTaskCgroupsUnderController_(
       CgroupConstant::Controller::DEVICES_CONTROLLER);
+  if (Mounted(CgroupConstant::Controller::CPUSET_CONTROLLER))
+    RmAllTaskCgroupsUnderController_(
+        CgroupConstant::Controller::CPUSET_CONTROLLER);
 }
 
 void CgroupManager::ControllersMounted(){
@@ -440,6 +634,197 @@ std::unique_ptr<Cgroup> CgroupManager::CreateOrOpen_(
   }
 }
 
+std::unique_ptr<Cgroup> CgroupManager::CreateOrOpenFs_(
+    const std::string &cgroup_string, ControllerFlags controllers) {
+  using CgroupConstant::Controller;
+
+  CgroupDirFds dir_fds;
+  dir_fds.fill(-1);
+
+  // Close the opened fds and remove the directories created by us.
+  auto rollback = [&](size_t end) {
+    for (size_t i = 0; i < end; i++) {
+      if (dir_fds[i] == -1) continue;
+      close(dir_fds[i]);
+      unlinkat(m_root_dir_fds_[i], cgroup_string.c_str(), AT_REMOVEDIR);
+    }
+  };
+
+  for (size_t i = 0; i < dir_fds.size(); i++) {
+    auto controller = static_cast<Controller>(i);
+    int root_fd = m_root_dir_fds_[i];
+    if (!(controllers & controller) || root_fd == -1) continue;
+
+    // On cgroup v2, all controllers share the same directory.
+    if (cg_version_ == CgroupConstant::CgroupVersion::CGROUP_V2 &&
+        std::ranges::any_of(dir_fds, [](int fd) { return fd != -1; }))
+      break;
+
+    if (mkdirat(root_fd, cgroup_string.c_str(), 0755) == -1 &&
+        errno != EEXIST) {
+      CRANE_WARN("Unable to create cgroup {} under {}: {}", cgroup_string,
+                 CgroupConstant::GetControllerStringView(controller),
+                 strerror(errno));
+      rollback(i);
+      return nullptr;
+    }
+
+    dir_fds[i] = openat(root_fd, cgroup_string.c_str(),
+                        O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fds[i] == -1) {
+      CRANE_WARN("Unable to open cgroup {} under {}: {}", cgroup_string,
+                 CgroupConstant::GetControllerStringView(controller),
+                 strerror(errno));
+      unlinkat(root_fd, cgroup_string.c_str(), AT_REMOVEDIR);
+      rollback(i);
+      return nullptr;
+    }
+
+    // Try to turn on hierarchical memory accounting in V1.
+    if (controller == Controller::MEMORY_CONTROLLER &&
+        !WriteCgroupFile(dir_fds[i], CgroupConstant::kMemoryUseHierarchyFile,
+                         "1"))
+      CRANE_WARN("Unable to set hierarchical memory settings for {}: {}",
+                 cgroup_string, strerror(errno));
+  }
+
+  if (cg_version_ == CgroupConstant::CgroupVersion::CGROUP_V1)
+    return std::make_unique<CgroupFsV1>(cgroup_string, m_root_dir_fds_,
+                                        dir_fds);
+
+  auto it = std::ranges::find_if(dir_fds, [](int fd) { return fd != -1; });
+  if (it == dir_fds.end()) {
+    CRANE_WARN("Unable to create cgroup {}: no controller is available.",
+               cgroup_string);
+    return nullptr;
+  }
+  size_t idx = std::distance(dir_fds.begin(), it);
+  return std::make_unique<CgroupFsV2>(cgroup_string, m_root_dir_fds_[idx],
+                                      *it);
+}
+
+std::unique_ptr<Cgroup> CgroupManager::CreateTaskCgroup_(
+    const std::string &cgroup_string) {
+  using CgroupConstant::Controller;
+
+  ControllerFlags cpuset_flags = NO_CONTROLLER_FLAG;
+  if (m_cpu_binding_)
+    cpuset_flags =
+        Controller::CPUSET_CONTROLLER | Controller::CPUSET_CONTROLLER_V2;
+
+  if (cg_backend_ == CgroupConstant::CgroupBackend::CGROUPFS) {
+    // Only directories are created here. Limits are written right after
+    // creation in AllocateAndGetCgroup without going through libcgroup.
+    return CreateOrOpenFs_(
+        cgroup_string,
+        cpuset_flags | Controller::CPU_CONTROLLER |
+            Controller::MEMORY_CONTROLLER | Controller::DEVICES_CONTROLLER |
+            Controller::CPU_CONTROLLER_V2 | Controller::MEMORY_CONTORLLER_V2);
+  }
+
+  if (GetCgroupVersion() == CgroupConstant::CgroupVersion::CGROUP_V1) {
+    return CreateOrOpen_(cgroup_string,
+                         cpuset_flags | Controller::CPU_CONTROLLER |
+                             Controller::MEMORY_CONTROLLER |
+                             Controller::DEVICES_CONTROLLER,
+                         NO_CONTROLLER_FLAG, false);
+  }
+
+  if (GetCgroupVersion() == CgroupConstant::CgroupVersion::CGROUP_V2) {
+    return CreateOrOpen_(cgroup_string,
+                         cpuset_flags | Controller::CPU_CONTROLLER_V2 |
+                             Controller::MEMORY_CONTORLLER_V2,
+                         NO_CONTROLLER_FLAG, false);
+  }
+
+  CRANE_WARN("cgroup version is not supported.");
+  return nullptr;
+}
+
+std::unique_ptr<Cgroup> CgroupManager::AcquireCgroupFromPool_() {
+  std::unique_ptr<Cgroup> cg;
+  bool refill = false;
+  {
+    absl::MutexLock lock_guard(&m_pool_mtx_);
+    m_pool_window_acquire_cnt_++;
+    UpdateCgroupPoolTarget_();
+
+    if (!m_cg_pool_.empty()) {
+      cg = std::move(m_cg_pool_.back());
+      m_cg_pool_.pop_back();
+    }
+
+    // Refill in background once the pool drops below half of the target.
+    if (!m_pool_refilling_ && m_cg_pool_.size() * 2 < m_pool_target_size_) {
+      m_pool_refilling_ = true;
+      refill = true;
+    }
+  }
+
+  if (refill) g_thread_pool->detach_task([this] { RefillCgroupPool_(); });
+  return cg;
+}
+
+void CgroupManager::RecycleCgroup_(std::unique_ptr<Cgroup> cg) {
+  {
+    absl::MutexLock lock_guard(&m_pool_mtx_);
+    UpdateCgroupPoolTarget_();
+    if (m_cg_pool_.size() >= m_pool_target_size_) return;
+  }
+
+  if (!cg->ResetForReuse()) {
+    CRANE_DEBUG("Failed to reset cgroup {}. Destroy it.",
+                cg->GetCgroupString());
+    return;
+  }
+
+  absl::MutexLock lock_guard(&m_pool_mtx_);
+  if (m_cg_pool_.size() < m_pool_target_size_)
+    m_cg_pool_.emplace_back(std::move(cg));
+}
+
+void CgroupManager::RefillCgroupPool_() {
+  size_t num;
+  {
+    absl::MutexLock lock_guard(&m_pool_mtx_);
+    num = m_pool_target_size_ > m_cg_pool_.size()
+              ? m_pool_target_size_ - m_cg_pool_.size()
+              : 0;
+  }
+
+  std::vector<std::unique_ptr<Cgroup>> cgs;
+  for (size_t i = 0; i < num; i++) {
+    auto cg = CreateTaskCgroup_(fmt::format(
+        "{}{}", CgroupConstant::kPooledCgPathPrefix, m_pool_cg_seq_++));
+    if (!cg) break;
+    cgs.emplace_back(std::move(cg));
+  }
+
+  CRANE_TRACE("{} cgroups are created for the cgroup pool.", cgs.size());
+
+  absl::MutexLock lock_guard(&m_pool_mtx_);
+  for (auto &cg : cgs) m_cg_pool_.emplace_back(std::move(cg));
+  m_pool_refilling_ = false;
+}
+
+void CgroupManager::UpdateCgroupPoolTarget_() {
+  absl::Time now = absl::Now();
+  if (now - m_pool_window_start_ < CgroupConstant::kCgroupPoolAdjustInterval)
+    return;
+
+  // Follow a burst of task launches immediately and shrink slowly when the
+  // launch rate drops.
+  size_t demand = m_pool_window_acquire_cnt_;
+  size_t target = demand >= m_pool_target_size_
+                      ? demand
+                      : (m_pool_target_size_ + demand) / 2;
+  m_pool_target_size_ =
+      std::clamp<size_t>(target, m_pool_min_size_, m_pool_max_size_);
+
+  m_pool_window_acquire_cnt_ = 0;
+  m_pool_window_start_ = now;
+}
+
 bool CgroupManager::CheckIfCgroupForTasksExists(task_id_t task_id) {
   return m_task_id_to_cg_map_.Contains(task_id);
 }
@@ -457,25 +842,12 @@ bool CgroupManager::AllocateAndGetCgroup(task_id_t task_id, Cgroup **cg) {
   {
     auto cg_it = m_task_id_to_cg_map_[task_id];
     auto &cg_unique_ptr = *cg_it;
-    if (!cg_unique_ptr) {
-      if (GetCgroupVersion() == CgroupConstant::CgroupVersion::CGROUP_V1) {
-        cg_unique_ptr = CgroupManager::CreateOrOpen_(
-            CgroupStrByTaskId_(task_id),
-            NO_CONTROLLER_FLAG | CgroupConstant::Controller::CPU_CONTROLLER |
-                CgroupConstant::Controller::MEMORY_CONTROLLER |
-                CgroupConstant::Controller::DEVICES_CONTROLLER,
-            NO_CONTROLLER_FLAG, false);
-      } else if (GetCgroupVersion() ==
-                 CgroupConstant::CgroupVersion::CGROUP_V2) {
-        cg_unique_ptr = CgroupManager::CreateOrOpen_(
-            CgroupStrByTaskId_(task_id),
-            NO_CONTROLLER_FLAG | CgroupConstant::Controller::CPU_CONTROLLER_V2 |
-                CgroupConstant::Controller::MEMORY_CONTORLLER_V2,
-            NO_CONTROLLER_FLAG, false);
-      } else {
-        CRANE_WARN("cgroup version is not supported.");
-      }
+    if (!cg_unique_ptr && m_pool_enabled_) {
+      cg_unique_ptr = AcquireCgroupFromPool_();
+      if (cg_unique_ptr) cg_unique_ptr->ResetResourceUsage();
     }
+    if (!cg_unique_ptr)
+      cg_unique_ptr = CreateTaskCgroup_(CgroupStrByTaskId_(task_id));
 
     if (!cg_unique_ptr) return false;
 
@@ -499,9 +871,80 @@ bool CgroupManager::AllocateAndGetCgroup(task_id_t task_id, Cgroup **cg) {
   if (ok)
     ok &=
         DedicatedResourceAllocator::Allocate(res.dedicated_res_in_node(), pcg);
+  if (ok && m_cpu_binding_)
+    ok &= BindCpus_(task_id, res, pcg);
   return ok;
 }
 
+bool CgroupManager::BindCpus_(task_id_t task_id,
+                              const crane::grpc::ResourceInNode &res,
+                              Cgroup *cg) {
+  double core_limit = res.allocatable_res_in_node().cpu_core_limit();
+
+  absl::MutexLock lock_guard(&m_cpu_binding_mtx_);
+
+  std::optional<CpusetAllocator::Cpuset> assigned;
+  bool newly_assigned = false;
+  if (core_limit >= 1 && std::floor(core_limit) == core_limit) {
+    // A task may be put into its cgroup more than once, e.g., by crun.
+    assigned = m_cpuset_allocator_.GetCpusetOfTask(task_id);
+    if (!assigned) {
+      std::vector<uint32_t> device_numa_nodes;
+      for (const auto &[dev_name, type_slots_map] :
+           res.dedicated_res_in_node().name_type_map())
+        for (const auto &[dev_type, slots] : type_slots_map.type_slots_map())
+          for (const auto &slot : slots.slots()) {
+            auto dev_it = g_this_node_device.find(slot);
+            if (dev_it != g_this_node_device.end() &&
+                dev_it->second->affinity.numa_node >= 0)
+              device_numa_nodes.emplace_back(
+                  dev_it->second->affinity.numa_node);
+          }
+
+      assigned = m_cpuset_allocator_.Allocate(task_id, uint32_t(core_limit),
+                                              device_numa_nodes);
+      newly_assigned = assigned.has_value();
+    }
+    if (!assigned)
+      CRANE_WARN(
+          "Not enough free cpus for task #{}. It shares the cpus left with "
+          "other tasks.",
+          task_id);
+  }
+
+  if (assigned) {
+    std::string cpus = CpusetAllocator::ToListString(assigned->cpus);
+    std::string mems = CpusetAllocator::ToListString(assigned->mems);
+    CRANE_TRACE("Bind task #{} to cpus {} and mems {}.", task_id, cpus, mems);
+    if (!cg->SetCpuset(cpus, mems)) return false;
+
+    if (newly_assigned) {
+      m_shared_cpu_cgroup_map_.erase(task_id);
+      RebindSharedCpusNoLock_();
+    }
+    return true;
+  }
+
+  m_shared_cpu_cgroup_map_[task_id] = cg;
+  CpusetAllocator::Cpuset cpuset = m_cpuset_allocator_.SharedCpus();
+  return cg->SetCpuset(CpusetAllocator::ToListString(cpuset.cpus),
+                       CpusetAllocator::ToListString(cpuset.mems));
+}
+
+void CgroupManager::RebindSharedCpusNoLock_() {
+  if (m_shared_cpu_cgroup_map_.empty()) return;
+
+  CpusetAllocator::Cpuset cpuset = m_cpuset_allocator_.SharedCpus();
+  std::string cpus = CpusetAllocator::ToListString(cpuset.cpus);
+  std::string mems = CpusetAllocator::ToListString(cpuset.mems);
+  CRANE_TRACE("Bind {} tasks sharing cpus to cpus {} and mems {}.",
+              m_shared_cpu_cgroup_map_.size(), cpus, mems);
+
+  for (const auto &[task_id, cg] : m_shared_cpu_cgroup_map_)
+    if (!cg->SetCpuset(cpus, mems))
+      CRANE_WARN("Failed to update the cpuset of task #{}.", task_id);
+}
+
 bool CgroupManager::CreateCgroups(std::vector<CgroupSpec> &&cg_specs) {
   std::chrono::steady_clock::time_point begin;
   std::chrono::steady_clock::time_point end;
@@ -558,6 +1001,11 @@ bool CgroupManager::ReleaseCgroup(uint32_t task_id, uid_t uid) {
   }
 
   this->m_task_id_to_cg_spec_map_.Erase(task_id);
+  if (m_cpu_binding_) {
+    absl::MutexLock lock_guard(&m_cpu_binding_mtx_);
+    m_shared_cpu_cgroup_map_.erase(task_id);
+    if (m_cpuset_allocator_.Free(task_id)) RebindSharedCpusNoLock_();
+  }
 
   this->m_uid_to_task_ids_map_[uid]->erase(task_id);
   if (this->m_uid_to_task_ids_map_[uid]->empty()) {
@@ -583,31 +1031,155 @@ bool CgroupManager::ReleaseCgroup(uint32_t task_id, uid_t uid) {
     this->m_task_id_to_cg_map_.Erase(task_id);
 
     if (cgroup != nullptr) {
-      g_thread_pool->detach_task([cgroup]() {
-        bool rc;
-        int cnt = 0;
-
-        while (true) {
-          if (cgroup->Empty()) break;
-
-          if (cnt >= 5) {
-            CRANE_ERROR(
-                "Couldn't kill the processes in cgroup {} after {} times. "
-                "Skipping it.",
-                cgroup->GetCgroupString(), cnt);
-            break;
-          }
+      if (m_teardown_inotify_fd_ == -1 || !WatchCgroupTeardown_(cgroup))
+        TeardownCgroupByPolling_(cgroup);
+    }
+    return true;
+  }
+}
+
+bool CgroupManager::WatchCgroupTeardown_(Cgroup *cg) {
+  cg->KillAllProcesses();
+
+  std::string events_path =
+      fmt::format("{}/{}/{}", CgroupConstant::RootCgroupFullPath,
+                  cg->GetCgroupString(), CgroupConstant::kCgroupEventsFile);
+
+  std::unique_ptr<Cgroup> empty_cg;
+  {
+    // Hold the lock across inotify_add_watch() so that an event of the new
+    // watch descriptor is not handled before the cgroup is recorded.
+    absl::MutexLock lock_guard(&m_teardown_mtx_);
+    int wd = inotify_add_watch(m_teardown_inotify_fd_, events_path.c_str(),
+                               IN_MODIFY);
+    if (wd == -1) {
+      CRANE_WARN("Failed to watch {}: {}. Fall back to polling.", events_path,
+                 strerror(errno));
+      return false;
+    }
+
+    // The cgroup may have become empty before the watch was added.
+    if (cg->Empty()) {
+      inotify_rm_watch(m_teardown_inotify_fd_, wd);
+      empty_cg.reset(cg);
+    } else {
+      m_pending_teardowns_.emplace(
+          wd, PendingTeardown{
+                  .cg = std::unique_ptr<Cgroup>(cg),
+                  .kill_cnt = 1,
+                  .next_kill_time =
+                      absl::Now() +
+                      CgroupConstant::kCgroupTeardownRetryInterval});
+    }
+  }
 
-          cgroup->KillAllProcesses();
-          ++cnt;
-          std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  if (empty_cg) FinishCgroupTeardown_(std::move(empty_cg), true);
+  return true;
+}
+
+void CgroupManager::ProcessTeardownEvents() {
+  absl::flat_hash_set<int> modified_wds;
+
+  alignas(struct inotify_event) char buf[4096];
+  while (true) {
+    ssize_t len = read(m_teardown_inotify_fd_, buf, sizeof(buf));
+    if (len == -1 && errno == EINTR) continue;
+    if (len <= 0) break;
+
+    for (char *ptr = buf; ptr < buf + len;) {
+      auto *event = reinterpret_cast<struct inotify_event *>(ptr);
+      if (event->mask & IN_MODIFY) modified_wds.emplace(event->wd);
+      ptr += sizeof(struct inotify_event) + event->len;
+    }
+  }
+
+  std::vector<std::pair<std::unique_ptr<Cgroup>, bool /*empty*/>> finished;
+  {
+    absl::MutexLock lock_guard(&m_teardown_mtx_);
+    absl::Time now = absl::Now();
+
+    for (auto it = m_pending_teardowns_.begin();
+         it != m_pending_teardowns_.end();) {
+      auto &[wd, pending] = *it;
+
+      bool empty = false;
+      bool give_up = false;
+      if (modified_wds.contains(wd) && pending.cg->Empty()) {
+        empty = true;
+      } else if (now >= pending.next_kill_time) {
+        // Processes in uninterruptible sleep may survive for a while.
+        if (pending.cg->Empty()) {
+          empty = true;
+        } else if (pending.kill_cnt >=
+                   CgroupConstant::kCgroupTeardownMaxKillCount) {
+          CRANE_ERROR(
+              "Couldn't kill the processes in cgroup {} after {} times. "
+              "Skipping it.",
+              pending.cg->GetCgroupString(), pending.kill_cnt);
+          give_up = true;
+        } else {
+          pending.cg->KillAllProcesses();
+          pending.kill_cnt++;
+          pending.next_kill_time =
+              now + CgroupConstant::kCgroupTeardownRetryInterval;
         }
+      }
 
-        delete cgroup;
-      });
+      if (empty || give_up) {
+        inotify_rm_watch(m_teardown_inotify_fd_, wd);
+        finished.emplace_back(std::move(pending.cg), empty);
+        m_pending_teardowns_.erase(it++);
+      } else {
+        ++it;
+      }
     }
-    return true;
   }
+
+  for (auto &[cg, empty] : finished)
+    FinishCgroupTeardown_(std::move(cg), empty);
+}
+
+void CgroupManager::TeardownCgroupByPolling_(Cgroup *cg) {
+  g_thread_pool->detach_task([this, cg]() {
+    bool empty = false;
+    int cnt = 0;
+
+    while (true) {
+      if (cg->Empty()) {
+        empty = true;
+        break;
+      }
+
+      if (cnt >= CgroupConstant::kCgroupTeardownMaxKillCount) {
+        CRANE_ERROR(
+            "Couldn't kill the processes in cgroup {} after {} times. "
+            "Skipping it.",
+            cg->GetCgroupString(), cnt);
+        break;
+      }
+
+      cg->KillAllProcesses();
+      ++cnt;
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    if (empty && m_pool_enabled_)
+      RecycleCgroup_(std::unique_ptr<Cgroup>(cg));
+    else
+      delete cg;
+  });
+}
+
+void CgroupManager::FinishCgroupTeardown_(std::unique_ptr<Cgroup> cg,
+                                          bool empty) {
+  // Removing or resetting a cgroup may take a while. Keep it away from the
+  // event loop.
+  g_thread_pool->detach_task([this, cg = cg.release(), empty]() {
+    if (empty && m_pool_enabled_)
+      RecycleCgroup_(std::unique_ptr<Cgroup>(cg));
+    else
+      delete cg;
+  });
 }
 
 void CgroupManager::RmAllTaskCgroupsUnderController_(
@@ -684,11 +1256,11 @@ bool CgroupManager::QueryTaskInfoOfUidAsync(uid_t uid, TaskInfoOfUid *info) {
   info->job_cnt = 0;
   info->cgroup_exists = false;
 
-  if (this->m_uid_to_task_ids_map_.Contains(uid)) {
-    auto task_ids = this->m_uid_to_task_ids_map_[uid];
-    info->job_cnt = task_ids->size();
-    info->first_task_id = *task_ids->begin();
-  }
+  this->m_uid_to_task_ids_map_.Read(
+      uid, [info](const absl::flat_hash_set<task_id_t> &task_ids) {
+        info->job_cnt = task_ids.size();
+        info->first_task_id = *task_ids.begin();
+      });
   return info->job_cnt > 0;
 }
 
@@ -702,8 +1274,12 @@ bool CgroupManager::MigrateProcToCgroupOfTask(pid_t pid, task_id_t task_id) {
 
 std::optional<std::string> CgroupManager::QueryTaskExecutionNode(
     task_id_t task_id) {
-  if (!this->m_task_id_to_cg_spec_map_.Contains(task_id)) return std::nullopt;
-  return this->m_task_id_to_cg_spec_map_[task_id]->execution_node;
+  std::optional<std::string> execution_node;
+  this->m_task_id_to_cg_spec_map_.Read(
+      task_id, [&](const CgroupSpec &spec) {
+        execution_node = spec.execution_node;
+      });
+  return execution_node;
 }
 
 std::optional<crane::grpc::ResourceInNode> CgroupManager::GetTaskResourceInNode(
@@ -743,9 +1319,75 @@ std::vector<EnvPair> CgroupManager::GetResourceEnvListOfTask(
     CRANE_ERROR("Trying to get resource env list of a non-existent task #{}",
                 task_id);
 
+  std::vector<EnvPair> cpuset_env_vec = GetCpusetEnvListOfTask(task_id);
+  res.insert(res.end(), cpuset_env_vec.begin(), cpuset_env_vec.end());
   return res;
 }
 
+std::vector<EnvPair> CgroupManager::GetCpusetEnvListOfTask(task_id_t task_id) {
+  std::vector<EnvPair> env_vec;
+  if (!m_cpu_binding_) return env_vec;
+
+  auto cpuset = m_cpuset_allocator_.GetCpusetOfTask(task_id);
+  if (!cpuset) return env_vec;
+
+  env_vec.emplace_back("CRANE_CPU_BIND_LIST",
+                       CpusetAllocator::ToListString(cpuset->cpus));
+  env_vec.emplace_back("CRANE_MEM_BIND_LIST",
+                       CpusetAllocator::ToListString(cpuset->mems));
+  return env_vec;
+}
+
+std::optional<crane::grpc::TaskResourceUsage>
+CgroupManager::GetTaskResourceUsage(task_id_t task_id) {
+  auto cg_ptr = m_task_id_to_cg_map_[task_id];
+  if (!cg_ptr || !*cg_ptr) return std::nullopt;
+
+  crane::grpc::TaskResourceUsage usage;
+  if (!(*cg_ptr)->ReadResourceUsage(&usage)) return std::nullopt;
+  return usage;
+}
+
+std::unordered_map<task_id_t, crane::grpc::TaskResourceUsage>
+CgroupManager::GetAllTaskResourceUsage() {
+  std::unordered_map<task_id_t, crane::grpc::TaskResourceUsage> usage_map;
+
+  m_task_id_to_cg_map_.ForEach([&](task_id_t task_id, const auto &cg) {
+    auto cg_ptr = cg.GetExclusivePtr();
+    if (!*cg_ptr) return;
+
+    crane::grpc::TaskResourceUsage usage;
+    if ((*cg_ptr)->ReadResourceUsage(&usage))
+      usage_map.emplace(task_id, std::move(usage));
+  });
+  return usage_map;
+}
+
+std::optional<task_id_t> CgroupManager::FindTaskIdBySocketInode(
+    ino_t inode) {
+  std::vector<std::pair<task_id_t, std::vector<pid_t>>> task_procs;
+  m_task_id_to_cg_map_.ForEach([&](task_id_t task_id, const auto &cg) {
+    auto cg_ptr = cg.GetExclusivePtr();
+    if (!*cg_ptr) return;
+
+    std::vector<pid_t> pids;
+    if ((*cg_ptr)->GetProcs(&pids) && !pids.empty())
+      task_procs.emplace_back(task_id, std::move(pids));
+  });
+
+  // /proc is scanned after the map lock is released.
+  for (const auto &[task_id, pids] : task_procs) {
+    for (pid_t pid : pids) {
+      if (util::os::ProcessHasSocketInode(pid, inode)) {
+        CRANE_TRACE("Socket inode {} is owned by pid {} of task #{}", inode,
+                    pid, task_id);
+        return task_id;
+      }
+    }
+  }
+  return std::nullopt;
+}
+
 bool CgroupV1::MigrateProcIn(pid_t pid) {
   using CgroupConstant::Controller;
   using CgroupConstant::GetControllerStringView;
@@ -930,6 +1572,9 @@ end:
  * If the cgroup was created by us in the OS, remove it..
  */
 Cgroup::~Cgroup() {
+  for (int fd : m_usage_fds_)
+    if (fd >= 0) close(fd);
+
   if (m_cgroup_) {
     int err;
     if ((err = cgroup_delete_cgroup_ext(
@@ -944,6 +1589,73 @@ Cgroup::~Cgroup() {
   }
 }
 
+bool Cgroup::ReadRawUsage_(RawUsage *usage) {
+  bool read_any = false;
+  std::string content;
+  for (uint8_t i = 0; i < UsageFileCount; i++) {
+    auto file = static_cast<UsageFile>(i);
+    int &fd = m_usage_fds_[i];
+    if (fd == -1) {
+      std::string path = UsageFilePath_(file);
+      if (!path.empty()) {
+        // The peak file is also written to restart the peak tracking.
+        if (file == USAGE_MEMORY_PEAK)
+          fd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd == -1) fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+      }
+      if (fd == -1) fd = -2;
+    }
+    if (fd < 0) continue;
+
+    if (!PreadFile(fd, &content)) {
+      CRANE_TRACE("Failed to read {}: {}", UsageFilePath_(file),
+                  strerror(errno));
+      continue;
+    }
+    ParseUsageFile_(file, content, usage);
+    read_any = true;
+  }
+  return read_any;
+}
+
+bool Cgroup::ReadResourceUsage(crane::grpc::TaskResourceUsage *usage) {
+  absl::MutexLock lock_guard(&m_usage_mtx_);
+
+  RawUsage raw;
+  if (!ReadRawUsage_(&raw)) return false;
+
+  auto since_baseline = [](uint64_t value, uint64_t baseline) {
+    return value > baseline ? value - baseline : 0;
+  };
+
+  m_sampled_mem_peak_ = std::max(m_sampled_mem_peak_, raw.mem_current_bytes);
+
+  usage->set_cpu_time_usec(
+      since_baseline(raw.cpu_time_usec, m_usage_baseline_.cpu_time_usec));
+  usage->set_mem_peak_bytes(raw.mem_peak_bytes && m_kernel_mem_peak_valid_
+                                ? raw.mem_peak_bytes.value()
+                                : m_sampled_mem_peak_);
+  usage->set_mem_current_bytes(raw.mem_current_bytes);
+  usage->set_io_read_bytes(
+      since_baseline(raw.io_read_bytes, m_usage_baseline_.io_read_bytes));
+  usage->set_io_write_bytes(
+      since_baseline(raw.io_write_bytes, m_usage_baseline_.io_write_bytes));
+  return true;
+}
+
+void Cgroup::ResetResourceUsage() {
+  absl::MutexLock lock_guard(&m_usage_mtx_);
+
+  m_usage_baseline_ = RawUsage{};
+  ReadRawUsage_(&m_usage_baseline_);
+  m_sampled_mem_peak_ = 0;
+
+  // Without a resettable peak counter, the peak of the previous task would be
+  // reported. Fall back to the sampled peak then.
+  int peak_fd = m_usage_fds_[USAGE_MEMORY_PEAK];
+  m_kernel_mem_peak_valid_ = peak_fd >= 0 && ResetMemoryPeak_(peak_fd);
+}
+
 bool CgroupV1::SetMemorySoftLimitBytes(uint64_t memory_bytes) {
   return SetControllerValue(
       CgroupConstant::Controller::MEMORY_CONTROLLER,
@@ -991,6 +1703,52 @@ bool CgroupV1::SetCpuCoreLimit(double core_num) {
   return ret;
 }
 
+bool CgroupV1::ResetForReuse() {
+  // Uncharge the page cache left by the previous task.
+  return SetControllerValue(CgroupConstant::Controller::MEMORY_CONTROLLER,
+                            CgroupConstant::ControllerFile::MEMORY_FORCE_EMPTY,
+                            0);
+}
+
+std::string CgroupV1::UsageFilePath_(UsageFile file) const {
+  switch (file) {
+  case USAGE_CPU:
+    return fmt::format("{}/cpu/{}/cpuacct.usage",
+                       CgroupConstant::RootCgroupFullPath, m_cgroup_path_);
+  case USAGE_MEMORY_PEAK:
+    return fmt::format("{}/memory/{}/memory.max_usage_in_bytes",
+                       CgroupConstant::RootCgroupFullPath, m_cgroup_path_);
+  case USAGE_MEMORY_CURRENT:
+    return fmt::format("{}/memory/{}/memory.usage_in_bytes",
+                       CgroupConstant::RootCgroupFullPath, m_cgroup_path_);
+  default:
+    // The blkio controller is not attached to task cgroups.
+    return {};
+  }
+}
+
+void CgroupV1::ParseUsageFile_(UsageFile file, const std::string &content,
+                               RawUsage *usage) const {
+  uint64_t value = ParseUint64(absl::StripAsciiWhitespace(content));
+  switch (file) {
+  case USAGE_CPU:
+    usage->cpu_time_usec = value / 1000;  // in nanoseconds
+    break;
+  case USAGE_MEMORY_PEAK:
+    usage->mem_peak_bytes = value;
+    break;
+  case USAGE_MEMORY_CURRENT:
+    usage->mem_current_bytes = value;
+    break;
+  default:
+    break;
+  }
+}
+
+bool CgroupV1::ResetMemoryPeak_(int peak_fd) {
+  return pwrite(peak_fd, "0", 1, 0) == 1;
+}
+
 bool CgroupV1::SetBlockioWeight(uint64_t weight) {
   return SetControllerValue(CgroupConstant::Controller::BLOCK_CONTROLLER,
                             CgroupConstant::ControllerFile::BLOCKIO_WEIGHT,
@@ -1203,6 +1961,31 @@ bool CgroupV1::Empty() {
     return false;
   }
 }
+
+bool CgroupV1::GetProcs(std::vector<pid_t> *pids) {
+  using namespace CgroupConstant::Internal;
+
+  const char *controller = CgroupConstant::GetControllerStringView(
+                               CgroupConstant::Controller::CPU_CONTROLLER)
+                               .data();
+
+  const char *cg_name = m_cgroup_path_.c_str();
+
+  int size, rc;
+  pid_t *procs;
+
+  rc = cgroup_get_procs(const_cast<char *>(cg_name),
+                        const_cast<char *>(controller), &procs, &size);
+  if (rc != 0) {
+    CRANE_ERROR("cgroup_get_procs error on cgroup \"{}\": {}", cg_name,
+                cgroup_strerror(rc));
+    return false;
+  }
+
+  pids->assign(procs, procs + size);
+  free(procs);
+  return true;
+}
 bool CgroupV1::SetDeviceAccess(const std::unordered_set<SlotId> &devices,
                                bool set_read, bool set_write, bool set_mknod) {
   std::string op;
@@ -1238,6 +2021,16 @@ bool CgroupV1::SetDeviceAccess(const std::unordered_set<SlotId> &devices,
   return ok;
 }
 
+bool CgroupV1::SetCpuset(const std::string &cpus, const std::string &mems) {
+  // Both files must be set before any process can be attached.
+  bool ok = SetControllerStr(CgroupConstant::Controller::CPUSET_CONTROLLER,
+                             CgroupConstant::ControllerFile::CPUSET_CPUS, cpus);
+  if (ok)
+    ok = SetControllerStr(CgroupConstant::Controller::CPUSET_CONTROLLER,
+                          CgroupConstant::ControllerFile::CPUSET_MEMS, mems);
+  return ok;
+}
+
 /**
  *
  */
@@ -1282,15 +2075,104 @@ bool CgroupV2::SetBlockioWeight(uint64_t weight) {
                             weight);
 }
 
+bool CgroupV2::ResetForReuse() {
+  // There is no memory.force_empty in v2. Shrinking memory.max of an empty
+  // cgroup to 0 reclaims the page cache charged by the previous task.
+  return SetMemoryLimitBytes(0);
+}
+
+std::string CgroupV2::UsageFilePath_(UsageFile file) const {
+  std::string_view name;
+  switch (file) {
+  case USAGE_CPU:
+    name = "cpu.stat";
+    break;
+  case USAGE_MEMORY_PEAK:
+    name = "memory.peak";  // Linux 5.19+
+    break;
+  case USAGE_MEMORY_CURRENT:
+    name = "memory.current";
+    break;
+  case USAGE_IO:
+    name = "io.stat";
+    break;
+  default:
+    return {};
+  }
+  return fmt::format("{}/{}/{}", CgroupConstant::RootCgroupFullPath,
+                     m_cgroup_path_, name);
+}
+
+void CgroupV2::ParseUsageFile_(UsageFile file, const std::string &content,
+                               RawUsage *usage) const {
+  switch (file) {
+  case USAGE_CPU:
+    for (absl::string_view line :
+         absl::StrSplit(content, '\n', absl::SkipEmpty())) {
+      if (absl::ConsumePrefix(&line, "usage_usec ")) {
+        usage->cpu_time_usec = ParseUint64(line);
+        break;
+      }
+    }
+    break;
+  case USAGE_MEMORY_PEAK:
+    usage->mem_peak_bytes = ParseUint64(absl::StripAsciiWhitespace(content));
+    break;
+  case USAGE_MEMORY_CURRENT:
+    usage->mem_current_bytes =
+        ParseUint64(absl::StripAsciiWhitespace(content));
+    break;
+  case USAGE_IO:
+    // Each line is like "8:0 rbytes=1 wbytes=2 rios=3 wios=4 ...".
+    for (absl::string_view line :
+         absl::StrSplit(content, '\n', absl::SkipEmpty())) {
+      for (absl::string_view field : absl::StrSplit(line, ' ')) {
+        if (absl::ConsumePrefix(&field, "rbytes="))
+          usage->io_read_bytes += ParseUint64(field);
+        else if (absl::ConsumePrefix(&field, "wbytes="))
+          usage->io_write_bytes += ParseUint64(field);
+      }
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+bool CgroupV2::ResetMemoryPeak_(int peak_fd) {
+  // Since Linux 6.12, writing to memory.peak restarts the peak tracking for
+  // reads through the same open file.
+  return pwrite(peak_fd, "reset", 5, 0) == 5;
+}
+
 bool CgroupV2::SetDeviceAccess(const std::unordered_set<SlotId> &devices,
                                bool set_read, bool set_write, bool set_mknod) {
   // TODO
   return true;
 }
 
+bool CgroupV2::SetCpuset(const std::string &cpus, const std::string &mems) {
+  bool ok =
+      SetControllerStr(CgroupConstant::Controller::CPUSET_CONTROLLER_V2,
+                       CgroupConstant::ControllerFile::CPUSET_CPUS, cpus);
+  if (ok)
+    ok = SetControllerStr(CgroupConstant::Controller::CPUSET_CONTROLLER_V2,
+                          CgroupConstant::ControllerFile::CPUSET_MEMS, mems);
+  return ok;
+}
+
 bool CgroupV2::KillAllProcesses() {
   using namespace CgroupConstant::Internal;
 
+  // cgroup.kill (Linux 5.14+) kills all processes in the cgroup atomically,
+  // including the ones forked while they are being killed.
+  std::string kill_file =
+      fmt::format("{}/{}/{}", CgroupConstant::RootCgroupFullPath,
+                  m_cgroup_path_, CgroupConstant::kCgroupKillFile);
+  if (WriteCgroupFile(AT_FDCWD, kill_file.c_str(), "1")) return true;
+  if (errno != ENOENT)
+    CRANE_WARN("Failed to write {}: {}", kill_file, strerror(errno));
+
   const char *controller = CgroupConstant::GetControllerStringView(
                                CgroupConstant::Controller::CPU_CONTROLLER_V2)
                                .data();
@@ -1340,6 +2222,31 @@ bool CgroupV2::Empty() {
   }
 }
 
+bool CgroupV2::GetProcs(std::vector<pid_t> *pids) {
+  using namespace CgroupConstant::Internal;
+
+  const char *controller = CgroupConstant::GetControllerStringView(
+                               CgroupConstant::Controller::CPU_CONTROLLER_V2)
+                               .data();
+
+  const char *cg_name = m_cgroup_path_.c_str();
+
+  int size, rc;
+  pid_t *procs;
+
+  rc = cgroup_get_procs(const_cast<char *>(cg_name),
+                        const_cast<char *>(controller), &procs, &size);
+  if (rc != 0) {
+    CRANE_ERROR("cgroup_get_procs error on cgroup \"{}\": {}", cg_name,
+                cgroup_strerror(rc));
+    return false;
+  }
+
+  pids->assign(procs, procs + size);
+  free(procs);
+  return true;
+}
+
 bool CgroupV2::MigrateProcIn(pid_t pid) {
   using CgroupConstant::Controller;
   using CgroupConstant::GetControllerStringView;
@@ -1356,6 +2263,207 @@ end:
   return err == 0;
 }
 
+CgroupFsV1::~CgroupFsV1() {
+  for (size_t i = 0; i < m_dir_fds_.size(); i++) {
+    if (m_dir_fds_[i] == -1) continue;
+    close(m_dir_fds_[i]);
+
+    // Fails with EBUSY if there are processes left in the cgroup.
+    if (unlinkat(m_root_fds_[i], m_cgroup_path_.c_str(), AT_REMOVEDIR) != 0)
+      CRANE_ERROR("Unable to completely remove cgroup {} under {}: {}",
+                  m_cgroup_path_,
+                  CgroupConstant::GetControllerStringView(
+                      static_cast<CgroupConstant::Controller>(i)),
+                  strerror(errno));
+  }
+}
+
+bool CgroupFsV1::SetControllerValue(
+    CgroupConstant::Controller controller,
+    CgroupConstant::ControllerFile controller_file, uint64_t value) {
+  return SetControllerStr(controller, controller_file, std::to_string(value));
+}
+
+bool CgroupFsV1::SetControllerStr(
+    CgroupConstant::Controller controller,
+    CgroupConstant::ControllerFile controller_file, const std::string &str) {
+  return SetControllerStrs(controller, controller_file, {str});
+}
+
+bool CgroupFsV1::SetControllerStrs(
+    CgroupConstant::Controller controller,
+    CgroupConstant::ControllerFile controller_file,
+    const std::vector<std::string> &strs) {
+  int dir_fd = m_dir_fds_[static_cast<size_t>(controller)];
+  if (dir_fd == -1) {
+    CRANE_ERROR("Unable to set {} because cgroup {} is not mounted.",
+                CgroupConstant::GetControllerFileStringView(controller_file),
+                CgroupConstant::GetControllerStringView(controller));
+    return false;
+  }
+
+  // Each entry of a file like devices.allow must be written separately.
+  for (const auto &str : strs) {
+    if (!WriteCgroupFile(
+            dir_fd,
+            CgroupConstant::GetControllerFileStringView(controller_file).data(),
+            str)) {
+      CRANE_ERROR("Unable to set {} to {} in cgroup {}: {}",
+                  CgroupConstant::GetControllerFileStringView(controller_file),
+                  str, m_cgroup_path_, strerror(errno));
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CgroupFsV1::KillAllProcesses() {
+  int dir_fd = m_dir_fds_[static_cast<size_t>(
+      CgroupConstant::Controller::CPU_CONTROLLER)];
+
+  std::vector<pid_t> pids;
+  if (!ReadCgroupProcs(dir_fd, &pids)) {
+    CRANE_ERROR("Failed to read procs of cgroup {}: {}", m_cgroup_path_,
+                strerror(errno));
+    return false;
+  }
+
+  for (pid_t pid : pids) kill(pid, SIGKILL);
+  return true;
+}
+
+bool CgroupFsV1::Empty() {
+  int dir_fd = m_dir_fds_[static_cast<size_t>(
+      CgroupConstant::Controller::CPU_CONTROLLER)];
+
+  std::vector<pid_t> pids;
+  if (!ReadCgroupProcs(dir_fd, &pids)) {
+    CRANE_ERROR("Failed to read procs of cgroup {}: {}", m_cgroup_path_,
+                strerror(errno));
+    return false;
+  }
+  return pids.empty();
+}
+
+bool CgroupFsV1::GetProcs(std::vector<pid_t> *pids) {
+  int dir_fd = m_dir_fds_[static_cast<size_t>(
+      CgroupConstant::Controller::CPU_CONTROLLER)];
+
+  if (!ReadCgroupProcs(dir_fd, pids)) {
+    CRANE_ERROR("Failed to read procs of cgroup {}: {}", m_cgroup_path_,
+                strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool CgroupFsV1::MigrateProcIn(pid_t pid) {
+  std::string pid_str = std::to_string(pid);
+  for (int dir_fd : m_dir_fds_) {
+    if (dir_fd == -1) continue;
+    if (!WriteCgroupFile(dir_fd, CgroupConstant::kCgroupProcsFile, pid_str)) {
+      CRANE_WARN("Cannot attach pid {} to cgroup {}: {}", pid, m_cgroup_path_,
+                 strerror(errno));
+      return false;
+    }
+  }
+  return true;
+}
+
+CgroupFsV2::~CgroupFsV2() {
+  close(m_dir_fd_);
+
+  // Fails with EBUSY if there are processes left in the cgroup.
+  if (unlinkat(m_root_fd_, m_cgroup_path_.c_str(), AT_REMOVEDIR) != 0)
+    CRANE_ERROR("Unable to completely remove cgroup {}: {}", m_cgroup_path_,
+                strerror(errno));
+}
+
+bool CgroupFsV2::SetControllerValue(
+    CgroupConstant::Controller controller,
+    CgroupConstant::ControllerFile controller_file, uint64_t value) {
+  return SetControllerStr(controller, controller_file, std::to_string(value));
+}
+
+bool CgroupFsV2::SetControllerStr(
+    CgroupConstant::Controller controller,
+    CgroupConstant::ControllerFile controller_file, const std::string &str) {
+  return SetControllerStrs(controller, controller_file, {str});
+}
+
+bool CgroupFsV2::SetControllerStrs(
+    CgroupConstant::Controller controller,
+    CgroupConstant::ControllerFile controller_file,
+    const std::vector<std::string> &strs) {
+  if (!g_cg_mgr->Mounted(controller)) {
+    CRANE_ERROR("Unable to set {} because cgroup {} is not mounted.",
+                CgroupConstant::GetControllerFileStringView(controller_file),
+                CgroupConstant::GetControllerStringView(controller));
+    return false;
+  }
+
+  for (const auto &str : strs) {
+    if (!WriteCgroupFile(
+            m_dir_fd_,
+            CgroupConstant::GetControllerFileStringView(controller_file).data(),
+            str)) {
+      CRANE_ERROR("Unable to set {} to {} in cgroup {}: {}",
+                  CgroupConstant::GetControllerFileStringView(controller_file),
+                  str, m_cgroup_path_, strerror(errno));
+      return false;
+    }
+  }
+  return true;
+}
+
+bool CgroupFsV2::KillAllProcesses() {
+  if (WriteCgroupFile(m_dir_fd_, CgroupConstant::kCgroupKillFile, "1"))
+    return true;
+  if (errno != ENOENT)
+    CRANE_WARN("Failed to write {} of cgroup {}: {}",
+               CgroupConstant::kCgroupKillFile, m_cgroup_path_,
+               strerror(errno));
+
+  std::vector<pid_t> pids;
+  if (!ReadCgroupProcs(m_dir_fd_, &pids)) {
+    CRANE_ERROR("Failed to read procs of cgroup {}: {}", m_cgroup_path_,
+                strerror(errno));
+    return false;
+  }
+
+  for (pid_t pid : pids) kill(pid, SIGKILL);
+  return true;
+}
+
+bool CgroupFsV2::Empty() {
+  std::vector<pid_t> pids;
+  if (!ReadCgroupProcs(m_dir_fd_, &pids)) {
+    CRANE_ERROR("Failed to read procs of cgroup {}: {}", m_cgroup_path_,
+                strerror(errno));
+    return false;
+  }
+  return pids.empty();
+}
+
+bool CgroupFsV2::GetProcs(std::vector<pid_t> *pids) {
+  if (!ReadCgroupProcs(m_dir_fd_, pids)) {
+    CRANE_ERROR("Failed to read procs of cgroup {}: {}", m_cgroup_path_,
+                strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool CgroupFsV2::MigrateProcIn(pid_t pid) {
+  if (!WriteCgroupFile(m_dir_fd_, CgroupConstant::kCgroupProcsFile,
+                       std::to_string(pid))) {
+    CRANE_WARN("Cannot attach pid {} to cgroup {}: {}", pid, m_cgroup_path_,
+               strerror(errno));
+    return false;
+  }
+  return true;
+}
+
 bool AllocatableResourceAllocator::Allocate(const AllocatableResource &resource,
                                             Cgroup *cg) {
   bool ok;
@@ -25,6 +25,7 @@
 
 #include <libcgroup.h>
 
+#include "CpusetAllocator.h"
 #include "CranedPublicDefs.h"
 #include "crane/AtomicHashMap.h"
 #include "crane/OS.h"
@@ -39,6 +40,12 @@ enum class CgroupVersion : uint64_t {
   UNDEFINED,
 };
 
+enum class CgroupBackend : uint8_t {
+  LIBCGROUP = 0,
+  // Access the cgroup filesystem directly with cached directory fds.
+  CGROUPFS,
+};
+
 enum class Controller : uint64_t {
   MEMORY_CONTROLLER = 0,
   CPUACCT_CONTROLLER,
@@ -46,6 +53,7 @@ enum class Controller : uint64_t {
   BLOCK_CONTROLLER,
   CPU_CONTROLLER,
   DEVICES_CONTROLLER,
+  CPUSET_CONTROLLER,
 
   MEMORY_CONTORLLER_V2,
   CPU_CONTROLLER_V2,
@@ -64,6 +72,7 @@ enum class ControllerFile : uint64_t {
   MEMORY_LIMIT_BYTES,
   MEMORY_MEMSW_LIMIT_IN_BYTES,
   MEMORY_SOFT_LIMIT_BYTES,
+  MEMORY_FORCE_EMPTY,
 
   BLOCKIO_WEIGHT,
 
@@ -81,6 +90,10 @@ enum class ControllerFile : uint64_t {
   IO_WEIGHT_V2,
   // root cgroup controller can't be change or created
 
+  // Both V1 and V2
+  CPUSET_CPUS,
+  CPUSET_MEMS,
+
   ControllerFileCount,
 };
 
@@ -112,6 +125,22 @@ enum class ControllerFile : uint64_t {
 
 inline const char *kTaskCgPathPrefix = "Crane_Task_";
 inline const char *RootCgroupFullPath = "/sys/fs/cgroup";
+inline const char *kCgroupProcsFile = "cgroup.procs";
+inline const char *kCgroupSubtreeControlFile = "cgroup.subtree_control";
+inline const char *kMemoryUseHierarchyFile = "memory.use_hierarchy";
+inline const char *kCgroupKillFile = "cgroup.kill";
+inline const char *kCgroupEventsFile = "cgroup.events";
+
+// Name prefix of the empty cgroups kept in the cgroup pool.
+inline const char *kPooledCgPathPrefix = "Crane_Task_Pool_";
+// The target size of the cgroup pool is adjusted by the number of cgroups
+// acquired in each interval.
+inline const absl::Duration kCgroupPoolAdjustInterval = absl::Seconds(10);
+
+// If a released cgroup on v2 is still populated after this interval, its
+// processes are killed again, for at most kCgroupTeardownMaxKillCount times.
+inline const absl::Duration kCgroupTeardownRetryInterval = absl::Seconds(1);
+inline constexpr int kCgroupTeardownMaxKillCount = 5;
 namespace Internal {
 
 constexpr std::array<std::string_view,
@@ -123,6 +152,7 @@ constexpr std::array<std::string_view,
         "blkio",
         "cpu",
         "devices",
+        "cpuset",
         // V2
         "memory",
         "cpu",
@@ -141,6 +171,7 @@ constexpr std::array<std::string_view,
         "memory.limit_in_bytes",
         "memory.memsw.limit_in_bytes",
         "memory.soft_limit_in_bytes",
+        "memory.force_empty",
 
         "blkio.weight",
 
@@ -157,6 +188,8 @@ constexpr std::array<std::string_view,
 
         "io.weight",
 
+        "cpuset.cpus",
+        "cpuset.mems",
     };
 
 }  // namespace Internal
@@ -285,27 +318,92 @@ class Cgroup {
   virtual bool SetDeviceAccess(const std::unordered_set<SlotId> &devices,
                                bool set_read, bool set_write,
                                bool set_mknod) = 0;
-
-  bool SetControllerValue(CgroupConstant::Controller controller,
-                          CgroupConstant::ControllerFile controller_file,
-                          uint64_t value);
-  bool SetControllerStr(CgroupConstant::Controller controller,
-                        CgroupConstant::ControllerFile controller_file,
-                        const std::string &str);
-  bool SetControllerStrs(CgroupConstant::Controller controller,
-                         CgroupConstant::ControllerFile controller_file,
-                         const std::vector<std::string> &strs);
+  // cpus and mems are in the list format, e.g., "0-3,8".
+  virtual bool SetCpuset(const std::string &cpus, const std::string &mems) = 0;
+
+  virtual bool SetControllerValue(
+      CgroupConstant::Controller controller,
+      CgroupConstant::ControllerFile controller_file, uint64_t value);
+  virtual bool SetControllerStr(CgroupConstant::Controller controller,
+                                CgroupConstant::ControllerFile controller_file,
+                                const std::string &str);
+  virtual bool SetControllerStrs(
+      CgroupConstant::Controller controller,
+      CgroupConstant::ControllerFile controller_file,
+      const std::vector<std::string> &strs);
   virtual bool MigrateProcIn(pid_t pid) = 0;
 
   virtual bool KillAllProcesses() = 0;
 
   virtual bool Empty() = 0;
 
+  // Read the pids in cgroup.procs.
+  virtual bool GetProcs(std::vector<pid_t> *pids) = 0;
+
+  // Prepare an empty cgroup to be reused by another task. Limits are set
+  // again when the cgroup is acquired, so only the charged state left by the
+  // previous task is dropped here.
+  virtual bool ResetForReuse() = 0;
+
+  /**
+   * Read the resource usage of the task in this cgroup. Usage files are
+   * opened on the first call and read by pread() afterwards, so sampling
+   * costs one syscall per file.
+   * Unavailable counters (e.g. io on cgroup v1) are left as 0.
+   */
+  bool ReadResourceUsage(crane::grpc::TaskResourceUsage *usage);
+
+  /**
+   * Counters of a cgroup accumulate across the tasks using it. Called when a
+   * pooled cgroup is handed to a new task so that only the usage since then
+   * is reported.
+   */
+  void ResetResourceUsage();
+
  protected:
+  enum UsageFile : uint8_t {
+    USAGE_CPU = 0,
+    USAGE_MEMORY_PEAK,
+    USAGE_MEMORY_CURRENT,
+    USAGE_IO,
+    UsageFileCount,
+  };
+
+  // Counters read from the usage files as they are. cpu time and io bytes
+  // are cumulative.
+  struct RawUsage {
+    uint64_t cpu_time_usec{0};
+    std::optional<uint64_t> mem_peak_bytes;
+    uint64_t mem_current_bytes{0};
+    uint64_t io_read_bytes{0};
+    uint64_t io_write_bytes{0};
+  };
+
+  virtual std::string UsageFilePath_(UsageFile file) const = 0;
+
+  virtual void ParseUsageFile_(UsageFile file, const std::string &content,
+                               RawUsage *usage) const = 0;
+
+  // Restart the peak memory counter through the opened usage file.
+  virtual bool ResetMemoryPeak_(int peak_fd) = 0;
+
+  bool ReadRawUsage_(RawUsage *usage)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(m_usage_mtx_);
+
   // CgroupConstant::CgroupVersion cg_vsion; // maybe for hybird mode
   virtual bool ModifyCgroup_(CgroupConstant::ControllerFile controller_file);
   std::string m_cgroup_path_;
   mutable struct cgroup *m_cgroup_;
+
+  absl::Mutex m_usage_mtx_;
+  // -1: not opened yet. -2: the file does not exist on this kernel.
+  std::array<int, UsageFileCount> m_usage_fds_ ABSL_GUARDED_BY(m_usage_mtx_){
+      -1, -1, -1, -1};
+  RawUsage m_usage_baseline_ ABSL_GUARDED_BY(m_usage_mtx_);
+  // The max sampled memory usage, used when the kernel cannot report the
+  // peak of the current task.
+  uint64_t m_sampled_mem_peak_ ABSL_GUARDED_BY(m_usage_mtx_){0};
+  bool m_kernel_mem_peak_valid_ ABSL_GUARDED_BY(m_usage_mtx_){true};
 };
 
 class CgroupV1 : public Cgroup {
@@ -323,12 +421,24 @@ class CgroupV1 : public Cgroup {
   bool SetDeviceAccess(const std::unordered_set<SlotId> &devices, bool set_read,
                        bool set_write, bool set_mknod) override;
 
+  bool SetCpuset(const std::string &cpus, const std::string &mems) override;
+
   bool KillAllProcesses() override;
 
   bool Empty() override;
 
+  bool GetProcs(std::vector<pid_t> *pids) override;
+
   bool MigrateProcIn(pid_t pid) override;
 
+  bool ResetForReuse() override;
+
+ protected:
+  std::string UsageFilePath_(UsageFile file) const override;
+  void ParseUsageFile_(UsageFile file, const std::string &content,
+                       RawUsage *usage) const override;
+  bool ResetMemoryPeak_(int peak_fd) override;
+
  private:
 };
 
@@ -348,15 +458,98 @@ class CgroupV2 : public Cgroup {
   bool SetDeviceAccess(const std::unordered_set<SlotId> &devices, bool set_read,
                        bool set_write, bool set_mknod) override;
 
+  bool SetCpuset(const std::string &cpus, const std::string &mems) override;
+
   bool KillAllProcesses() override;
 
   bool Empty() override;
 
+  bool GetProcs(std::vector<pid_t> *pids) override;
+
   bool MigrateProcIn(pid_t pid) override;
 
+  bool ResetForReuse() override;
+
+ protected:
+  std::string UsageFilePath_(UsageFile file) const override;
+  void ParseUsageFile_(UsageFile file, const std::string &content,
+                       RawUsage *usage) const override;
+  bool ResetMemoryPeak_(int peak_fd) override;
+
  private:
 };
 
+using CgroupDirFds =
+    std::array<int, static_cast<size_t>(
+                        CgroupConstant::Controller::ControllerCount)>;
+
+/*
+ * Cgroups of the cgroupfs backend.
+ * The directory of the cgroup in each controller hierarchy is opened once
+ * when the cgroup is created. Controller files are then written by openat()
+ * relative to the cached fds, so that each setter costs exactly one write
+ * instead of rewriting all values set so far by cgroup_modify_cgroup().
+ * Unused slots of the fd arrays are -1.
+ */
+class CgroupFsV1 : public CgroupV1 {
+ public:
+  // root_fds are owned by CgroupManager and dir_fds are owned by this object.
+  CgroupFsV1(const std::string &path, const CgroupDirFds &root_fds,
+             const CgroupDirFds &dir_fds)
+      : CgroupV1(path, nullptr), m_root_fds_(root_fds), m_dir_fds_(dir_fds) {}
+  ~CgroupFsV1() override;
+
+  bool SetControllerValue(CgroupConstant::Controller controller,
+                          CgroupConstant::ControllerFile controller_file,
+                          uint64_t value) override;
+  bool SetControllerStr(CgroupConstant::Controller controller,
+                        CgroupConstant::ControllerFile controller_file,
+                        const std::string &str) override;
+  bool SetControllerStrs(CgroupConstant::Controller controller,
+                         CgroupConstant::ControllerFile controller_file,
+                         const std::vector<std::string> &strs) override;
+
+  bool KillAllProcesses() override;
+
+  bool Empty() override;
+
+  bool GetProcs(std::vector<pid_t> *pids) override;
+
+  bool MigrateProcIn(pid_t pid) override;
+
+ private:
+  CgroupDirFds m_root_fds_;
+  CgroupDirFds m_dir_fds_;
+};
+
+class CgroupFsV2 : public CgroupV2 {
+ public:
+  CgroupFsV2(const std::string &path, int root_fd, int dir_fd)
+      : CgroupV2(path, nullptr), m_root_fd_(root_fd), m_dir_fd_(dir_fd) {}
+  ~CgroupFsV2() override;
+
+  bool SetControllerValue(CgroupConstant::Controller controller,
+                          CgroupConstant::ControllerFile controller_file,
+                          uint64_t value) override;
+  bool SetControllerStr(CgroupConstant::Controller controller,
+                        CgroupConstant::ControllerFile controller_file,
+                        const std::string &str) override;
+  bool SetControllerStrs(CgroupConstant::Controller controller,
+                         CgroupConstant::ControllerFile controller_file,
+                         const std::vector<std::string> &strs) override;
+
+  bool KillAllProcesses() override;
+
+  bool Empty() override;
+
+  bool GetProcs(std::vector<pid_t> *pids) override;
+
+  bool MigrateProcIn(pid_t pid) override;
+
+ private:
+  int m_root_fd_;
+  int m_dir_fd_;
+};
 
 class AllocatableResourceAllocator {
  public:
@@ -373,6 +566,10 @@ class DedicatedResourceAllocator {
 
 class CgroupManager {
  public:
+  ~CgroupManager() {
+    if (m_teardown_inotify_fd_ != -1) close(m_teardown_inotify_fd_);
+  }
+
   int Init();
 
   bool Mounted(CgroupConstant::Controller controller) {
@@ -397,6 +594,18 @@ class CgroupManager {
 
   bool ReleaseCgroupByTaskIdOnly(task_id_t task_id);
 
+  /**
+   * On cgroup v2, released cgroups are not polled until they are empty.
+   * Instead, cgroup.events of each cgroup being torn down is watched by an
+   * inotify fd, which should be polled by the event loop of Craned.
+   * @return -1 if event-driven teardown is not available.
+   */
+  int GetTeardownEventFd() const { return m_teardown_inotify_fd_; }
+
+  // Called by the event loop when the teardown event fd is readable or
+  // every kCgroupTeardownRetryInterval.
+  void ProcessTeardownEvents();
+
   std::optional<crane::grpc::ResourceInNode> GetTaskResourceInNode(
       task_id_t task_id);
 
@@ -405,10 +614,49 @@ class CgroupManager {
 
   std::vector<EnvPair> GetResourceEnvListOfTask(task_id_t task_id);
 
+  // The cpus and NUMA nodes assigned to the task. Empty if the task has no
+  // assigned cpus.
+  std::vector<EnvPair> GetCpusetEnvListOfTask(task_id_t task_id);
+
+  // Return std::nullopt if the task has no cgroup on this node.
+  std::optional<crane::grpc::TaskResourceUsage> GetTaskResourceUsage(
+      task_id_t task_id);
+
+  std::unordered_map<task_id_t, crane::grpc::TaskResourceUsage>
+  GetAllTaskResourceUsage();
+
+  /**
+   * Find the task whose cgroup contains a process owning the socket inode.
+   * Only the processes listed in cgroup.procs of task cgroups are checked
+   * instead of every process on the node.
+   */
+  std::optional<task_id_t> FindTaskIdBySocketInode(ino_t inode);
+
   void SetCgroupVersion(CgroupConstant::CgroupVersion v) { cg_version_ = v; }
 
   CgroupConstant::CgroupVersion GetCgroupVersion() { return cg_version_; }
 
+  // Must be called before Init().
+  void SetCgroupBackend(CgroupConstant::CgroupBackend backend) {
+    cg_backend_ = backend;
+  }
+
+  CgroupConstant::CgroupBackend GetCgroupBackend() { return cg_backend_; }
+
+  // Keep a pool of pre-created empty cgroups for newly launched tasks, whose
+  // size is adjusted between min_size and max_size by the launch rate.
+  // Must be called before Init().
+  void EnableCgroupPool(uint32_t min_size, uint32_t max_size) {
+    m_pool_enabled_ = true;
+    m_pool_min_size_ = min_size;
+    m_pool_max_size_ = std::max(min_size, max_size);
+  }
+
+  // Run each task requesting whole cores on its own cpus through the cpuset
+  // controller. The other tasks share the cpus left. Must be called before
+  // Init().
+  void EnableCpuBinding() { m_cpu_binding_ = true; }
+
  private:
   static std::string CgroupStrByTaskId_(task_id_t task_id);
 
@@ -417,6 +665,47 @@ class CgroupManager {
                                         ControllerFlags required_controllers,
                                         bool retrieve);
 
+  bool InitCgroupFs_();
+
+  // Create a cgroup with the controllers used by tasks through the selected
+  // backend.
+  std::unique_ptr<Cgroup> CreateTaskCgroup_(const std::string &cgroup_string);
+
+  // Return nullptr if the pool is empty.
+  std::unique_ptr<Cgroup> AcquireCgroupFromPool_();
+
+  // Put an empty cgroup back to the pool, or destroy it if the pool is full.
+  void RecycleCgroup_(std::unique_ptr<Cgroup> cg);
+
+  void RefillCgroupPool_();
+
+  // Set cpuset of the cgroup to the cpus assigned to the task, or to the
+  // cpus not assigned to any task if the task doesn't request whole cores or
+  // there are not enough free cpus. The cpus are taken from the NUMA nodes of
+  // the devices of the task if possible.
+  bool BindCpus_(task_id_t task_id, const crane::grpc::ResourceInNode &res,
+                 Cgroup *cg);
+
+  // Set the cpuset of the tasks sharing cpus to the cpus left after cpus
+  // are assigned or freed.
+  void RebindSharedCpusNoLock_()
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(m_cpu_binding_mtx_);
+
+  void UpdateCgroupPoolTarget_() ABSL_EXCLUSIVE_LOCKS_REQUIRED(m_pool_mtx_);
+
+  // Kill the processes of a released cgroup and wait for it to be empty by
+  // inotify. Return false if the cgroup cannot be watched.
+  bool WatchCgroupTeardown_(Cgroup *cg);
+
+  // Kill and poll the processes of a released cgroup in the thread pool.
+  void TeardownCgroupByPolling_(Cgroup *cg);
+
+  // Recycle or destroy a released cgroup in the thread pool.
+  void FinishCgroupTeardown_(std::unique_ptr<Cgroup> cg, bool empty);
+
+  std::unique_ptr<Cgroup> CreateOrOpenFs_(const std::string &cgroup_string,
+                                          ControllerFlags controllers);
+
   int InitializeController_(struct cgroup &cgroup,
                             CgroupConstant::Controller controller,
                             bool required, bool has_cgroup,
@@ -433,14 +722,57 @@ class CgroupManager {
 
   CgroupConstant::CgroupVersion cg_version_;
 
-  util::AtomicHashMap<absl::flat_hash_map, task_id_t, CgroupSpec>
+  CgroupConstant::CgroupBackend cg_backend_{
+      CgroupConstant::CgroupBackend::LIBCGROUP};
+
+  // Fds of the root cgroup directory in each controller hierarchy, used by
+  // the cgroupfs backend. On cgroup v2, all v2 controllers share one fd.
+  CgroupDirFds m_root_dir_fds_{};
+
+  bool m_cpu_binding_{false};
+  CpusetAllocator m_cpuset_allocator_;
+  // Serializes the assignment of cpus with the cpuset updates of the tasks
+  // sharing cpus, so that no shared task runs on assigned cpus.
+  absl::Mutex m_cpu_binding_mtx_;
+  absl::flat_hash_map<task_id_t, Cgroup *> m_shared_cpu_cgroup_map_
+      ABSL_GUARDED_BY(m_cpu_binding_mtx_);
+
+  bool m_pool_enabled_{false};
+  uint32_t m_pool_min_size_{0};
+  uint32_t m_pool_max_size_{0};
+  std::atomic_uint32_t m_pool_cg_seq_{0};
+
+  absl::Mutex m_pool_mtx_;
+  std::vector<std::unique_ptr<Cgroup>> m_cg_pool_ ABSL_GUARDED_BY(m_pool_mtx_);
+  size_t m_pool_target_size_ ABSL_GUARDED_BY(m_pool_mtx_){0};
+  size_t m_pool_window_acquire_cnt_ ABSL_GUARDED_BY(m_pool_mtx_){0};
+  absl::Time m_pool_window_start_ ABSL_GUARDED_BY(m_pool_mtx_);
+  bool m_pool_refilling_ ABSL_GUARDED_BY(m_pool_mtx_){false};
+
+  struct PendingTeardown {
+    std::unique_ptr<Cgroup> cg;
+    int kill_cnt;
+    absl::Time next_kill_time;
+  };
+
+  int m_teardown_inotify_fd_{-1};
+
+  absl::Mutex m_teardown_mtx_;
+  absl::flat_hash_map<int /*watch descriptor*/, PendingTeardown>
+      m_pending_teardowns_ ABSL_GUARDED_BY(m_teardown_mtx_);
+
+  // These maps are hit by gRPC threads, TaskManager and PAM queries at the
+  // same time. They are sharded so that the insertion or removal of a task
+  // does not block the accesses to other tasks.
+  util::ShardedAtomicHashMap<absl::flat_hash_map, task_id_t, CgroupSpec>
       m_task_id_to_cg_spec_map_;
 
-  util::AtomicHashMap<absl::flat_hash_map, task_id_t, std::unique_ptr<Cgroup>>
+  util::ShardedAtomicHashMap<absl::flat_hash_map, task_id_t,
+                             std::unique_ptr<Cgroup>>
       m_task_id_to_cg_map_;
 
-  util::AtomicHashMap<absl::flat_hash_map, uid_t /*uid*/,
-                      absl::flat_hash_set<task_id_t>>
+  util::ShardedAtomicHashMap<absl::flat_hash_map, uid_t /*uid*/,
+                             absl::flat_hash_set<task_id_t>>
       m_uid_to_task_ids_map_;
 };
 
@@ -0,0 +1,249 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "CpusetAllocator.h"
+
+namespace Craned {
+
+namespace {
+
+bool ReadFirstLine(const std::filesystem::path& path, std::string* line) {
+  std::ifstream file(path);
+  if (!file.is_open()) return false;
+  std::getline(file, *line);
+  return true;
+}
+
+}  // namespace
+
+bool CpusetAllocator::Init(const std::string& sysfs_system_dir) {
+  std::filesystem::path system_dir(sysfs_system_dir);
+
+  std::string line;
+  std::vector<uint32_t> online_cpus;
+  if (!ReadFirstLine(system_dir / "cpu" / "online", &line) ||
+      !ParseListString(line, &online_cpus)) {
+    CRANE_ERROR("Failed to read online cpus from {}/cpu/online.",
+                sysfs_system_dir);
+    return false;
+  }
+  std::unordered_set<uint32_t> online_set(online_cpus.begin(),
+                                          online_cpus.end());
+
+  std::error_code ec;
+  for (const auto& entry :
+       std::filesystem::directory_iterator(system_dir / "node", ec)) {
+    std::string name = entry.path().filename().string();
+    uint32_t node_id;
+    if (!name.starts_with("node") ||
+        !absl::SimpleAtoi(name.substr(strlen("node")), &node_id))
+      continue;
+
+    std::vector<uint32_t> cpus;
+    if (!ReadFirstLine(entry.path() / "cpulist", &line) ||
+        !ParseListString(line, &cpus)) {
+      CRANE_ERROR("Failed to read cpus of NUMA node {}.", node_id);
+      return false;
+    }
+
+    NumaNode numa_node{.id = node_id};
+    for (uint32_t cpu : cpus)
+      if (online_set.erase(cpu)) numa_node.cpus.emplace_back(cpu);
+
+    // Memory-only nodes are skipped.
+    if (!numa_node.cpus.empty())
+      m_numa_nodes_.emplace_back(std::move(numa_node));
+  }
+
+  // No NUMA support, or some online cpus are not listed by any node.
+  if (!online_set.empty()) {
+    if (!m_numa_nodes_.empty())
+      CRANE_WARN("{} online cpus do not belong to any NUMA node.",
+                 online_set.size());
+    std::vector<uint32_t> rest(online_set.begin(), online_set.end());
+    std::ranges::sort(rest);
+    m_numa_nodes_.emplace_back(NumaNode{.id = 0, .cpus = std::move(rest)});
+  }
+
+  std::ranges::sort(m_numa_nodes_, {}, &NumaNode::id);
+
+  absl::MutexLock lock_guard(&m_mtx_);
+  for (const auto& numa_node : m_numa_nodes_) {
+    m_all_.cpus.insert(m_all_.cpus.end(), numa_node.cpus.begin(),
+                       numa_node.cpus.end());
+    if (m_all_.mems.empty() || m_all_.mems.back() != numa_node.id)
+      m_all_.mems.emplace_back(numa_node.id);
+
+    m_cpu_used_.emplace_back(numa_node.cpus.size(), false);
+    m_free_cpu_num_.emplace_back(numa_node.cpus.size());
+  }
+  std::ranges::sort(m_all_.cpus);
+
+  CRANE_DEBUG("{} cpus in {} NUMA nodes can be assigned to tasks: {}",
+              m_all_.cpus.size(), m_numa_nodes_.size(),
+              ToListString(m_all_.cpus));
+  return !m_all_.cpus.empty();
+}
+
+std::optional<CpusetAllocator::Cpuset> CpusetAllocator::Allocate(
+    task_id_t task_id, uint32_t cpu_num,
+    const std::vector<uint32_t>& preferred_numa_nodes) {
+  absl::MutexLock lock_guard(&m_mtx_);
+  if (cpu_num == 0 || m_task_cpuset_map_.contains(task_id))
+    return std::nullopt;
+
+  uint32_t total_free = std::reduce(m_free_cpu_num_.begin(),
+                                    m_free_cpu_num_.end(), uint32_t{0});
+  if (total_free < cpu_num) return std::nullopt;
+
+  auto is_preferred = [&](int i) {
+    return std::ranges::find(preferred_numa_nodes, m_numa_nodes_[i].id) !=
+           preferred_numa_nodes.end();
+  };
+
+  // The NUMA node with the fewest free cpus which can hold all the cpus,
+  // among the preferred nodes if any of them can.
+  int best = -1;
+  for (int i = 0; i < m_numa_nodes_.size(); i++) {
+    if (m_free_cpu_num_[i] < cpu_num) continue;
+    if (best == -1 ||
+        std::pair(!is_preferred(i), m_free_cpu_num_[i]) <
+            std::pair(!is_preferred(best), m_free_cpu_num_[best]))
+      best = i;
+  }
+
+  std::vector<int> order;
+  if (best != -1) {
+    order.emplace_back(best);
+  } else {
+    order.resize(m_numa_nodes_.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::ranges::stable_sort(order, [&](int lhs, int rhs) {
+      return std::pair(is_preferred(lhs), m_free_cpu_num_[lhs]) >
+             std::pair(is_preferred(rhs), m_free_cpu_num_[rhs]);
+    });
+  }
+
+  Cpuset cpuset;
+  uint32_t needed = cpu_num;
+  for (int i : order) {
+    if (needed == 0) break;
+    if (m_free_cpu_num_[i] == 0) continue;
+
+    std::vector<bool>& used = m_cpu_used_[i];
+    for (size_t pos = 0; pos < used.size() && needed > 0; pos++) {
+      if (used[pos]) continue;
+      used[pos] = true;
+      cpuset.cpus.emplace_back(m_numa_nodes_[i].cpus[pos]);
+      m_free_cpu_num_[i]--;
+      needed--;
+    }
+    cpuset.mems.emplace_back(m_numa_nodes_[i].id);
+  }
+
+  std::ranges::sort(cpuset.cpus);
+  std::ranges::sort(cpuset.mems);
+  m_task_cpuset_map_.emplace(task_id, cpuset);
+  return cpuset;
+}
+
+bool CpusetAllocator::Free(task_id_t task_id) {
+  absl::MutexLock lock_guard(&m_mtx_);
+  auto it = m_task_cpuset_map_.find(task_id);
+  if (it == m_task_cpuset_map_.end()) return false;
+
+  std::unordered_set<uint32_t> cpus(it->second.cpus.begin(),
+                                    it->second.cpus.end());
+  for (int i = 0; i < m_numa_nodes_.size(); i++) {
+    const auto& node_cpus = m_numa_nodes_[i].cpus;
+    for (size_t pos = 0; pos < node_cpus.size(); pos++) {
+      if (m_cpu_used_[i][pos] && cpus.contains(node_cpus[pos])) {
+        m_cpu_used_[i][pos] = false;
+        m_free_cpu_num_[i]++;
+      }
+    }
+  }
+
+  m_task_cpuset_map_.erase(it);
+  return true;
+}
+
+std::optional<CpusetAllocator::Cpuset> CpusetAllocator::GetCpusetOfTask(
+    task_id_t task_id) {
+  absl::MutexLock lock_guard(&m_mtx_);
+  auto it = m_task_cpuset_map_.find(task_id);
+  if (it == m_task_cpuset_map_.end()) return std::nullopt;
+  return it->second;
+}
+
+CpusetAllocator::Cpuset CpusetAllocator::SharedCpus() {
+  absl::MutexLock lock_guard(&m_mtx_);
+  Cpuset cpuset;
+  for (int i = 0; i < m_numa_nodes_.size(); i++) {
+    if (m_free_cpu_num_[i] == 0) continue;
+
+    const auto& node_cpus = m_numa_nodes_[i].cpus;
+    for (size_t pos = 0; pos < node_cpus.size(); pos++)
+      if (!m_cpu_used_[i][pos]) cpuset.cpus.emplace_back(node_cpus[pos]);
+    cpuset.mems.emplace_back(m_numa_nodes_[i].id);
+  }
+  if (cpuset.cpus.empty()) return m_all_;
+
+  std::ranges::sort(cpuset.cpus);
+  std::ranges::sort(cpuset.mems);
+  return cpuset;
+}
+
+uint32_t CpusetAllocator::FreeCpuNum() {
+  absl::MutexLock lock_guard(&m_mtx_);
+  return std::reduce(m_free_cpu_num_.begin(), m_free_cpu_num_.end(),
+                     uint32_t{0});
+}
+
+std::string CpusetAllocator::ToListString(const std::vector<uint32_t>& ids) {
+  std::vector<std::string> ranges;
+  for (size_t i = 0; i < ids.size();) {
+    size_t j = i;
+    while (j + 1 < ids.size() && ids[j + 1] == ids[j] + 1) j++;
+
+    if (i == j)
+      ranges.emplace_back(std::to_string(ids[i]));
+    else
+      ranges.emplace_back(fmt::format("{}-{}", ids[i], ids[j]));
+    i = j + 1;
+  }
+  return absl::StrJoin(ranges, ",");
+}
+
+bool CpusetAllocator::ParseListString(const std::string& str,
+                                      std::vector<uint32_t>* ids) {
+  std::string stripped(absl::StripAsciiWhitespace(str));
+  if (stripped.empty()) return true;
+
+  std::vector<std::string> ranges = absl::StrSplit(stripped, ',');
+  for (const auto& range : ranges) {
+    std::vector<std::string> bounds = absl::StrSplit(range, '-');
+    uint32_t first, last;
+    if (bounds.size() > 2 || !absl::SimpleAtoi(bounds[0], &first) ||
+        !absl::SimpleAtoi(bounds.back(), &last) || first > last)
+      return false;
+
+    for (uint32_t id = first; id <= last; id++) ids->emplace_back(id);
+  }
+  return true;
+}
+
+}  // namespace Craned
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#pragma once
+
+#include "CranedPublicDefs.h"
+// Precompiled header comes first.
+
+namespace Craned {
+
+inline const char* kSysfsSystemDir = "/sys/devices/system";
+
+/**
+ * Assigns cpus of this node to tasks requesting whole cores, so that each
+ * task runs on its own cpus instead of sharing all cpus under a CFS quota.
+ *
+ * The NUMA topology is read from sysfs. The cpus of a task are taken from a
+ * single NUMA node if any node has enough free cpus, choosing the node with
+ * the fewest free cpus to keep larger nodes free for larger tasks. Otherwise
+ * they are taken from the nodes with the most free cpus first. In both cases
+ * the NUMA nodes of the devices allocated to the task are tried first.
+ *
+ * CraneCtld accounts cpus by count. Tasks requesting a fraction of a core are
+ * not assigned any cpu here, so the free cpus here are never fewer than the
+ * free cpu count seen by CraneCtld and a whole-core task always gets its cpus.
+ * Tasks without assigned cpus share the free cpus, see SharedCpus().
+ */
+class CpusetAllocator {
+ public:
+  struct Cpuset {
+    std::vector<uint32_t> cpus;
+    // NUMA nodes of the cpus.
+    std::vector<uint32_t> mems;
+  };
+
+  /**
+   * Read the online cpus and NUMA nodes under sysfs_system_dir, i.e.,
+   * cpu/online and node/node<N>/cpulist. All cpus are put into NUMA node 0
+   * if the kernel has no NUMA support.
+   */
+  bool Init(const std::string& sysfs_system_dir = kSysfsSystemDir);
+
+  /**
+   * @param preferred_numa_nodes are the ids of NUMA nodes whose cpus are
+   * taken first, e.g., the nodes of the devices of the task.
+   * @return std::nullopt if there are not enough free cpus or the task has
+   * been assigned cpus already.
+   */
+  std::optional<Cpuset> Allocate(
+      task_id_t task_id, uint32_t cpu_num,
+      const std::vector<uint32_t>& preferred_numa_nodes = {});
+
+  // Return false if no cpu is assigned to the task.
+  bool Free(task_id_t task_id);
+
+  std::optional<Cpuset> GetCpusetOfTask(task_id_t task_id);
+
+  // All the cpus and NUMA nodes.
+  const Cpuset& AllCpus() const { return m_all_; }
+
+  /**
+   * The cpus not assigned to any task and their NUMA nodes, which are shared
+   * by the tasks without assigned cpus. All the cpus if every cpu is
+   * assigned, since a cpuset can't be empty.
+   */
+  Cpuset SharedCpus();
+
+  uint32_t FreeCpuNum();
+
+  // Format like "0-3,8,10-11", used by cpuset.cpus and cpulist in sysfs.
+  static std::string ToListString(const std::vector<uint32_t>& ids);
+  static bool ParseListString(const std::string& str,
+                              std::vector<uint32_t>* ids);
+
+ private:
+  struct NumaNode {
+    uint32_t id;
+    std::vector<uint32_t> cpus;
+  };
+
+  std::vector<NumaNode> m_numa_nodes_;
+  Cpuset m_all_;
+
+  absl::Mutex m_mtx_;
+  // Indexed by the position of a cpu in m_numa_nodes_[i].cpus.
+  std::vector<std::vector<bool>> m_cpu_used_ ABSL_GUARDED_BY(m_mtx_);
+  std::vector<uint32_t> m_free_cpu_num_ ABSL_GUARDED_BY(m_mtx_);
+  absl::flat_hash_map<task_id_t, Cpuset> m_task_cpuset_map_
+      ABSL_GUARDED_BY(m_mtx_);
+};
+
+}  // namespace Craned
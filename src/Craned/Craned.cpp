@@ -30,6 +30,7 @@
 #include "CforedClient.h"
 #include "CranedServer.h"
 #include "CtldClient.h"
+#include "Zygote.h"
 #include "crane/Network.h"
 #include "crane/OS.h"
 #include "crane/PluginClient.h"
@@ -83,7 +84,8 @@ void ParseConfig(int argc, char** argv) {
       std::string,
       std::vector<std::tuple<std::string /*name*/, std::string /*type*/,
                              std::vector<std::string> /*path*/,
-                             std::string /*EnvInjector*/>>>
+                             std::string /*EnvInjector*/,
+                             SlotAffinity /*Affinity*/>>>
       each_node_device;
   if (std::filesystem::exists(config_path)) {
     try {
@@ -285,7 +287,8 @@ void ParseConfig(int argc, char** argv) {
 
           std::vector<std::tuple<std::string /*name*/, std::string /*type*/,
                                  std::vector<std::string> /*path*/,
-                                 std::string /*EnvInjector*/>>
+                                 std::string /*EnvInjector*/,
+                                 SlotAffinity /*Affinity*/>>
               devices;
           if (node["gres"]) {
             for (auto gres_it = node["gres"].begin();
@@ -298,6 +301,13 @@ void ParseConfig(int argc, char** argv) {
               if (gres_node["EnvInjector"]) {
                 env_injector = gres_node["EnvInjector"].as<std::string>();
               }
+              // Read from sysfs if not configured.
+              SlotAffinity affinity;
+              if (gres_node["NumaNode"])
+                affinity.numa_node = gres_node["NumaNode"].as<int32_t>();
+              if (gres_node["PcieSwitch"])
+                affinity.pcie_switch =
+                    gres_node["PcieSwitch"].as<std::string>();
               if (gres_node["DeviceFileRegex"]) {
                 device_file_configured = true;
                 std::list<std::string> device_path_list;
@@ -309,9 +319,9 @@ void ParseConfig(int argc, char** argv) {
                   std::exit(1);
                 }
                 for (const auto& device_path : device_path_list) {
-                  devices.push_back(std::make_tuple(device_name, device_type,
-                                                    std::vector{device_path},
-                                                    env_injector));
+                  devices.push_back(std::make_tuple(
+                      device_name, device_type, std::vector{device_path},
+                      env_injector, affinity));
                 }
               }
               if (gres_node["DeviceFileList"] &&
@@ -331,7 +341,7 @@ void ParseConfig(int argc, char** argv) {
                       std::make_tuple(device_name, device_type,
                                       std::vector(device_path_list.begin(),
                                                   device_path_list.end()),
-                                      env_injector));
+                                      env_injector, affinity));
                 }
               }
               if (!device_file_configured) {
@@ -457,6 +467,41 @@ void ParseConfig(int argc, char** argv) {
             g_config.CranedForeground = false;
         }
 
+        if (config["CranedCgroupBackend"]) {
+          auto val = config["CranedCgroupBackend"].as<std::string>();
+          if (val == "cgroupfs")
+            g_config.CgroupFsBackend = true;
+          else if (val == "libcgroup")
+            g_config.CgroupFsBackend = false;
+          else
+            CRANE_WARN("Unknown CranedCgroupBackend '{}'. Use libcgroup.", val);
+        }
+
+        if (config["CgroupPool"]) {
+          const auto& pool_config = config["CgroupPool"];
+
+          if (pool_config["Enabled"])
+            g_config.CgroupPool.Enabled = pool_config["Enabled"].as<bool>();
+          if (pool_config["MinSize"])
+            g_config.CgroupPool.MinSize = pool_config["MinSize"].as<uint32_t>();
+          if (pool_config["MaxSize"])
+            g_config.CgroupPool.MaxSize = pool_config["MaxSize"].as<uint32_t>();
+        }
+
+        if (config["CranedCpuBinding"])
+          g_config.CpuBinding = config["CranedCpuBinding"].as<bool>();
+
+        if (config["CranedUseZygote"])
+          g_config.CranedUseZygote = config["CranedUseZygote"].as<bool>();
+
+        if (config["CranedScriptInMemfd"])
+          g_config.CranedScriptInMemfd =
+              config["CranedScriptInMemfd"].as<bool>();
+
+        if (config["TaskUsageSampleInterval"])
+          g_config.TaskUsageSampleIntervalSec =
+              config["TaskUsageSampleInterval"].as<uint32_t>();
+
         if (config["Plugin"]) {
           const auto& plugin_config = config["Plugin"];
 
@@ -472,6 +517,24 @@ void ParseConfig(int argc, char** argv) {
                 fmt::format("unix://{}{}", g_config.CraneBaseDir,
                             kDefaultPlugindUnixSockPath);
           }
+
+          if (plugin_config["MaxQueuedTasks"])
+            g_config.Plugin.MaxQueuedTasks =
+                plugin_config["MaxQueuedTasks"].as<uint32_t>();
+          if (plugin_config["MaxInflightRpcs"])
+            g_config.Plugin.MaxInflightRpcs =
+                plugin_config["MaxInflightRpcs"].as<uint32_t>();
+          if (plugin_config["MaxBatchSize"])
+            g_config.Plugin.MaxBatchSize =
+                plugin_config["MaxBatchSize"].as<uint32_t>();
+          if (plugin_config["JobMonitorPushInterval"])
+            g_config.Plugin.JobMonitorPushIntervalSec =
+                plugin_config["JobMonitorPushInterval"].as<uint32_t>();
+          if (g_config.Plugin.JobMonitorPushIntervalSec > 0 &&
+              g_config.TaskUsageSampleIntervalSec == 0)
+            CRANE_WARN(
+                "Plugin.JobMonitorPushInterval is ignored since "
+                "TaskUsageSampleInterval is 0.");
         }
       }
     } catch (YAML::BadFile& e) {
@@ -537,9 +600,11 @@ void ParseConfig(int argc, char** argv) {
     for (auto& dev_arg : devices) {
       std::string name, type, env_injector;
       std::vector<std::string> path;
-      std::tie(name, type, path, env_injector) = dev_arg;
+      SlotAffinity affinity;
+      std::tie(name, type, path, env_injector, affinity) = dev_arg;
       std::unique_ptr dev = Craned::DeviceManager::ConstructDevice(
           name, type, path, env_injector);
+      dev->affinity = std::move(affinity);
       if (!dev->Init()) {
         CRANE_ERROR("Access Device {} failed.", static_cast<std::string>(*dev));
         std::exit(1);
@@ -547,6 +612,9 @@ void ParseConfig(int argc, char** argv) {
         dev->dev_id = dev->device_metas.front().path;
         node_res->dedicated_res.name_type_slots_map[dev->name][dev->type]
             .emplace(dev->dev_id);
+        if (!dev->affinity.IsUnknown())
+          node_res->dedicated_res.slot_affinity_map[dev->dev_id] =
+              dev->affinity;
         Craned::g_this_node_device[dev->dev_id] = std::move(dev);
       }
     }
@@ -605,6 +673,12 @@ void GlobalVariableInit() {
   using Craned::CgroupManager;
   using Craned::CgroupConstant::Controller;
   g_cg_mgr = std::make_unique<Craned::CgroupManager>();
+  if (g_config.CgroupFsBackend)
+    g_cg_mgr->SetCgroupBackend(Craned::CgroupConstant::CgroupBackend::CGROUPFS);
+  if (g_config.CgroupPool.Enabled)
+    g_cg_mgr->EnableCgroupPool(g_config.CgroupPool.MinSize,
+                               g_config.CgroupPool.MaxSize);
+  if (g_config.CpuBinding) g_cg_mgr->EnableCpuBinding();
   g_cg_mgr->Init();
   if (g_cg_mgr->GetCgroupVersion() ==
           Craned::CgroupConstant::CgroupVersion::CGROUP_V1 &&
@@ -622,6 +696,17 @@ void GlobalVariableInit() {
     std::exit(1);
   }
 
+  if (g_config.CranedUseZygote) {
+    // The zygote must be forked before any thread other than those of the
+    // logger is created.
+    g_zygote = std::make_unique<Craned::Zygote>();
+    if (!g_zygote->Start()) {
+      CRANE_WARN(
+          "Failed to start zygote. Task processes will be forked by Craned.");
+      g_zygote.reset();
+    }
+  }
+
   g_thread_pool =
       std::make_unique<BS::thread_pool>(std::thread::hardware_concurrency());
 
@@ -635,7 +720,12 @@ void GlobalVariableInit() {
   if (g_config.Plugin.Enabled) {
     CRANE_INFO("[Plugin] Plugin module is enabled.");
     g_plugin_client = std::make_unique<plugin::PluginClient>();
-    g_plugin_client->InitChannelAndStub(g_config.Plugin.PlugindSockPath);
+    plugin::PluginClient::Options options{
+        .max_queued_tasks = g_config.Plugin.MaxQueuedTasks,
+        .max_inflight_rpcs = g_config.Plugin.MaxInflightRpcs,
+        .max_batch_size = g_config.Plugin.MaxBatchSize};
+    g_plugin_client->InitChannelAndStub(g_config.Plugin.PlugindSockPath,
+                                        options);
   }
 
   g_cfored_manager = std::make_unique<Craned::CforedManager>();
@@ -662,6 +752,7 @@ void StartServer() {
   // Free global variables
   g_task_mgr->Wait();
   g_task_mgr.reset();
+  g_zygote.reset();
   // CforedManager MUST be destructed after TaskManager.
   g_cfored_manager.reset();
   g_server.reset();
@@ -27,6 +27,26 @@ namespace Craned {
 
 inline const uint64_t kEvSigChldResendMs = 500'000;
 
+// When the script of a task is kept in a memfd, the memfd is placed at this
+// fd in the task process and bash runs /proc/self/fd/<kTaskScriptFd>.
+inline constexpr int kTaskScriptFd = 3;
+
+// Called in the child process before execv(). Make the script memfd
+// available at kTaskScriptFd across execv().
+inline bool InstallTaskScriptFd(int fd) {
+  if (fd == kTaskScriptFd) return fcntl(fd, F_SETFD, 0) == 0;
+  return dup2(fd, kTaskScriptFd) == kTaskScriptFd;
+}
+
+// Status changes generated within this window are coalesced and sent to
+// CraneCtld in one TaskStatusChangeBatch RPC.
+inline const uint64_t kTaskStatusChangeBatchWindowMs = 20;
+inline const uint32_t kTaskStatusChangeBatchMaxSize = 1000;
+// Status changes which fail to be sent or are not acked by CraneCtld are
+// resent with an exponential backoff between these bounds.
+inline const uint64_t kTaskStatusChangeRetryMinBackoffMs = 100;
+inline const uint64_t kTaskStatusChangeRetryMaxBackoffMs = 10000;
+
 using EnvPair = std::pair<std::string, std::string>;
 
 struct TaskStatusChange {
@@ -34,6 +54,8 @@ struct TaskStatusChange {
   crane::grpc::TaskStatus new_status{};
   uint32_t exit_code{};
   std::optional<std::string> reason;
+  // Final usage of the task cgroup.
+  crane::grpc::TaskResourceUsage resource_usage;
 };
 
 struct TaskInfoOfUid {
@@ -62,9 +84,22 @@ struct Config {
   struct PluginConfig {
     bool Enabled{false};
     std::string PlugindSockPath;
+    uint32_t MaxQueuedTasks{kDefaultPluginMaxQueuedTasks};
+    uint32_t MaxInflightRpcs{kDefaultPluginMaxInflightRpcs};
+    uint32_t MaxBatchSize{kDefaultPluginMaxBatchSize};
+    // Seconds between two pushes of the sampled task resource usage to
+    // plugind. 0 disables the push.
+    uint32_t JobMonitorPushIntervalSec{0};
   };
   PluginConfig Plugin;
 
+  struct CgroupPoolConfig {
+    bool Enabled{false};
+    uint32_t MinSize{4};
+    uint32_t MaxSize{64};
+  };
+  CgroupPoolConfig CgroupPool;
+
   CranedListenConf ListenConf;
   bool CompressedRpc{};
 
@@ -79,6 +114,17 @@ struct Config {
   std::string CranedUnixSockPath;
 
   bool CranedForeground{};
+  // Spawn task processes by a zygote process forked at the boot of Craned.
+  bool CranedUseZygote{false};
+  // Pass task scripts in sealed memfds instead of files in CranedScriptDir.
+  bool CranedScriptInMemfd{false};
+  // Manage task cgroups through the cgroup filesystem instead of libcgroup.
+  bool CgroupFsBackend{false};
+  // Bind tasks requesting whole cores to their own cpus by cpuset.
+  bool CpuBinding{false};
+  // Interval of sampling the resource usage of task cgroups. 0 disables
+  // sampling, and the peak memory is then only read from the kernel.
+  uint32_t TaskUsageSampleIntervalSec{30};
 
   std::string Hostname;
   CranedId CranedIdOfThisNode;
@@ -17,8 +17,6 @@
 #include "CranedServer.h"
 
 #include <arpa/inet.h>
-#include <sys/stat.h>
-#include <yaml-cpp/yaml.h>
 
 #include "CtldClient.h"
 
@@ -49,7 +47,7 @@ grpc::Status CranedServiceImpl::TerminateTasks(
               absl::StrJoin(request->task_id_list(), ","));
 
   for (task_id_t id : request->task_id_list())
-    g_task_mgr->TerminateTaskAsync(id);
+    g_task_mgr->TerminateTaskAsync(id, request->kill_grace_seconds());
   response->set_ok(true);
 
   return Status::OK;
@@ -74,18 +72,23 @@ grpc::Status CranedServiceImpl::QueryTaskIdFromPort(
 
   ino_t inode;
   bool inode_found = false;
+  bool netlink_available;
 
-  // find inode
-  // 1._find_match_in_tcp_file
-  inode_found =
-      crane::FindTcpInodeByPort("/proc/net/tcp", request->port(), &inode);
-  if (!inode_found) {
-    CRANE_TRACE(
-        "Inode num for port {} is not found in /proc/net/tcp, try "
-        "/proc/net/tcp6.",
-        request->port());
+  // 1. Find the inode of the socket. NETLINK_SOCK_DIAG filters the sockets
+  // by port in the kernel. /proc/net/tcp{,6} is parsed only if it fails.
+  inode_found = crane::FindTcpInodeByPortNetlink(request->port(), &inode,
+                                                 &netlink_available);
+  if (!netlink_available) {
     inode_found =
-        crane::FindTcpInodeByPort("/proc/net/tcp6", request->port(), &inode);
+        crane::FindTcpInodeByPort("/proc/net/tcp", request->port(), &inode);
+    if (!inode_found) {
+      CRANE_TRACE(
+          "Inode num for port {} is not found in /proc/net/tcp, try "
+          "/proc/net/tcp6.",
+          request->port());
+      inode_found =
+          crane::FindTcpInodeByPort("/proc/net/tcp6", request->port(), &inode);
+    }
   }
 
   if (!inode_found) {
@@ -94,73 +97,21 @@ grpc::Status CranedServiceImpl::QueryTaskIdFromPort(
     return Status::OK;
   }
 
-  // 2.find_pid_by_inode
-  pid_t pid_i = -1;
-  std::filesystem::path proc_path{"/proc"};
-  for (auto const &dir_entry : std::filesystem::directory_iterator(proc_path)) {
-    if (isdigit(dir_entry.path().filename().string()[0])) {
-      std::string pid_s = dir_entry.path().filename().string();
-      std::string proc_fd_path =
-          fmt::format("{}/{}/fd", proc_path.string(), pid_s);
-      if (!std::filesystem::exists(proc_fd_path)) {
-        continue;
-      }
-      for (auto const &fd_dir_entry :
-           std::filesystem::directory_iterator(proc_fd_path)) {
-        struct stat statbuf {};
-        std::string fdpath = fmt::format(
-            "{}/{}", proc_fd_path, fd_dir_entry.path().filename().string());
-        const char *fdchar = fdpath.c_str();
-        if (stat(fdchar, &statbuf) != 0) {
-          continue;
-        }
-        if (statbuf.st_ino == inode) {
-          pid_i = std::stoi(pid_s);
-          CRANE_TRACE("Pid for the process that owns port {} is {}",
-                      request->port(), pid_i);
-          break;
-        }
-      }
-    }
-    if (pid_i != -1) {
-      break;
-    }
-  }
-  if (pid_i == -1) {
-    CRANE_TRACE("Pid for the process that owns port {} is not found.",
-                request->port());
+  // 2. Find the task by the processes in task cgroups. Processes outside
+  // task cgroups never belong to a task, so the other processes on the node
+  // are not scanned.
+  std::optional<task_id_t> task_id_opt =
+      g_cg_mgr->FindTaskIdBySocketInode(inode);
+  if (!task_id_opt.has_value()) {
+    CRANE_TRACE("No task process owns port {}.", request->port());
     response->set_ok(false);
     return Status::OK;
   }
 
-  // 3. pid2jobid
-  do {
-    std::optional<uint32_t> task_id_opt =
-        g_task_mgr->QueryTaskIdFromPidAsync(pid_i);
-    if (task_id_opt.has_value()) {
-      CRANE_TRACE("Task id for pid {} is #{}", pid_i, task_id_opt.value());
-      response->set_ok(true);
-      response->set_task_id(task_id_opt.value());
-      return Status::OK;
-    } else {
-      std::string proc_dir = fmt::format("/proc/{}/status", pid_i);
-      YAML::Node proc_details = YAML::LoadFile(proc_dir);
-      if (proc_details["PPid"]) {
-        pid_t ppid = std::stoi(proc_details["PPid"].as<std::string>());
-        CRANE_TRACE("Pid {} not found in TaskManager. Checking ppid {}", pid_i,
-                    ppid);
-        pid_i = ppid;
-      } else {
-        CRANE_TRACE(
-            "Pid {} not found in TaskManager. "
-            "However ppid is 1. Break the loop.",
-            pid_i);
-        pid_i = 1;
-      }
-    }
-  } while (pid_i > 1);
-
-  response->set_ok(false);
+  CRANE_TRACE("Task id for port {} is #{}", request->port(),
+              task_id_opt.value());
+  response->set_ok(true);
+  response->set_task_id(task_id_opt.value());
   return Status::OK;
 }
 
@@ -521,6 +472,86 @@ grpc::Status CranedServiceImpl::QueryCranedRemoteMeta(
   return Status::OK;
 }
 
+grpc::Status CranedServiceImpl::QueryTaskResourceUsage(
+    grpc::ServerContext *context,
+    const ::crane::grpc::QueryTaskResourceUsageRequest *request,
+    crane::grpc::QueryTaskResourceUsageReply *response) {
+  auto *usage_map = response->mutable_usage_map();
+
+  if (request->task_id_list().empty()) {
+    for (auto &[task_id, usage] : g_cg_mgr->GetAllTaskResourceUsage())
+      (*usage_map)[task_id] = std::move(usage);
+    return Status::OK;
+  }
+
+  for (task_id_t task_id : request->task_id_list()) {
+    auto usage = g_cg_mgr->GetTaskResourceUsage(task_id);
+    if (usage.has_value()) (*usage_map)[task_id] = std::move(usage.value());
+  }
+  return Status::OK;
+}
+
+grpc::Status CranedServiceImpl::Relay(grpc::ServerContext *context,
+                                      const crane::grpc::RelayRequest *request,
+                                      crane::grpc::RelayReply *response) {
+  CRANE_TRACE("Receive Relay with {} target(s) and fan-out {}.",
+              request->targets_size(), request->fan_out());
+
+  crane::RelayTree relay_tree(
+      request->fan_out(),
+      [this](const std::string &id) { return GetPeerCranedStub_(id); });
+
+  return relay_tree.ServeRelay(
+      *context, *request, response, g_config.CranedIdOfThisNode,
+      [this, context](const crane::grpc::RelayTarget &target) {
+        switch (target.payload_case()) {
+        case crane::grpc::RelayTarget::kTerminateTasks: {
+          crane::grpc::TerminateTasksReply reply;
+          return TerminateTasks(context, &target.terminate_tasks(), &reply)
+              .ok();
+        }
+        case crane::grpc::RelayTarget::kReleaseCgroup: {
+          crane::grpc::ReleaseCgroupForTasksReply reply;
+          return ReleaseCgroupForTasks(context, &target.release_cgroup(),
+                                       &reply)
+              .ok();
+        }
+        default:
+          CRANE_ERROR("Unknown payload in Relay request.");
+          return false;
+        }
+      });
+}
+
+std::shared_ptr<crane::grpc::Craned::Stub>
+CranedServiceImpl::GetPeerCranedStub_(const std::string &craned_id) {
+  // Only the craneds in the config file are relayed to.
+  if (!g_config.CranedRes.contains(craned_id)) return nullptr;
+
+  absl::MutexLock lock(&m_peer_stub_mtx_);
+  auto it = m_peer_stub_map_.find(craned_id);
+  if (it != m_peer_stub_map_.end()) return it->second;
+
+  std::shared_ptr<Channel> channel;
+  if (g_config.ListenConf.UseTls)
+    channel = CreateTcpTlsChannelByHostname(
+        craned_id, g_config.ListenConf.CranedListenPort,
+        g_config.ListenConf.TlsCerts);
+  else
+    channel = CreateTcpInsecureChannel(craned_id,
+                                       g_config.ListenConf.CranedListenPort);
+
+  if (!channel) {
+    CRANE_ERROR("Failed to create channel to {}.", craned_id);
+    return nullptr;
+  }
+
+  std::shared_ptr<crane::grpc::Craned::Stub> stub =
+      crane::grpc::Craned::NewStub(channel);
+  m_peer_stub_map_.emplace(craned_id, stub);
+  return stub;
+}
+
 CranedServer::CranedServer(const Config::CranedListenConf &listen_conf) {
   m_service_impl_ = std::make_unique<CranedServiceImpl>();
 
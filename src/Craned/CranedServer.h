@@ -24,6 +24,7 @@
 #include "TaskManager.h"
 #include "crane/Lock.h"
 #include "crane/PublicHeader.h"
+#include "crane/RelayTree.h"
 #include "protos/Crane.grpc.pb.h"
 #include "protos/Crane.pb.h"
 
@@ -104,6 +105,25 @@ class CranedServiceImpl : public Craned::Service {
       grpc::ServerContext *context,
       const ::crane::grpc::QueryCranedRemoteMetaRequest *request,
       crane::grpc::QueryCranedRemoteMetaReply *response) override;
+
+  grpc::Status QueryTaskResourceUsage(
+      grpc::ServerContext *context,
+      const ::crane::grpc::QueryTaskResourceUsageRequest *request,
+      crane::grpc::QueryTaskResourceUsageReply *response) override;
+
+  grpc::Status Relay(grpc::ServerContext *context,
+                     const crane::grpc::RelayRequest *request,
+                     crane::grpc::RelayReply *response) override;
+
+ private:
+  // Stubs of the other craneds in the cluster used for relaying. The
+  // channels reconnect by themselves, so the stubs are never evicted.
+  std::shared_ptr<crane::grpc::Craned::Stub> GetPeerCranedStub_(
+      const std::string &craned_id);
+
+  absl::Mutex m_peer_stub_mtx_;
+  absl::flat_hash_map<std::string, std::shared_ptr<crane::grpc::Craned::Stub>>
+      m_peer_stub_map_ ABSL_GUARDED_BY(m_peer_stub_mtx_);
 };
 
 class CranedServer {
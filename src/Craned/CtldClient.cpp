@@ -125,6 +125,7 @@ void CtldClient::AsyncSendThread_() {
       &m_task_status_change_list_);
 
   bool prev_conn_state = false;
+  absl::Duration retry_backoff = absl::ZeroDuration();
   while (true) {
     if (m_thread_stop_) break;
 
@@ -144,61 +145,149 @@ void CtldClient::AsyncSendThread_() {
 
     bool has_msg = m_task_status_change_mtx_.LockWhenWithTimeout(
         cond, absl::Milliseconds(50));
-    if (!has_msg) {
-      m_task_status_change_mtx_.Unlock();
-      continue;
-    }
+    m_task_status_change_mtx_.Unlock();
+    if (!has_msg) continue;
+
+    // Tasks on a node often end at the same time. Wait for a short window
+    // to coalesce their status changes into one RPC. After a failed round,
+    // wait for the backoff instead so that rejected changes are not resent
+    // in a tight loop.
+    if (retry_backoff == absl::ZeroDuration())
+      std::this_thread::sleep_for(
+          std::chrono::milliseconds(kTaskStatusChangeBatchWindowMs));
+    else
+      std::this_thread::sleep_for(absl::ToChronoMilliseconds(retry_backoff));
 
     std::list<TaskStatusChange> changes;
+    m_task_status_change_mtx_.Lock();
     changes.splice(changes.begin(), std::move(m_task_status_change_list_));
     m_task_status_change_mtx_.Unlock();
 
-    while (!changes.empty()) {
-      grpc::ClientContext context;
-      crane::grpc::TaskStatusChangeRequest request;
-      crane::grpc::TaskStatusChangeReply reply;
-      grpc::Status status;
+    SendTaskStatusChanges_(&changes);
+
+    if (changes.empty()) {
+      retry_backoff = absl::ZeroDuration();
+      continue;
+    }
+
+    retry_backoff = std::clamp(
+        retry_backoff * 2,
+        absl::Milliseconds(kTaskStatusChangeRetryMinBackoffMs),
+        absl::Milliseconds(kTaskStatusChangeRetryMaxBackoffMs));
+    CRANE_TRACE("{} task status change(s) will be resent in {}.",
+                changes.size(), absl::FormatDuration(retry_backoff));
+
+    // Put the changes which are not sent or not acked back into
+    // m_task_status_change_list_ before the newer ones.
+    m_task_status_change_mtx_.Lock();
+    m_task_status_change_list_.splice(m_task_status_change_list_.begin(),
+                                      std::move(changes));
+    m_task_status_change_mtx_.Unlock();
+  }
+}
 
-      auto status_change = changes.front();
+void CtldClient::SendTaskStatusChanges_(std::list<TaskStatusChange>* changes) {
+  std::list<TaskStatusChange> unacked;
 
-      CRANE_TRACE("Sending TaskStatusChange for task #{}",
-                  status_change.task_id);
+  while (!changes->empty()) {
+    if (m_batch_rpc_unimplemented_) {
+      if (!SendTaskStatusChange_(changes->front())) break;
+      changes->pop_front();
+      continue;
+    }
 
-      request.set_craned_id(m_craned_id_);
-      request.set_task_id(status_change.task_id);
-      request.set_new_status(status_change.new_status);
-      request.set_exit_code(status_change.exit_code);
+    grpc::ClientContext context;
+    crane::grpc::TaskStatusChangeBatchRequest request;
+    crane::grpc::TaskStatusChangeBatchReply reply;
+    grpc::Status status;
+
+    std::list<TaskStatusChange> batch;
+    auto batch_end = changes->begin();
+    for (uint32_t i = 0;
+         i < kTaskStatusChangeBatchMaxSize && batch_end != changes->end(); ++i)
+      ++batch_end;
+    batch.splice(batch.begin(), *changes, changes->begin(), batch_end);
+
+    request.set_craned_id(m_craned_id_);
+    for (const TaskStatusChange& status_change : batch) {
+      auto* change = request.add_changes();
+      change->set_task_id(status_change.task_id);
+      change->set_craned_id(m_craned_id_);
+      change->set_new_status(status_change.new_status);
+      change->set_exit_code(status_change.exit_code);
       if (status_change.reason.has_value())
-        request.set_reason(status_change.reason.value());
-
-      status = m_stub_->TaskStatusChange(&context, request, &reply);
-      if (!status.ok()) {
-        CRANE_ERROR(
-            "Failed to send TaskStatusChange: "
-            "{{TaskId: {}, NewStatus: {}}}, reason: {} | {}, code: {}",
-            status_change.task_id, int(status_change.new_status),
-            status.error_message(), context.debug_error_string(),
-            int(status.error_code()));
-
-        if (status.error_code() == grpc::UNAVAILABLE) {
-          // If some messages are not sent due to channel failure,
-          // put them back into m_task_status_change_list_
-          if (!changes.empty()) {
-            m_task_status_change_mtx_.Lock();
-            m_task_status_change_list_.splice(
-                m_task_status_change_list_.begin(), std::move(changes));
-            m_task_status_change_mtx_.Unlock();
-          }
-          break;
-        } else
-          changes.pop_front();
-      } else {
-        CRANE_TRACE("TaskStatusChange for task #{} sent. reply.ok={}",
-                    status_change.task_id, reply.ok());
-        changes.pop_front();
+        change->set_reason(status_change.reason.value());
+      *change->mutable_resource_usage() = status_change.resource_usage;
+    }
+
+    CRANE_TRACE("Sending TaskStatusChangeBatch for {} task(s)", batch.size());
+
+    status = m_stub_->TaskStatusChangeBatch(&context, request, &reply);
+    if (!status.ok()) {
+      changes->splice(changes->begin(), std::move(batch));
+
+      if (status.error_code() == grpc::UNIMPLEMENTED) {
+        // CraneCtld is older than this craned. Send the changes one by one.
+        CRANE_WARN(
+            "CraneCtld does not implement TaskStatusChangeBatch. "
+            "Falling back to TaskStatusChange.");
+        m_batch_rpc_unimplemented_ = true;
+        continue;
       }
+
+      CRANE_ERROR(
+          "Failed to send TaskStatusChangeBatch of {} task(s), "
+          "reason: {} | {}, code: {}",
+          request.changes_size(), status.error_message(),
+          context.debug_error_string(), int(status.error_code()));
+      break;
     }
+
+    absl::flat_hash_set<task_id_t> acked_task_ids(
+        reply.acked_task_id_list().begin(), reply.acked_task_id_list().end());
+    batch.remove_if([&](const TaskStatusChange& change) {
+      return acked_task_ids.contains(change.task_id);
+    });
+
+    CRANE_TRACE("TaskStatusChangeBatch sent. {} acked, {} to be resent.",
+                acked_task_ids.size(), batch.size());
+
+    unacked.splice(unacked.end(), std::move(batch));
+  }
+
+  changes->splice(changes->begin(), std::move(unacked));
+}
+
+bool CtldClient::SendTaskStatusChange_(const TaskStatusChange& status_change) {
+  grpc::ClientContext context;
+  crane::grpc::TaskStatusChangeRequest request;
+  crane::grpc::TaskStatusChangeReply reply;
+  grpc::Status status;
+
+  CRANE_TRACE("Sending TaskStatusChange for task #{}", status_change.task_id);
+
+  request.set_craned_id(m_craned_id_);
+  request.set_task_id(status_change.task_id);
+  request.set_new_status(status_change.new_status);
+  request.set_exit_code(status_change.exit_code);
+  if (status_change.reason.has_value())
+    request.set_reason(status_change.reason.value());
+  *request.mutable_resource_usage() = status_change.resource_usage;
+
+  status = m_stub_->TaskStatusChange(&context, request, &reply);
+  if (!status.ok()) {
+    CRANE_ERROR(
+        "Failed to send TaskStatusChange: "
+        "{{TaskId: {}, NewStatus: {}}}, reason: {} | {}, code: {}",
+        status_change.task_id, int(status_change.new_status),
+        status.error_message(), context.debug_error_string(),
+        int(status.error_code()));
+    return false;
   }
+
+  CRANE_TRACE("TaskStatusChange for task #{} sent. reply.ok={}",
+              status_change.task_id, reply.ok());
+  return true;
 }
 
 }  // namespace Craned
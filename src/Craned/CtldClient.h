@@ -66,6 +66,13 @@ class CtldClient {
  private:
   void AsyncSendThread_();
 
+  // Send the changes in batches of at most kTaskStatusChangeBatchMaxSize.
+  // The changes which are not sent or not acked by CraneCtld are left in
+  // changes.
+  void SendTaskStatusChanges_(std::list<TaskStatusChange>* changes);
+
+  bool SendTaskStatusChange_(const TaskStatusChange& status_change);
+
   absl::Mutex m_task_status_change_mtx_;
 
   std::list<TaskStatusChange> m_task_status_change_list_
@@ -78,6 +85,10 @@ class CtldClient {
 
   std::unique_ptr<CraneCtld::Stub> m_stub_;
 
+  // Set when CraneCtld does not implement TaskStatusChangeBatch. Only
+  // accessed by m_async_send_thread_.
+  bool m_batch_rpc_unimplemented_{false};
+
   CranedId m_craned_id_;
 
   absl::Notification m_start_connecting_notification_;
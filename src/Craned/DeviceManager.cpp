@@ -45,6 +45,10 @@ bool BasicDevice::Init() {
     device_meta.minor = std::get<1>(device_major_minor_optype);
     device_meta.op_type = std::get<2>(device_major_minor_optype);
   }
+
+  if (!device_metas.empty())
+    DeviceManager::ReadDeviceAffinityFromSysfs(device_metas.front(),
+                                               &affinity);
   return true;
 }
 
@@ -74,6 +78,46 @@ DeviceManager::GetDeviceFileMajorMinorOpType(const std::string& path) {
   }
 }
 
+void DeviceManager::ReadDeviceAffinityFromSysfs(
+    const BasicDevice::DeviceMeta& meta, SlotAffinity* affinity,
+    const std::string& sysfs_dev_dir) {
+  if (meta.op_type != 'c' && meta.op_type != 'b') return;
+
+  std::error_code ec;
+  std::filesystem::path device_dir = std::filesystem::canonical(
+      fmt::format("{}/{}/{}:{}/device", sysfs_dev_dir,
+                  meta.op_type == 'c' ? "char" : "block", meta.major,
+                  meta.minor),
+      ec);
+  if (ec) return;
+
+  if (affinity->numa_node == -1) {
+    std::ifstream numa_node_file(device_dir / "numa_node");
+    int32_t numa_node;
+    if (numa_node_file >> numa_node && numa_node >= 0)
+      affinity->numa_node = numa_node;
+  }
+
+  // e.g. /sys/devices/pci0000:00/0000:00:01.0/0000:01:00.0/0000:02:08.0/
+  // 0000:03:00.0, where 0000:00:01.0 is the root port and 0000:01:00.0 is
+  // the upstream port of the switch.
+  if (affinity->pcie_switch.empty() &&
+      std::filesystem::exists(device_dir / "subsystem_vendor")) {
+    std::vector<std::string> pci_ports;
+    for (const auto& component : device_dir.parent_path()) {
+      std::string name = component.string();
+      if (name.starts_with("pci"))
+        pci_ports.clear();
+      else if (std::ranges::count(name, ':') == 2)
+        pci_ports.emplace_back(std::move(name));
+    }
+    if (pci_ports.size() >= 2)
+      affinity->pcie_switch = pci_ports[1];
+    else if (!pci_ports.empty())
+      affinity->pcie_switch = pci_ports[0];
+  }
+}
+
 std::unique_ptr<BasicDevice> DeviceManager::ConstructDevice(
     const std::string& device_name, const std::string& device_type,
     const std::vector<std::string>& device_path,
@@ -39,6 +39,9 @@ struct BasicDevice {
   };
   std::vector<DeviceMeta> device_metas;
 
+  // Given in config, or read from sysfs by Init() if not given.
+  SlotAffinity affinity;
+
   BasicDevice(const std::string& device_name, const std::string& device_type,
               const std::vector<std::string>& device_path,
               const std::string& env_injector);
@@ -63,6 +66,17 @@ class DeviceManager {
   static std::optional<std::tuple<unsigned int, unsigned int, char>>
   GetDeviceFileMajorMinorOpType(const std::string& path);
 
+  /**
+   * Read the NUMA node and the PCIe switch of a device file from
+   * <sysfs_dev_dir>/{char,block}/<major>:<minor>/device. The PCIe switch is
+   * named by the PCI address of the upstream port of the switch above the
+   * device, or of the root port if there is no switch.
+   * Unknown fields are left unchanged.
+   */
+  static void ReadDeviceAffinityFromSysfs(
+      const BasicDevice::DeviceMeta& meta, SlotAffinity* affinity,
+      const std::string& sysfs_dev_dir = "/sys/dev");
+
   static std::vector<std::pair<std::string, std::string>>
   GetDevEnvListByResInNode(
       const crane::grpc::DedicatedResourceInNode& res_in_node);
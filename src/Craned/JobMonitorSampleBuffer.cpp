@@ -0,0 +1,56 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+
+#include "JobMonitorSampleBuffer.h"
+
+namespace Craned {
+
+std::optional<crane::grpc::plugin::JobMonitorSamplesRequest>
+JobMonitorSampleBuffer::AddSamples(absl::Time now,
+                                   absl::Duration push_interval,
+                                   const UsageMap& usage_map) {
+  if (m_last_push_time_ == absl::InfinitePast()) m_last_push_time_ = now;
+
+  int64_t sample_time = absl::ToUnixSeconds(now);
+  for (const auto& [task_id, usage] : usage_map) {
+    auto [it, inserted] = m_series_map_.try_emplace(task_id);
+    if (inserted) {
+      it->second = m_samples_.add_series_list();
+      it->second->set_task_id(task_id);
+    }
+
+    crane::grpc::plugin::JobUsageSeries* series = it->second;
+    series->add_sample_time(sample_time);
+    series->add_cpu_time_usec(usage.cpu_time_usec());
+    series->add_mem_current_bytes(usage.mem_current_bytes());
+    series->add_mem_peak_bytes(usage.mem_peak_bytes());
+    series->add_io_read_bytes(usage.io_read_bytes());
+    series->add_io_write_bytes(usage.io_write_bytes());
+  }
+
+  if (now - m_last_push_time_ < push_interval) return std::nullopt;
+  m_last_push_time_ = now;
+
+  std::optional<crane::grpc::plugin::JobMonitorSamplesRequest> samples;
+  if (m_samples_.series_list_size() > 0) samples = std::move(m_samples_);
+
+  m_samples_.Clear();
+  m_series_map_.clear();
+  return samples;
+}
+
+}  // namespace Craned
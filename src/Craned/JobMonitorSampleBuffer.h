@@ -0,0 +1,55 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+
+#pragma once
+
+#include "CranedPublicDefs.h"
+// Precompiled header comes first.
+
+#include "protos/Plugin.pb.h"
+
+namespace Craned {
+
+/**
+ * Accumulates the periodic resource usage samples of tasks into one series
+ * per task, in which the i-th elements of all columns form the i-th sample,
+ * and hands them out for pushing to plugind every push interval.
+ * Not thread-safe.
+ */
+class JobMonitorSampleBuffer {
+ public:
+  using UsageMap =
+      std::unordered_map<task_id_t, crane::grpc::TaskResourceUsage>;
+
+  /**
+   * Append one sample taken at now for each task in usage_map.
+   * @return the samples accumulated since the last push if push_interval
+   * has passed since then, which are removed from the buffer. std::nullopt
+   * if it is not time to push yet or there is no sample. The push interval
+   * starts with the first sample.
+   */
+  std::optional<crane::grpc::plugin::JobMonitorSamplesRequest> AddSamples(
+      absl::Time now, absl::Duration push_interval, const UsageMap& usage_map);
+
+ private:
+  crane::grpc::plugin::JobMonitorSamplesRequest m_samples_;
+  absl::flat_hash_map<task_id_t, crane::grpc::plugin::JobUsageSeries*>
+      m_series_map_;
+  absl::Time m_last_push_time_{absl::InfinitePast()};
+};
+
+}  // namespace Craned
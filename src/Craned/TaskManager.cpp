@@ -17,17 +17,97 @@
 #include "TaskManager.h"
 
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
 #include <google/protobuf/io/zero_copy_stream_impl.h>
 #include <google/protobuf/util/delimited_message_util.h>
 
 #include "CforedClient.h"
 #include "CgroupManager.h"
+#include "Zygote.h"
 #include "crane/OS.h"
+#include "crane/PluginClient.h"
 #include "protos/CraneSubprocess.pb.h"
 #include "protos/PublicDefs.pb.h"
 
 namespace Craned {
 
+namespace {
+
+#ifndef SYS_pidfd_open
+#  define SYS_pidfd_open 434
+#endif
+
+// P_PIDFD is only declared by glibc 2.36+.
+constexpr idtype_t kIdTypePidfd = static_cast<idtype_t>(3);
+
+int PidfdOpen(pid_t pid) {
+  return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+}
+
+// pidfd_open() is available since Linux 5.3 but waitid(P_PIDFD) only since
+// 5.4, which fails with EINVAL before. Craned is not its own child, so a
+// supported waitid() fails with ECHILD here.
+bool PidfdSupported() {
+  int fd = PidfdOpen(getpid());
+  if (fd == -1) return false;
+
+  siginfo_t si{};
+  int rc = waitid(kIdTypePidfd, fd, &si, WEXITED | WNOHANG);
+  int err = errno;
+  close(fd);
+  if (rc == -1 && err == EINVAL) {
+    errno = EINVAL;
+    return false;
+  }
+  return true;
+}
+
+// Reap the exited process referred by pidfd.
+bool ReapByPidfd(int pidfd, ProcSigchldInfo* info) {
+  siginfo_t si{};
+  int rc;
+  do {
+    rc = waitid(kIdTypePidfd, pidfd, &si, WEXITED | WNOHANG);
+  } while (rc == -1 && errno == EINTR);
+  if (rc == -1 || si.si_pid == 0) return false;
+
+  info->pid = si.si_pid;
+  info->is_terminated_by_signal = si.si_code != CLD_EXITED;
+  info->value = si.si_status;
+  return true;
+}
+
+// Write the script into a sealed memfd so that it can be read by the task
+// process without touching the file system. Return -1 on failure.
+int CreateScriptMemfd(task_id_t task_id, const std::string& script) {
+  std::string name = fmt::format("Crane-{}.sh", task_id);
+  int fd = memfd_create(name.c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd == -1) return -1;
+
+  size_t written = 0;
+  while (written < script.size()) {
+    ssize_t n = write(fd, script.data() + written, script.size() - written);
+    if (n == -1 && errno == EINTR) continue;
+    if (n <= 0) {
+      close(fd);
+      return -1;
+    }
+    written += n;
+  }
+
+  // The script can no longer be modified, even by the task itself.
+  if (fcntl(fd, F_ADD_SEALS,
+            F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) == -1) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+}  // namespace
+
 bool TaskInstance::IsCrun() const {
   return this->task.type() == crane::grpc::Interactive &&
          this->task.interactive_meta().interactive_type() == crane::grpc::Crun;
@@ -100,6 +180,28 @@ TaskManager::TaskManager() {
     CRANE_ERROR("Could not initialize libevent!");
     std::terminate();
   }
+  if (PidfdSupported()) {
+    m_use_pidfd_ = true;
+  } else {
+    CRANE_WARN("pidfd is not supported: {}. Reap processes by SIGCHLD.",
+               strerror(errno));
+  }
+
+  if (m_use_pidfd_ && g_zygote && g_zygote->Alive()) {
+    // The zygote is also a child of Craned and should be reaped.
+    m_zygote_pidfd_ = PidfdOpen(g_zygote->Pid());
+    if (m_zygote_pidfd_ == -1) {
+      CRANE_ERROR("Failed to open pidfd of the zygote: {}", strerror(errno));
+      std::terminate();
+    }
+    m_ev_zygote_pidfd_ = event_new(m_ev_base_, m_zygote_pidfd_, EV_READ,
+                                   EvZygotePidfdCb_, this);
+    if (!m_ev_zygote_pidfd_ || event_add(m_ev_zygote_pidfd_, nullptr) < 0) {
+      CRANE_ERROR("Could not add the zygote pidfd event to base!");
+      std::terminate();
+    }
+  }
+
   {  // SIGCHLD
     m_ev_sigchld_ = evsignal_new(m_ev_base_, SIGCHLD, EvSigchldCb_, this);
     if (!m_ev_sigchld_) {
@@ -238,6 +340,33 @@ TaskManager::TaskManager() {
       std::terminate();
     }
   }
+  if (g_config.TaskUsageSampleIntervalSec > 0) {
+    m_ev_sample_task_usage_ =
+        event_new(m_ev_base_, -1, EV_PERSIST, EvSampleTaskUsageCb_, this);
+    if (!m_ev_sample_task_usage_) {
+      CRANE_ERROR("Failed to create the sample_task_usage event!");
+      std::terminate();
+    }
+    timeval tv{.tv_sec = g_config.TaskUsageSampleIntervalSec, .tv_usec = 0};
+    if (event_add(m_ev_sample_task_usage_, &tv) < 0) {
+      CRANE_ERROR("Could not add the m_ev_sample_task_usage_ to base!");
+      std::terminate();
+    }
+    m_last_job_monitor_push_time_ = absl::Now();
+  }
+  if (int fd = g_cg_mgr->GetTeardownEventFd(); fd != -1) {
+    m_ev_cgroup_teardown_ = event_new(m_ev_base_, fd, EV_READ | EV_PERSIST,
+                                      EvCgroupTeardownCb_, this);
+    if (!m_ev_cgroup_teardown_) {
+      CRANE_ERROR("Failed to create the cgroup teardown event!");
+      std::terminate();
+    }
+    timeval tv = absl::ToTimeval(CgroupConstant::kCgroupTeardownRetryInterval);
+    if (event_add(m_ev_cgroup_teardown_, &tv) < 0) {
+      CRANE_ERROR("Could not add the m_ev_cgroup_teardown_ to base!");
+      std::terminate();
+    }
+  }
 
   m_ev_loop_thread_ =
       std::thread([this]() { event_base_dispatch(m_ev_base_); });
@@ -247,6 +376,9 @@ TaskManager::~TaskManager() {
   if (m_ev_loop_thread_.joinable()) m_ev_loop_thread_.join();
 
   if (m_ev_sigchld_) event_free(m_ev_sigchld_);
+  if (m_ev_process_sigchld_) event_free(m_ev_process_sigchld_);
+  if (m_ev_zygote_pidfd_) event_free(m_ev_zygote_pidfd_);
+  if (m_zygote_pidfd_ != -1) close(m_zygote_pidfd_);
   if (m_ev_sigint_) event_free(m_ev_sigint_);
 
   if (m_ev_query_task_id_from_pid_) event_free(m_ev_query_task_id_from_pid_);
@@ -258,6 +390,8 @@ TaskManager::~TaskManager() {
   if (m_ev_task_time_limit_change_) event_free(m_ev_task_time_limit_change_);
   if (m_ev_task_terminate_) event_free(m_ev_task_terminate_);
   if (m_ev_check_task_status_) event_free(m_ev_check_task_status_);
+  if (m_ev_cgroup_teardown_) event_free(m_ev_cgroup_teardown_);
+  if (m_ev_sample_task_usage_) event_free(m_ev_sample_task_usage_);
 
   if (m_ev_base_) event_base_free(m_ev_base_);
 }
@@ -335,6 +469,13 @@ void TaskManager::EvSigchldCb_(evutil_socket_t sig, short events,
   assert(m_instance_ptr_->m_instance_ptr_ != nullptr);
   auto* this_ = reinterpret_cast<TaskManager*>(user_data);
 
+  if (this_->m_use_pidfd_) {
+    this_->ReapUnwatchedChildren_();
+    if (this_->m_is_ending_now_ && this_->m_task_map_.empty())
+      this_->EvActivateShutdown_();
+    return;
+  }
+
   int status;
   pid_t pid;
   while (true) {
@@ -342,6 +483,8 @@ void TaskManager::EvSigchldCb_(evutil_socket_t sig, short events,
                   /* TODO(More status tracing): | WUNTRACED | WCONTINUED */);
 
     if (pid > 0) {
+      if (g_zygote && g_zygote->CheckAndMarkExited(pid)) continue;
+
       auto sigchld_info = std::make_unique<ProcSigchldInfo>();
 
       if (WIFEXITED(status)) {
@@ -428,7 +571,6 @@ void TaskManager::EvProcessSigchldCb_(int sig, short events, void* user_data) {
 
     TaskInstance* instance = task_iter->second;
     ProcessInstance* proc = proc_iter->second;
-    uint32_t task_id = instance->task.task_id();
 
     // Remove indexes from pid to ProcessInstance*
     this_->m_pid_proc_map_.erase(proc_iter);
@@ -436,38 +578,163 @@ void TaskManager::EvProcessSigchldCb_(int sig, short events, void* user_data) {
 
     this_->m_mtx_.Unlock();
 
-    instance->sigchld_info = *sigchld_info;
-    proc->Finish(sigchld_info->is_terminated_by_signal, sigchld_info->value);
+    this_->EvOnProcessExit_(instance, proc, *sigchld_info);
+  }
+}
 
-    // Free the ProcessInstance. ITask struct is not freed here because
-    // the ITask for an Interactive task can have no ProcessInstance.
-    auto pr_it = instance->processes.find(pid);
-    if (pr_it == instance->processes.end()) {
-      CRANE_ERROR("Failed to find pid {} in task #{}'s ProcessInstances", pid,
-                  task_id);
-    } else {
-      instance->processes.erase(pr_it);
+void TaskManager::EvPidfdCb_(int pidfd, short events, void* user_data) {
+  auto* this_ = m_instance_ptr_;
+  auto* proc = reinterpret_cast<ProcessInstance*>(user_data);
+  pid_t pid = proc->GetPid();
 
-      if (!instance->processes.empty()) {
-        if (sigchld_info->is_terminated_by_signal) {
-          // If a task is terminated by a signal and there are other
-          //  running processes belonging to this task, kill them.
-          this_->TerminateTaskAsync(task_id);
-        }
-      } else {
-        if (instance->IsCrun())
-          // TaskStatusChange of a crun task is triggered in
-          // CforedManager.
-          g_cfored_manager->TaskProcOnCforedStopped(
-              instance->task.interactive_meta().cfored_name(),
-              instance->task.task_id());
-        else /* Batch / Calloc */ {
-          // If the ProcessInstance has no process left,
-          // send TaskStatusChange for this task.
-          // See the comment of EvActivateTaskStatusChange_.
-          this_->TaskStopAndDoStatusChangeAsync(task_id);
-        }
-      }
+  ProcSigchldInfo sigchld_info{};
+  if (!ReapByPidfd(pidfd, &sigchld_info)) {
+    CRANE_ERROR("Failed to reap pid {} by pidfd: {}", pid, strerror(errno));
+    return;
+  }
+  CRANE_TRACE("Process {} exited. Signaled: {}, Value: {}", pid,
+              sigchld_info.is_terminated_by_signal, sigchld_info.value);
+
+  // The pidfd event is added after the pid is put into the index maps, so
+  // the pid is always found here.
+  TaskInstance* instance;
+  {
+    absl::MutexLock lock_guard(&this_->m_mtx_);
+    auto task_iter = this_->m_pid_task_map_.find(pid);
+    auto proc_iter = this_->m_pid_proc_map_.find(pid);
+    if (task_iter == this_->m_pid_task_map_.end() ||
+        proc_iter == this_->m_pid_proc_map_.end()) {
+      CRANE_ERROR("Exited pid {} is not in the index maps.", pid);
+      return;
+    }
+    instance = task_iter->second;
+    this_->m_pid_proc_map_.erase(proc_iter);
+    this_->m_pid_task_map_.erase(task_iter);
+  }
+
+  this_->EvOnProcessExit_(instance, proc, sigchld_info);
+
+  // An unwatched child which exited after this one is not reaped on its
+  // SIGCHLD since this one was the first zombie.
+  this_->ReapUnwatchedChildren_();
+
+  if (this_->m_is_ending_now_ && this_->m_task_map_.empty())
+    this_->EvActivateShutdown_();
+}
+
+void TaskManager::EvZygotePidfdCb_(int pidfd, short events, void* user_data) {
+  auto* this_ = reinterpret_cast<TaskManager*>(user_data);
+
+  ProcSigchldInfo sigchld_info{};
+  if (ReapByPidfd(pidfd, &sigchld_info))
+    g_zygote->CheckAndMarkExited(sigchld_info.pid);
+
+  this_->ReapUnwatchedChildren_();
+}
+
+void TaskManager::ReapUnwatchedChildren_() {
+  while (true) {
+    // Peek at an exited child without reaping it.
+    siginfo_t si{};
+    int rc;
+    do {
+      rc = waitid(P_ALL, 0, &si, WEXITED | WNOHANG | WNOWAIT);
+    } while (rc == -1 && errno == EINTR);
+    if (rc == -1 || si.si_pid == 0) break;
+
+    pid_t pid = si.si_pid;
+    // The zygote is reaped by its own pidfd event.
+    if (m_zygote_pidfd_ != -1 && pid == g_zygote->Pid()) break;
+
+    {
+      // WatchProcessExit_() holds m_mtx_, so a child is either watched
+      // before this check or reaped here before its pidfd is opened.
+      absl::MutexLock lock_guard(&m_mtx_);
+      auto proc_iter = m_pid_proc_map_.find(pid);
+      // The first exited child is reaped by its pidfd event, which calls
+      // this function again.
+      if (proc_iter != m_pid_proc_map_.end() &&
+          proc_iter->second->GetPidfd() != -1)
+        break;
+
+      do {
+        rc = waitid(P_PID, pid, &si, WEXITED | WNOHANG);
+      } while (rc == -1 && errno == EINTR);
+    }
+    if (rc == -1 || si.si_pid == 0) break;
+
+    if (g_zygote && g_zygote->CheckAndMarkExited(pid)) continue;
+
+    CRANE_TRACE("Reaped pid {} not watched by pidfd. Signaled: {}, Value: {}",
+                pid, si.si_code != CLD_EXITED, si.si_status);
+
+    // Handled as on SIGCHLD, including resending the exit status by a timer
+    // if the pid is not yet in the index maps.
+    auto sigchld_info = std::make_unique<ProcSigchldInfo>();
+    sigchld_info->pid = pid;
+    sigchld_info->is_terminated_by_signal = si.si_code != CLD_EXITED;
+    sigchld_info->value = si.si_status;
+    m_sigchld_queue_.enqueue(std::move(sigchld_info));
+    event_active(m_ev_process_sigchld_, 0, 0);
+  }
+}
+
+bool TaskManager::WatchProcessExit_(ProcessInstance* process) {
+  int pidfd = PidfdOpen(process->GetPid());
+  if (pidfd == -1) {
+    CRANE_ERROR("Failed to open pidfd of pid {}: {}", process->GetPid(),
+                strerror(errno));
+    return false;
+  }
+
+  struct event* ev = event_new(m_ev_base_, pidfd, EV_READ, EvPidfdCb_, process);
+  if (!ev || event_add(ev, nullptr) < 0) {
+    CRANE_ERROR("Failed to add the pidfd event of pid {}.", process->GetPid());
+    if (ev) event_free(ev);
+    close(pidfd);
+    return false;
+  }
+  process->SetPidfd(pidfd, ev);
+  return true;
+}
+
+void TaskManager::EvOnProcessExit_(TaskInstance* instance,
+                                   ProcessInstance* proc,
+                                   const ProcSigchldInfo& sigchld_info) {
+  pid_t pid = proc->GetPid();
+  uint32_t task_id = instance->task.task_id();
+
+  instance->sigchld_info = sigchld_info;
+  proc->Finish(sigchld_info.is_terminated_by_signal, sigchld_info.value);
+
+  // Free the ProcessInstance. ITask struct is not freed here because
+  // the ITask for an Interactive task can have no ProcessInstance.
+  auto pr_it = instance->processes.find(pid);
+  if (pr_it == instance->processes.end()) {
+    CRANE_ERROR("Failed to find pid {} in task #{}'s ProcessInstances", pid,
+                task_id);
+    return;
+  }
+  instance->processes.erase(pr_it);
+
+  if (!instance->processes.empty()) {
+    if (sigchld_info.is_terminated_by_signal) {
+      // If a task is terminated by a signal and there are other
+      //  running processes belonging to this task, kill them.
+      TerminateTaskAsync(task_id);
+    }
+  } else {
+    if (instance->IsCrun())
+      // TaskStatusChange of a crun task is triggered in
+      // CforedManager.
+      g_cfored_manager->TaskProcOnCforedStopped(
+          instance->task.interactive_meta().cfored_name(),
+          instance->task.task_id());
+    else /* Batch / Calloc */ {
+      // If the ProcessInstance has no process left,
+      // send TaskStatusChange for this task.
+      // See the comment of EvActivateTaskStatusChange_.
+      TaskStopAndDoStatusChangeAsync(task_id);
     }
   }
 }
@@ -619,6 +886,9 @@ CraneErr TaskManager::SpawnProcessInInstance_(TaskInstance* instance,
   using crane::grpc::subprocess::CanStartMessage;
   using crane::grpc::subprocess::ChildProcessReady;
 
+  if (g_zygote && g_zygote->Alive())
+    return SpawnProcessByZygote_(instance, process);
+
   int ctrl_sock_pair[2];    // Socket pair for passing control messages.
   int io_in_sock_pair[2];   // Socket pair for forwarding IO of crun tasks.
   int io_out_sock_pair[2];  // Socket pair for forwarding IO of crun tasks.
@@ -637,6 +907,8 @@ CraneErr TaskManager::SpawnProcessInInstance_(TaskInstance* instance,
                 instance->task.task_id());
     return CraneErr::kCgroupError;
   }
+  std::vector<EnvPair> cpuset_env_vec =
+      g_cg_mgr->GetCpusetEnvListOfTask(instance->task.task_id());
 
   if (socketpair(AF_UNIX, SOCK_STREAM, 0, ctrl_sock_pair) != 0) {
     CRANE_ERROR("Failed to create socket pair: {}", strerror(errno));
@@ -909,7 +1181,16 @@ CraneErr TaskManager::SpawnProcessInInstance_(TaskInstance* instance,
     // If these file descriptors are not closed, a program like mpirun may
     // keep waiting for the input from stdin or other fds and will never end.
     if (instance->task.type() == crane::grpc::Batch) close(0);
-    util::os::CloseFdFrom(3);
+    if (instance->meta->script_memfd != -1) {
+      if (!InstallTaskScriptFd(instance->meta->script_memfd)) {
+        fmt::print(stderr, "[Craned Subprocess Error] Failed to install the "
+                   "script memfd: {}\n", strerror(errno));
+        std::abort();
+      }
+      util::os::CloseFdFrom(kTaskScriptFd + 1);
+    } else {
+      util::os::CloseFdFrom(3);
+    }
 
     std::vector<EnvPair> task_env_vec = instance->GetTaskEnvList();
     std::vector<EnvPair> res_env_vec =
@@ -927,6 +1208,7 @@ CraneErr TaskManager::SpawnProcessInInstance_(TaskInstance* instance,
 
     FuncSetEnv(task_env_vec);
     FuncSetEnv(res_env_vec);
+    FuncSetEnv(cpuset_env_vec);
 
     // Prepare the command line arguments.
     std::vector<const char*> argv;
@@ -959,6 +1241,146 @@ CraneErr TaskManager::SpawnProcessInInstance_(TaskInstance* instance,
   }
 }
 
+CraneErr TaskManager::SpawnProcessByZygote_(TaskInstance* instance,
+                                            ProcessInstance* process) {
+  using crane::grpc::subprocess::ZygoteSpawnReply;
+  using crane::grpc::subprocess::ZygoteSpawnRequest;
+
+  task_id_t task_id = instance->task.task_id();
+
+  std::optional<crane::grpc::ResourceInNode> res_in_node =
+      g_cg_mgr->GetTaskResourceInNode(task_id);
+  if (!res_in_node.has_value()) {
+    CRANE_ERROR("Failed to get resource info for task #{}", task_id);
+    return CraneErr::kCgroupError;
+  }
+
+  ZygoteSpawnRequest request;
+  request.set_task_id(task_id);
+  request.set_uid(instance->pwd_entry.Uid());
+  request.set_gid(instance->pwd_entry.Gid());
+  request.set_cwd(instance->task.cwd());
+
+  request.set_exec_path("/bin/bash");
+  // Argv[0] is the program name which can be anything.
+  request.add_argv("CraneScript");
+  // Load settings of the user by bash --login if --get-user-env is set.
+  if (instance->task.get_user_env()) request.add_argv("--login");
+  request.add_argv(process->GetExecPath());
+  for (const auto& arg : process->GetArgList()) request.add_argv(arg);
+
+  auto FuncAddEnv = [&request](const std::vector<EnvPair>& v) {
+    for (const auto& [name, value] : v) {
+      auto* env = request.add_env();
+      env->set_name(name);
+      env->set_value(value);
+    }
+  };
+  FuncAddEnv(instance->GetTaskEnvList());
+  FuncAddEnv(CgroupManager::GetResourceEnvListByResInNode(res_in_node.value()));
+  FuncAddEnv(g_cg_mgr->GetCpusetEnvListOfTask(task_id));
+
+  std::vector<int> fds;
+
+  int cgroup_fd = -1;
+  if (g_cg_mgr->GetCgroupVersion() ==
+      CgroupConstant::CgroupVersion::CGROUP_V2) {
+    std::string cg_dir = fmt::format("{}/{}", CgroupConstant::RootCgroupFullPath,
+                                     instance->cgroup->GetCgroupString());
+    cgroup_fd = open(cg_dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (cgroup_fd == -1) {
+      CRANE_ERROR("Failed to open cgroup directory {} of task #{}: {}", cg_dir,
+                  task_id, strerror(errno));
+      return CraneErr::kCgroupError;
+    }
+    request.set_has_cgroup_fd(true);
+    fds.push_back(cgroup_fd);
+  } else {
+    request.set_cgroup_path(instance->cgroup->GetCgroupString());
+  }
+
+  int io_in_sock_pair[2];   // Socket pair for forwarding IO of crun tasks.
+  int io_out_sock_pair[2];  // Socket pair for forwarding IO of crun tasks.
+
+  if (instance->task.type() == crane::grpc::Batch) {
+    request.set_stdout_file(process->batch_meta.parsed_output_file_pattern);
+    request.set_stderr_file(process->batch_meta.parsed_error_file_pattern);
+    request.set_close_stdin(true);
+  } else if (instance->IsCrun()) {
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, io_in_sock_pair) !=
+        0) {
+      CRANE_ERROR("Failed to create socket pair for task io forward: {}",
+                  strerror(errno));
+      if (cgroup_fd != -1) close(cgroup_fd);
+      return CraneErr::kSystemErr;
+    }
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, io_out_sock_pair) !=
+        0) {
+      CRANE_ERROR("Failed to create socket pair for task io forward: {}",
+                  strerror(errno));
+      close(io_in_sock_pair[0]);
+      close(io_in_sock_pair[1]);
+      if (cgroup_fd != -1) close(cgroup_fd);
+      return CraneErr::kSystemErr;
+    }
+
+    request.set_has_io_fds(true);
+    fds.push_back(io_in_sock_pair[1]);
+    fds.push_back(io_out_sock_pair[1]);
+  }
+
+  if (instance->meta->script_memfd != -1) {
+    request.set_has_script_fd(true);
+    fds.push_back(instance->meta->script_memfd);
+  }
+
+  ZygoteSpawnReply reply;
+  CraneErr err = g_zygote->Spawn(request, fds, &reply);
+
+  // The zygote holds its own copies of these fds.
+  if (cgroup_fd != -1) close(cgroup_fd);
+  if (instance->IsCrun()) {
+    close(io_in_sock_pair[1]);
+    close(io_out_sock_pair[1]);
+  }
+
+  if (err != CraneErr::kOk || !reply.ok()) {
+    CRANE_ERROR("Zygote failed to spawn the process of task #{}: {}", task_id,
+                err != CraneErr::kOk ? CraneErrStr(err) : reply.reason());
+    if (instance->IsCrun()) {
+      close(io_in_sock_pair[0]);
+      close(io_out_sock_pair[0]);
+    }
+    return err != CraneErr::kOk ? err : CraneErr::kSystemErr;
+  }
+
+  pid_t child_pid = reply.pid();
+  process->SetPid(child_pid);
+  CRANE_DEBUG("Subprocess was created by zygote for task #{} pid: {}", task_id,
+              child_pid);
+
+  if (instance->IsCrun()) {
+    auto* meta = dynamic_cast<CrunMetaInTaskInstance*>(instance->meta.get());
+    meta->proc_in_fd = io_in_sock_pair[0];
+    meta->proc_out_fd = io_out_sock_pair[0];
+    g_cfored_manager->RegisterIOForward(
+        instance->task.interactive_meta().cfored_name(), task_id,
+        meta->proc_in_fd, meta->proc_out_fd);
+  }
+
+  if (reply.failed_before_exec()) {
+    // The child is terminating itself by SIGABRT and will be reaped in the
+    // SIGCHLD handler. Just like the fork() path, return kOk so that only ONE
+    // TaskStatusChange is triggered.
+    CRANE_ERROR("Subprocess {} of task #{} failed before execv: {}", child_pid,
+                task_id, reply.reason());
+    if (reply.cgroup_error()) instance->err_before_exec = CraneErr::kCgroupError;
+  }
+
+  return CraneErr::kOk;
+}
+
 CraneErr TaskManager::ExecuteTaskAsync(crane::grpc::TaskToD const& task) {
   if (!g_cg_mgr->CheckIfCgroupForTasksExists(task.task_id())) {
     CRANE_DEBUG("Executing task #{} without an allocated cgroup. Ignoring it.",
@@ -1057,31 +1479,46 @@ void TaskManager::LaunchTaskInstanceMt_(TaskInstance* instance) {
   // Calloc tasks have no scripts to run. Just return.
   if (instance->IsCalloc()) return;
 
-  instance->meta->parsed_sh_script_path =
-      fmt::format("{}/Crane-{}.sh", g_config.CranedScriptDir, task_id);
-  auto& sh_path = instance->meta->parsed_sh_script_path;
+  const std::string& script =
+      instance->task.type() == crane::grpc::Batch
+          ? instance->task.batch_meta().sh_script()
+          : instance->task.interactive_meta().sh_script();
 
-  FILE* fptr = fopen(sh_path.c_str(), "w");
-  if (fptr == nullptr) {
-    CRANE_ERROR("Failed write the script for task #{}", task_id);
-    EvActivateTaskStatusChange_(
-        task_id, crane::grpc::TaskStatus::Failed,
-        ExitCode::kExitCodeFileNotFound,
-        fmt::format("Cannot write shell script for batch task #{}", task_id));
-    return;
+  std::string exec_path;
+  if (g_config.CranedScriptInMemfd) {
+    instance->meta->script_memfd = CreateScriptMemfd(task_id, script);
+    if (instance->meta->script_memfd != -1)
+      exec_path = fmt::format("/proc/self/fd/{}", kTaskScriptFd);
+    else
+      CRANE_WARN("Failed to create memfd for the script of task #{}: {}. "
+                 "Fall back to script file.",
+                 task_id, strerror(errno));
   }
 
-  if (instance->task.type() == crane::grpc::Batch)
-    fputs(instance->task.batch_meta().sh_script().c_str(), fptr);
-  else  // Crun
-    fputs(instance->task.interactive_meta().sh_script().c_str(), fptr);
+  if (exec_path.empty()) {
+    instance->meta->parsed_sh_script_path =
+        fmt::format("{}/Crane-{}.sh", g_config.CranedScriptDir, task_id);
+    auto& sh_path = instance->meta->parsed_sh_script_path;
+
+    FILE* fptr = fopen(sh_path.c_str(), "w");
+    if (fptr == nullptr) {
+      CRANE_ERROR("Failed write the script for task #{}", task_id);
+      EvActivateTaskStatusChange_(
+          task_id, crane::grpc::TaskStatus::Failed,
+          ExitCode::kExitCodeFileNotFound,
+          fmt::format("Cannot write shell script for batch task #{}", task_id));
+      return;
+    }
 
-  fclose(fptr);
+    fputs(script.c_str(), fptr);
+    fclose(fptr);
 
-  chmod(sh_path.c_str(), strtol("0755", nullptr, 8));
+    chmod(sh_path.c_str(), strtol("0755", nullptr, 8));
+    exec_path = sh_path;
+  }
 
-  auto process =
-      std::make_unique<ProcessInstance>(sh_path, std::list<std::string>());
+  auto process = std::make_unique<ProcessInstance>(std::move(exec_path),
+                                                   std::list<std::string>());
 
   // Prepare file output name for batch tasks.
   if (instance->task.type() == crane::grpc::Batch) {
@@ -1127,12 +1564,18 @@ void TaskManager::LaunchTaskInstanceMt_(TaskInstance* instance) {
     // kOk means that SpawnProcessInInstance_ has successfully forked a child
     // process.
     // Now we put the child pid into index maps.
-    // SIGCHLD sent just after fork() and before putting pid into maps
-    // will repeatedly be sent by timer and eventually be handled once the
-    // SIGCHLD processing callback sees the pid in index maps.
+    // With pidfd, the exit of the child is watched only after that, so it is
+    // always handled with the pid in index maps. The exited child stays a
+    // zombie until it is reaped through the pidfd, so the pid is not reused.
+    // Otherwise, SIGCHLD sent just after fork() and before putting pid into
+    // maps will repeatedly be sent by timer and eventually be handled once
+    // the SIGCHLD processing callback sees the pid in index maps.
     m_mtx_.Lock();
     m_pid_task_map_.emplace(process->GetPid(), instance);
     m_pid_proc_map_.emplace(process->GetPid(), process.get());
+    if (m_use_pidfd_ && !WatchProcessExit_(process.get()))
+      CRANE_WARN("Pid {} of task #{} is reaped by SIGCHLD instead of pidfd.",
+                 process->GetPid(), task_id);
 
     // Move the ownership of ProcessInstance into the TaskInstance.
     // Make sure existing process can be found when handling SIGCHLD.
@@ -1191,6 +1634,14 @@ void TaskManager::EvTaskStatusChangeCb_(int efd, short events,
 
     bool orphaned = instance->orphaned;
 
+    // The cgroup is released later by CraneCtld, so the final usage can
+    // still be read here.
+    if (!orphaned) {
+      auto usage = g_cg_mgr->GetTaskResourceUsage(status_change.task_id);
+      if (usage.has_value())
+        status_change.resource_usage = std::move(usage.value());
+    }
+
     // Free the TaskInstance structure
     this_->m_task_map_.erase(status_change.task_id);
 
@@ -1315,6 +1766,29 @@ void TaskManager::EvOnTaskTimerCb_(int, short, void* arg_) {
   }
 }
 
+void TaskManager::EvOnTaskKillTimerCb_(int, short, void* arg_) {
+  auto* arg = reinterpret_cast<EvTimerCbArg*>(arg_);
+  TaskManager* this_ = arg->task_manager;
+  task_id_t task_id = arg->task_id;
+
+  // As in EvOnTaskTimerCb_, the task may have ended just before.
+  auto task_it = this_->m_task_map_.find(task_id);
+  if (task_it == this_->m_task_map_.end()) {
+    CRANE_TRACE("Task #{} has already been removed.", task_id);
+    return;
+  }
+
+  TaskInstance* task_instance = task_it->second.get();
+  delete arg;
+  event_free(task_instance->kill_timer);
+  task_instance->kill_timer = nullptr;
+
+  CRANE_TRACE("Task #{} is still running after its grace time. Killing it...",
+              task_id);
+  for (auto&& [pid, pr_instance] : task_instance->processes)
+    KillProcessInstance_(pr_instance.get(), SIGKILL);
+}
+
 void TaskManager::EvTerminateTaskCb_(int efd, short events, void* user_data) {
   auto* this_ = reinterpret_cast<TaskManager*>(user_data);
 
@@ -1367,6 +1841,12 @@ void TaskManager::EvTerminateTaskCb_(int efd, short events, void* user_data) {
       // just send a kill signal here.
       for (auto&& [pid, pr_instance] : task_instance->processes)
         KillProcessInstance_(pr_instance.get(), sig);
+
+      if (elem.kill_grace_sec != 0 && task_instance->kill_timer == nullptr) {
+        this_->EvAddKillTimer_(task_instance, elem.kill_grace_sec);
+        CRANE_TRACE("Add a kill timer of {} seconds for task #{}",
+                    elem.kill_grace_sec, elem.task_id);
+      }
     } else if (task_instance->task.type() == crane::grpc::Interactive) {
       // For an Interactive task with no process running, it ends immediately.
       this_->EvActivateTaskStatusChange_(elem.task_id, crane::grpc::Completed,
@@ -1376,8 +1856,11 @@ void TaskManager::EvTerminateTaskCb_(int efd, short events, void* user_data) {
   }
 }
 
-void TaskManager::TerminateTaskAsync(uint32_t task_id) {
-  EvQueueTaskTerminate elem{.task_id = task_id, .terminated_by_user = true};
+void TaskManager::TerminateTaskAsync(uint32_t task_id,
+                                     uint32_t kill_grace_sec) {
+  EvQueueTaskTerminate elem{.task_id = task_id,
+                            .terminated_by_user = true,
+                            .kill_grace_sec = kill_grace_sec};
   m_task_terminate_queue_.enqueue(elem);
   event_active(m_ev_task_terminate_, 0, 0);
 }
@@ -1405,6 +1888,36 @@ bool TaskManager::CheckTaskStatusAsync(task_id_t task_id,
   return true;
 }
 
+void TaskManager::EvSampleTaskUsageCb_(int, short events, void* user_data) {
+  // Reading the usage files tracks the peak memory on kernels which cannot
+  // report the peak of a reused cgroup.
+  auto* this_ = reinterpret_cast<TaskManager*>(user_data);
+
+  auto usage_map = g_cg_mgr->GetAllTaskResourceUsage();
+  CRANE_TRACE("Resource usage of {} tasks is sampled.", usage_map.size());
+
+  // The same samples are pushed to plugind so that plugins do not need to
+  // poll the cgroups of all tasks by themselves.
+  if (!g_config.Plugin.Enabled ||
+      g_config.Plugin.JobMonitorPushIntervalSec == 0)
+    return;
+
+  auto samples = this_->m_job_monitor_sample_buffer_.AddSamples(
+      absl::Now(), absl::Seconds(g_config.Plugin.JobMonitorPushIntervalSec),
+      usage_map);
+  if (!samples) return;
+
+  samples->set_craned_id(g_config.CranedIdOfThisNode);
+  samples->set_sample_interval(g_config.TaskUsageSampleIntervalSec);
+  CRANE_TRACE("Pushing usage samples of {} tasks to plugind.",
+              samples->series_list_size());
+  g_plugin_client->JobMonitorSamplesHookAsync(std::move(*samples));
+}
+
+void TaskManager::EvCgroupTeardownCb_(int, short events, void* user_data) {
+  g_cg_mgr->ProcessTeardownEvents();
+}
+
 void TaskManager::EvCheckTaskStatusCb_(int, short events, void* user_data) {
   auto* this_ = reinterpret_cast<TaskManager*>(user_data);
 
@@ -30,10 +30,12 @@
 #include "CgroupManager.h"
 #include "CtldClient.h"
 #include "DeviceManager.h"
+#include "JobMonitorSampleBuffer.h"
 #include "crane/PasswordEntry.h"
 #include "crane/PublicHeader.h"
 #include "protos/Crane.grpc.pb.h"
 #include "protos/Crane.pb.h"
+#include "protos/Plugin.pb.h"
 
 namespace Craned {
 
@@ -69,6 +71,8 @@ class ProcessInstance {
     }
 
     if (m_ev_buf_event_) bufferevent_free(m_ev_buf_event_);
+    if (m_ev_pidfd_) event_free(m_ev_pidfd_);
+    if (m_pidfd_ != -1) close(m_pidfd_);
   }
 
   [[nodiscard]] const std::string& GetExecPath() const {
@@ -81,6 +85,13 @@ class ProcessInstance {
   void SetPid(pid_t pid) { m_pid_ = pid; }
   [[nodiscard]] pid_t GetPid() const { return m_pid_; }
 
+  // The ProcessInstance takes the ownership of pidfd and its event.
+  void SetPidfd(int pidfd, struct event* ev_pidfd) {
+    m_pidfd_ = pidfd;
+    m_ev_pidfd_ = ev_pidfd;
+  }
+  [[nodiscard]] int GetPidfd() const { return m_pidfd_; }
+
   void SetEvBufEvent(struct bufferevent* ev_buf_event) {
     m_ev_buf_event_ = ev_buf_event;
   }
@@ -112,6 +123,11 @@ class ProcessInstance {
   /* ------------- Fields set by SpawnProcessInInstance_  ---------------- */
   pid_t m_pid_;
 
+  // The pidfd becomes readable when the process exits. -1 if Craned falls
+  // back to reaping by SIGCHLD.
+  int m_pidfd_{-1};
+  struct event* m_ev_pidfd_{nullptr};
+
   // The underlying event that handles the output of the task.
   struct bufferevent* m_ev_buf_event_;
 
@@ -140,7 +156,12 @@ class ProcessInstance {
 
 struct MetaInTaskInstance {
   std::string parsed_sh_script_path;
-  virtual ~MetaInTaskInstance() = default;
+  // Sealed memfd holding the script if CranedScriptInMemfd is set.
+  int script_memfd{-1};
+
+  virtual ~MetaInTaskInstance() {
+    if (script_memfd != -1) close(script_memfd);
+  }
 };
 
 struct BatchMetaInTaskInstance : MetaInTaskInstance {
@@ -153,7 +174,8 @@ struct CrunMetaInTaskInstance : MetaInTaskInstance {
   ~CrunMetaInTaskInstance() override = default;
 };
 
-// also arg for EvDoSigChldCb_
+// The exit status of a process, collected by waitid() on its pidfd or by
+// waitpid() in the SIGCHLD handler.
 struct ProcSigchldInfo {
   pid_t pid;
   bool is_terminated_by_signal;
@@ -173,6 +195,13 @@ struct TaskInstance {
       termination_timer = nullptr;
     }
 
+    if (kill_timer) {
+      delete static_cast<EvTimerCbArg*>(event_get_callback_arg(kill_timer));
+      evtimer_del(kill_timer);
+      event_free(kill_timer);
+      kill_timer = nullptr;
+    }
+
     if (this->IsCrun()) {
       close(dynamic_cast<CrunMetaInTaskInstance*>(meta.get())->proc_in_fd);
     }
@@ -190,6 +219,9 @@ struct TaskInstance {
   std::string cgroup_path;
   Cgroup* cgroup;
   struct event* termination_timer{nullptr};
+  // Armed when the task is terminated with a grace time. SIGKILL is sent to
+  // the processes left when it fires.
+  struct event* kill_timer{nullptr};
 
   // Task execution results
   bool orphaned{false};
@@ -220,7 +252,11 @@ class TaskManager {
   std::optional<std::vector<std::pair<std::string, std::string>>>
   QueryTaskEnvironmentVariablesAsync(task_id_t task_id);
 
-  void TerminateTaskAsync(uint32_t task_id);
+  /**
+   * @param kill_grace_sec if non-zero, the processes still running so many
+   * seconds after the termination signal are killed by SIGKILL.
+   */
+  void TerminateTaskAsync(uint32_t task_id, uint32_t kill_grace_sec = 0);
 
   void MarkTaskAsOrphanedAndTerminateAsync(task_id_t task_id);
 
@@ -274,6 +310,7 @@ class TaskManager {
     bool terminated_by_timeout{false};  // If the task is canceled by user,
                                         // task->status=Timeout
     bool mark_as_orphaned{false};
+    uint32_t kill_grace_sec{0};
   };
 
   struct EvQueueCheckTaskStatus {
@@ -295,6 +332,11 @@ class TaskManager {
   CraneErr SpawnProcessInInstance_(TaskInstance* instance,
                                    ProcessInstance* process);
 
+  // Same semantics as SpawnProcessInInstance_, but the process is created by
+  // the zygote instead of forking Craned.
+  CraneErr SpawnProcessByZygote_(TaskInstance* instance,
+                                 ProcessInstance* process);
+
   const TaskInstance* FindInstanceByTaskId_(uint32_t task_id);
 
   // Ask TaskManager to stop its event loop.
@@ -360,6 +402,20 @@ class TaskManager {
     instance->termination_timer = nullptr;
   }
 
+  void EvAddKillTimer_(TaskInstance* instance, int64_t secs) {
+    auto* arg = new EvTimerCbArg;
+    arg->task_manager = this;
+    arg->task_id = instance->task.task_id();
+
+    timeval tv{static_cast<__time_t>(secs), 0};
+
+    struct event* ev = event_new(m_ev_base_, -1, 0, EvOnTaskKillTimerCb_, arg);
+    CRANE_ASSERT_MSG(ev != nullptr, "Failed to create new timer.");
+    evtimer_add(ev, &tv);
+
+    instance->kill_timer = ev;
+  }
+
   /**
    * Send a signal to the process group to which the processes in
    *  ProcessInstance belongs.
@@ -405,6 +461,27 @@ class TaskManager {
 
   static void EvSigchldCb_(evutil_socket_t sig, short events, void* user_data);
 
+  // Called when the pidfd of a process becomes readable, i.e., the process
+  // has exited. user_data is the ProcessInstance.
+  static void EvPidfdCb_(evutil_socket_t pidfd, short events, void* user_data);
+
+  static void EvZygotePidfdCb_(evutil_socket_t pidfd, short events,
+                               void* user_data);
+
+  // Watch the exit of a newly spawned process by its pidfd.
+  // Must be called after the pid is put into the index maps.
+  // If false is returned, the process is reaped by ReapUnwatchedChildren_().
+  bool WatchProcessExit_(ProcessInstance* process)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(m_mtx_);
+
+  // In pidfd mode, reap the exited children which are not watched through
+  // a pidfd and handle them as on SIGCHLD.
+  void ReapUnwatchedChildren_();
+
+  // Handle the exit of a process whose indexes have been removed.
+  void EvOnProcessExit_(TaskInstance* instance, ProcessInstance* proc,
+                        const ProcSigchldInfo& sigchld_info);
+
   static void EvProcessSigchldCb_(evutil_socket_t sig, short events,
                                   void* user_data);
 
@@ -437,11 +514,29 @@ class TaskManager {
 
   static void EvExitEventCb_(evutil_socket_t, short events, void* user_data);
 
+  static void EvCgroupTeardownCb_(evutil_socket_t, short events,
+                                  void* user_data);
+
+  static void EvSampleTaskUsageCb_(evutil_socket_t, short events,
+                                   void* user_data);
+
   static void EvOnTaskTimerCb_(evutil_socket_t, short, void* arg_);
 
+  static void EvOnTaskKillTimerCb_(evutil_socket_t, short, void* arg_);
+
   static void EvOnSigchldTimerCb_(evutil_socket_t, short, void* arg_);
 
   struct event_base* m_ev_base_{};
+
+  // Processes are reaped through their pidfds (Linux 5.4+) if available.
+  // Otherwise, all children are reaped in the SIGCHLD handler and the exit
+  // status is resent by a timer if the pid is not yet in the index maps.
+  // In pidfd mode, the SIGCHLD handler still reaps the children without a
+  // pidfd, e.g., those whose pidfd can not be opened.
+  bool m_use_pidfd_{false};
+  struct event* m_ev_zygote_pidfd_{};
+  int m_zygote_pidfd_{-1};
+
   struct event* m_ev_sigchld_{};
 
   // When this event is triggered, the TaskManager will not accept
@@ -485,6 +580,16 @@ class TaskManager {
   struct event* m_ev_check_task_status_{};
   ConcurrentQueue<EvQueueCheckTaskStatus> m_check_task_status_queue_;
 
+  // Triggered when a released cgroup may have become empty or periodically
+  // to kill the processes left in it again.
+  struct event* m_ev_cgroup_teardown_{};
+
+  struct event* m_ev_sample_task_usage_{};
+
+  // The usage samples not yet pushed to plugind. Only accessed in the event
+  // loop thread.
+  JobMonitorSampleBuffer m_job_monitor_sample_buffer_;
+
   std::thread m_ev_loop_thread_;
 
   static inline TaskManager* m_instance_ptr_;
@@ -0,0 +1,46 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+
+#include "TaskOutputRing.h"
+
+namespace Craned {
+
+int TaskOutputRing::FreeSpans(iovec* iov) const {
+  size_t tail = (m_head_ + m_size_) % m_capacity_;
+  size_t free_bytes = m_capacity_ - m_size_;
+  if (free_bytes == 0) return 0;
+
+  size_t first = std::min(free_bytes, m_capacity_ - tail);
+  iov[0] = {m_buf_.get() + tail, first};
+  if (first == free_bytes) return 1;
+
+  iov[1] = {m_buf_.get(), free_bytes - first};
+  return 2;
+}
+
+size_t TaskOutputRing::DrainTo(std::string* out, size_t max_bytes) {
+  size_t n = std::min(max_bytes, m_size_);
+  size_t first = std::min(n, m_capacity_ - m_head_);
+  out->append(m_buf_.get() + m_head_, first);
+  out->append(m_buf_.get(), n - first);
+
+  m_head_ = (m_head_ + n) % m_capacity_;
+  m_size_ -= n;
+  return n;
+}
+
+}  // namespace Craned
@@ -0,0 +1,74 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+
+#pragma once
+
+#include "CranedPublicDefs.h"
+// Precompiled header comes first.
+
+#include <sys/uio.h>
+
+namespace Craned {
+
+/**
+ * A fixed-size byte ring buffer. The output of a task is read from its fd
+ * directly into the free space, so it is copied only once more when it is
+ * packed into a gRPC message.
+ * Not thread-safe. However, the free spans returned by FreeSpans() stay free
+ * while other data are drained, so the caller may fill them without holding
+ * the lock protecting the ring.
+ */
+class TaskOutputRing {
+ public:
+  explicit TaskOutputRing(size_t capacity)
+      : m_buf_(std::make_unique<char[]>(capacity)), m_capacity_(capacity) {}
+
+  size_t Size() const { return m_size_; }
+  bool Empty() const { return m_size_ == 0; }
+  bool Full() const { return m_size_ == m_capacity_; }
+
+  // Fill iov with the free space of the ring.
+  // @return the number of iovecs used, at most 2.
+  int FreeSpans(iovec* iov) const;
+
+  // Mark n bytes at the beginning of the free space as filled.
+  void Commit(size_t n) { m_size_ += n; }
+
+  // Move at most max_bytes from the ring to the end of out.
+  // @return the number of bytes moved.
+  size_t DrainTo(std::string* out, size_t max_bytes);
+
+  /**
+   * Move all the data in chunks of at most max_chunk_bytes. new_chunk() is
+   * called for each chunk and returns the string it is appended to.
+   * @return the number of bytes moved.
+   */
+  template <typename NewChunkFn>
+  size_t DrainInChunks(size_t max_chunk_bytes, NewChunkFn&& new_chunk) {
+    size_t total = 0;
+    while (!Empty()) total += DrainTo(new_chunk(), max_chunk_bytes);
+    return total;
+  }
+
+ private:
+  std::unique_ptr<char[]> m_buf_;
+  size_t m_capacity_;
+  size_t m_head_{0};
+  size_t m_size_{0};
+};
+
+}  // namespace Craned
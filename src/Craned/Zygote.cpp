@@ -0,0 +1,504 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "Zygote.h"
+
+#include <fcntl.h>
+#include <grp.h>
+#include <libcgroup.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "crane/OS.h"
+
+namespace Craned {
+
+namespace {
+
+using crane::grpc::subprocess::ZygoteSpawnReply;
+using crane::grpc::subprocess::ZygoteSpawnRequest;
+
+// Largest size of a serialized request. Most of it is used by env.
+constexpr size_t kMaxMsgSize = 4 * 1024 * 1024;
+constexpr size_t kMaxFdNum = 4;
+constexpr size_t kMaxReplySize = 4096;
+
+// Same layout as struct clone_args in <linux/sched.h>, which is not included
+// here since it conflicts with the definitions in <sched.h>.
+struct CloneArgs {
+  uint64_t flags;
+  uint64_t pidfd;
+  uint64_t child_tid;
+  uint64_t parent_tid;
+  uint64_t exit_signal;
+  uint64_t stack;
+  uint64_t stack_size;
+  uint64_t tls;
+  uint64_t set_tid;
+  uint64_t set_tid_size;
+  uint64_t cgroup;
+};
+
+constexpr uint64_t kCloneIntoCgroup = 0x200000000ULL;
+
+#ifdef SYS_clone3
+constexpr long kSysClone3 = SYS_clone3;
+#else
+constexpr long kSysClone3 = 435;
+#endif
+
+// Only accessed in the zygote process.
+bool g_clone_into_cgroup_supported = true;
+
+// The zygote must not use spdlog. The async logger of Craned is drained by
+// a thread which does not exist in the zygote, so messages would be lost
+// and the zygote would block once the queue is full. Its locks may also be
+// held by that thread at the moment of fork(). Write to stderr directly.
+template <typename... Args>
+void ZygoteLog(fmt::format_string<Args...> format, Args&&... args) {
+  std::string msg =
+      fmt::format("[Zygote {}] {}\n", getpid(),
+                  fmt::format(format, std::forward<Args>(args)...));
+  (void)!write(STDERR_FILENO, msg.data(), msg.size());
+}
+
+enum class ChildStage : int32_t {
+  kCgroup = 1,
+  kCredential,
+  kChdir,
+  kStdio,
+  kExec,
+};
+
+constexpr std::string_view ChildStageStr(ChildStage stage) {
+  switch (stage) {
+  case ChildStage::kCgroup:
+    return "cgroup migration";
+  case ChildStage::kCredential:
+    return "credential setting";
+  case ChildStage::kChdir:
+    return "chdir";
+  case ChildStage::kStdio:
+    return "stdio redirection";
+  case ChildStage::kExec:
+    return "execv";
+  }
+  return "unknown stage";
+}
+
+struct ChildFailure {
+  ChildStage stage;
+  int32_t err;
+};
+
+[[noreturn]] void ReportAndAbort(int status_fd, ChildStage stage, int err) {
+  ChildFailure failure{stage, err};
+  (void)!write(status_fd, &failure, sizeof(failure));
+
+  // The child is created by a raw clone() and the thread id cached by glibc
+  // still refers to the zygote, so abort() may deliver SIGABRT to the zygote.
+  // Use kill() on the real pid instead.
+  // Craned uses SIGABRT to inform the client of this failure.
+  signal(SIGABRT, SIG_DFL);
+  kill(getpid(), SIGABRT);
+  _exit(128 + SIGABRT);
+}
+
+bool SendMsgWithFds(int sock_fd, const std::string& data,
+                    const std::vector<int>& fds) {
+  iovec iov{const_cast<char*>(data.data()), data.size()};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int) * kMaxFdNum)];
+  if (!fds.empty()) {
+    msg.msg_control = ctrl;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+  }
+
+  ssize_t n;
+  do {
+    n = sendmsg(sock_fd, &msg, MSG_NOSIGNAL);
+  } while (n < 0 && errno == EINTR);
+
+  return n == static_cast<ssize_t>(data.size());
+}
+
+ssize_t RecvMsgWithFds(int sock_fd, char* buf, size_t len,
+                       std::vector<int>* fds, bool* truncated) {
+  iovec iov{buf, len};
+  msghdr msg{};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+
+  alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int) * kMaxFdNum)];
+  msg.msg_control = ctrl;
+  msg.msg_controllen = sizeof(ctrl);
+
+  ssize_t n;
+  do {
+    n = recvmsg(sock_fd, &msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) return n;
+
+  for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+       cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+      continue;
+
+    size_t num = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for (size_t i = 0; i < num; i++) {
+      int fd;
+      memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+      fds->push_back(fd);
+    }
+  }
+
+  *truncated = msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC);
+  return n;
+}
+
+}  // namespace
+
+Zygote::~Zygote() {
+  absl::MutexLock lock_guard(&m_mtx_);
+  // The zygote exits when it reads EOF from the socket.
+  if (m_sock_fd_ != -1) close(m_sock_fd_);
+  m_sock_fd_ = -1;
+  m_alive_.store(false, std::memory_order_release);
+}
+
+bool Zygote::Start() {
+  int sock_pair[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sock_pair) != 0) {
+    CRANE_ERROR("Failed to create socket pair for zygote: {}",
+                strerror(errno));
+    return false;
+  }
+
+  // Best effort. A request larger than the socket buffer fails with EMSGSIZE.
+  int buf_size = kMaxMsgSize;
+  setsockopt(sock_pair[0], SOL_SOCKET, SO_SNDBUFFORCE, &buf_size,
+             sizeof(buf_size));
+  setsockopt(sock_pair[1], SOL_SOCKET, SO_RCVBUFFORCE, &buf_size,
+             sizeof(buf_size));
+
+  pid_t craned_pid = getpid();
+  pid_t pid = fork();
+  if (pid == -1) {
+    CRANE_ERROR("Failed to fork zygote: {}", strerror(errno));
+    close(sock_pair[0]);
+    close(sock_pair[1]);
+    return false;
+  }
+
+  if (pid == 0) {  // Zygote
+    close(sock_pair[0]);
+
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    if (getppid() != craned_pid) _exit(0);
+    prctl(PR_SET_NAME, "craned-zygote");
+
+    // SIGINT from the terminal of a foreground Craned is handled by Craned,
+    // which terminates all tasks before exiting. The zygote then exits on
+    // EOF of the socket or by PR_SET_PDEATHSIG.
+    signal(SIGINT, SIG_IGN);
+
+    ServeForever_(sock_pair[1]);
+  }
+
+  close(sock_pair[1]);
+
+  m_pid_ = pid;
+  {
+    absl::MutexLock lock_guard(&m_mtx_);
+    m_sock_fd_ = sock_pair[0];
+  }
+  m_alive_.store(true, std::memory_order_release);
+
+  CRANE_INFO("Zygote process {} started.", pid);
+  return true;
+}
+
+bool Zygote::CheckAndMarkExited(pid_t pid) {
+  if (pid != m_pid_) return false;
+
+  if (m_alive_.exchange(false, std::memory_order_acq_rel))
+    CRANE_WARN("Zygote process {} exited. Fall back to fork() in Craned.",
+               pid);
+  return true;
+}
+
+CraneErr Zygote::Spawn(const ZygoteSpawnRequest& request,
+                       const std::vector<int>& fds, ZygoteSpawnReply* reply) {
+  std::string data;
+  if (!request.SerializeToString(&data)) return CraneErr::kProtobufError;
+  if (data.size() > kMaxMsgSize || fds.size() > kMaxFdNum) {
+    CRANE_ERROR("Spawn request of task #{} is too large for zygote.",
+                request.task_id());
+    return CraneErr::kInvalidParam;
+  }
+
+  char buf[kMaxReplySize];
+  ssize_t n;
+
+  absl::MutexLock lock_guard(&m_mtx_);
+  if (!m_alive_.load(std::memory_order_acquire)) return CraneErr::kSystemErr;
+
+  if (!SendMsgWithFds(m_sock_fd_, data, fds)) {
+    CRANE_ERROR("Failed to send spawn request of task #{} to zygote: {}",
+                request.task_id(), strerror(errno));
+    if (errno != EMSGSIZE) m_alive_.store(false, std::memory_order_release);
+    return CraneErr::kSystemErr;
+  }
+
+  do {
+    n = recv(m_sock_fd_, buf, sizeof(buf), 0);
+  } while (n < 0 && errno == EINTR);
+
+  if (n <= 0) {
+    CRANE_ERROR("Zygote closed the connection while spawning task #{}.",
+                request.task_id());
+    m_alive_.store(false, std::memory_order_release);
+    return CraneErr::kSystemErr;
+  }
+
+  if (!reply->ParseFromArray(buf, static_cast<int>(n)))
+    return CraneErr::kProtobufError;
+
+  return CraneErr::kOk;
+}
+
+void Zygote::ServeForever_(int sock_fd) {
+  std::vector<char> buf(kMaxMsgSize);
+
+  while (true) {
+    std::vector<int> fds;
+    bool truncated = false;
+    ssize_t n =
+        RecvMsgWithFds(sock_fd, buf.data(), buf.size(), &fds, &truncated);
+    if (n == 0) _exit(0);  // Craned closed its end.
+    if (n < 0) {
+      ZygoteLog("Failed to receive request: {}", strerror(errno));
+      _exit(1);
+    }
+
+    ZygoteSpawnRequest request;
+    ZygoteSpawnReply reply;
+    size_t expected_fd_num =
+        (request.ParseFromArray(buf.data(), static_cast<int>(n))
+             ? (request.has_cgroup_fd() ? 1 : 0) +
+                   (request.has_io_fds() ? 2 : 0) +
+                   (request.has_script_fd() ? 1 : 0)
+             : SIZE_MAX);
+
+    if (truncated || fds.size() != expected_fd_num) {
+      reply.set_ok(false);
+      reply.set_reason("Malformed spawn request");
+    } else {
+      LaunchOne_(request, fds, &reply);
+    }
+
+    for (int fd : fds) close(fd);
+
+    std::string data;
+    reply.SerializeToString(&data);
+    if (send(sock_fd, data.data(), data.size(), MSG_NOSIGNAL) < 0) _exit(1);
+  }
+}
+
+void Zygote::LaunchOne_(const ZygoteSpawnRequest& request,
+                        const std::vector<int>& fds, ZygoteSpawnReply* reply) {
+  // The write end is closed on a successful execv(). Otherwise, the child
+  // writes a ChildFailure before it aborts.
+  int status_pipe[2];
+  if (pipe2(status_pipe, O_CLOEXEC) != 0) {
+    reply->set_ok(false);
+    reply->set_reason(fmt::format("pipe2() failed: {}", strerror(errno)));
+    return;
+  }
+
+  int cgroup_fd = request.has_cgroup_fd() ? fds[0] : -1;
+  bool in_cgroup;
+  pid_t pid = CloneChild_(cgroup_fd, &in_cgroup);
+  if (pid == -1) {
+    reply->set_ok(false);
+    reply->set_reason(fmt::format("clone() failed: {}", strerror(errno)));
+    close(status_pipe[0]);
+    close(status_pipe[1]);
+    return;
+  }
+
+  if (pid == 0) {
+    close(status_pipe[0]);
+    ExecInChild_(request, fds, in_cgroup, status_pipe[1]);
+  }
+
+  close(status_pipe[1]);
+  reply->set_ok(true);
+  reply->set_pid(pid);
+
+  ChildFailure failure{};
+  ssize_t n;
+  do {
+    n = read(status_pipe[0], &failure, sizeof(failure));
+  } while (n < 0 && errno == EINTR);
+  close(status_pipe[0]);
+
+  if (n == sizeof(failure)) {
+    reply->set_failed_before_exec(true);
+    reply->set_cgroup_error(failure.stage == ChildStage::kCgroup);
+    reply->set_reason(fmt::format("{} failed: {}",
+                                  ChildStageStr(failure.stage),
+                                  strerror(failure.err)));
+  }
+}
+
+pid_t Zygote::CloneChild_(int cgroup_fd, bool* in_cgroup) {
+  *in_cgroup = false;
+
+  if (cgroup_fd != -1 && g_clone_into_cgroup_supported) {
+    CloneArgs args{};
+    args.flags = CLONE_PARENT | kCloneIntoCgroup;
+    args.exit_signal = SIGCHLD;
+    args.cgroup = cgroup_fd;
+
+    long pid = syscall(kSysClone3, &args, sizeof(args));
+    if (pid >= 0) {
+      *in_cgroup = true;
+      return static_cast<pid_t>(pid);
+    }
+
+    if (errno == ENOSYS || errno == E2BIG || errno == EINVAL) {
+      g_clone_into_cgroup_supported = false;
+      ZygoteLog(
+          "clone3() with CLONE_INTO_CGROUP is not supported. "
+          "Children will migrate themselves into cgroups.");
+    } else {
+      ZygoteLog("clone3() into cgroup failed: {}. Retry with clone().",
+                strerror(errno));
+    }
+  }
+
+  // With CLONE_PARENT, Craned instead of the zygote is the parent of the
+  // child and receives SIGCHLD on its exit.
+  return static_cast<pid_t>(syscall(SYS_clone, CLONE_PARENT | SIGCHLD, nullptr,
+                                    nullptr, nullptr, nullptr));
+}
+
+void Zygote::ExecInChild_(const ZygoteSpawnRequest& request,
+                          const std::vector<int>& fds, bool in_cgroup,
+                          int status_fd) {
+  signal(SIGINT, SIG_DFL);
+  signal(SIGABRT, SIG_DFL);
+
+  // Migrate into the task cgroup before dropping privileges.
+  if (!in_cgroup) {
+    if (request.has_cgroup_fd()) {
+      int procs_fd = openat(fds[0], "cgroup.procs", O_WRONLY | O_CLOEXEC);
+      if (procs_fd == -1 || write(procs_fd, "0", 1) != 1)
+        ReportAndAbort(status_fd, ChildStage::kCgroup, errno);
+      close(procs_fd);
+    } else if (!request.cgroup_path().empty()) {
+      struct cgroup* cg = cgroup_new_cgroup(request.cgroup_path().c_str());
+      if (cg == nullptr || cgroup_get_cgroup(cg) != 0 ||
+          cgroup_attach_task(cg) != 0)
+        ReportAndAbort(status_fd, ChildStage::kCgroup, cgroup_get_last_errno());
+      cgroup_free(&cg);
+    }
+  }
+
+  // Set pgid to the pid of task root process.
+  setpgid(0, 0);
+
+  gid_t gid = request.gid();
+  uid_t uid = request.uid();
+  if (setgroups(1, &gid) == -1 || setregid(gid, gid) == -1 ||
+      setreuid(uid, uid) == -1)
+    ReportAndAbort(status_fd, ChildStage::kCredential, errno);
+
+  if (chdir(request.cwd().c_str()) == -1)
+    ReportAndAbort(status_fd, ChildStage::kChdir, errno);
+
+  if (request.has_io_fds()) {
+    int io_fd_begin = request.has_cgroup_fd() ? 1 : 0;
+    dup2(fds[io_fd_begin], 0);
+    dup2(fds[io_fd_begin + 1], 1);
+    dup2(fds[io_fd_begin + 1], 2);
+  } else if (!request.stdout_file().empty()) {
+    int stdout_fd = open(request.stdout_file().c_str(),
+                         O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (stdout_fd == -1) ReportAndAbort(status_fd, ChildStage::kStdio, errno);
+    dup2(stdout_fd, 1);
+
+    if (request.stderr_file().empty()) {
+      dup2(stdout_fd, 2);
+    } else {
+      int stderr_fd = open(request.stderr_file().c_str(),
+                           O_RDWR | O_CREAT | O_TRUNC, 0644);
+      if (stderr_fd == -1)
+        ReportAndAbort(status_fd, ChildStage::kStdio, errno);
+      dup2(stderr_fd, 2);
+      close(stderr_fd);
+    }
+    close(stdout_fd);
+  }
+
+  // If stdin is not closed for batch tasks, a program like mpirun may keep
+  // waiting for the input from stdin and will never end.
+  if (request.close_stdin()) close(0);
+
+  int keep_fd_end = 3;
+  if (request.has_script_fd()) {
+    // Move status_fd out of the way of the script fd.
+    if (status_fd == kTaskScriptFd) {
+      status_fd = fcntl(status_fd, F_DUPFD_CLOEXEC, kTaskScriptFd + 1);
+      if (status_fd == -1) std::abort();
+    }
+    if (!InstallTaskScriptFd(fds.back()))
+      ReportAndAbort(status_fd, ChildStage::kStdio, errno);
+    keep_fd_end = kTaskScriptFd + 1;
+  }
+  util::os::CloseFdRange(keep_fd_end, status_fd);
+  util::os::CloseFdFrom(status_fd + 1);
+
+  clearenv();
+  for (const auto& env : request.env())
+    setenv(env.name().c_str(), env.value().c_str(), 1);
+
+  std::vector<const char*> argv;
+  argv.reserve(request.argv_size() + 1);
+  for (const auto& arg : request.argv()) argv.push_back(arg.c_str());
+  argv.push_back(nullptr);
+
+  execv(request.exec_path().c_str(), const_cast<char* const*>(argv.data()));
+
+  int err = errno;
+  fmt::print(stderr, "[Craned Subprocess Error] Failed to execv. Error: {}\n",
+             strerror(err));
+  ReportAndAbort(status_fd, ChildStage::kExec, err);
+}
+
+}  // namespace Craned
@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#pragma once
+
+#include "CranedPublicDefs.h"
+// Precompiled header comes first.
+
+#include "protos/CraneSubprocess.pb.h"
+
+namespace Craned {
+
+/**
+ * A small launcher process forked at the boot of Craned.
+ *
+ * Forking the multithreaded Craned, whose address space grows with the
+ * number of tasks and gRPC buffers, for every task is expensive and is prone
+ * to deadlocks on locks held by other threads at the moment of fork().
+ * The zygote is forked once at boot, before the gRPC servers and worker
+ * threads are started, and then spawns task processes on request. Only the
+ * threads of the async logger exist at that time, so the zygote does not
+ * use spdlog and writes its messages to stderr instead.
+ *
+ * Requests are sent through a SOCK_SEQPACKET unix socket pair and the file
+ * descriptors needed by the child (cgroup directory, crun io sockets,
+ * script memfd) are passed by SCM_RIGHTS.
+ *
+ * Task processes are created with CLONE_PARENT so that Craned stays their
+ * parent and reaps them as before. On cgroup v2, clone3() with
+ * CLONE_INTO_CGROUP places the child into the task cgroup atomically.
+ */
+class Zygote {
+ public:
+  Zygote() = default;
+  ~Zygote();
+
+  /**
+   * Fork the zygote process.
+   * MUST be called before any thread other than those of the logger is
+   * created in Craned and after libcgroup is initialized.
+   */
+  bool Start();
+
+  bool Alive() const { return m_alive_.load(std::memory_order_acquire); }
+
+  pid_t Pid() const { return m_pid_; }
+
+  /**
+   * Called when a child of Craned is reaped.
+   * @return true if pid is the zygote itself and should not be treated as a
+   * task process.
+   */
+  bool CheckAndMarkExited(pid_t pid);
+
+  /**
+   * Spawn a task process through the zygote. The function blocks until the
+   * child has executed execv() or has failed before it.
+   * @param fds are passed to the zygote in the order described in
+   * ZygoteSpawnRequest. The caller still owns them.
+   * @return kOk if the request is handled by the zygote. The reply tells
+   * whether a child is created.
+   */
+  CraneErr Spawn(const crane::grpc::subprocess::ZygoteSpawnRequest& request,
+                 const std::vector<int>& fds,
+                 crane::grpc::subprocess::ZygoteSpawnReply* reply);
+
+ private:
+  [[noreturn]] static void ServeForever_(int sock_fd);
+
+  static void LaunchOne_(
+      const crane::grpc::subprocess::ZygoteSpawnRequest& request,
+      const std::vector<int>& fds,
+      crane::grpc::subprocess::ZygoteSpawnReply* reply);
+
+  /**
+   * @param[out] in_cgroup is set to true if the child is created directly in
+   * the cgroup referred by cgroup_fd.
+   */
+  static pid_t CloneChild_(int cgroup_fd, bool* in_cgroup);
+
+  [[noreturn]] static void ExecInChild_(
+      const crane::grpc::subprocess::ZygoteSpawnRequest& request,
+      const std::vector<int>& fds, bool in_cgroup, int status_fd);
+
+  pid_t m_pid_{-1};
+  std::atomic_bool m_alive_{false};
+
+  absl::Mutex m_mtx_;
+  int m_sock_fd_ ABSL_GUARDED_BY(m_mtx_){-1};
+};
+
+}  // namespace Craned
+
+inline std::unique_ptr<Craned::Zygote> g_zygote;
@@ -16,6 +16,7 @@
 
 #include "crane/PluginClient.h"
 
+#include <absl/container/flat_hash_set.h>
 #include <absl/synchronization/mutex.h>
 #include <absl/time/time.h>
 #include <google/protobuf/message.h>
@@ -23,12 +24,14 @@
 #include <grpcpp/support/channel_arguments.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <chrono>
 #include <cstddef>
-#include <iterator>
+#include <map>
 #include <memory>
 #include <string>
 #include <thread>
+#include <unordered_set>
 #include <vector>
 
 #include "crane/GrpcHelper.h"
@@ -44,11 +47,21 @@ namespace plugin {
 PluginClient::~PluginClient() {
   m_thread_stop_.store(true);
   CRANE_TRACE("PluginClient is ending. Waiting for the thread to finish.");
-  if (m_async_send_thread_.joinable()) m_async_send_thread_.join();
+  if (m_async_send_thread_.joinable()) {
+    m_async_send_thread_.join();
+  } else {
+    // The completion queue must be shut down before it is destroyed.
+    m_cq_.Shutdown();
+  }
 }
 
 // Note that we do not support TLS in plugin yet.
-void PluginClient::InitChannelAndStub(const std::string& endpoint) {
+void PluginClient::InitChannelAndStub(const std::string& endpoint,
+                                      const Options& options) {
+  m_options_ = options;
+  m_options_.max_inflight_rpcs = std::max(m_options_.max_inflight_rpcs, 1U);
+  m_options_.max_batch_size = std::max(m_options_.max_batch_size, 1U);
+
   m_channel_ = CreateUnixInsecureChannel(endpoint);
   // std::unique_ptr will automatically release the dangling stub.
   m_stub_ = CranePluginD::NewStub(m_channel_);
@@ -58,135 +71,353 @@ void PluginClient::InitChannelAndStub(const std::string& endpoint) {
 void PluginClient::AsyncSendThread_() {
   bool prev_conn_state = false;
 
+  // Hook calls which are built but not sent yet. Calls failed due to channel
+  // failure are put back to the front.
+  std::deque<std::unique_ptr<HookCall>> pending_calls;
+  // The calls in flight are owned by the completion queue as tags.
+  std::unordered_set<HookCall*> inflight_calls;
+  HookType inflight_type{HookType::START};
+
+  std::vector<HookEvent> events;
+  size_t max_dequeued_events =
+      size_t(m_options_.max_inflight_rpcs) * m_options_.max_batch_size;
+
   while (true) {
     if (m_thread_stop_.load()) break;
 
-    // Check channel connection
-    auto connected = m_channel_->WaitForConnected(
-        std::chrono::system_clock::now() + std::chrono::milliseconds(3000));
+    // Collect the finished calls. Only the first AsyncNext() waits.
+    auto deadline =
+        std::chrono::system_clock::now() + std::chrono::milliseconds(50);
+    while (!inflight_calls.empty()) {
+      void* tag;
+      bool ok;
+      if (m_cq_.AsyncNext(&tag, &ok, deadline) !=
+          grpc::CompletionQueue::GOT_EVENT)
+        break;
+      deadline = std::chrono::system_clock::now();
+
+      std::unique_ptr<HookCall> call(static_cast<HookCall*>(tag));
+      inflight_calls.erase(call.get());
+
+      if (call->status.error_code() == grpc::UNAVAILABLE) {
+        CRANE_DEBUG("[Plugin] Plugind is unavailable. Hook type {} is resent.",
+                    int(call->type));
+        // A ClientContext can not be reused, so a new call is made.
+        auto retry = std::make_unique<HookCall>();
+        retry->type = call->type;
+        retry->task_num = call->task_num;
+        retry->request = std::move(call->request);
+        pending_calls.emplace_front(std::move(retry));
+        continue;
+      }
 
-    if (!prev_conn_state && connected) {
-      CRANE_INFO("[Plugin] Plugind is connected.");
+      FinishHookCall_(call.get());
     }
-    prev_conn_state = connected;
 
-    if (!connected) {
-      CRANE_INFO("[Plugin] Plugind is not connected. Reconnecting...");
-      std::this_thread::sleep_for(std::chrono::seconds(1));
+    if (pending_calls.size() < m_options_.max_inflight_rpcs) {
+      auto approx_size =
+          std::min(m_event_queue_.size_approx(), max_dequeued_events);
+      if (approx_size > 0) {
+        events.resize(approx_size);
+        auto actual_size =
+            m_event_queue_.try_dequeue_bulk(events.begin(), approx_size);
+        events.resize(actual_size);
+        CRANE_DEBUG("[Plugin] Dequeued {} hook events.", actual_size);
+      }
+
+      ReleaseEventsInOrder_(&events);
+      if (!events.empty()) {
+        BuildHookCalls_(&events, &pending_calls);
+        events.clear();
+      }
+    }
+
+    if (pending_calls.empty()) {
+      if (inflight_calls.empty())
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
       continue;
     }
 
-    auto approx_size = m_event_queue_.size_approx();
-    if (approx_size == 0) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    if (inflight_calls.empty()) {
+      // Check channel connection
+      auto connected = m_channel_->WaitForConnected(
+          std::chrono::system_clock::now() + std::chrono::milliseconds(3000));
+
+      if (!prev_conn_state && connected) {
+        CRANE_INFO("[Plugin] Plugind is connected.");
+      }
+      prev_conn_state = connected;
+
+      if (!connected) {
+        CRANE_INFO("[Plugin] Plugind is not connected. Reconnecting...");
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        continue;
+      }
+    }
+
+    while (inflight_calls.size() < m_options_.max_inflight_rpcs &&
+           !pending_calls.empty()) {
+      // The START and END hooks of a task must arrive at plugind in order,
+      // so calls of different hook types are not in flight together.
+      if (!inflight_calls.empty() &&
+          pending_calls.front()->type != inflight_type)
+        break;
+
+      HookCall* call = pending_calls.front().release();
+      pending_calls.pop_front();
+
+      inflight_type = call->type;
+      inflight_calls.emplace(call);
+
+      HookDispatchFunc f = s_hook_dispatch_funcs_[size_t(call->type)];
+      (this->*f)(call);
+    }
+  }
+
+  // Cancel the calls in flight and wait for their tags before the completion
+  // queue is destroyed.
+  for (HookCall* call : inflight_calls) call->context.TryCancel();
+  m_cq_.Shutdown();
+
+  void* tag;
+  bool ok;
+  while (m_cq_.Next(&tag, &ok)) delete static_cast<HookCall*>(tag);
+
+  uint64_t undelivered = m_queued_task_num_.load();
+  if (undelivered > 0)
+    CRANE_INFO("[Plugin] Hooks of {} tasks are not delivered to plugind.",
+               undelivered);
+}
+
+void PluginClient::ReleaseEventsInOrder_(std::vector<HookEvent>* events) {
+  for (HookEvent& e : *events) m_held_events_.emplace(e.seq, std::move(e));
+  events->clear();
+  if (m_held_events_.empty()) return;
+
+  auto now = std::chrono::steady_clock::now();
+  if (m_held_events_.begin()->first > m_next_release_seq_) {
+    if (!m_seq_gap_since_.has_value()) m_seq_gap_since_ = now;
+    if (now - m_seq_gap_since_.value() < kSeqGapTimeout) return;
+
+    CRANE_WARN("[Plugin] Hook events #{}-#{} are lost.", m_next_release_seq_,
+               m_held_events_.begin()->first - 1);
+    m_next_release_seq_ = m_held_events_.begin()->first;
+  }
+  m_seq_gap_since_.reset();
+
+  // An event regarded as lost may still come later and is released at once.
+  auto it = m_held_events_.begin();
+  while (it != m_held_events_.end() && it->first <= m_next_release_seq_) {
+    m_next_release_seq_ = std::max(m_next_release_seq_, it->first + 1);
+    events->emplace_back(std::move(it->second));
+    it = m_held_events_.erase(it);
+  }
+}
+
+void PluginClient::BuildHookCalls_(
+    std::vector<HookEvent>* events,
+    std::deque<std::unique_ptr<HookCall>>* calls) {
+  using crane::grpc::plugin::EndHookRequest;
+  using crane::grpc::plugin::JobMonitorHookRequest;
+  using crane::grpc::plugin::JobMonitorSamplesRequest;
+  using crane::grpc::plugin::StartHookRequest;
+
+  // JOB_MONITOR events of the same task are coalesced.
+  absl::flat_hash_set<task_id_t> monitored_task_ids;
+
+  // The last START or END call into which following events of the same type
+  // are merged.
+  HookCall* batch = nullptr;
+
+  for (HookEvent& e : *events) {
+    if (e.type == HookType::JOB_MONITOR) {
+      batch = nullptr;
+
+      auto* request = dynamic_cast<JobMonitorHookRequest*>(e.msg.get());
+      if (!monitored_task_ids.emplace(request->task_id()).second) {
+        m_queued_task_num_.fetch_sub(1);
+        continue;
+      }
+
+      auto call = std::make_unique<HookCall>();
+      call->type = e.type;
+      call->task_num = 1;
+      call->request = std::move(e.msg);
+      calls->emplace_back(std::move(call));
       continue;
     }
 
-    // Move events to local list
-    std::list<HookEvent> events;
-    events.resize(approx_size);
-
-    auto actual_size =
-        m_event_queue_.try_dequeue_bulk(events.begin(), approx_size);
-    events.resize(actual_size);
-    CRANE_DEBUG("[Plugin] Dequeued {} hook events.", actual_size);
-
-    while (!events.empty()) {
-      auto& e = events.front();
-      grpc::ClientContext context;
-
-      HookDispatchFunc f = s_hook_dispatch_funcs_[size_t(e.type)];
-      auto status = (this->*f)(&context, e.msg.get());
-
-      if (!status.ok()) {
-        CRANE_ERROR(
-            "[Plugin] Failed to send hook event: "
-            "hook type: {}; {}; {} (code: {})",
-            int(e.type), context.debug_error_string(), status.error_message(),
-            int(status.error_code()));
-
-        if (status.error_code() == grpc::UNAVAILABLE) {
-          // If some messages are not sent due to channel failure,
-          // put them back into m_event_queue_
-          if (!events.empty()) {
-            m_event_queue_.enqueue_bulk(std::make_move_iterator(events.begin()),
-                                        events.size());
-          }
-          break;
-        }
-      } else {
-        CRANE_TRACE("[Plugin] Hook event sent: hook type: {}", int(e.type));
+    if (e.type == HookType::JOB_MONITOR_SAMPLES) {
+      batch = nullptr;
+
+      auto* request =
+          dynamic_cast<JobMonitorSamplesRequest*>(e.msg.get());
+      auto call = std::make_unique<HookCall>();
+      call->type = e.type;
+      call->task_num = request->series_list_size();
+      call->request = std::move(e.msg);
+      calls->emplace_back(std::move(call));
+      continue;
+    }
+
+    for (TaskSnapshotPtr& task : e.tasks) {
+      if (batch == nullptr || batch->type != e.type ||
+          batch->task_num >= m_options_.max_batch_size) {
+        auto call = std::make_unique<HookCall>();
+        call->type = e.type;
+        call->task_num = 0;
+        if (e.type == HookType::START)
+          call->request = std::make_unique<StartHookRequest>();
+        else
+          call->request = std::make_unique<EndHookRequest>();
+
+        batch = call.get();
+        calls->emplace_back(std::move(call));
       }
 
-      events.pop_front();
+      crane::grpc::TaskInfo* task_info;
+      if (e.type == HookType::START) {
+        auto* request = static_cast<StartHookRequest*>(batch->request.get());
+        task_info = request->add_task_info_list();
+        task->MoveToTaskInfo(task_info);
+      } else {
+        auto* request = static_cast<EndHookRequest*>(batch->request.get());
+        task_info = request->add_task_info_list();
+        task->MoveToTaskInfo(task_info);
+        task_info->mutable_elapsed_time()->set_seconds(
+            e.time - task_info->start_time().seconds());
+      }
+      batch->task_num++;
     }
   }
 }
 
-grpc::Status PluginClient::SendStartHook_(grpc::ClientContext* context,
-                                          google::protobuf::Message* msg) {
+void PluginClient::FinishHookCall_(HookCall* call) {
+  if (!call->status.ok()) {
+    CRANE_ERROR(
+        "[Plugin] Failed to send hook event: "
+        "hook type: {}; {}; {} (code: {})",
+        int(call->type), call->context.debug_error_string(),
+        call->status.error_message(), int(call->status.error_code()));
+  } else {
+    CRANE_TRACE("[Plugin] Hook event sent: hook type: {}, {} tasks",
+                int(call->type), call->task_num);
+  }
+
+  m_queued_task_num_.fetch_sub(call->task_num);
+}
+
+bool PluginClient::EnqueueEvent_(HookEvent&& event, uint32_t task_num) {
+  uint64_t queued = m_queued_task_num_.fetch_add(task_num);
+  // An event is always accepted by an empty queue even if it is larger than
+  // the limit.
+  if (queued != 0 && queued + task_num > m_options_.max_queued_tasks) {
+    m_queued_task_num_.fetch_sub(task_num);
+    m_dropped_task_num_.fetch_add(task_num);
+    if (!m_dropping_.exchange(true))
+      CRANE_WARN(
+          "[Plugin] Hooks of {} tasks are waiting for plugind. "
+          "New hook events are dropped.",
+          queued);
+    return false;
+  }
+
+  if (m_dropping_.load(std::memory_order_relaxed) &&
+      m_dropping_.exchange(false))
+    CRANE_WARN("[Plugin] Hooks of {} tasks have been dropped so far.",
+               m_dropped_task_num_.load());
+
+  // The seq is taken after the event is accepted so that no seq is skipped.
+  uint64_t seq = m_next_event_seq_.fetch_add(1);
+  event.seq = seq;
+  if (!m_event_queue_.enqueue(std::move(event))) {
+    // The sending thread skips the seq after kSeqGapTimeout.
+    CRANE_ERROR("[Plugin] Failed to enqueue hook event #{}.", seq);
+    m_queued_task_num_.fetch_sub(task_num);
+    m_dropped_task_num_.fetch_add(task_num);
+    return false;
+  }
+  return true;
+}
+
+void PluginClient::SendStartHook_(HookCall* call) {
   using crane::grpc::plugin::StartHookReply;
   using crane::grpc::plugin::StartHookRequest;
 
-  auto request = dynamic_cast<StartHookRequest*>(msg);
-  StartHookReply reply;
+  auto* request = dynamic_cast<StartHookRequest*>(call->request.get());
+  auto reply = std::make_unique<StartHookReply>();
 
-  CRANE_TRACE("[Plugin] Sending StartHook.");
-  return m_stub_->StartHook(context, *request, &reply);
+  CRANE_TRACE("[Plugin] Sending StartHook for {} tasks.", call->task_num);
+  auto reader =
+      m_stub_->PrepareAsyncStartHook(&call->context, *request, &m_cq_);
+  reader->StartCall();
+  reader->Finish(reply.get(), &call->status, call);
+  call->reply = std::move(reply);
 }
 
-grpc::Status PluginClient::SendEndHook_(grpc::ClientContext* context,
-                                        google::protobuf::Message* msg) {
+void PluginClient::SendEndHook_(HookCall* call) {
   using crane::grpc::plugin::EndHookReply;
   using crane::grpc::plugin::EndHookRequest;
 
-  auto request = dynamic_cast<EndHookRequest*>(msg);
-  EndHookReply reply;
+  auto* request = dynamic_cast<EndHookRequest*>(call->request.get());
+  auto reply = std::make_unique<EndHookReply>();
 
-  CRANE_TRACE("[Plugin] Sending EndHook.");
-  return m_stub_->EndHook(context, *request, &reply);
+  CRANE_TRACE("[Plugin] Sending EndHook for {} tasks.", call->task_num);
+  auto reader = m_stub_->PrepareAsyncEndHook(&call->context, *request, &m_cq_);
+  reader->StartCall();
+  reader->Finish(reply.get(), &call->status, call);
+  call->reply = std::move(reply);
 }
 
-grpc::Status PluginClient::SendJobMonitorHook_(grpc::ClientContext* context,
-                                               google::protobuf::Message* msg) {
+void PluginClient::SendJobMonitorHook_(HookCall* call) {
   using crane::grpc::plugin::JobMonitorHookReply;
   using crane::grpc::plugin::JobMonitorHookRequest;
 
-  auto request = dynamic_cast<JobMonitorHookRequest*>(msg);
-  JobMonitorHookReply reply;
+  auto* request = dynamic_cast<JobMonitorHookRequest*>(call->request.get());
+  auto reply = std::make_unique<JobMonitorHookReply>();
 
   CRANE_TRACE("[Plugin] Sending JobMonitorHook.");
-  return m_stub_->JobMonitorHook(context, *request, &reply);
+  auto reader =
+      m_stub_->PrepareAsyncJobMonitorHook(&call->context, *request, &m_cq_);
+  reader->StartCall();
+  reader->Finish(reply.get(), &call->status, call);
+  call->reply = std::move(reply);
 }
 
-void PluginClient::StartHookAsync(std::vector<crane::grpc::TaskInfo> tasks) {
-  auto request = std::make_unique<crane::grpc::plugin::StartHookRequest>();
-  auto* task_list = request->mutable_task_info_list();
-  for (auto& task : tasks) {
-    auto* task_it = task_list->Add();
-    task_it->CopyFrom(task);
-  }
+void PluginClient::SendJobMonitorSamplesHook_(HookCall* call) {
+  using crane::grpc::plugin::JobMonitorSamplesReply;
+  using crane::grpc::plugin::JobMonitorSamplesRequest;
+
+  auto* request = dynamic_cast<JobMonitorSamplesRequest*>(call->request.get());
+  auto reply = std::make_unique<JobMonitorSamplesReply>();
 
-  HookEvent e{HookType::START,
-              std::unique_ptr<google::protobuf::Message>(std::move(request))};
-  m_event_queue_.enqueue(std::move(e));
+  CRANE_TRACE("[Plugin] Sending JobMonitorSamples of {} tasks.",
+              call->task_num);
+  auto reader =
+      m_stub_->PrepareAsyncJobMonitorSamples(&call->context, *request, &m_cq_);
+  reader->StartCall();
+  reader->Finish(reply.get(), &call->status, call);
+  call->reply = std::move(reply);
 }
 
-void PluginClient::EndHookAsync(std::vector<crane::grpc::TaskInfo> tasks) {
-  auto request = std::make_unique<crane::grpc::plugin::EndHookRequest>();
-  auto* task_list = request->mutable_task_info_list();
+void PluginClient::StartHookAsync(std::vector<TaskSnapshotPtr> tasks) {
+  if (tasks.empty()) return;
 
-  auto now = absl::ToUnixSeconds(absl::Now());
-  for (auto& task : tasks) {
-    auto* task_it = task_list->Add();
-    task_it->CopyFrom(task);
-    task_it->mutable_elapsed_time()->set_seconds(now -
-                                                 task.start_time().seconds());
-  }
+  auto task_num = static_cast<uint32_t>(tasks.size());
+  HookEvent e{.type = HookType::START,
+              .time = absl::ToUnixSeconds(absl::Now()),
+              .tasks = std::move(tasks)};
+  EnqueueEvent_(std::move(e), task_num);
+}
 
-  HookEvent e{HookType::END,
-              std::unique_ptr<google::protobuf::Message>(std::move(request))};
-  m_event_queue_.enqueue(std::move(e));
+void PluginClient::EndHookAsync(std::vector<TaskSnapshotPtr> tasks) {
+  if (tasks.empty()) return;
+
+  auto task_num = static_cast<uint32_t>(tasks.size());
+  HookEvent e{.type = HookType::END,
+              .time = absl::ToUnixSeconds(absl::Now()),
+              .tasks = std::move(tasks)};
+  EnqueueEvent_(std::move(e), task_num);
 }
 
 void PluginClient::JobMonitorHookAsync(task_id_t task_id,
@@ -195,10 +426,25 @@ void PluginClient::JobMonitorHookAsync(task_id_t task_id,
   request->set_task_id(task_id);
   request->set_cgroup(cgroup_path);
 
-  HookEvent e{HookType::JOB_MONITOR,
-              std::unique_ptr<google::protobuf::Message>(std::move(request))};
+  HookEvent e{.type = HookType::JOB_MONITOR,
+              .time = absl::ToUnixSeconds(absl::Now()),
+              .msg = std::move(request)};
+  EnqueueEvent_(std::move(e), 1);
+}
+
+void PluginClient::JobMonitorSamplesHookAsync(
+    crane::grpc::plugin::JobMonitorSamplesRequest samples) {
+  if (samples.series_list_size() == 0) return;
+
+  auto task_num = static_cast<uint32_t>(samples.series_list_size());
+  auto request =
+      std::make_unique<crane::grpc::plugin::JobMonitorSamplesRequest>(
+          std::move(samples));
 
-  m_event_queue_.enqueue(std::move(e));
+  HookEvent e{.type = HookType::JOB_MONITOR_SAMPLES,
+              .time = absl::ToUnixSeconds(absl::Now()),
+              .msg = std::move(request)};
+  EnqueueEvent_(std::move(e), task_num);
 }
 
 }  // namespace plugin
@@ -20,10 +20,16 @@
 #include <concurrentqueue/concurrentqueue.h>
 #include <google/protobuf/message.h>
 #include <grpcpp/channel.h>
+#include <grpcpp/client_context.h>
+#include <grpcpp/completion_queue.h>
 #include <grpcpp/support/status.h>
 
 #include <array>
+#include <chrono>
+#include <deque>
+#include <map>
 #include <memory>
+#include <optional>
 #include <thread>
 #include <vector>
 
@@ -49,49 +55,132 @@ class PluginClient {
     START,
     END,
     JOB_MONITOR,
+    JOB_MONITOR_SAMPLES,
     HookTypeCount,
   };
 
+  struct Options {
+    // The max number of tasks in the hook events which are not yet delivered
+    // to plugind. New hook events are dropped when it is reached, so that a
+    // slow plugind does not make the memory grow without bound.
+    uint32_t max_queued_tasks{kDefaultPluginMaxQueuedTasks};
+    // The max number of hook RPCs sent to plugind at the same time.
+    uint32_t max_inflight_rpcs{kDefaultPluginMaxInflightRpcs};
+    // Adjacent START or END hook events are merged into one RPC with at most
+    // this number of tasks.
+    uint32_t max_batch_size{kDefaultPluginMaxBatchSize};
+  };
+
+  /**
+   * A copy of the fields of a task taken when a hook is called. The
+   * TaskInfo sent to plugind is built from it on the plugin thread, so
+   * that the caller does not pay for building protobuf messages.
+   */
+  class TaskSnapshot {
+   public:
+    virtual ~TaskSnapshot() = default;
+    // Called once on the plugin thread. The snapshot is not used afterwards.
+    virtual void MoveToTaskInfo(crane::grpc::TaskInfo* task_info) = 0;
+  };
+  using TaskSnapshotPtr = std::unique_ptr<TaskSnapshot>;
+
   struct HookEvent {
     HookType type;
+    // Unix seconds when the hook is called.
+    int64_t time;
+    // The order in which the hook is called. Set by EnqueueEvent_().
+    uint64_t seq;
+    // For START and END.
+    std::vector<TaskSnapshotPtr> tasks;
+    // For JOB_MONITOR and JOB_MONITOR_SAMPLES.
     std::unique_ptr<google::protobuf::Message> msg;
   };
 
-  void InitChannelAndStub(const std::string& endpoint);
+  void InitChannelAndStub(const std::string& endpoint,
+                          const Options& options);
 
   // These functions are used to add HookEvent into the event queue.
-  void StartHookAsync(std::vector<crane::grpc::TaskInfo> tasks);
-  void EndHookAsync(std::vector<crane::grpc::TaskInfo> tasks);
+  void StartHookAsync(std::vector<TaskSnapshotPtr> tasks);
+  void EndHookAsync(std::vector<TaskSnapshotPtr> tasks);
   void JobMonitorHookAsync(task_id_t task_id, std::string cgroup_path);
+  void JobMonitorSamplesHookAsync(
+      crane::grpc::plugin::JobMonitorSamplesRequest samples);
+
+  // The number of tasks in the hook events dropped since the start.
+  uint64_t DroppedTaskNum() const { return m_dropped_task_num_.load(); }
 
  private:
-  // HookDispatchFunc is a function pointer type that handles different
-  // event.
-  using HookDispatchFunc = grpc::Status (PluginClient::*)(
-      grpc::ClientContext*, google::protobuf::Message* msg);
-  grpc::Status SendStartHook_(grpc::ClientContext* context,
-                              google::protobuf::Message* msg);
-  grpc::Status SendEndHook_(grpc::ClientContext* context,
-                            google::protobuf::Message* msg);
-  grpc::Status SendJobMonitorHook_(grpc::ClientContext* context,
-                                   google::protobuf::Message* msg);
+  // A hook RPC built from one or more hook events.
+  struct HookCall {
+    HookType type;
+    // The number of tasks counted in m_queued_task_num_.
+    uint32_t task_num;
+    std::unique_ptr<google::protobuf::Message> request;
+    std::unique_ptr<google::protobuf::Message> reply;
+
+    grpc::ClientContext context;
+    grpc::Status status;
+  };
+
+  // HookDispatchFunc is a function pointer type that starts the async RPC of
+  // different hook events.
+  using HookDispatchFunc = void (PluginClient::*)(HookCall* call);
+  void SendStartHook_(HookCall* call);
+  void SendEndHook_(HookCall* call);
+  void SendJobMonitorHook_(HookCall* call);
+  void SendJobMonitorSamplesHook_(HookCall* call);
+
+  // Return false and count the event as dropped if the queue is full.
+  bool EnqueueEvent_(HookEvent&& event, uint32_t task_num);
+
+  // The queue keeps the order of the events of one thread only. The
+  // dequeued events are held here and replaced by those whose preceding
+  // events in the order of seq have all been dequeued.
+  void ReleaseEventsInOrder_(std::vector<HookEvent>* events);
+
+  // Merge the events dequeued from m_event_queue_ into hook calls.
+  void BuildHookCalls_(std::vector<HookEvent>* events,
+                       std::deque<std::unique_ptr<HookCall>>* calls);
+
+  void FinishHookCall_(HookCall* call);
 
   void AsyncSendThread_();
 
+  Options m_options_;
+
   std::shared_ptr<Channel> m_channel_;
   std::unique_ptr<CranePluginD::Stub> m_stub_;
+  grpc::CompletionQueue m_cq_;
 
   std::thread m_async_send_thread_;
   std::atomic<bool> m_thread_stop_{false};
 
   ConcurrentQueue<HookEvent> m_event_queue_;
+  std::atomic<uint64_t> m_queued_task_num_{0};
+
+  // The seq of the next event to enqueue.
+  std::atomic<uint64_t> m_next_event_seq_{0};
+
+  // Used by the sending thread only.
+  std::map<uint64_t, HookEvent> m_held_events_;
+  uint64_t m_next_release_seq_{0};
+  // Since when a missing seq is waited for. An event missing for
+  // kSeqGapTimeout is regarded as lost.
+  std::optional<std::chrono::steady_clock::time_point> m_seq_gap_since_;
+  static constexpr std::chrono::seconds kSeqGapTimeout{1};
+
+  std::atomic<uint64_t> m_dropped_task_num_{0};
+  // Set when an event is dropped and cleared when an event is accepted again,
+  // so that a warning is logged once per congestion instead of per event.
+  std::atomic<bool> m_dropping_{false};
 
   // Use this array to dispatch the hook event to the corresponding function in
   // O(1) time.
   static constexpr std::array<HookDispatchFunc, size_t(HookType::HookTypeCount)>
       s_hook_dispatch_funcs_{{&PluginClient::SendStartHook_,
                               &PluginClient::SendEndHook_,
-                              &PluginClient::SendJobMonitorHook_}};
+                              &PluginClient::SendJobMonitorHook_,
+                              &PluginClient::SendJobMonitorSamplesHook_}};
 };
 
 }  // namespace plugin
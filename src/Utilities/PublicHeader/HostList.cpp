@@ -0,0 +1,698 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "crane/HostList.h"
+
+#include <absl/container/flat_hash_map.h>
+#include <absl/strings/ascii.h>
+#include <absl/strings/str_join.h>
+
+#include <algorithm>
+#include <charconv>
+
+#include "crane/Logger.h"
+
+namespace util {
+
+namespace {
+
+using Range = HostList::Range;
+
+// Longer numbers may not fit into uint64_t.
+constexpr uint32_t kMaxNumberWidth = 19;
+
+constexpr uint64_t Pow10(uint32_t n) {
+  uint64_t val = 1;
+  while (n-- > 0) val *= 10;
+  return val;
+}
+
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+void AppendNumber(uint64_t value, uint32_t width, std::string* out) {
+  char buf[kMaxNumberWidth + 1];
+  auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+  auto len = static_cast<uint32_t>(ptr - buf);
+  if (len < width) out->append(width - len, '0');
+  out->append(buf, ptr);
+}
+
+bool ParseNumber(std::string_view str, uint64_t* value) {
+  if (str.empty() || str.size() > kMaxNumberWidth) return false;
+  auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), *value);
+  return ec == std::errc() && ptr == str.data() + str.size();
+}
+
+/**
+ * Split host at its first number.
+ * @return false if host has no number or the number is too long.
+ */
+bool SplitAtFirstNumber(std::string_view host, std::string_view* prefix,
+                        uint64_t* value, uint32_t* width,
+                        std::string_view* suffix) {
+  size_t start = 0;
+  while (start < host.size() && !IsDigit(host[start])) start++;
+  if (start == host.size()) return false;
+
+  size_t end = start;
+  while (end < host.size() && IsDigit(host[end])) end++;
+  if (!ParseNumber(host.substr(start, end - start), value)) return false;
+
+  *prefix = host.substr(0, start);
+  *suffix = host.substr(end);
+  *width = end - start;
+  return true;
+}
+
+// Merge [first, last] into the sorted disjoint ranges.
+void InsertRange(uint64_t first, uint64_t last, std::vector<Range>* ranges) {
+  // The first range which overlaps or adjoins [first, last].
+  auto it = std::lower_bound(
+      ranges->begin(), ranges->end(), first,
+      [](const Range& range, uint64_t val) { return range.second + 1 < val; });
+  auto merge_end = it;
+  while (merge_end != ranges->end() && merge_end->first <= last + 1) {
+    first = std::min(first, merge_end->first);
+    last = std::max(last, merge_end->second);
+    ++merge_end;
+  }
+
+  if (it == merge_end) {
+    ranges->insert(it, {first, last});
+  } else {
+    *it = {first, last};
+    ranges->erase(std::next(it), merge_end);
+  }
+}
+
+void AppendMergedRange(const Range& range, std::vector<Range>* ranges) {
+  if (!ranges->empty() && ranges->back().second + 1 >= range.first)
+    ranges->back().second = std::max(ranges->back().second, range.second);
+  else
+    ranges->emplace_back(range);
+}
+
+std::vector<Range> UnionRanges(const std::vector<Range>& lhs,
+                               const std::vector<Range>& rhs) {
+  std::vector<Range> result;
+  result.reserve(lhs.size() + rhs.size());
+
+  auto l = lhs.begin();
+  auto r = rhs.begin();
+  while (l != lhs.end() || r != rhs.end()) {
+    if (r == rhs.end() || (l != lhs.end() && l->first < r->first))
+      AppendMergedRange(*l++, &result);
+    else
+      AppendMergedRange(*r++, &result);
+  }
+  return result;
+}
+
+std::vector<Range> IntersectRanges(const std::vector<Range>& lhs,
+                                   const std::vector<Range>& rhs) {
+  std::vector<Range> result;
+
+  auto l = lhs.begin();
+  auto r = rhs.begin();
+  while (l != lhs.end() && r != rhs.end()) {
+    uint64_t first = std::max(l->first, r->first);
+    uint64_t last = std::min(l->second, r->second);
+    if (first <= last) result.emplace_back(first, last);
+
+    if (l->second < r->second)
+      ++l;
+    else
+      ++r;
+  }
+  return result;
+}
+
+std::vector<Range> SubtractRanges(const std::vector<Range>& lhs,
+                                  const std::vector<Range>& rhs) {
+  std::vector<Range> result;
+
+  auto r = rhs.begin();
+  for (auto [first, last] : lhs) {
+    while (r != rhs.end() && r->second < first) ++r;
+
+    auto cur = r;
+    bool left = true;
+    while (cur != rhs.end() && cur->first <= last) {
+      if (cur->first > first) result.emplace_back(first, cur->first - 1);
+      if (cur->second >= last) {
+        left = false;
+        break;
+      }
+      first = cur->second + 1;
+      ++cur;
+    }
+    if (left) result.emplace_back(first, last);
+  }
+  return result;
+}
+
+// The ranges of the same prefix and suffix with the given width.
+struct RangeFamily {
+  uint32_t width;
+  const std::vector<Range>* ranges;
+};
+
+/**
+ * Append the content of a bracket, e.g. "1-9,012". Families are sorted by
+ * width. A range ending at 9...9 goes on with the range of the next width
+ * starting at 10...0 since "8-10" expands to 8, 9 and 10.
+ */
+void AppendBracketContent(const std::vector<RangeFamily>& families,
+                          std::string* out) {
+  // The range of each family which is already appended by stitching.
+  std::vector<size_t> stitched(families.size(), SIZE_MAX);
+  bool first_item = true;
+
+  for (size_t i = 0; i < families.size(); i++) {
+    const auto& ranges = *families[i].ranges;
+    for (size_t j = 0; j < ranges.size(); j++) {
+      if (j == stitched[i]) continue;
+
+      uint64_t last = ranges[j].second;
+      size_t k = i;
+      while (k + 1 < families.size() &&
+             families[k + 1].width == families[k].width + 1 &&
+             last == Pow10(families[k].width) - 1) {
+        const auto& next_ranges = *families[k + 1].ranges;
+        uint64_t next_first = Pow10(families[k].width);
+        auto it = std::lower_bound(
+            next_ranges.begin(), next_ranges.end(), next_first,
+            [](const Range& range, uint64_t val) { return range.first < val; });
+        if (it == next_ranges.end() || it->first != next_first) break;
+
+        stitched[k + 1] = it - next_ranges.begin();
+        last = it->second;
+        k++;
+      }
+
+      if (!first_item) out->push_back(',');
+      first_item = false;
+
+      AppendNumber(ranges[j].first, families[i].width, out);
+      if (last != ranges[j].first) {
+        out->push_back('-');
+        AppendNumber(last, families[k].width, out);
+      }
+    }
+  }
+}
+
+// Find the first number which is not in brackets.
+bool FindFirstNumberOutsideBrackets(std::string_view str, size_t* start,
+                                    size_t* end) {
+  size_t depth = 0;
+  for (size_t i = 0; i < str.size(); i++) {
+    if (str[i] == '[') {
+      depth++;
+    } else if (str[i] == ']') {
+      depth--;
+    } else if (depth == 0 && IsDigit(str[i])) {
+      *start = i;
+      *end = i;
+      while (*end < str.size() && IsDigit(str[*end])) (*end)++;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Remove the brackets which hold a single number, e.g. "a[1]" -> "a1".
+std::string RemoveSingleNumberBrackets(std::string_view str) {
+  std::string output;
+  output.reserve(str.size());
+
+  size_t pos = 0;
+  while (pos < str.size()) {
+    size_t open = str.find('[', pos);
+    if (open == std::string_view::npos) break;
+    size_t close = str.find(']', open);
+    if (close == std::string_view::npos) break;
+
+    std::string_view content = str.substr(open + 1, close - open - 1);
+    output.append(str.substr(pos, open - pos));
+    if (content.find_first_of("-,") == std::string_view::npos)
+      output.append(content);
+    else
+      output.append(str.substr(open, close - open + 1));
+    pos = close + 1;
+  }
+  output.append(str.substr(pos));
+  return output;
+}
+
+struct BracketItem {
+  uint64_t first;
+  uint64_t last;
+  // The length of the first number. Shorter numbers are padded with zeros.
+  uint32_t width;
+};
+
+// A literal if items is empty.
+struct Segment {
+  std::string_view literal;
+  std::vector<BracketItem> items;
+};
+
+using Term = std::vector<Segment>;
+
+bool ParseBracket(std::string_view content, std::vector<BracketItem>* items) {
+  size_t pos = 0;
+  while (true) {
+    size_t comma = content.find(',', pos);
+    std::string_view item = content.substr(
+        pos, comma == std::string_view::npos ? comma : comma - pos);
+
+    BracketItem bracket_item{};
+    size_t dash = item.find('-');
+    std::string_view first_str = item.substr(0, dash);
+    if (!ParseNumber(first_str, &bracket_item.first)) return false;
+    if (dash == std::string_view::npos) {
+      bracket_item.last = bracket_item.first;
+    } else if (!ParseNumber(item.substr(dash + 1), &bracket_item.last) ||
+               bracket_item.last < bracket_item.first) {
+      return false;
+    }
+    bracket_item.width = first_str.size();
+    items->emplace_back(bracket_item);
+
+    if (comma == std::string_view::npos) break;
+    pos = comma + 1;
+  }
+  return true;
+}
+
+/**
+ * Split a hostlist expression into terms. Whitespace should have been
+ * removed from expr. The terms refer to expr.
+ */
+bool ParseExpr(std::string_view expr, std::vector<Term>* terms) {
+  size_t pos = 0;
+  Term term;
+
+  while (pos <= expr.size()) {
+    size_t special = expr.find_first_of("[],", pos);
+    if (special == std::string_view::npos) special = expr.size();
+
+    if (special > pos)
+      term.emplace_back(Segment{.literal = expr.substr(pos, special - pos)});
+
+    if (special == expr.size() || expr[special] == ',') {
+      if (!term.empty()) terms->emplace_back(std::move(term));
+      term.clear();
+      pos = special + 1;
+      continue;
+    }
+
+    if (expr[special] == ']') {
+      CRANE_ERROR("Illegal node name string format: isolated bracket");
+      return false;
+    }
+
+    size_t close = expr.find_first_of("[]", special + 1);
+    if (close == std::string_view::npos || expr[close] == '[') {
+      CRANE_ERROR(close == std::string_view::npos
+                      ? "Illegal node name string format: isolated bracket"
+                      : "Illegal node name string format: duplicate brackets");
+      return false;
+    }
+
+    Segment segment;
+    if (!ParseBracket(expr.substr(special + 1, close - special - 1),
+                      &segment.items)) {
+      CRANE_ERROR("Illegal node name string format: bad bracket '{}'",
+                  expr.substr(special, close - special + 1));
+      return false;
+    }
+    term.emplace_back(std::move(segment));
+    pos = close + 1;
+  }
+
+  return true;
+}
+
+std::string RemoveWhitespace(std::string_view expr) {
+  std::string str;
+  str.reserve(expr.size());
+  for (char c : expr)
+    if (!absl::ascii_isspace(c)) str.push_back(c);
+  return str;
+}
+
+// Call fn with each host of segments[index...] appended to buf.
+void ExpandSegments(const Term& term, size_t index, std::string* buf,
+                    const std::function<void(std::string_view)>& fn) {
+  if (index == term.size()) {
+    fn(*buf);
+    return;
+  }
+
+  size_t len = buf->size();
+  const Segment& segment = term[index];
+  if (segment.items.empty()) {
+    buf->append(segment.literal);
+    ExpandSegments(term, index + 1, buf, fn);
+  } else {
+    for (const auto& item : segment.items) {
+      for (uint64_t val = item.first;; val++) {
+        AppendNumber(val, item.width, buf);
+        ExpandSegments(term, index + 1, buf, fn);
+        buf->resize(len);
+        if (val == item.last) break;
+      }
+    }
+  }
+  buf->resize(len);
+}
+
+}  // namespace
+
+bool ForEachHostInExpr(std::string_view expr,
+                       const std::function<void(std::string_view)>& fn) {
+  std::string normalized = RemoveWhitespace(expr);
+  std::vector<Term> terms;
+  if (!ParseExpr(normalized, &terms)) return false;
+
+  std::string buf;
+  for (const auto& term : terms) ExpandSegments(term, 0, &buf, fn);
+  return true;
+}
+
+bool HostList::Parse(std::string_view expr) {
+  std::string normalized = RemoveWhitespace(expr);
+  std::vector<Term> terms;
+  if (!ParseExpr(normalized, &terms)) return false;
+
+  std::string buf;
+  for (const auto& term : terms) {
+    // If the first number of the hosts is the first bracket, add its items
+    // as ranges once for each suffix instead of host by host.
+    size_t bracket_index = term[0].items.empty() ? 1 : 0;
+    bool fast_path =
+        bracket_index < term.size() && !term[bracket_index].items.empty() &&
+        (bracket_index == 0 ||
+         std::ranges::none_of(term[0].literal, IsDigit)) &&
+        (bracket_index + 1 == term.size() ||
+         (term[bracket_index + 1].items.empty() &&
+          !IsDigit(term[bracket_index + 1].literal.front())));
+
+    if (!fast_path) {
+      ExpandSegments(term, 0, &buf,
+                     [this](std::string_view host) { Insert(host); });
+      continue;
+    }
+
+    std::string_view prefix =
+        bracket_index == 0 ? std::string_view{} : term[0].literal;
+    Term suffix_term(term.begin() + bracket_index + 1, term.end());
+    ExpandSegments(suffix_term, 0, &buf, [&](std::string_view suffix) {
+      for (const auto& item : term[bracket_index].items) {
+        // The numbers longer than the width are not padded.
+        uint64_t first = item.first;
+        for (uint32_t width = item.width; first <= item.last; width++) {
+          uint64_t last = width >= kMaxNumberWidth
+                              ? item.last
+                              : std::min(item.last, Pow10(width) - 1);
+          AddRange_({prefix, suffix, width}, first, last);
+          first = last + 1;
+          if (last == item.last) break;
+        }
+      }
+    });
+  }
+  return true;
+}
+
+void HostList::Insert(std::string_view host) {
+  if (host.empty()) return;
+
+  RangeKeyView key{};
+  uint64_t value;
+  if (!SplitAtFirstNumber(host, &key.prefix, &value, &key.width,
+                          &key.suffix)) {
+    m_plain_hosts_.emplace(host);
+    return;
+  }
+  AddRange_(key, value, value);
+}
+
+void HostList::InsertBulk(const std::vector<std::string_view>& hosts) {
+  // The numbers of each key. Consecutive hosts usually share the key.
+  absl::flat_hash_map<std::tuple<std::string_view, std::string_view, uint32_t>,
+                      std::vector<uint64_t>>
+      key_values_map;
+  std::vector<uint64_t>* last_values = nullptr;
+  RangeKeyView last_key{};
+
+  for (std::string_view host : hosts) {
+    if (host.empty()) continue;
+
+    RangeKeyView key{};
+    uint64_t value;
+    if (!SplitAtFirstNumber(host, &key.prefix, &value, &key.width,
+                            &key.suffix)) {
+      m_plain_hosts_.emplace(host);
+      continue;
+    }
+
+    if (last_values == nullptr || key.prefix != last_key.prefix ||
+        key.suffix != last_key.suffix || key.width != last_key.width) {
+      last_key = key;
+      last_values = &key_values_map[{key.prefix, key.suffix, key.width}];
+    }
+    last_values->emplace_back(value);
+  }
+
+  std::vector<Range> ranges;
+  for (auto& [key_tuple, values] : key_values_map) {
+    RangeKeyView key{.prefix = std::get<0>(key_tuple),
+                     .suffix = std::get<1>(key_tuple),
+                     .width = std::get<2>(key_tuple)};
+    std::ranges::sort(values);
+    ranges.clear();
+    for (uint64_t value : values) AppendMergedRange({value, value}, &ranges);
+
+    auto it = m_ranges_.find(key);
+    if (it == m_ranges_.end())
+      m_ranges_.emplace(RangeKey{.prefix = std::string(key.prefix),
+                                 .suffix = std::string(key.suffix),
+                                 .width = key.width},
+                        ranges);
+    else
+      it->second = UnionRanges(it->second, ranges);
+  }
+}
+
+void HostList::AddRange_(const RangeKeyView& key, uint64_t first,
+                         uint64_t last) {
+  auto it = m_ranges_.find(key);
+  if (it == m_ranges_.end())
+    it = m_ranges_
+             .emplace(RangeKey{.prefix = std::string(key.prefix),
+                               .suffix = std::string(key.suffix),
+                               .width = key.width},
+                      std::vector<Range>{})
+             .first;
+  InsertRange(first, last, &it->second);
+}
+
+bool HostList::Contains(std::string_view host) const {
+  RangeKeyView key{};
+  uint64_t value;
+  if (!SplitAtFirstNumber(host, &key.prefix, &value, &key.width,
+                          &key.suffix))
+    return m_plain_hosts_.contains(host);
+
+  auto it = m_ranges_.find(key);
+  if (it == m_ranges_.end()) return false;
+
+  const auto& ranges = it->second;
+  auto range_it = std::upper_bound(
+      ranges.begin(), ranges.end(), value,
+      [](uint64_t val, const Range& range) { return val < range.first; });
+  return range_it != ranges.begin() && std::prev(range_it)->second >= value;
+}
+
+size_t HostList::Size() const {
+  size_t size = m_plain_hosts_.size();
+  for (const auto& [key, ranges] : m_ranges_)
+    for (const auto& [first, last] : ranges) size += last - first + 1;
+  return size;
+}
+
+void HostList::Clear() {
+  m_ranges_.clear();
+  m_plain_hosts_.clear();
+}
+
+HostList& HostList::operator|=(const HostList& rhs) {
+  for (const auto& [key, ranges] : rhs.m_ranges_) {
+    auto [it, inserted] = m_ranges_.try_emplace(key, ranges);
+    if (!inserted) it->second = UnionRanges(it->second, ranges);
+  }
+  m_plain_hosts_.insert(rhs.m_plain_hosts_.begin(), rhs.m_plain_hosts_.end());
+  return *this;
+}
+
+HostList& HostList::operator&=(const HostList& rhs) {
+  for (auto it = m_ranges_.begin(); it != m_ranges_.end();) {
+    auto rhs_it = rhs.m_ranges_.find(it->first);
+    if (rhs_it != rhs.m_ranges_.end())
+      it->second = IntersectRanges(it->second, rhs_it->second);
+
+    if (rhs_it == rhs.m_ranges_.end() || it->second.empty())
+      it = m_ranges_.erase(it);
+    else
+      ++it;
+  }
+
+  std::erase_if(m_plain_hosts_, [&rhs](const std::string& host) {
+    return !rhs.m_plain_hosts_.contains(host);
+  });
+  return *this;
+}
+
+HostList& HostList::operator-=(const HostList& rhs) {
+  for (auto it = m_ranges_.begin(); it != m_ranges_.end();) {
+    auto rhs_it = rhs.m_ranges_.find(it->first);
+    if (rhs_it != rhs.m_ranges_.end())
+      it->second = SubtractRanges(it->second, rhs_it->second);
+
+    if (it->second.empty())
+      it = m_ranges_.erase(it);
+    else
+      ++it;
+  }
+
+  for (const auto& host : rhs.m_plain_hosts_) m_plain_hosts_.erase(host);
+  return *this;
+}
+
+void HostList::ForEach(const std::function<void(std::string_view)>& fn) const {
+  std::string buf;
+  for (const auto& [key, ranges] : m_ranges_) {
+    buf = key.prefix;
+    for (const auto& [first, last] : ranges) {
+      for (uint64_t val = first;; val++) {
+        buf.resize(key.prefix.size());
+        AppendNumber(val, key.width, &buf);
+        buf.append(key.suffix);
+        fn(buf);
+        if (val == last) break;
+      }
+    }
+  }
+
+  for (const auto& host : m_plain_hosts_) fn(host);
+}
+
+std::string HostList::Encode() const {
+  // The items whose first number is folded into brackets.
+  std::vector<std::string> pending;
+  std::vector<std::string> done(m_plain_hosts_.begin(), m_plain_hosts_.end());
+
+  // The keys with the same prefix and suffix are adjacent in m_ranges_.
+  std::vector<RangeFamily> families;
+  for (auto it = m_ranges_.begin(); it != m_ranges_.end();) {
+    const RangeKey& key = it->first;
+
+    families.clear();
+    for (; it != m_ranges_.end() && it->first.prefix == key.prefix &&
+           it->first.suffix == key.suffix;
+         ++it)
+      families.emplace_back(it->first.width, &it->second);
+
+    std::string item{key.prefix};
+    item.push_back('[');
+    AppendBracketContent(families, &item);
+    item.push_back(']');
+    item.append(key.suffix);
+    pending.emplace_back(std::move(item));
+  }
+
+  // Fold the next number of the items in the same way until no number is
+  // left outside brackets.
+  struct NumberInItem {
+    std::string_view head;
+    std::string_view tail;
+    uint32_t width;
+    uint64_t value;
+  };
+  while (!pending.empty()) {
+    std::vector<NumberInItem> numbers;
+    for (auto& item : pending) {
+      size_t start, end;
+      NumberInItem number{};
+      if (!FindFirstNumberOutsideBrackets(item, &start, &end) ||
+          !ParseNumber(std::string_view(item).substr(start, end - start),
+                       &number.value)) {
+        done.emplace_back(std::move(item));
+        continue;
+      }
+      number.head = std::string_view(item).substr(0, start);
+      number.tail = std::string_view(item).substr(end);
+      number.width = end - start;
+      numbers.emplace_back(number);
+    }
+
+    std::ranges::sort(numbers, [](const auto& lhs, const auto& rhs) {
+      return std::tie(lhs.head, lhs.tail, lhs.width, lhs.value) <
+             std::tie(rhs.head, rhs.tail, rhs.width, rhs.value);
+    });
+
+    std::vector<std::string> next;
+    std::vector<std::vector<Range>> family_ranges;
+    for (size_t i = 0; i < numbers.size();) {
+      size_t group_end = i;
+      while (group_end < numbers.size() &&
+             numbers[group_end].head == numbers[i].head &&
+             numbers[group_end].tail == numbers[i].tail)
+        group_end++;
+
+      families.clear();
+      family_ranges.clear();
+      for (size_t j = i; j < group_end; j++) {
+        if (j == i || numbers[j].width != numbers[j - 1].width) {
+          families.emplace_back(numbers[j].width, nullptr);
+          family_ranges.emplace_back();
+        }
+        AppendMergedRange({numbers[j].value, numbers[j].value},
+                          &family_ranges.back());
+      }
+      for (size_t j = 0; j < families.size(); j++)
+        families[j].ranges = &family_ranges[j];
+
+      std::string item{numbers[i].head};
+      item.push_back('[');
+      AppendBracketContent(families, &item);
+      item.push_back(']');
+      item.append(numbers[i].tail);
+      next.emplace_back(std::move(item));
+
+      i = group_end;
+    }
+    pending = std::move(next);
+  }
+
+  std::ranges::sort(done);
+  return RemoveSingleNumberBrackets(absl::StrJoin(done, ","));
+}
+
+}  // namespace util
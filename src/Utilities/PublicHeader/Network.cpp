@@ -16,6 +16,11 @@
 
 #include "crane/Network.h"
 
+#include <linux/inet_diag.h>
+#include <linux/netlink.h>
+#include <linux/sock_diag.h>
+#include <sys/socket.h>
+
 #include "crane/Logger.h"
 
 namespace crane {
@@ -333,4 +338,105 @@ bool FindTcpInodeByPort(const std::string& tcp_path, int port, ino_t* inode) {
   return false;
 }
 
-}  // namespace crane
\ No newline at end of file
+namespace {
+
+// Send a SOCK_DIAG_BY_FAMILY request for the tcp sockets of the given family
+// whose local port is port. The port filter is evaluated by the kernel with
+// inet_diag bytecode, so only the matched sockets are returned.
+// @return -1 on netlink failure, 0 if no socket is found, otherwise 1.
+int QueryTcpInodeByNetlink(int nl_fd, uint8_t family, uint16_t port,
+                           ino_t* inode) {
+  // local port >= port && local port <= port
+  struct {
+    inet_diag_bc_op ge;
+    inet_diag_bc_op ge_port;
+    inet_diag_bc_op le;
+    inet_diag_bc_op le_port;
+  } bytecode{};
+
+  // The `yes` offset jumps to the next operation and the `no` offset jumps
+  // beyond the end of the bytecode, which rejects the socket.
+  bytecode.ge = {INET_DIAG_BC_S_GE, 2 * sizeof(inet_diag_bc_op),
+                 sizeof(bytecode) + sizeof(inet_diag_bc_op)};
+  bytecode.ge_port.no = port;
+  bytecode.le = {INET_DIAG_BC_S_LE, 2 * sizeof(inet_diag_bc_op),
+                 2 * sizeof(inet_diag_bc_op) + sizeof(inet_diag_bc_op)};
+  bytecode.le_port.no = port;
+
+  struct {
+    nlmsghdr nlh;
+    inet_diag_req_v2 req;
+    nlattr bc_attr;
+  } msg{};
+
+  msg.nlh.nlmsg_len = sizeof(msg) + sizeof(bytecode);
+  msg.nlh.nlmsg_type = SOCK_DIAG_BY_FAMILY;
+  msg.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  msg.req.sdiag_family = family;
+  msg.req.sdiag_protocol = IPPROTO_TCP;
+  msg.req.idiag_states = ~0U;
+  msg.bc_attr.nla_type = INET_DIAG_REQ_BYTECODE;
+  msg.bc_attr.nla_len = sizeof(nlattr) + sizeof(bytecode);
+
+  sockaddr_nl kernel_addr{.nl_family = AF_NETLINK};
+  iovec iov[2] = {{&msg, sizeof(msg)}, {&bytecode, sizeof(bytecode)}};
+  msghdr req_hdr{.msg_name = &kernel_addr,
+                 .msg_namelen = sizeof(kernel_addr),
+                 .msg_iov = iov,
+                 .msg_iovlen = 2};
+  if (sendmsg(nl_fd, &req_hdr, 0) == -1) return -1;
+
+  bool found = false;
+  alignas(nlmsghdr) char buf[32768];
+  while (true) {
+    ssize_t len = recv(nl_fd, buf, sizeof(buf), 0);
+    if (len == -1 && errno == EINTR) continue;
+    if (len <= 0) return -1;
+
+    auto* nlh = reinterpret_cast<nlmsghdr*>(buf);
+    for (; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+      if (nlh->nlmsg_type == NLMSG_DONE) return found ? 1 : 0;
+      if (nlh->nlmsg_type == NLMSG_ERROR) return -1;
+
+      auto* diag_msg = static_cast<inet_diag_msg*>(NLMSG_DATA(nlh));
+      // Sockets in TIME_WAIT have no inode and are not owned by any process.
+      if (!found && diag_msg->idiag_inode != 0) {
+        *inode = diag_msg->idiag_inode;
+        found = true;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+bool FindTcpInodeByPortNetlink(int port, ino_t* inode, bool* available) {
+  *available = false;
+  if (port <= 0 || port > UINT16_MAX) return false;
+
+  int nl_fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_SOCK_DIAG);
+  if (nl_fd == -1) {
+    CRANE_DEBUG("Failed to create NETLINK_SOCK_DIAG socket: {}",
+                strerror(errno));
+    return false;
+  }
+
+  int rc = 0;
+  for (uint8_t family : {AF_INET, AF_INET6}) {
+    rc = QueryTcpInodeByNetlink(nl_fd, family, port, inode);
+    if (rc != 0) break;
+  }
+  close(nl_fd);
+
+  if (rc == -1) {
+    CRANE_DEBUG("Failed to query tcp sockets by NETLINK_SOCK_DIAG: {}",
+                strerror(errno));
+    return false;
+  }
+
+  *available = true;
+  if (rc == 1) CRANE_TRACE("Inode num for port {} is {}", port, *inode);
+  return rc == 1;
+}
+
+}  // namespace crane
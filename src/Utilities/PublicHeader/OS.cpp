@@ -17,6 +17,7 @@
 #include "crane/OS.h"
 
 #if defined(__linux__) || defined(__unix__)
+#  include <dirent.h>
 #  include <sys/sysinfo.h>
 #  include <sys/utsname.h>
 #elif defined(_WIN32)
@@ -144,4 +145,31 @@ absl::Time GetSystemBootTime() {
 #endif
 }
 
+bool ProcessHasSocketInode(pid_t pid, ino_t inode) {
+  std::string fd_dir = fmt::format("/proc/{}/fd", pid);
+  DIR* dir = opendir(fd_dir.c_str());
+  if (dir == nullptr) return false;
+
+  // Compare the link targets instead of stat()-ing every fd, which avoids
+  // resolving the files behind the fds.
+  std::string target = fmt::format("socket:[{}]", inode);
+  char link_buf[64];
+  bool found = false;
+
+  int dir_fd = dirfd(dir);
+  while (dirent* entry = readdir(dir)) {
+    if (entry->d_name[0] == '.') continue;
+    ssize_t len =
+        readlinkat(dir_fd, entry->d_name, link_buf, sizeof(link_buf));
+    if (len == static_cast<ssize_t>(target.size()) &&
+        target.compare(0, len, link_buf, len) == 0) {
+      found = true;
+      break;
+    }
+  }
+
+  closedir(dir);
+  return found;
+}
+
 }  // namespace util::os
\ No newline at end of file
@@ -170,9 +170,25 @@ DedicatedResourceInNode Intersection(const DedicatedResourceInNode& lhs,
       result.name_type_slots_map[lhs_name] = std::move(intersection);
   }
 
+  // The affinity of rhs is used if both sides know the same slot.
+  for (const auto* affinity_map : {&rhs.slot_affinity_map,
+                                   &lhs.slot_affinity_map})
+    for (const auto& [slot, affinity] : *affinity_map)
+      result.slot_affinity_map.emplace(slot, affinity);
+
   return result;
 }
 
+SlotAffinity::SlotAffinity(const crane::grpc::SlotAffinity& rhs)
+    : numa_node(rhs.numa_node()), pcie_switch(rhs.pcie_switch()) {}
+
+SlotAffinity::operator crane::grpc::SlotAffinity() const {
+  crane::grpc::SlotAffinity val{};
+  val.set_numa_node(numa_node);
+  val.set_pcie_switch(pcie_switch);
+  return val;
+}
+
 AllocatableResource::AllocatableResource(
     const crane::grpc::AllocatableResource& value) {
   cpu_count = cpu_t{value.cpu_core_limit()};
@@ -225,6 +241,9 @@ DedicatedResourceInNode& DedicatedResourceInNode::operator+=(
   for (const auto& [rhs_name, rhs_type_slots_map] : rhs.name_type_slots_map)
     this->name_type_slots_map[rhs_name] += rhs_type_slots_map;
 
+  for (const auto& [slot, affinity] : rhs.slot_affinity_map)
+    this->slot_affinity_map.insert_or_assign(slot, affinity);
+
   return *this;
 }
 
@@ -262,16 +281,23 @@ DedicatedResourceInNode::DedicatedResourceInNode(
   for (const auto& [name, type_slots_map] : rhs.name_type_map())
     // Implicitly call grpc::DeviceTypeSlotsMap -> TypeSlotsMap conversion
     this->name_type_slots_map.emplace(name, type_slots_map);
+
+  for (const auto& [slot, affinity] : rhs.slot_affinity_map())
+    this->slot_affinity_map.emplace(slot, affinity);
 }
 
 DedicatedResourceInNode& DedicatedResourceInNode::operator=(
     const crane::grpc::DedicatedResourceInNode& rhs) {
   this->name_type_slots_map.clear();
+  this->slot_affinity_map.clear();
 
   for (const auto& [name, type_slots_map] : rhs.name_type_map())
     // Implicitly call grpc::DeviceTypeSlotsMap -> TypeSlotsMap conversion
     this->name_type_slots_map[name] = type_slots_map;
 
+  for (const auto& [slot, affinity] : rhs.slot_affinity_map())
+    this->slot_affinity_map.emplace(slot, affinity);
+
   return *this;
 }
 
@@ -310,6 +336,11 @@ DedicatedResourceInNode::operator crane::grpc::DedicatedResourceInNode() const {
         static_cast<crane::grpc::DeviceTypeSlotsMap>(type_slots_map);
   }
 
+  auto* grpc_slot_affinity_map = val.mutable_slot_affinity_map();
+  for (const auto& [slot, affinity] : this->slot_affinity_map)
+    (*grpc_slot_affinity_map)[slot] =
+        static_cast<crane::grpc::SlotAffinity>(affinity);
+
   return val;
 }
 
@@ -716,6 +747,15 @@ bool ResourceView::GetFeasibleResourceInNode(const ResourceInNode& avail_res,
 
   feasible_res->allocatable_res = this->allocatable_res;
 
+  // Available slots sharing the same affinity.
+  struct Domain {
+    uint64_t size{0};
+    std::map<std::string /*type*/, std::vector<SlotId>> type_slots;
+  };
+
+  const SlotAffinity unknown_affinity{};
+  const auto& affinity_map = avail_res.dedicated_res.slot_affinity_map;
+
   // chose slot for each node gres request
   for (const auto& [dev_name, name_type_req] : this->device_map) {
     auto dres_avail_it =
@@ -729,36 +769,91 @@ bool ResourceView::GetFeasibleResourceInNode(const ResourceInNode& avail_res,
     uint64_t untyped_cnt = name_type_req.first;
     const auto& typed_cnt_map = name_type_req.second;
 
-    auto& feasible_res_dev_name = feasible_res->dedicated_res[dev_name];
-
+    uint64_t typed_total = 0;
     for (const auto& [dev_type, typed_cnt] : typed_cnt_map) {
       auto avail_slots_it = dres_avail.type_slots_map.find(dev_type);
-      if (avail_slots_it == dres_avail.type_slots_map.end()) return false;
+      if (avail_slots_it == dres_avail.type_slots_map.end() ||
+          avail_slots_it->second.size() < typed_cnt)
+        return false;
+      typed_total += typed_cnt;
+    }
 
-      const auto& avail_slots = avail_slots_it->second;
-      auto& feasible_res_dev_name_type = feasible_res_dev_name[dev_type];
+    // Slots without affinity fall into the same domain, so the slots are
+    // chosen in the order of std::set if no affinity is known.
+    std::map<SlotAffinity, Domain> domains;
+    uint64_t avail_total = 0;
+    for (const auto& [dev_type, slots] : dres_avail.type_slots_map) {
+      for (const auto& slot : slots) {
+        auto affinity_it = affinity_map.find(slot);
+        Domain& domain = domains[affinity_it == affinity_map.end()
+                                     ? unknown_affinity
+                                     : affinity_it->second];
+        domain.type_slots[dev_type].emplace_back(slot);
+        ++domain.size;
+      }
+      avail_total += slots.size();
+    }
+    if (avail_total < typed_total + untyped_cnt) return false;
+
+    auto holds_all = [&](const Domain& domain) {
+      if (domain.size < typed_total + untyped_cnt) return false;
+      for (const auto& [dev_type, typed_cnt] : typed_cnt_map) {
+        auto it = domain.type_slots.find(dev_type);
+        if (typed_cnt > 0 &&
+            (it == domain.type_slots.end() || it->second.size() < typed_cnt))
+          return false;
+      }
+      return true;
+    };
+
+    // The smallest domain holding the whole request comes first, which keeps
+    // larger domains for larger requests. Then the larger domains come first
+    // so that a request spans as few domains as possible.
+    std::vector<const Domain*> order;
+    order.reserve(domains.size());
+    for (const auto& [affinity, domain] : domains) order.emplace_back(&domain);
+    std::ranges::stable_sort(order, [](const Domain* lhs, const Domain* rhs) {
+      return lhs->size > rhs->size;
+    });
+
+    auto best_it = order.end();
+    for (auto it = order.begin(); it != order.end(); ++it)
+      if (holds_all(**it) &&
+          (best_it == order.end() || (*it)->size < (*best_it)->size))
+        best_it = it;
+    if (best_it != order.end())
+      std::rotate(order.begin(), best_it, best_it + 1);
 
-      if (avail_slots.size() < typed_cnt) return false;
+    auto& feasible_res_dev_name = feasible_res->dedicated_res[dev_name];
 
-      auto it = avail_slots.begin();
-      for (size_t i = 0; i < typed_cnt; ++i, ++it)
-        feasible_res_dev_name_type.emplace(*it);
+    for (const auto& [dev_type, typed_cnt] : typed_cnt_map) {
+      auto& feasible_res_dev_name_type = feasible_res_dev_name[dev_type];
 
-      for (; untyped_cnt > 0 && it != avail_slots.end(); ++it, --untyped_cnt)
-        feasible_res_dev_name_type.emplace(*it);
+      uint64_t needed = typed_cnt;
+      for (const Domain* domain : order) {
+        if (needed == 0) break;
+        auto it = domain->type_slots.find(dev_type);
+        if (it == domain->type_slots.end()) continue;
+
+        for (const auto& slot : it->second) {
+          if (needed == 0) break;
+          feasible_res_dev_name_type.emplace(slot);
+          --needed;
+        }
+      }
     }
 
-    // If there are still untyped slots to be allocated,
-    // we need to find the remaining slots from other types.
-    if (untyped_cnt > 0) {
-      for (const auto& [type, slots] : dres_avail.type_slots_map) {
-        if (typed_cnt_map.contains(type)) continue;
-
-        auto it = slots.begin();
-        for (; untyped_cnt > 0 && it != slots.end(); ++it, --untyped_cnt)
-          feasible_res_dev_name[type].emplace(*it);
-
+    // Untyped slots can be of any type not chosen yet.
+    for (const Domain* domain : order) {
+      if (untyped_cnt == 0) break;
+      for (const auto& [dev_type, slots] : domain->type_slots) {
         if (untyped_cnt == 0) break;
+
+        auto& feasible_res_dev_name_type = feasible_res_dev_name[dev_type];
+        for (const auto& slot : slots) {
+          if (untyped_cnt == 0) break;
+          if (feasible_res_dev_name_type.emplace(slot).second) --untyped_cnt;
+        }
       }
     }
 
@@ -0,0 +1,210 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "crane/RelayTree.h"
+
+#include <string_view>
+#include <unordered_set>
+
+#include "crane/Logger.h"
+
+namespace crane {
+
+namespace {
+
+struct RelayCall {
+  // The targets [begin, end) are sent to the craned of targets[begin].
+  int begin;
+  int end;
+  bool direct;
+
+  std::shared_ptr<crane::grpc::Craned::Stub> stub;
+  ::grpc::ClientContext context;
+  crane::grpc::RelayRequest request;
+  crane::grpc::RelayReply reply;
+  ::grpc::Status status;
+  std::unique_ptr<::grpc::ClientAsyncResponseReader<crane::grpc::RelayReply>>
+      reader;
+};
+
+}  // namespace
+
+RelayTree::RelayTree(uint32_t fan_out, CranedStubGetter stub_getter,
+                     std::chrono::milliseconds hop_timeout)
+    : m_fan_out_(fan_out),
+      m_stub_getter_(std::move(stub_getter)),
+      m_hop_timeout_(hop_timeout) {}
+
+uint32_t RelayTree::Depth(uint32_t fan_out, size_t target_num) {
+  if (fan_out == 0) return target_num == 0 ? 0 : 1;
+
+  uint32_t depth = 0;
+  while (target_num > 0) {
+    depth++;
+    // The relay handles one target and each of its subtrees holds at most
+    // ceil((target_num - 1) / fan_out) targets.
+    target_num = (target_num - 1 + fan_out - 1) / fan_out;
+  }
+  return depth;
+}
+
+std::vector<std::string> RelayTree::Broadcast(
+    const google::protobuf::RepeatedPtrField<crane::grpc::RelayTarget>&
+        targets) const {
+  uint32_t hop_num = Depth(m_fan_out_, targets.size()) + 1;
+  return Broadcast(targets,
+                   std::chrono::system_clock::now() + m_hop_timeout_ * hop_num);
+}
+
+std::vector<std::string> RelayTree::Broadcast(
+    const google::protobuf::RepeatedPtrField<crane::grpc::RelayTarget>&
+        targets,
+    std::chrono::system_clock::time_point deadline) const {
+  std::vector<std::string> failed_craned_ids;
+  if (targets.empty()) return failed_craned_ids;
+
+  ::grpc::CompletionQueue cq;
+  std::vector<std::unique_ptr<RelayCall>> calls;
+  size_t pending_call_num = 0;
+  std::vector<bool> confirmed(targets.size(), false);
+
+  auto start_call = [&](int begin, int end, bool direct) {
+    const std::string& craned_id = targets[begin].craned_id();
+    auto now = std::chrono::system_clock::now();
+    if (now >= deadline) return false;
+
+    auto stub = m_stub_getter_(craned_id);
+    if (!stub) {
+      CRANE_DEBUG("No stub of craned {} for relaying.", craned_id);
+      return false;
+    }
+
+    auto call = std::make_unique<RelayCall>();
+    call->begin = begin;
+    call->end = end;
+    call->direct = direct;
+    call->stub = std::move(stub);
+
+    uint32_t fan_out = direct ? 0 : m_fan_out_;
+    for (int i = begin; i < end; i++) *call->request.add_targets() = targets[i];
+    call->request.set_fan_out(fan_out);
+    call->context.set_deadline(std::min(
+        deadline, now + m_hop_timeout_ * Depth(fan_out, end - begin)));
+
+    call->reader = call->stub->AsyncRelay(&call->context, call->request, &cq);
+    call->reader->Finish(&call->reply, &call->status, call.get());
+
+    calls.emplace_back(std::move(call));
+    pending_call_num++;
+    return true;
+  };
+
+  // Send each unconfirmed craned of [begin, end) its own target.
+  auto send_directly = [&](int begin, int end) {
+    for (int i = begin; i < end; i++)
+      if (!confirmed[i]) start_call(i, i + 1, true);
+  };
+
+  int target_num = targets.size();
+  int group_num =
+      m_fan_out_ == 0 ? target_num : std::min<int>(target_num, m_fan_out_);
+  int base_size = target_num / group_num;
+  int extra = target_num % group_num;
+
+  int begin = 0;
+  for (int g = 0; g < group_num; g++) {
+    int end = begin + base_size + (g < extra ? 1 : 0);
+    // A relay without a stub is not retried, but its subtree is.
+    if (!start_call(begin, end, end - begin == 1))
+      send_directly(begin + 1, end);
+    begin = end;
+  }
+
+  void* tag;
+  bool ok;
+  while (pending_call_num > 0 && cq.Next(&tag, &ok)) {
+    pending_call_num--;
+    auto* call = static_cast<RelayCall*>(tag);
+
+    if (call->status.ok()) {
+      // Only the targets of this subtree can be confirmed by its relay.
+      std::unordered_set<std::string_view> delivered(
+          call->reply.delivered_craned_ids().begin(),
+          call->reply.delivered_craned_ids().end());
+      for (int i = call->begin; i < call->end; i++)
+        if (delivered.contains(targets[i].craned_id())) confirmed[i] = true;
+    } else {
+      CRANE_DEBUG("Relay RPC to craned {} for {} target(s) failed: {}",
+                  targets[call->begin].craned_id(), call->end - call->begin,
+                  call->status.error_message());
+    }
+
+    // The craneds which the relay can not confirm, including the relay
+    // itself if it does not reply, are retried directly. The confirmed ones
+    // are never sent twice.
+    if (!call->direct) send_directly(call->begin, call->end);
+  }
+
+  cq.Shutdown();
+  while (cq.Next(&tag, &ok));
+
+  for (int i = 0; i < target_num; i++)
+    if (!confirmed[i]) failed_craned_ids.emplace_back(targets[i].craned_id());
+
+  return failed_craned_ids;
+}
+
+::grpc::Status RelayTree::ServeRelay(const ::grpc::ServerContext& context,
+                                     const crane::grpc::RelayRequest& request,
+                                     crane::grpc::RelayReply* reply,
+                                     const std::string& local_craned_id,
+                                     const LocalHandler& local_handler) const {
+  if (request.targets().empty()) return ::grpc::Status::OK;
+
+  const crane::grpc::RelayTarget& local_target = request.targets(0);
+  if (local_target.craned_id() != local_craned_id) {
+    CRANE_ERROR("Relay request for craned {} is received by craned {}.",
+                local_target.craned_id(), local_craned_id);
+    return {::grpc::StatusCode::INVALID_ARGUMENT,
+            "The first target is not the receiver."};
+  }
+
+  // The local target is handled first. The handlers only queue the work or
+  // do it quickly, so the subtree is not delayed much.
+  if (local_handler(local_target))
+    reply->add_delivered_craned_ids(local_craned_id);
+
+  if (request.targets_size() == 1) return ::grpc::Status::OK;
+
+  google::protobuf::RepeatedPtrField<crane::grpc::RelayTarget> subtree(
+      request.targets().begin() + 1, request.targets().end());
+  RelayTree relay_tree(request.fan_out(), m_stub_getter_, m_hop_timeout_);
+
+  // Leave a part of a hop for the reply to reach the caller, so that the
+  // confirmed craneds of a slow subtree are not retried by the caller.
+  std::vector<std::string> failed_ids = relay_tree.Broadcast(
+      subtree, context.deadline() - m_hop_timeout_ / 4);
+
+  std::unordered_set<std::string_view> failed(failed_ids.begin(),
+                                              failed_ids.end());
+  for (const auto& target : subtree)
+    if (!failed.contains(target.craned_id()))
+      reply->add_delivered_craned_ids(target.craned_id());
+
+  return ::grpc::Status::OK;
+}
+
+}  // namespace crane
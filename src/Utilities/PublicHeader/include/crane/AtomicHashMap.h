@@ -17,6 +17,9 @@
 #pragma once
 
 #include <absl/container/flat_hash_map.h>
+#include <absl/hash/hash.h>
+
+#include <array>
 
 #include "Lock.h"
 #include "Pointer.h"
@@ -186,4 +189,117 @@ class AtomicHashMap {
   rw_mutex m_global_rw_mutex_;
 };
 
+/**
+ * An AtomicHashMap whose keys are spread over ShardNum shards by hash.
+ * Each shard has its own rw_mutex, so that Emplace() and Erase() only block
+ * the accessors of the same shard instead of the whole map.
+ *
+ * ValueExclusivePtr is the same type as the one of AtomicHashMap.
+ * Since there is no single raw map, the whole map is visited by ForEach(),
+ * which locks one shard at a time. It does NOT give a consistent snapshot
+ * across shards.
+ */
+template <template <typename...> class MapType, typename Key, typename T,
+          size_t ShardNum = 16>
+class ShardedAtomicHashMap {
+ public:
+  static_assert(ShardNum > 0);
+
+  using RawMap = MapType<Key, Synchronized<T>>;
+
+  using CombinedLock = typename AtomicHashMap<MapType, Key, T>::CombinedLock;
+
+  using ValueExclusivePtr = util::ManagedScopeExclusivePtr<T, CombinedLock>;
+
+  ShardedAtomicHashMap() = default;
+
+  // This function should be called only once!
+  void InitFromMap(MapType<Key, T>&& other_map) {
+    for (auto& [k, v] : other_map) ShardOf_(k).map.emplace(k, std::move(v));
+  }
+
+  bool Contains(const Key& key) {
+    Shard& shard = ShardOf_(key);
+    read_lock_guard lock_guard(shard.rw_mtx);
+    return shard.map.contains(key);
+  }
+
+  ValueExclusivePtr GetValueExclusivePtr(const Key& key) {
+    Shard& shard = ShardOf_(key);
+    shard.rw_mtx.lock_shared();
+    auto iter = shard.map.find(key);
+
+    if (iter == shard.map.end()) {
+      shard.rw_mtx.unlock_shared();
+      return ValueExclusivePtr{};
+    } else {
+      iter->second.Mutex().Lock();
+      CombinedLock combined_lock(&shard.rw_mtx, &iter->second.Mutex());
+      return ValueExclusivePtr{iter->second.RawPtr(), std::move(combined_lock)};
+    }
+  }
+
+  ValueExclusivePtr operator[](const Key& key) {
+    return GetValueExclusivePtr(key);
+  }
+
+  /**
+   * Call fn(const T&) with the value of key under the reader lock of the
+   * value, so concurrent readers of the same value do not wait for each
+   * other. Writers through ValueExclusivePtr still exclude them.
+   * @return false if key does not exist.
+   */
+  template <typename Fn>
+  bool Read(const Key& key, Fn&& fn) {
+    Shard& shard = ShardOf_(key);
+    read_lock_guard lock_guard(shard.rw_mtx);
+    auto iter = shard.map.find(key);
+    if (iter == shard.map.end()) return false;
+
+    absl::ReaderMutexLock value_lock(&iter->second.Mutex());
+    fn(static_cast<const T&>(*iter->second.RawPtr()));
+    return true;
+  }
+
+  /**
+   * Call fn(const Key&, const Synchronized<T>&) for every element.
+   * Shards are locked one by one in the shared mode.
+   */
+  template <typename Fn>
+  void ForEach(Fn&& fn) {
+    for (Shard& shard : m_shards_) {
+      read_lock_guard lock_guard(shard.rw_mtx);
+      for (const auto& [k, v] : shard.map) fn(k, v);
+    }
+  }
+
+  template <typename... Args>
+  void Emplace(const Key& key, Args&&... args) {
+    Shard& shard = ShardOf_(key);
+    write_lock_guard lock_guard(shard.rw_mtx);
+    shard.map.emplace(key, std::forward<Args>(args)...);
+  }
+
+  void Erase(const Key& key) {
+    Shard& shard = ShardOf_(key);
+    write_lock_guard lock_guard(shard.rw_mtx);
+    shard.map.erase(key);
+  }
+
+ private:
+  // Shards are aligned to cache lines to avoid false sharing of the mutexes.
+  struct alignas(64) Shard {
+    RawMap map;
+    rw_mutex rw_mtx;
+  };
+
+  Shard& ShardOf_(const Key& key) {
+    size_t hash = absl::Hash<Key>{}(key);
+    // The low bits are also used by the shard's own hash table.
+    return m_shards_[(hash >> 32 ^ hash) % ShardNum];
+  }
+
+  std::array<Shard, ShardNum> m_shards_;
+};
+
 }  // namespace util
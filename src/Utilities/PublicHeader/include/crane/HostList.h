@@ -0,0 +1,132 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#pragma once
+
+#include <compare>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace util {
+
+/**
+ * A set of host names which is kept compressed.
+ *
+ * A name is split at its first number into a prefix, the number and a
+ * suffix, e.g. "a01s02" into "a", 1 and "s02". The numbers of the names
+ * sharing the prefix, the suffix and the number of digits (zero padding
+ * included) are kept as sorted disjoint ranges. Thus "cn[00001-10000]" is
+ * one range and set operations, encoding and decoding take time linear in
+ * the number of ranges rather than hosts. Names without any number are
+ * kept as they are.
+ */
+class HostList {
+ public:
+  // [first, last] of the numbers.
+  using Range = std::pair<uint64_t, uint64_t>;
+
+  HostList() = default;
+
+  /**
+   * Add the hosts in a hostlist expression, e.g. "cn[01-10,12],login1".
+   * Empty items are ignored.
+   * @return false on a format error. Nothing is added in that case.
+   */
+  bool Parse(std::string_view expr);
+
+  void Insert(std::string_view host);
+
+  // Insert many hosts in any order. Inserting unsorted hosts one by one may
+  // take O(n^2) time while this sorts the numbers of each key once.
+  void InsertBulk(const std::vector<std::string_view>& hosts);
+
+  bool Contains(std::string_view host) const;
+
+  size_t Size() const;
+
+  bool Empty() const { return m_ranges_.empty() && m_plain_hosts_.empty(); }
+
+  void Clear();
+
+  HostList& operator|=(const HostList& rhs);
+  HostList& operator&=(const HostList& rhs);
+  HostList& operator-=(const HostList& rhs);
+
+  friend bool operator==(const HostList& lhs, const HostList& rhs) = default;
+
+  /**
+   * Call fn with each host. The view passed to fn is only valid during the
+   * call.
+   */
+  void ForEach(const std::function<void(std::string_view)>& fn) const;
+
+  /**
+   * Encode the hosts into a hostlist expression. Numbers are folded into
+   * brackets from the leftmost one, e.g. "a[01-02]s[1-4]", and the items
+   * are sorted.
+   */
+  std::string Encode() const;
+
+ private:
+  struct RangeKey {
+    std::string prefix;
+    std::string suffix;
+    // The number of digits including the leading zeros.
+    uint32_t width;
+
+    bool operator==(const RangeKey&) const = default;
+  };
+
+  struct RangeKeyLess {
+    using is_transparent = void;
+
+    template <typename L, typename R>
+    bool operator()(const L& lhs, const R& rhs) const {
+      return std::tie(lhs.prefix, lhs.suffix, lhs.width) <
+             std::tie(rhs.prefix, rhs.suffix, rhs.width);
+    }
+  };
+
+  struct RangeKeyView {
+    std::string_view prefix;
+    std::string_view suffix;
+    uint32_t width;
+  };
+
+  // Add [first, last] whose numbers all have width digits when padded.
+  void AddRange_(const RangeKeyView& key, uint64_t first, uint64_t last);
+
+  std::map<RangeKey, std::vector<Range>, RangeKeyLess> m_ranges_;
+  std::set<std::string, std::less<>> m_plain_hosts_;
+};
+
+/**
+ * Call fn with each host in a hostlist expression in the order they appear.
+ * Duplicates are kept and empty items are ignored. The view passed to fn is
+ * only valid during the call.
+ * @return false on a format error. fn may have been called before that.
+ */
+bool ForEachHostInExpr(std::string_view expr,
+                       const std::function<void(std::string_view)>& fn);
+
+}  // namespace util
@@ -61,4 +61,10 @@ int GetIpAddrVer(const std::string& ip);
 
 bool FindTcpInodeByPort(const std::string& tcp_path, int port, ino_t* inode);
 
+/// Find the inode of the tcp socket bound to the local port by
+/// NETLINK_SOCK_DIAG, which avoids parsing the whole /proc/net/tcp{,6}.
+/// @param[out] available is set to false if NETLINK_SOCK_DIAG cannot be used,
+/// in which case the caller should fall back to FindTcpInodeByPort().
+bool FindTcpInodeByPortNetlink(int port, ino_t* inode, bool* available);
+
 }  // namespace crane
\ No newline at end of file
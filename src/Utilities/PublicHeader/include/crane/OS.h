@@ -60,6 +60,9 @@ bool GetSystemReleaseInfo(SystemRelInfo* info);
 
 absl::Time GetSystemBootTime();
 
+// Check whether one of the fds of the process refers to the socket inode.
+bool ProcessHasSocketInode(pid_t pid, ino_t inode);
+
 }  // namespace os
 
 }  // namespace util
\ No newline at end of file
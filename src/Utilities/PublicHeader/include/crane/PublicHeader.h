@@ -76,6 +76,7 @@ inline const char* kDefaultCraneBaseDir = "/var/crane/";
 inline const char* kDefaultCraneCtldMutexFile = "cranectld/cranectld.lock";
 inline const char* kDefaultCraneCtldLogPath = "cranectld/cranectld.log";
 inline const char* kDefaultCraneCtldDbPath = "cranectld/embedded.db";
+inline const char* kDefaultCraneCtldEventJournalPath = "cranectld/journal.bin";
 
 inline const char* kDefaultCranedScriptDir = "craned/scripts";
 inline const char* kDefaultCranedUnixSockPath = "craned/craned.sock";
@@ -83,6 +84,9 @@ inline const char* kDefaultCranedMutexFile = "craned/craned.lock";
 inline const char* kDefaultCranedLogPath = "craned/craned.log";
 
 inline const char* kDefaultPlugindUnixSockPath = "cplugind/cplugind.sock";
+inline constexpr uint32_t kDefaultPluginMaxQueuedTasks = 100000;
+inline constexpr uint32_t kDefaultPluginMaxInflightRpcs = 4;
+inline constexpr uint32_t kDefaultPluginMaxBatchSize = 500;
 
 constexpr uint64_t kTaskMinTimeLimitSec = 11;
 constexpr int64_t kTaskMaxTimeLimitSec =
@@ -106,6 +110,7 @@ enum ExitCodeEnum : uint16_t {
   kExitCodeExceedTimeLimit,
   kExitCodeCranedDown,
   kExitCodeExecutionError,
+  kExitCodeReservationEnded,
 
   __MAX_EXIT_CODE  // NOLINT(bugprone-reserved-identifier)
 };
@@ -219,6 +224,24 @@ bool operator<=(const TypeSlotsMap& lhs, const TypeSlotsMap& rhs);
 
 TypeSlotsMap Intersection(const TypeSlotsMap& lhs, const TypeSlotsMap& rhs);
 
+// Where a slot is attached. Slots sharing a NUMA node and a PCIe switch
+// communicate with each other and with the cpus of the NUMA node faster.
+struct SlotAffinity {
+  int32_t numa_node{-1};  // -1 if unknown.
+  std::string pcie_switch;  // Empty if unknown.
+
+  SlotAffinity() = default;
+  SlotAffinity(int32_t numa_node, std::string pcie_switch)
+      : numa_node(numa_node), pcie_switch(std::move(pcie_switch)) {}
+
+  explicit SlotAffinity(const crane::grpc::SlotAffinity& rhs);
+  explicit operator crane::grpc::SlotAffinity() const;
+
+  bool IsUnknown() const { return numa_node == -1 && pcie_switch.empty(); }
+
+  auto operator<=>(const SlotAffinity& rhs) const = default;
+};
+
 struct DedicatedResourceInNode {
   DedicatedResourceInNode() = default;
 
@@ -255,6 +278,10 @@ struct DedicatedResourceInNode {
   // config: gpu:a100 whit file /dev/nvidia[0-3]
   // parsed: name:gpu,slot:a100,index:/dev/nvidia0,....,/dev/nvidia3
   std::unordered_map<std::string /*name*/, TypeSlotsMap> name_type_slots_map;
+
+  // Static metadata of slots. It is merged by operator+= and kept by
+  // operator-=, and is not compared by operator== and operator<=.
+  std::unordered_map<SlotId, SlotAffinity> slot_affinity_map;
 };
 
 bool operator<=(const DedicatedResourceInNode& lhs,
@@ -373,6 +400,12 @@ class ResourceView {
   bool IsZero() const;
   void SetToZero();
 
+  /**
+   * Choose the slots of avail_res satisfying the device request.
+   * Slots are chosen by their SlotAffinity: the smallest group of slots
+   * sharing a NUMA node and a PCIe switch which can hold the whole request of
+   * a device comes first, then the groups with more available slots.
+   */
   bool GetFeasibleResourceInNode(const ResourceInNode& avail_res,
                                  ResourceInNode* feasible_res);
 
@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "protos/Crane.grpc.pb.h"
+#include "protos/Crane.pb.h"
+
+namespace crane {
+
+// The timeout of one hop of the relay tree. The deadline of a relay request
+// is this value times the depth of its subtree.
+constexpr std::chrono::seconds kRelayHopTimeout{5};
+
+/**
+ * Delivers requests to many craneds through a tree of relays.
+ *
+ * The targets are split into at most fan_out contiguous subtrees. The first
+ * craned of each subtree is its relay: it receives the whole subtree in one
+ * Relay RPC, handles its own target and splits the rest in the same way.
+ * Each relay replies with the craneds which confirmed the delivery. A relay
+ * stops waiting for its subtrees a little before its own deadline, so that
+ * the confirmed part of a slow subtree still reaches the caller.
+ *
+ * The targets of a subtree which are not confirmed by its relay, including
+ * the relay itself if the Relay RPC fails, are retried directly, one RPC per
+ * craned. A fan_out of 0 sends every target directly.
+ */
+class RelayTree {
+ public:
+  using CranedStubGetter =
+      std::function<std::shared_ptr<crane::grpc::Craned::Stub>(
+          const std::string& craned_id)>;
+  // Handles the payload of the local target. Returns whether it's delivered.
+  using LocalHandler =
+      std::function<bool(const crane::grpc::RelayTarget& target)>;
+
+  /**
+   * @param stub_getter returns nullptr if the craned is known to be
+   * unreachable. It may be called from the calling thread of Broadcast()
+   * only.
+   */
+  RelayTree(uint32_t fan_out, CranedStubGetter stub_getter,
+            std::chrono::milliseconds hop_timeout = kRelayHopTimeout);
+
+  /**
+   * Blocks until every subtree replies or times out. The deadline leaves
+   * one hop for the direct retries after the deepest subtree.
+   * @return the ids of the craneds which did not confirm the delivery.
+   */
+  std::vector<std::string> Broadcast(
+      const google::protobuf::RepeatedPtrField<crane::grpc::RelayTarget>&
+          targets) const;
+
+  /**
+   * Same as above, but every RPC, including the retries, finishes before
+   * the deadline.
+   */
+  std::vector<std::string> Broadcast(
+      const google::protobuf::RepeatedPtrField<crane::grpc::RelayTarget>&
+          targets,
+      std::chrono::system_clock::time_point deadline) const;
+
+  /**
+   * Serves a Relay RPC on the craned local_craned_id: handles targets[0]
+   * with local_handler and broadcasts the rest with the fan-out of the
+   * request, stopping early enough to reply before the deadline of context.
+   * The fan-out of this RelayTree is not used.
+   */
+  ::grpc::Status ServeRelay(const ::grpc::ServerContext& context,
+                            const crane::grpc::RelayRequest& request,
+                            crane::grpc::RelayReply* reply,
+                            const std::string& local_craned_id,
+                            const LocalHandler& local_handler) const;
+
+  // The number of hops needed to reach the last craned of a subtree.
+  static uint32_t Depth(uint32_t fan_out, size_t target_num);
+
+ private:
+  uint32_t m_fan_out_;
+  CranedStubGetter m_stub_getter_;
+  std::chrono::milliseconds m_hop_timeout_;
+};
+
+}  // namespace crane
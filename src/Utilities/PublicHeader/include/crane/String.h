@@ -29,6 +29,7 @@
 #include <string>
 #include <vector>
 
+#include "crane/HostList.h"
 #include "crane/PublicHeader.h"
 
 namespace util {
@@ -40,32 +41,13 @@ std::string ReadableMemory(uint64_t memory_bytes);
 bool ParseHostList(const std::string &host_str,
                    std::list<std::string> *host_list);
 
-bool FoundFirstNumberWithoutBrackets(const std::string &input, int *start,
-                                     int *end);
-
-std::string RemoveBracketsWithoutDashOrComma(const std::string &input);
-
-bool HostNameListToStr_(std::list<std::string> &host_list,
-                        std::list<std::string> *res_list);
-
 template <std::ranges::range T>
 std::string HostNameListToStr(T const &host_list)
   requires std::same_as<std::ranges::range_value_t<T>, std::string>
 {
-  std::list<std::string> source_list{host_list.begin(), host_list.end()};
-  while (true) {
-    std::list<std::string> res_list;
-    if (HostNameListToStr_(source_list, &res_list)) {
-      res_list.sort();
-      std::string host_name_str{absl::StrJoin(res_list, ",")};
-      // Remove brackets containing single numbers
-      // Temporary "[]" can be used to mark that the number has been processed,
-      // so "[]" cannot be removed during the processing and can only be deleted
-      // at the end
-      return RemoveBracketsWithoutDashOrComma(host_name_str);
-    }
-    source_list = res_list;
-  }
+  HostList hosts;
+  hosts.InsertBulk({host_list.begin(), host_list.end()});
+  return hosts.Encode();
 }
 
 void SetCurrentThreadName(const std::string &name);
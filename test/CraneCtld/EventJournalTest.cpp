@@ -0,0 +1,224 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "EventJournal.h"
+
+using Ctld::EventJournal;
+using Ctld::JournalEventType;
+using Ctld::JournalRecord;
+using Ctld::PendingDiagnosis;
+
+namespace {
+
+class EventJournalTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    m_dir_ = std::filesystem::temp_directory_path() /
+             fmt::format("event_journal_test_{}", getpid());
+    std::filesystem::create_directories(m_dir_);
+    m_path_ = (m_dir_ / "journal.bin").string();
+  }
+
+  void TearDown() override { std::filesystem::remove_all(m_dir_); }
+
+  std::vector<JournalRecord> ReadAll(const std::string& path) {
+    auto result = Ctld::ReadJournalFile(path);
+    EXPECT_TRUE(result.has_value()) << result.error();
+    return result.has_value() ? result.value() : std::vector<JournalRecord>{};
+  }
+
+  std::filesystem::path m_dir_;
+  std::string m_path_;
+};
+
+}  // namespace
+
+TEST_F(EventJournalTest, RecordsOfAllThreadsAreWritten) {
+  constexpr int kThreadNum = 4;
+  constexpr int kRecordNum = 1000;
+
+  {
+    EventJournal journal;
+    ASSERT_TRUE(journal.Init(m_path_, 64 * 1024 * 1024, 2));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreadNum; t++) {
+      threads.emplace_back([&journal, t] {
+        for (int i = 0; i < kRecordNum; i++) {
+          journal.NodeRejected(t, fmt::format("cn{:02}", i % 100),
+                               PendingDiagnosis::kExcludedNode);
+          // Leave some time to the flush thread.
+          if (i % 100 == 0) std::this_thread::yield();
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+  }
+
+  std::vector<JournalRecord> records = ReadAll(m_path_);
+
+  // Records of one thread keep their order.
+  std::vector<int> next_index(kThreadNum, 0);
+  int dropped = 0;
+  for (const auto& record : records) {
+    if (record.type == JournalEventType::kRecordsDropped) {
+      dropped += record.arg0;
+      continue;
+    }
+    ASSERT_EQ(record.type, JournalEventType::kNodeRejected);
+    ASSERT_LT(record.task_id, kThreadNum);
+    int& index = next_index[record.task_id];
+    EXPECT_EQ(record.CranedId(), fmt::format("cn{:02}", index % 100));
+    EXPECT_EQ(record.reason, PendingDiagnosis::kExcludedNode);
+    index++;
+  }
+
+  int written = 0;
+  for (int index : next_index) written += index;
+  EXPECT_EQ(written + dropped, kThreadNum * kRecordNum);
+}
+
+TEST_F(EventJournalTest, FullRingDropsRecords) {
+  constexpr int kRecordNum = 10000;
+
+  {
+    EventJournal journal;
+    ASSERT_TRUE(journal.Init(m_path_, 64 * 1024 * 1024, 1));
+    for (int i = 0; i < kRecordNum; i++)
+      journal.NotStarted(i, PendingDiagnosis::kNoTimeWindow);
+  }
+
+  int written = 0;
+  int dropped = 0;
+  for (const auto& record : ReadAll(m_path_)) {
+    if (record.type == JournalEventType::kRecordsDropped)
+      dropped += record.arg0;
+    else
+      written++;
+  }
+  EXPECT_GT(written, 0);
+  EXPECT_EQ(written + dropped, kRecordNum);
+}
+
+TEST_F(EventJournalTest, Rotate) {
+  constexpr uint64_t kMaxFileSize = 16 * 1024;
+
+  EventJournal journal;
+  ASSERT_TRUE(journal.Init(m_path_, kMaxFileSize, 3));
+
+  // Each flush writes 100 records, i.e., 6400 bytes.
+  for (int round = 0; round < 10; round++) {
+    for (int i = 0; i < 100; i++)
+      journal.StatusChanged(round * 100 + i, crane::grpc::Pending,
+                            crane::grpc::Running);
+    journal.Flush();
+  }
+
+  EXPECT_TRUE(std::filesystem::exists(m_path_ + ".1"));
+  EXPECT_TRUE(std::filesystem::exists(m_path_ + ".2"));
+  EXPECT_FALSE(std::filesystem::exists(m_path_ + ".3"));
+
+  // Files are filled up to kMaxFileSize and the latest records are in the
+  // current file.
+  EXPECT_LE(std::filesystem::file_size(m_path_ + ".1"), kMaxFileSize);
+  std::vector<JournalRecord> records = ReadAll(m_path_);
+  ASSERT_FALSE(records.empty());
+  EXPECT_EQ(records.back().task_id, 999);
+  EXPECT_EQ(records.back().arg0, crane::grpc::Pending);
+  EXPECT_EQ(records.back().arg1, crane::grpc::Running);
+}
+
+TEST_F(EventJournalTest, RingsOfExitedThreadsAreFreed) {
+  constexpr int kThreadNum = 100;
+
+  EventJournal journal;
+  ASSERT_TRUE(journal.Init(m_path_, 64 * 1024 * 1024, 1));
+
+  for (int t = 0; t < kThreadNum; t++) {
+    std::thread([&journal, t] {
+      journal.NotStarted(t, PendingDiagnosis::kStartLater);
+    }).join();
+  }
+  journal.Flush();
+
+  EXPECT_EQ(journal.ThreadRingNum(), 0);
+
+  // The records of the exited threads are written before their rings are
+  // freed.
+  std::vector<JournalRecord> records = ReadAll(m_path_);
+  ASSERT_EQ(records.size(), kThreadNum);
+  for (int t = 0; t < kThreadNum; t++) EXPECT_EQ(records[t].task_id, t);
+
+  // The ring of a living thread is kept.
+  journal.NotStarted(kThreadNum, PendingDiagnosis::kStartLater);
+  journal.Flush();
+  EXPECT_EQ(journal.ThreadRingNum(), 1);
+}
+
+TEST_F(EventJournalTest, RetryOpenOnNextFlush) {
+  // Any write of more than 10 records reopens the file.
+  constexpr uint64_t kMaxFileSize =
+      sizeof(Ctld::JournalFileHeader) + 10 * sizeof(JournalRecord);
+  constexpr int kRecordNum = 50;
+
+  EventJournal journal;
+  ASSERT_TRUE(journal.Init(m_path_, kMaxFileSize, 2));
+
+  std::filesystem::remove_all(m_dir_);
+  for (int i = 0; i < kRecordNum; i++)
+    journal.StatusChanged(i, crane::grpc::Pending, crane::grpc::Running);
+  journal.Flush();
+  EXPECT_FALSE(std::filesystem::exists(m_path_));
+
+  std::filesystem::create_directories(m_dir_);
+  journal.Flush();
+
+  // The records are kept in the ring while the file can not be opened.
+  std::vector<JournalRecord> records = ReadAll(m_path_);
+  ASSERT_FALSE(records.empty());
+  EXPECT_EQ(records.back().task_id, kRecordNum - 1);
+}
+
+TEST_F(EventJournalTest, ReadInvalidFile) {
+  std::ofstream(m_path_) << "not a journal";
+  EXPECT_TRUE(Ctld::ReadJournalFile(m_path_).has_error());
+  EXPECT_TRUE(Ctld::ReadJournalFile(m_path_ + ".none").has_error());
+}
+
+TEST(EventJournal, FormatRecord) {
+  JournalRecord record{};
+  record.time_ns = 1'700'000'000'123'456'789;
+  record.task_id = 42;
+  record.type = JournalEventType::kNodeRejected;
+  record.reason = PendingDiagnosis::kResourceExceedsNode;
+  memcpy(record.craned_id, "cn\"01", 5);
+
+  EXPECT_EQ(Ctld::FormatJournalRecord(record, true),
+            R"({"time_ns":1700000000123456789,"task_id":42,)"
+            R"("event":"NodeRejected","craned":"cn\"01",)"
+            R"("reason":"ResourceExceedsNode"})");
+  EXPECT_TRUE(Ctld::FormatJournalRecord(record, false)
+                  .ends_with(" #42 NodeRejected craned=cn\"01 "
+                             "reason=ResourceExceedsNode"));
+
+  record.type = JournalEventType::kRpcOutcome;
+  record.reason = uint16_t(Ctld::JournalRpcType::kCancelTask);
+  record.arg0 = uint16_t(CraneErr::kOk);
+  EXPECT_TRUE(Ctld::FormatJournalRecord(record, false)
+                  .ends_with(" #42 RpcOutcome rpc=CancelTask result=Success"));
+}
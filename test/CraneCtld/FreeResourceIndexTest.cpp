@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <gtest/gtest.h>
+
+#include <set>
+
+#include "FreeResourceIndex.h"
+
+using Ctld::FreeResourceIndex;
+
+namespace {
+
+ResourceInNode Res(uint32_t cpu, uint64_t mem_gb) {
+  ResourceInNode res;
+  res.allocatable_res.cpu_count = cpu_t(cpu);
+  res.allocatable_res.memory_bytes = mem_gb * 1024 * 1024 * 1024;
+  res.allocatable_res.memory_sw_bytes = res.allocatable_res.memory_bytes;
+  return res;
+}
+
+std::vector<CranedId> Visit(const FreeResourceIndex& index, uint32_t cpu) {
+  std::vector<CranedId> visited;
+  index.ForEachFromLeast(cpu_t(cpu), [&](const CranedId& craned_id,
+                                         const auto& /*key*/) {
+    visited.emplace_back(craned_id);
+    return true;
+  });
+  return visited;
+}
+
+// The nodes BestFit picks for a task which can run now, given the free
+// resource of each node.
+std::vector<CranedId> SelectNodes(
+    const FreeResourceIndex& index,
+    const std::unordered_map<CranedId, ResourceInNode>& avail,
+    const ResourceInNode& req, size_t limit) {
+  std::vector<CranedId> selected;
+  index.SelectFromLeast(
+      req.allocatable_res.cpu_count, limit,
+      [&](const CranedId& craned_id) { return req <= avail.at(craned_id); },
+      &selected);
+  return selected;
+}
+
+}  // namespace
+
+TEST(FreeResourceIndexTest, VisitFromLeastFreeResource) {
+  FreeResourceIndex index;
+  index.Insert("cn1", Res(8, 32));
+  index.Insert("cn2", Res(2, 8));
+  index.Insert("cn3", Res(4, 16));
+  index.Insert("cn4", Res(4, 8));
+
+  EXPECT_EQ(Visit(index, 1),
+            (std::vector<CranedId>{"cn2", "cn4", "cn3", "cn1"}));
+  // Nodes with less cpu than requested are not visited.
+  EXPECT_EQ(Visit(index, 3), (std::vector<CranedId>{"cn4", "cn3", "cn1"}));
+
+  index.Update("cn1", Res(1, 4));
+  index.Erase("cn4");
+  EXPECT_EQ(index.Size(), 3u);
+  EXPECT_EQ(Visit(index, 1), (std::vector<CranedId>{"cn1", "cn2", "cn3"}));
+
+  // Visiting stops when fn returns false.
+  uint32_t visited = 0;
+  index.ForEachFromLeast(cpu_t(0), [&](const CranedId&, const auto&) {
+    return ++visited < 2;
+  });
+  EXPECT_EQ(visited, 2u);
+}
+
+TEST(FreeResourceIndexTest, NodesWithSameFreeResource) {
+  FreeResourceIndex index;
+  for (int i = 5; i >= 1; i--) index.Insert(fmt::format("cn{}", i), Res(4, 8));
+
+  // Ties are broken by the node id.
+  EXPECT_EQ(Visit(index, 1),
+            (std::vector<CranedId>{"cn1", "cn2", "cn3", "cn4", "cn5"}));
+
+  index.Erase("cn3");
+  index.Update("cn4", Res(2, 8));
+  index.Update("cn1", Res(4, 8));
+  EXPECT_EQ(index.Size(), 4u);
+  EXPECT_EQ(Visit(index, 1),
+            (std::vector<CranedId>{"cn4", "cn1", "cn2", "cn5"}));
+}
+
+TEST(FreeResourceIndexTest, SelectTightestFitFirst) {
+  std::unordered_map<CranedId, ResourceInNode> avail{{"cn1", Res(8, 32)},
+                                                     {"cn2", Res(2, 8)},
+                                                     {"cn3", Res(4, 16)},
+                                                     {"cn4", Res(4, 8)}};
+  FreeResourceIndex index;
+  for (const auto& [craned_id, res] : avail) index.Insert(craned_id, res);
+
+  // cn2 has too few cpus and is not visited. cn4 has too little memory.
+  ResourceInNode req = Res(3, 12);
+  EXPECT_EQ(SelectNodes(index, avail, req, 1), (std::vector<CranedId>{"cn3"}));
+  EXPECT_EQ(SelectNodes(index, avail, req, 3),
+            (std::vector<CranedId>{"cn3", "cn1"}));
+
+  // Nodes rejected by the predicate, e.g., excluded ones, are skipped.
+  std::vector<CranedId> selected;
+  index.SelectFromLeast(
+      req.allocatable_res.cpu_count, 1,
+      [&](const CranedId& craned_id) {
+        return craned_id != "cn3" && req <= avail.at(craned_id);
+      },
+      &selected);
+  EXPECT_EQ(selected, (std::vector<CranedId>{"cn1"}));
+}
+
+TEST(FreeResourceIndexTest, PackSmallTasksIntoFewNodes) {
+  constexpr uint32_t kNodeNum = 32;
+
+  std::unordered_map<CranedId, ResourceInNode> avail;
+  FreeResourceIndex index;
+  for (uint32_t i = 0; i < kNodeNum; i++) {
+    CranedId craned_id = fmt::format("cn{:02}", i);
+    avail.emplace(craned_id, Res(16, 64));
+    index.Insert(craned_id, avail.at(craned_id));
+  }
+
+  // 1, 2 and 4 cpus with 2G memory per cpu. 245 cpus in total, a bit less
+  // than half of the cluster. The index is updated after each placement as
+  // the scheduler does.
+  std::set<CranedId> used;
+  for (uint32_t i = 0; i < 105; i++) {
+    uint32_t cpu = 1u << (i % 3);
+    ResourceInNode req = Res(cpu, 2 * cpu);
+    std::vector<CranedId> selected = SelectNodes(index, avail, req, 1);
+    ASSERT_EQ(selected.size(), 1u);
+
+    avail.at(selected[0]) -= req;
+    index.Update(selected[0], avail.at(selected[0]));
+    used.emplace(selected[0]);
+  }
+
+  // The tasks fill up the nodes one by one and 245 cpus fit into 16 nodes.
+  std::set<CranedId> expected;
+  for (uint32_t i = 0; i < 16; i++) expected.emplace(fmt::format("cn{:02}", i));
+  EXPECT_EQ(used, expected);
+}
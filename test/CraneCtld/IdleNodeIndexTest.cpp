@@ -0,0 +1,72 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "IdleNodeIndex.h"
+
+using Ctld::IdleNodeIndex;
+
+namespace {
+
+absl::Time At(int64_t seconds) { return absl::FromUnixSeconds(seconds); }
+
+}  // namespace
+
+TEST(IdleNodeIndex, LongestIdleFirst) {
+  IdleNodeIndex index;
+  index.AddNode("cn1", {"CPU"}, At(300));
+  index.AddNode("cn2", {"CPU", "GPU"}, At(100));
+  index.AddNode("cn3", {"GPU"}, At(200));
+  index.AddNode("cn4", {"CPU"}, At(200));
+
+  EXPECT_EQ(index.GetIdleNodes("CPU", 10),
+            (std::vector<CranedId>{"cn2", "cn4", "cn1"}));
+  EXPECT_EQ(index.GetIdleNodes("CPU", 2),
+            (std::vector<CranedId>{"cn2", "cn4"}));
+  EXPECT_EQ(index.GetIdleNodes("GPU", 10),
+            (std::vector<CranedId>{"cn2", "cn3"}));
+  EXPECT_TRUE(index.GetIdleNodes("Unknown", 10).empty());
+
+  EXPECT_EQ(index.IdleNodeNum("CPU"), 3);
+  EXPECT_EQ(index.IdleNodeNum("GPU"), 2);
+}
+
+TEST(IdleNodeIndex, AddAndRemove) {
+  IdleNodeIndex index;
+  index.AddNode("cn1", {"CPU", "GPU"}, At(100));
+  index.AddNode("cn2", {"CPU"}, At(200));
+
+  // A node added twice keeps the time since which it has been idle.
+  index.AddNode("cn1", {"CPU", "GPU"}, At(500));
+  EXPECT_EQ(index.GetIdleNodes("CPU", 10),
+            (std::vector<CranedId>{"cn1", "cn2"}));
+
+  // e.g. a task starts on cn1.
+  index.RemoveNode("cn1");
+  EXPECT_FALSE(index.Contains("cn1"));
+  EXPECT_EQ(index.GetIdleNodes("CPU", 10), (std::vector<CranedId>{"cn2"}));
+  EXPECT_EQ(index.IdleNodeNum("GPU"), 0);
+
+  // Removing a busy node does nothing.
+  index.RemoveNode("cn1");
+
+  // The task ends later.
+  index.AddNode("cn1", {"CPU", "GPU"}, At(600));
+  EXPECT_TRUE(index.Contains("cn1"));
+  EXPECT_EQ(index.GetIdleNodes("CPU", 10),
+            (std::vector<CranedId>{"cn2", "cn1"}));
+}
@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Preemption.h"
+
+using Ctld::PreemptCandidate;
+using Ctld::SelectPreemptionVictimsInNode;
+
+namespace {
+
+ResourceInNode Res(uint32_t cpu) {
+  ResourceInNode res;
+  res.allocatable_res.cpu_count = cpu_t(cpu);
+  res.allocatable_res.memory_bytes = uint64_t(cpu) * 1024 * 1024 * 1024;
+  res.allocatable_res.memory_sw_bytes = res.allocatable_res.memory_bytes;
+  return res;
+}
+
+ResourceView Request(uint32_t cpu) {
+  ResourceView view;
+  view += Res(cpu);
+  return view;
+}
+
+PreemptCandidate Candidate(task_id_t task_id, uint32_t qos_priority,
+                           int64_t start_sec, uint32_t cpu) {
+  return PreemptCandidate{.task_id = task_id,
+                          .qos_priority = qos_priority,
+                          .start_time = absl::FromUnixSeconds(start_sec),
+                          .res = Res(cpu)};
+}
+
+}  // namespace
+
+TEST(PreemptionTest, NoVictimIfRequestFits) {
+  std::vector<task_id_t> victims{1};
+  ASSERT_TRUE(SelectPreemptionVictimsInNode(
+      Res(4), Request(4), {Candidate(1, 1, 100, 4)}, &victims));
+  EXPECT_TRUE(victims.empty());
+}
+
+TEST(PreemptionTest, FailIfCandidatesAreNotEnough) {
+  std::vector<task_id_t> victims;
+  EXPECT_FALSE(SelectPreemptionVictimsInNode(
+      Res(1), Request(8),
+      {Candidate(1, 1, 100, 2), Candidate(2, 1, 200, 2)}, &victims));
+}
+
+TEST(PreemptionTest, LowerPriorityAndLaterStartFirst) {
+  std::vector<task_id_t> victims;
+  ASSERT_TRUE(SelectPreemptionVictimsInNode(
+      Res(0), Request(2),
+      {Candidate(1, 5, 300, 2), Candidate(2, 1, 100, 2),
+       Candidate(3, 1, 200, 2)},
+      &victims));
+  EXPECT_EQ(victims, std::vector<task_id_t>{3});
+}
+
+TEST(PreemptionTest, UnnecessaryVictimsAreSpared) {
+  // Task 1 and task 2 are chosen before task 3 is found to be needed. Task 3
+  // alone is enough, so both of them are spared.
+  std::vector<task_id_t> victims;
+  ASSERT_TRUE(SelectPreemptionVictimsInNode(
+      Res(0), Request(6),
+      {Candidate(1, 1, 300, 1), Candidate(2, 1, 200, 1),
+       Candidate(3, 2, 100, 6)},
+      &victims));
+  EXPECT_EQ(victims, std::vector<task_id_t>{3});
+
+  // Task 3 covers only a part of the request now.
+  ASSERT_TRUE(SelectPreemptionVictimsInNode(
+      Res(1), Request(6),
+      {Candidate(1, 1, 300, 1), Candidate(2, 1, 200, 1),
+       Candidate(3, 2, 100, 4)},
+      &victims));
+  EXPECT_EQ(victims, (std::vector<task_id_t>{1, 3}));
+}
@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Reservation.h"
+
+using Ctld::BlockReservationInTimeline;
+using Ctld::Reservation;
+using Ctld::RestrictPreemptionNodesByReservations;
+using Ctld::RestrictTimelineToReservation;
+
+namespace {
+
+using Timeline = std::map<absl::Time, ResourceInNode>;
+
+const absl::Time kNow = absl::FromUnixSeconds(1000);
+
+absl::Time At(int64_t sec) { return kNow + absl::Seconds(sec); }
+
+ResourceInNode Res(uint32_t cpu) {
+  ResourceInNode res;
+  res.allocatable_res.cpu_count = cpu_t(cpu);
+  res.allocatable_res.memory_bytes = uint64_t(cpu) * 1024 * 1024 * 1024;
+  res.allocatable_res.memory_sw_bytes = res.allocatable_res.memory_bytes;
+  return res;
+}
+
+Reservation MakeReservation(int64_t start_sec, int64_t end_sec,
+                            std::optional<uint32_t> cpu_per_node) {
+  Reservation reservation;
+  reservation.name = "rsv";
+  reservation.start_time = At(start_sec);
+  reservation.end_time = At(end_sec);
+  if (cpu_per_node) {
+    reservation.whole_node = false;
+    reservation.res_per_node = Res(*cpu_per_node).allocatable_res;
+  }
+  return reservation;
+}
+
+// Return the cpu count of each interval of the timeline.
+std::vector<std::pair<int64_t, uint32_t>> CpuTimeline(
+    const Timeline& timeline) {
+  std::vector<std::pair<int64_t, uint32_t>> cpus;
+  for (const auto& [time, res] : timeline)
+    cpus.emplace_back(absl::ToInt64Seconds(time - kNow),
+                      static_cast<uint32_t>(res.allocatable_res.cpu_count));
+  return cpus;
+}
+
+}  // namespace
+
+TEST(ReservationTest, WholeNodeBlockLeavesRoomForBackfill) {
+  // 4 cores are free now and 8 after a running task ends at now+50.
+  Timeline timeline{{At(0), Res(4)}, {At(50), Res(8)}};
+  BlockReservationInTimeline(MakeReservation(100, 200, std::nullopt), kNow,
+                             &timeline);
+
+  using Cpus = std::vector<std::pair<int64_t, uint32_t>>;
+  EXPECT_EQ(CpuTimeline(timeline), (Cpus{{0, 4}, {50, 8}, {100, 0}, {200, 8}}));
+}
+
+TEST(ReservationTest, PartialBlockSubtractsReservedResource) {
+  Timeline timeline{{At(0), Res(8)}};
+  BlockReservationInTimeline(MakeReservation(-10, 100, 6), kNow, &timeline);
+
+  using Cpus = std::vector<std::pair<int64_t, uint32_t>>;
+  EXPECT_EQ(CpuTimeline(timeline), (Cpus{{0, 2}, {100, 8}}));
+
+  // No underflow if other tasks already hold a part of the reserved cores.
+  timeline = {{At(0), Res(3)}};
+  BlockReservationInTimeline(MakeReservation(0, 100, 6), kNow, &timeline);
+  EXPECT_EQ(CpuTimeline(timeline), (Cpus{{0, 0}, {100, 3}}));
+}
+
+TEST(ReservationTest, RestrictToWholeNodeReservation) {
+  Timeline timeline{{At(0), Res(8)}};
+  RestrictTimelineToReservation(MakeReservation(100, 200, std::nullopt), kNow,
+                                {}, &timeline);
+
+  using Cpus = std::vector<std::pair<int64_t, uint32_t>>;
+  EXPECT_EQ(CpuTimeline(timeline), (Cpus{{0, 0}, {100, 8}, {200, 0}}));
+}
+
+TEST(ReservationTest, RestrictToPartialReservation) {
+  // A task in the reservation holds 2 of the 6 reserved cores until now+50.
+  Timeline timeline{{At(0), Res(6)}, {At(50), Res(8)}};
+  RestrictTimelineToReservation(MakeReservation(0, 100, 6), kNow,
+                                {{At(50), Res(2).allocatable_res}},
+                                &timeline);
+
+  using Cpus = std::vector<std::pair<int64_t, uint32_t>>;
+  EXPECT_EQ(CpuTimeline(timeline), (Cpus{{0, 4}, {50, 6}, {100, 0}}));
+}
+
+TEST(ReservationTest, PreemptionNodesOfTaskInReservation) {
+  Reservation reservation = MakeReservation(7200, 10800, std::nullopt);
+  reservation.craned_ids = {"cn1", "cn2"};
+  std::vector<Reservation> reservations{reservation};
+
+  // The reservation opens in two hours. The task can't preempt anything yet.
+  std::unordered_set<std::string> craned_ids{"cn1", "cn2", "cn3"};
+  EXPECT_FALSE(RestrictPreemptionNodesByReservations(
+      "rsv", absl::Hours(1), kNow, reservations, &craned_ids));
+
+  // A deleted or unknown reservation.
+  EXPECT_FALSE(RestrictPreemptionNodesByReservations(
+      "other", absl::Hours(1), At(8000), reservations, &craned_ids));
+
+  // Once active, only the nodes of the reservation are candidates.
+  EXPECT_TRUE(RestrictPreemptionNodesByReservations(
+      "rsv", absl::Hours(1), At(8000), reservations, &craned_ids));
+  EXPECT_EQ(craned_ids, (std::unordered_set<std::string>{"cn1", "cn2"}));
+}
+
+TEST(ReservationTest, PreemptionNodesOfTaskOutsideReservation) {
+  Reservation whole = MakeReservation(-100, 100, std::nullopt);
+  whole.name = "whole";
+  whole.craned_ids = {"cn1"};
+  Reservation partial = MakeReservation(500, 1000, 2);
+  partial.name = "partial";
+  partial.craned_ids = {"cn2"};
+  Reservation ended = MakeReservation(-200, -100, std::nullopt);
+  ended.name = "ended";
+  ended.craned_ids = {"cn3"};
+  std::vector<Reservation> reservations{whole, partial, ended};
+
+  // The partial reservation begins after the task would end.
+  std::unordered_set<std::string> craned_ids{"cn1", "cn2", "cn3", "cn4"};
+  EXPECT_TRUE(RestrictPreemptionNodesByReservations(
+      "", absl::Seconds(500), kNow, reservations, &craned_ids));
+  EXPECT_EQ(craned_ids,
+            (std::unordered_set<std::string>{"cn2", "cn3", "cn4"}));
+
+  // A longer task would overlap it.
+  craned_ids = {"cn1", "cn2", "cn3", "cn4"};
+  EXPECT_TRUE(RestrictPreemptionNodesByReservations(
+      "", absl::Seconds(501), kNow, reservations, &craned_ids));
+  EXPECT_EQ(craned_ids, (std::unordered_set<std::string>{"cn3", "cn4"}));
+}
@@ -0,0 +1,161 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <gtest/gtest.h>
+
+#include "Topology.h"
+
+using Ctld::Config;
+using Ctld::TopologyTree;
+
+namespace {
+
+AllocatableResource Res(uint32_t cpu, uint64_t mem_gb) {
+  AllocatableResource res;
+  res.cpu_count = cpu_t(cpu);
+  res.memory_bytes = mem_gb * 1024 * 1024 * 1024;
+  res.memory_sw_bytes = res.memory_bytes;
+  return res;
+}
+
+// root -> {s1: cn[1-2], s2: cn[3-6]}
+std::vector<Config::Switch> TwoLevelTopology() {
+  return {
+      {.name = "root", .switches = {"s1", "s2"}, .nodes = {}},
+      {.name = "s1", .switches = {}, .nodes = {"cn1", "cn2"}},
+      {.name = "s2", .switches = {}, .nodes = {"cn3", "cn4", "cn5", "cn6"}},
+  };
+}
+
+}  // namespace
+
+TEST(TopologyTest, InvalidTopology) {
+  std::string reason;
+
+  TopologyTree unknown_switch;
+  EXPECT_FALSE(unknown_switch.Init(
+      {{.name = "root", .switches = {"s1"}, .nodes = {}}}, &reason));
+  EXPECT_TRUE(unknown_switch.Empty());
+
+  TopologyTree two_parents;
+  EXPECT_FALSE(two_parents.Init(
+      {{.name = "a", .switches = {"c"}, .nodes = {}},
+       {.name = "b", .switches = {"c"}, .nodes = {}},
+       {.name = "c", .switches = {}, .nodes = {"cn1"}}},
+      &reason));
+
+  TopologyTree cycle;
+  EXPECT_FALSE(
+      cycle.Init({{.name = "a", .switches = {"b"}, .nodes = {}},
+                  {.name = "b", .switches = {"a"}, .nodes = {"cn1"}}},
+                 &reason));
+
+  TopologyTree two_switches_of_node;
+  EXPECT_FALSE(two_switches_of_node.Init(
+      {{.name = "a", .switches = {}, .nodes = {"cn1"}},
+       {.name = "b", .switches = {}, .nodes = {"cn1"}}},
+      &reason));
+}
+
+TEST(TopologyTest, AggregatesFollowNodes) {
+  TopologyTree tree;
+  std::string reason;
+  ASSERT_TRUE(tree.Init(TwoLevelTopology(), &reason)) << reason;
+
+  for (int i = 1; i <= 6; i++) tree.NodeUp(fmt::format("cn{}", i), Res(4, 8));
+
+  auto root = tree.GetSwitchAggregate("root");
+  ASSERT_TRUE(root.has_value());
+  EXPECT_EQ(root->alive_node_num, 6u);
+  EXPECT_EQ(root->res_avail, Res(24, 48));
+
+  tree.MallocResource("cn1", Res(3, 2));
+  EXPECT_EQ(tree.GetSwitchAggregate("s1")->res_avail, Res(5, 14));
+  EXPECT_EQ(tree.GetSwitchAggregate("s2")->res_avail, Res(16, 32));
+  EXPECT_EQ(tree.GetSwitchAggregate("root")->res_avail, Res(21, 46));
+
+  tree.FreeResource("cn1", Res(3, 2));
+  tree.NodeDown("cn3", Res(4, 8));
+  EXPECT_EQ(tree.GetSwitchAggregate("s2")->alive_node_num, 3u);
+  EXPECT_EQ(tree.GetSwitchAggregate("root")->res_avail, Res(20, 40));
+
+  // A node not in the topology does not change any switch.
+  tree.NodeUp("cn7", Res(4, 8));
+  EXPECT_EQ(tree.GetSwitchAggregate("root")->alive_node_num, 5u);
+
+  EXPECT_TRUE(tree.AnySwitchMayFit(5, Res(4, 8)));
+  EXPECT_FALSE(tree.AnySwitchMayFit(6, Res(4, 8)));
+  EXPECT_FALSE(tree.AnySwitchMayFit(2, Res(11, 8)));
+}
+
+TEST(TopologyTest, SelectInSmallestSwitch) {
+  TopologyTree tree;
+  std::string reason;
+  ASSERT_TRUE(tree.Init(TwoLevelTopology(), &reason)) << reason;
+  for (int i = 1; i <= 6; i++) tree.NodeUp(fmt::format("cn{}", i), Res(4, 8));
+
+  std::list<CranedId> selected;
+  std::vector<CranedId> checked;
+  auto runnable_in = [&](absl::flat_hash_set<CranedId> runnable) {
+    return [&checked, runnable](const CranedId& craned_id) {
+      checked.emplace_back(craned_id);
+      return runnable.contains(craned_id);
+    };
+  };
+
+  // Two nodes fit in s1, which is smaller than s2, so the nodes of s2 are
+  // never checked.
+  ASSERT_TRUE(tree.SelectInSmallestSwitch(
+      2, Res(4, 8), runnable_in({"cn1", "cn2", "cn3", "cn4"}), &selected));
+  EXPECT_EQ(selected, (std::list<CranedId>{"cn1", "cn2"}));
+  EXPECT_EQ(checked, (std::vector<CranedId>{"cn1", "cn2"}));
+
+  // s1 has only one runnable node, so s2 is used. The walk stops as soon as
+  // s2 gathers two nodes.
+  selected.clear();
+  checked.clear();
+  ASSERT_TRUE(tree.SelectInSmallestSwitch(
+      2, Res(4, 8), runnable_in({"cn1", "cn4", "cn5"}), &selected));
+  EXPECT_EQ(selected, (std::list<CranedId>{"cn4", "cn5"}));
+  EXPECT_EQ(checked,
+            (std::vector<CranedId>{"cn1", "cn2", "cn3", "cn4", "cn5"}));
+
+  // No leaf switch holds 3 runnable nodes, so the nodes come from root. Each
+  // node is checked only once.
+  selected.clear();
+  checked.clear();
+  ASSERT_TRUE(tree.SelectInSmallestSwitch(
+      3, Res(4, 8), runnable_in({"cn1", "cn3", "cn5"}), &selected));
+  EXPECT_EQ(selected, (std::list<CranedId>{"cn1", "cn3", "cn5"}));
+  EXPECT_EQ(checked.size(), 6u);
+
+  // A switch whose aggregates can not hold the task is skipped without
+  // checking its nodes.
+  tree.MallocResource("cn1", Res(2, 0));
+  selected.clear();
+  checked.clear();
+  ASSERT_TRUE(tree.SelectInSmallestSwitch(
+      2, Res(4, 8), runnable_in({"cn3", "cn4"}), &selected));
+  EXPECT_EQ(selected, (std::list<CranedId>{"cn3", "cn4"}));
+  EXPECT_EQ(checked, (std::vector<CranedId>{"cn3", "cn4"}));
+  tree.FreeResource("cn1", Res(2, 0));
+
+  // Not enough runnable nodes below any switch.
+  selected.clear();
+  EXPECT_FALSE(tree.SelectInSmallestSwitch(2, Res(4, 8), runnable_in({"cn1"}),
+                                           &selected));
+  EXPECT_TRUE(selected.empty());
+}
@@ -0,0 +1,105 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "../../src/Craned/CgroupManager.h"
+
+#include "gtest/gtest.h"
+
+// Measures the cost of setting up and releasing the cgroup of a task with
+// each cgroup backend, with and without the cgroup pool. Root privilege is
+// required. Run it manually, e.g.,
+//   sudo ./craned_cgroup_benchmark
+
+using namespace Craned;
+using CgroupConstant::CgroupBackend;
+
+namespace {
+
+constexpr task_id_t kTaskIdBase = 900'000'000;
+constexpr int kTaskNum = 500;
+
+using BenchmarkParam = std::tuple<CgroupBackend, bool /*pool enabled*/>;
+
+std::string ParamName(const BenchmarkParam& param) {
+  auto [backend, pooled] = param;
+  return fmt::format(
+      "{}{}", backend == CgroupBackend::CGROUPFS ? "cgroupfs" : "libcgroup",
+      pooled ? "_pooled" : "");
+}
+
+}  // namespace
+
+class CgroupBackendBenchmark
+    : public testing::TestWithParam<BenchmarkParam> {
+ public:
+  void SetUp() override {
+    if (geteuid() != 0) GTEST_SKIP() << "Root privilege is required.";
+
+    g_thread_pool = std::make_unique<BS::thread_pool>(4);
+    g_cg_mgr = std::make_unique<CgroupManager>();
+    g_cg_mgr->SetCgroupBackend(std::get<0>(GetParam()));
+    if (std::get<1>(GetParam()))
+      g_cg_mgr->EnableCgroupPool(kTaskNum, kTaskNum);
+    g_cg_mgr->Init();
+  }
+
+  void TearDown() override {
+    if (g_thread_pool) g_thread_pool->wait();
+    g_cg_mgr.reset();
+    g_thread_pool.reset();
+  }
+};
+
+TEST_P(CgroupBackendBenchmark, SetupPerTask) {
+  std::vector<CgroupSpec> specs;
+  for (int i = 0; i < kTaskNum; i++) {
+    CgroupSpec spec;
+    spec.uid = 0;
+    spec.task_id = kTaskIdBase + i;
+    auto* res = spec.res_in_node.mutable_allocatable_res_in_node();
+    res->set_cpu_core_limit(1);
+    res->set_memory_limit_bytes(256 * 1024 * 1024);
+    res->set_memory_sw_limit_bytes(256 * 1024 * 1024);
+    specs.emplace_back(std::move(spec));
+  }
+  ASSERT_TRUE(g_cg_mgr->CreateCgroups(std::move(specs)));
+
+  auto setup_begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < kTaskNum; i++) {
+    Cgroup* cg;
+    ASSERT_TRUE(g_cg_mgr->AllocateAndGetCgroup(kTaskIdBase + i, &cg));
+  }
+  auto setup_end = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < kTaskNum; i++)
+    ASSERT_TRUE(g_cg_mgr->ReleaseCgroup(kTaskIdBase + i, 0));
+  g_thread_pool->wait();
+  auto release_end = std::chrono::steady_clock::now();
+
+  auto us = [](auto d) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+  };
+  fmt::print("[{}] cgroup setup: {} us/task, release: {} us/task\n",
+             ParamName(GetParam()), us(setup_end - setup_begin) / kTaskNum,
+             us(release_end - setup_end) / kTaskNum);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    Backends, CgroupBackendBenchmark,
+    testing::Combine(testing::Values(CgroupBackend::LIBCGROUP,
+                                     CgroupBackend::CGROUPFS),
+                     testing::Bool()),
+    [](const auto& info) { return ParamName(info.param); });
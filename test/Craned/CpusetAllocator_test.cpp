@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "../../src/Craned/CpusetAllocator.h"
+
+#include <fstream>
+
+#include "gtest/gtest.h"
+
+using Craned::CpusetAllocator;
+
+namespace fs = std::filesystem;
+
+class CpusetAllocatorTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    m_sysfs_dir_ = fs::temp_directory_path() /
+                   fmt::format("cpuset_allocator_test_{}", getpid());
+    fs::create_directories(m_sysfs_dir_ / "cpu");
+  }
+
+  void TearDown() override { fs::remove_all(m_sysfs_dir_); }
+
+  void WriteFile(const fs::path& path, const std::string& content) {
+    fs::create_directories(path.parent_path());
+    std::ofstream(path) << content << '\n';
+  }
+
+  // Two NUMA nodes with 4 cpus each.
+  void WriteTwoNodes() {
+    WriteFile(m_sysfs_dir_ / "cpu" / "online", "0-7");
+    WriteFile(m_sysfs_dir_ / "node" / "node0" / "cpulist", "0-3");
+    WriteFile(m_sysfs_dir_ / "node" / "node1" / "cpulist", "4-7");
+  }
+
+  fs::path m_sysfs_dir_;
+};
+
+TEST_F(CpusetAllocatorTest, ListString) {
+  std::vector<uint32_t> ids;
+  ASSERT_TRUE(CpusetAllocator::ParseListString("0-3,8,10-11\n", &ids));
+  EXPECT_EQ(ids, (std::vector<uint32_t>{0, 1, 2, 3, 8, 10, 11}));
+  EXPECT_EQ(CpusetAllocator::ToListString(ids), "0-3,8,10-11");
+
+  ids.clear();
+  EXPECT_FALSE(CpusetAllocator::ParseListString("3-1", &ids));
+  EXPECT_FALSE(CpusetAllocator::ParseListString("a", &ids));
+}
+
+TEST_F(CpusetAllocatorTest, PackWithinNumaNode) {
+  WriteTwoNodes();
+  CpusetAllocator allocator;
+  ASSERT_TRUE(allocator.Init(m_sysfs_dir_.string()));
+  EXPECT_EQ(CpusetAllocator::ToListString(allocator.AllCpus().cpus), "0-7");
+  EXPECT_EQ(CpusetAllocator::ToListString(allocator.AllCpus().mems), "0-1");
+
+  auto cpuset = allocator.Allocate(1, 1);
+  ASSERT_TRUE(cpuset.has_value());
+  EXPECT_EQ(cpuset->cpus, (std::vector<uint32_t>{0}));
+  EXPECT_EQ(cpuset->mems, (std::vector<uint32_t>{0}));
+
+  // Node 0 has 3 free cpus and is the tightest fit.
+  cpuset = allocator.Allocate(2, 3);
+  ASSERT_TRUE(cpuset.has_value());
+  EXPECT_EQ(cpuset->cpus, (std::vector<uint32_t>{1, 2, 3}));
+
+  // Only node 1 can hold 4 cpus.
+  allocator.Free(1);
+  cpuset = allocator.Allocate(3, 4);
+  ASSERT_TRUE(cpuset.has_value());
+  EXPECT_EQ(cpuset->cpus, (std::vector<uint32_t>{4, 5, 6, 7}));
+  EXPECT_EQ(cpuset->mems, (std::vector<uint32_t>{1}));
+
+  EXPECT_EQ(allocator.FreeCpuNum(), 1u);
+  EXPECT_FALSE(allocator.Allocate(4, 2).has_value());
+  // A task is assigned cpus only once.
+  EXPECT_FALSE(allocator.Allocate(3, 1).has_value());
+}
+
+TEST_F(CpusetAllocatorTest, SpanNumaNodes) {
+  WriteTwoNodes();
+  CpusetAllocator allocator;
+  ASSERT_TRUE(allocator.Init(m_sysfs_dir_.string()));
+
+  ASSERT_TRUE(allocator.Allocate(1, 2).has_value());
+
+  // No single node has 6 free cpus.
+  auto cpuset = allocator.Allocate(2, 6);
+  ASSERT_TRUE(cpuset.has_value());
+  EXPECT_EQ(cpuset->cpus, (std::vector<uint32_t>{2, 3, 4, 5, 6, 7}));
+  EXPECT_EQ(cpuset->mems, (std::vector<uint32_t>{0, 1}));
+
+  allocator.Free(2);
+  EXPECT_EQ(allocator.FreeCpuNum(), 6u);
+  EXPECT_EQ(allocator.GetCpusetOfTask(1)->cpus,
+            (std::vector<uint32_t>{0, 1}));
+  EXPECT_FALSE(allocator.GetCpusetOfTask(2).has_value());
+}
+
+TEST_F(CpusetAllocatorTest, PreferDeviceNumaNodes) {
+  WriteTwoNodes();
+  CpusetAllocator allocator;
+  ASSERT_TRUE(allocator.Init(m_sysfs_dir_.string()));
+
+  ASSERT_TRUE(allocator.Allocate(1, 1).has_value());
+
+  // Node 0 is the tightest fit, but the devices of the task are on node 1.
+  auto cpuset = allocator.Allocate(2, 2, {1});
+  ASSERT_TRUE(cpuset.has_value());
+  EXPECT_EQ(cpuset->cpus, (std::vector<uint32_t>{4, 5}));
+
+  // Node 1 can't hold 3 cpus any more.
+  cpuset = allocator.Allocate(3, 3, {1});
+  ASSERT_TRUE(cpuset.has_value());
+  EXPECT_EQ(cpuset->cpus, (std::vector<uint32_t>{1, 2, 3}));
+
+  // Spanning nodes, the cpus of node 1 are taken first.
+  allocator.Free(3);
+  cpuset = allocator.Allocate(4, 4, {1});
+  ASSERT_TRUE(cpuset.has_value());
+  EXPECT_EQ(cpuset->cpus, (std::vector<uint32_t>{1, 2, 6, 7}));
+  EXPECT_EQ(cpuset->mems, (std::vector<uint32_t>{0, 1}));
+}
+
+TEST_F(CpusetAllocatorTest, SharedCpusExcludeAssignedOnes) {
+  WriteTwoNodes();
+  CpusetAllocator allocator;
+  ASSERT_TRUE(allocator.Init(m_sysfs_dir_.string()));
+  EXPECT_EQ(CpusetAllocator::ToListString(allocator.SharedCpus().cpus), "0-7");
+
+  ASSERT_TRUE(allocator.Allocate(1, 4).has_value());
+  ASSERT_TRUE(allocator.Allocate(2, 2).has_value());
+  auto shared = allocator.SharedCpus();
+  EXPECT_EQ(CpusetAllocator::ToListString(shared.cpus), "6-7");
+  EXPECT_EQ(CpusetAllocator::ToListString(shared.mems), "1");
+
+  // A cpuset can't be empty, so all cpus are shared when none is left.
+  ASSERT_TRUE(allocator.Allocate(3, 2).has_value());
+  EXPECT_EQ(CpusetAllocator::ToListString(allocator.SharedCpus().cpus),
+            "0-7");
+
+  EXPECT_TRUE(allocator.Free(1));
+  EXPECT_FALSE(allocator.Free(1));
+  shared = allocator.SharedCpus();
+  EXPECT_EQ(CpusetAllocator::ToListString(shared.cpus), "0-3");
+  EXPECT_EQ(CpusetAllocator::ToListString(shared.mems), "0");
+}
+
+TEST_F(CpusetAllocatorTest, NoNumaSupport) {
+  WriteFile(m_sysfs_dir_ / "cpu" / "online", "0-1,3");
+  CpusetAllocator allocator;
+  ASSERT_TRUE(allocator.Init(m_sysfs_dir_.string()));
+
+  EXPECT_EQ(CpusetAllocator::ToListString(allocator.AllCpus().cpus), "0-1,3");
+  EXPECT_EQ(CpusetAllocator::ToListString(allocator.AllCpus().mems), "0");
+
+  auto cpuset = allocator.Allocate(1, 3);
+  ASSERT_TRUE(cpuset.has_value());
+  EXPECT_EQ(cpuset->cpus, (std::vector<uint32_t>{0, 1, 3}));
+}
@@ -0,0 +1,144 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+
+#include "../../src/Craned/JobMonitorSampleBuffer.h"
+
+#include "gtest/gtest.h"
+
+using Craned::JobMonitorSampleBuffer;
+
+namespace {
+
+const absl::Time kStart = absl::FromUnixSeconds(1000);
+constexpr absl::Duration kPushInterval = absl::Seconds(30);
+
+crane::grpc::TaskResourceUsage Usage(uint64_t base) {
+  crane::grpc::TaskResourceUsage usage;
+  usage.set_cpu_time_usec(base);
+  usage.set_mem_current_bytes(base + 1);
+  usage.set_mem_peak_bytes(base + 2);
+  usage.set_io_read_bytes(base + 3);
+  usage.set_io_write_bytes(base + 4);
+  return usage;
+}
+
+const crane::grpc::plugin::JobUsageSeries* FindSeries(
+    const crane::grpc::plugin::JobMonitorSamplesRequest& samples,
+    task_id_t task_id) {
+  for (const auto& series : samples.series_list())
+    if (series.task_id() == task_id) return &series;
+  return nullptr;
+}
+
+}  // namespace
+
+TEST(JobMonitorSampleBufferTest, AppendSamplesPerTask) {
+  JobMonitorSampleBuffer buffer;
+
+  // Task 2 ends after the second sample and task 3 starts at it.
+  EXPECT_FALSE(buffer.AddSamples(kStart, kPushInterval,
+                                 {{1, Usage(100)}, {2, Usage(200)}}));
+  EXPECT_FALSE(buffer.AddSamples(kStart + absl::Seconds(10), kPushInterval,
+                                 {{1, Usage(110)},
+                                  {2, Usage(210)},
+                                  {3, Usage(300)}}));
+  auto samples = buffer.AddSamples(kStart + absl::Seconds(30), kPushInterval,
+                                   {{1, Usage(120)}, {3, Usage(310)}});
+  ASSERT_TRUE(samples.has_value());
+  ASSERT_EQ(samples->series_list_size(), 3);
+
+  const auto* series = FindSeries(*samples, 1);
+  ASSERT_NE(series, nullptr);
+  EXPECT_EQ(std::vector<int64_t>(series->sample_time().begin(),
+                                 series->sample_time().end()),
+            (std::vector<int64_t>{1000, 1010, 1030}));
+  EXPECT_EQ(std::vector<uint64_t>(series->cpu_time_usec().begin(),
+                                  series->cpu_time_usec().end()),
+            (std::vector<uint64_t>{100, 110, 120}));
+  EXPECT_EQ(std::vector<uint64_t>(series->mem_current_bytes().begin(),
+                                  series->mem_current_bytes().end()),
+            (std::vector<uint64_t>{101, 111, 121}));
+  EXPECT_EQ(std::vector<uint64_t>(series->mem_peak_bytes().begin(),
+                                  series->mem_peak_bytes().end()),
+            (std::vector<uint64_t>{102, 112, 122}));
+  EXPECT_EQ(std::vector<uint64_t>(series->io_read_bytes().begin(),
+                                  series->io_read_bytes().end()),
+            (std::vector<uint64_t>{103, 113, 123}));
+  EXPECT_EQ(std::vector<uint64_t>(series->io_write_bytes().begin(),
+                                  series->io_write_bytes().end()),
+            (std::vector<uint64_t>{104, 114, 124}));
+
+  series = FindSeries(*samples, 2);
+  ASSERT_NE(series, nullptr);
+  EXPECT_EQ(std::vector<int64_t>(series->sample_time().begin(),
+                                 series->sample_time().end()),
+            (std::vector<int64_t>{1000, 1010}));
+
+  series = FindSeries(*samples, 3);
+  ASSERT_NE(series, nullptr);
+  EXPECT_EQ(std::vector<uint64_t>(series->cpu_time_usec().begin(),
+                                  series->cpu_time_usec().end()),
+            (std::vector<uint64_t>{300, 310}));
+}
+
+TEST(JobMonitorSampleBufferTest, PushAtIntervalBoundary) {
+  JobMonitorSampleBuffer buffer;
+
+  // The interval starts with the first sample.
+  EXPECT_FALSE(buffer.AddSamples(kStart, kPushInterval, {{1, Usage(0)}}));
+  EXPECT_FALSE(buffer.AddSamples(kStart + kPushInterval - absl::Seconds(1),
+                                 kPushInterval, {{1, Usage(0)}}));
+
+  auto samples =
+      buffer.AddSamples(kStart + kPushInterval, kPushInterval, {{1, Usage(0)}});
+  ASSERT_TRUE(samples.has_value());
+  EXPECT_EQ(samples->series_list(0).sample_time_size(), 3);
+
+  // The next interval starts at the push.
+  EXPECT_FALSE(buffer.AddSamples(kStart + kPushInterval * 2 - absl::Seconds(1),
+                                 kPushInterval, {{1, Usage(0)}}));
+  EXPECT_TRUE(buffer.AddSamples(kStart + kPushInterval * 2, kPushInterval,
+                                {{1, Usage(0)}}));
+}
+
+TEST(JobMonitorSampleBufferTest, ResetAfterPush) {
+  JobMonitorSampleBuffer buffer;
+
+  EXPECT_FALSE(buffer.AddSamples(kStart, kPushInterval, {{1, Usage(100)}}));
+  auto samples = buffer.AddSamples(kStart + kPushInterval, kPushInterval,
+                                   {{1, Usage(130)}});
+  ASSERT_TRUE(samples.has_value());
+  EXPECT_EQ(samples->series_list(0).sample_time_size(), 2);
+
+  // Only the samples taken after the push are in the next one, and the
+  // series of the tasks which have ended are gone.
+  EXPECT_FALSE(buffer.AddSamples(kStart + kPushInterval + absl::Seconds(10),
+                                 kPushInterval, {{2, Usage(200)}}));
+  samples = buffer.AddSamples(kStart + kPushInterval * 2, kPushInterval,
+                              {{2, Usage(230)}});
+  ASSERT_TRUE(samples.has_value());
+  ASSERT_EQ(samples->series_list_size(), 1);
+  EXPECT_EQ(samples->series_list(0).task_id(), 2u);
+  EXPECT_EQ(std::vector<uint64_t>(
+                samples->series_list(0).cpu_time_usec().begin(),
+                samples->series_list(0).cpu_time_usec().end()),
+            (std::vector<uint64_t>{200, 230}));
+
+  // Nothing is pushed without any sample.
+  EXPECT_FALSE(
+      buffer.AddSamples(kStart + kPushInterval * 3, kPushInterval, {}));
+}
@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+
+#include "../../src/Craned/TaskOutputRing.h"
+
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+
+using Craned::TaskOutputRing;
+
+namespace {
+
+// Copy data into the free spans of the ring as readv() does.
+// @return the number of bytes copied.
+size_t Fill(TaskOutputRing* ring, std::string_view data) {
+  iovec iov[2];
+  int iov_cnt = ring->FreeSpans(iov);
+
+  size_t copied = 0;
+  for (int i = 0; i < iov_cnt && copied < data.size(); i++) {
+    size_t n = std::min(iov[i].iov_len, data.size() - copied);
+    memcpy(iov[i].iov_base, data.data() + copied, n);
+    copied += n;
+  }
+  ring->Commit(copied);
+  return copied;
+}
+
+std::string DrainAll(TaskOutputRing* ring) {
+  std::string out;
+  ring->DrainTo(&out, ring->Size());
+  return out;
+}
+
+}  // namespace
+
+TEST(TaskOutputRingTest, WrapAround) {
+  TaskOutputRing ring(8);
+  ASSERT_EQ(Fill(&ring, "abcdef"), 6u);
+
+  std::string out;
+  EXPECT_EQ(ring.DrainTo(&out, 4), 4u);
+  EXPECT_EQ(out, "abcd");
+
+  // The free space is split at the end of the buffer.
+  iovec iov[2];
+  ASSERT_EQ(ring.FreeSpans(iov), 2);
+  EXPECT_EQ(iov[0].iov_len, 2u);
+  EXPECT_EQ(iov[1].iov_len, 4u);
+
+  ASSERT_EQ(Fill(&ring, "ghijkl"), 6u);
+  EXPECT_TRUE(ring.Full());
+  EXPECT_EQ(DrainAll(&ring), "efghijkl");
+  EXPECT_TRUE(ring.Empty());
+}
+
+TEST(TaskOutputRingTest, PartialDrains) {
+  TaskOutputRing ring(16);
+  ASSERT_EQ(Fill(&ring, "0123456789"), 10u);
+
+  std::string out;
+  EXPECT_EQ(ring.DrainTo(&out, 3), 3u);
+  EXPECT_EQ(ring.DrainTo(&out, 3), 3u);
+  EXPECT_EQ(out, "012345");
+  EXPECT_EQ(ring.Size(), 4u);
+
+  // Draining more than the data moves only the data.
+  EXPECT_EQ(ring.DrainTo(&out, 100), 4u);
+  EXPECT_EQ(out, "0123456789");
+  EXPECT_EQ(ring.DrainTo(&out, 100), 0u);
+}
+
+TEST(TaskOutputRingTest, FullRingHasNoFreeSpan) {
+  TaskOutputRing ring(8);
+
+  // The output fd is read into the free spans with readv().
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  ASSERT_EQ(write(fds[1], "0123456789", 10), 10);
+
+  iovec iov[2];
+  int iov_cnt = ring.FreeSpans(iov);
+  ASSERT_EQ(iov_cnt, 1);
+  ssize_t n = readv(fds[0], iov, iov_cnt);
+  ASSERT_EQ(n, 8);
+  ring.Commit(n);
+
+  // The caller stops polling the fd when no free span is left.
+  EXPECT_TRUE(ring.Full());
+  EXPECT_EQ(ring.FreeSpans(iov), 0);
+
+  // Draining a part of the ring makes room for the rest of the output.
+  std::string out;
+  ring.DrainTo(&out, 5);
+  iov_cnt = ring.FreeSpans(iov);
+  ASSERT_EQ(iov_cnt, 1);
+  n = readv(fds[0], iov, iov_cnt);
+  ASSERT_EQ(n, 2);
+  ring.Commit(n);
+  EXPECT_EQ(out + DrainAll(&ring), "0123456789");
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST(TaskOutputRingTest, DrainInChunksSplitsAtCap) {
+  constexpr size_t kCapacity = 256 * 1024;
+  constexpr size_t kMaxChunkBytes = 64 * 1024;
+  TaskOutputRing ring(kCapacity);
+
+  // Start in the middle of the buffer so that a chunk wraps around.
+  std::string data(kCapacity / 2, 'a');
+  ASSERT_EQ(Fill(&ring, data), data.size());
+  DrainAll(&ring);
+
+  data.clear();
+  for (size_t i = 0; i < kCapacity - 1; i++) data.push_back('a' + i % 26);
+  ASSERT_EQ(Fill(&ring, data), data.size());
+
+  std::vector<std::string> chunks;
+  size_t moved = ring.DrainInChunks(kMaxChunkBytes,
+                                    [&] { return &chunks.emplace_back(); });
+  EXPECT_EQ(moved, data.size());
+  EXPECT_TRUE(ring.Empty());
+
+  ASSERT_EQ(chunks.size(), 4u);
+  for (size_t i = 0; i < 3; i++) EXPECT_EQ(chunks[i].size(), kMaxChunkBytes);
+  EXPECT_EQ(chunks[3].size(), kMaxChunkBytes - 1);
+  EXPECT_EQ(absl::StrJoin(chunks, ""), data);
+
+  // Nothing is produced for an empty ring.
+  moved = ring.DrainInChunks(kMaxChunkBytes,
+                             [&] { return &chunks.emplace_back(); });
+  EXPECT_EQ(moved, 0u);
+  EXPECT_EQ(chunks.size(), 4u);
+}
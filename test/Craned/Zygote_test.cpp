@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "../../src/Craned/Zygote.h"
+
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <filesystem>
+#include <fstream>
+
+using namespace Craned;
+
+namespace {
+
+int CreateMemfd(const std::string& content) {
+  int fd = memfd_create("zygote_test.sh", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (fd == -1) return -1;
+  if (write(fd, content.data(), content.size()) !=
+      static_cast<ssize_t>(content.size())) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream in(path);
+  return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+}  // namespace
+
+class ZygoteTest : public testing::Test {
+ public:
+  void SetUp() override {
+    // The zygote sets the credential of the child.
+    if (geteuid() != 0) GTEST_SKIP() << "Zygote tests require root.";
+    ASSERT_TRUE(m_zygote_.Start());
+
+    char dir[] = "/tmp/zygote_test_XXXXXX";
+    ASSERT_NE(mkdtemp(dir), nullptr);
+    m_dir_ = dir;
+  }
+
+  void TearDown() override {
+    if (!m_dir_.empty()) std::filesystem::remove_all(m_dir_);
+  }
+
+  crane::grpc::subprocess::ZygoteSpawnRequest NewRequest(
+      const std::string& stdout_file) {
+    crane::grpc::subprocess::ZygoteSpawnRequest request;
+    request.set_task_id(1);
+    request.set_uid(getuid());
+    request.set_gid(getgid());
+    request.set_cwd(m_dir_);
+    request.set_stdout_file(stdout_file);
+    request.set_close_stdin(true);
+    return request;
+  }
+
+  // The child is created with CLONE_PARENT, so it is reaped here.
+  static int WaitExitStatus(pid_t pid) {
+    int status;
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status)) return -1;
+    return WEXITSTATUS(status);
+  }
+
+ protected:
+  Zygote m_zygote_;
+  std::string m_dir_;
+};
+
+TEST_F(ZygoteTest, SpawnWithoutFds) {
+  std::string out = m_dir_ + "/out";
+  auto request = NewRequest(out);
+  request.set_exec_path("/bin/sh");
+  request.add_argv("sh");
+  request.add_argv("-c");
+  request.add_argv("echo no-fd");
+
+  crane::grpc::subprocess::ZygoteSpawnReply reply;
+  ASSERT_EQ(m_zygote_.Spawn(request, {}, &reply), CraneErr::kOk);
+  ASSERT_TRUE(reply.ok()) << reply.reason();
+  ASSERT_FALSE(reply.failed_before_exec()) << reply.reason();
+
+  EXPECT_EQ(WaitExitStatus(reply.pid()), 0);
+  EXPECT_EQ(ReadFile(out), "no-fd\n");
+}
+
+TEST_F(ZygoteTest, SpawnWithScriptMemfd) {
+  int script_fd = CreateMemfd("#!/bin/bash\necho from-memfd\n");
+  ASSERT_NE(script_fd, -1);
+
+  std::string out = m_dir_ + "/out";
+  auto request = NewRequest(out);
+  request.set_exec_path("/bin/bash");
+  request.add_argv("bash");
+  request.add_argv(fmt::format("/proc/self/fd/{}", kTaskScriptFd));
+  request.set_has_script_fd(true);
+
+  crane::grpc::subprocess::ZygoteSpawnReply reply;
+  CraneErr err = m_zygote_.Spawn(request, {script_fd}, &reply);
+  close(script_fd);
+
+  ASSERT_EQ(err, CraneErr::kOk);
+  ASSERT_TRUE(reply.ok()) << reply.reason();
+  ASSERT_FALSE(reply.failed_before_exec()) << reply.reason();
+
+  EXPECT_EQ(WaitExitStatus(reply.pid()), 0);
+  EXPECT_EQ(ReadFile(out), "from-memfd\n");
+}
@@ -0,0 +1,101 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "crane/AtomicHashMap.h"
+
+// Compares util::AtomicHashMap with util::ShardedAtomicHashMap under
+// concurrent accesses which look like the ones on the task maps of Craned:
+// value lookups from many threads while tasks are inserted and removed.
+// Run it manually, e.g.,
+//   ./atomic_hash_map_benchmark
+
+namespace {
+
+constexpr int kKeyNum = 1024;
+constexpr int kOpNumPerThread = 200'000;
+
+using GlobalMap = util::AtomicHashMap<absl::flat_hash_map, uint32_t, int64_t>;
+template <size_t ShardNum>
+using ShardedMap = util::ShardedAtomicHashMap<absl::flat_hash_map, uint32_t,
+                                              int64_t, ShardNum>;
+
+// One in write_every operations inserts and then erases a key.
+// Return the throughput in Mops/s.
+template <typename Map>
+double RunWorkload(int thread_num, int write_every) {
+  Map map;
+  for (uint32_t i = 0; i < kKeyNum; i++) map.Emplace(i, 0);
+
+  std::atomic_bool start{false};
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; t++) {
+    threads.emplace_back([&, t] {
+      std::mt19937 rng(t);
+      std::uniform_int_distribution<uint32_t> dist(0, kKeyNum - 1);
+      uint32_t churn_key = kKeyNum + t * kOpNumPerThread;
+      while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+
+      for (int i = 0; i < kOpNumPerThread; i++) {
+        if (write_every > 0 && i % write_every == 0) {
+          map.Emplace(churn_key, i);
+          map.Erase(churn_key++);
+        } else {
+          auto ptr = map[dist(rng)];
+          (*ptr)++;
+        }
+      }
+    });
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  start.store(true, std::memory_order_release);
+  for (auto& thread : threads) thread.join();
+  auto end = std::chrono::steady_clock::now();
+
+  double us =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - begin)
+          .count();
+  return static_cast<double>(thread_num) * kOpNumPerThread / us;
+}
+
+}  // namespace
+
+TEST(AtomicHashMapBenchmark, Contention) {
+  int max_thread_num =
+      std::max(2, static_cast<int>(std::thread::hardware_concurrency()));
+
+  for (int write_every : {0, 100, 10}) {
+    fmt::print("write ratio: {}\n",
+               write_every ? fmt::format("1/{}", write_every) : "0");
+    for (int thread_num = 1; thread_num <= max_thread_num; thread_num *= 2) {
+      fmt::print(
+          "  {:>3} threads: global {:6.2f}, 16 shards {:6.2f}, "
+          "64 shards {:6.2f} Mops/s\n",
+          thread_num, RunWorkload<GlobalMap>(thread_num, write_every),
+          RunWorkload<ShardedMap<16>>(thread_num, write_every),
+          RunWorkload<ShardedMap<64>>(thread_num, write_every));
+    }
+  }
+}
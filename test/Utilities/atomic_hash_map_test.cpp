@@ -0,0 +1,94 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "crane/AtomicHashMap.h"
+
+#include <gtest/gtest.h>
+
+#include <thread>
+#include <vector>
+
+using ShardedMap = util::ShardedAtomicHashMap<absl::flat_hash_map, int, int, 4>;
+
+TEST(ShardedAtomicHashMap, Basic) {
+  ShardedMap map;
+  absl::flat_hash_map<int, int> init_map;
+  for (int i = 0; i < 100; i++) init_map.emplace(i, i * 10);
+  map.InitFromMap(std::move(init_map));
+
+  EXPECT_TRUE(map.Contains(42));
+  EXPECT_FALSE(map.Contains(100));
+  EXPECT_EQ(map[100].get(), nullptr);
+
+  {
+    auto ptr = map[42];
+    ASSERT_NE(ptr.get(), nullptr);
+    EXPECT_EQ(*ptr, 420);
+    *ptr = 1;
+  }
+
+  int value = 0;
+  EXPECT_TRUE(map.Read(42, [&](const int& v) { value = v; }));
+  EXPECT_EQ(value, 1);
+  EXPECT_FALSE(map.Read(100, [&](const int&) { FAIL(); }));
+
+  map.Emplace(100, 1000);
+  map.Erase(0);
+  EXPECT_TRUE(map.Contains(100));
+  EXPECT_FALSE(map.Contains(0));
+
+  int cnt = 0;
+  int64_t sum = 0;
+  map.ForEach([&](int key, const util::Synchronized<int>& v) {
+    cnt++;
+    sum += key;
+    EXPECT_EQ(*v.GetExclusivePtr(), key == 42 ? 1 : key * 10);
+  });
+  EXPECT_EQ(cnt, 100);
+  EXPECT_EQ(sum, 100 * 101 / 2);
+}
+
+TEST(ShardedAtomicHashMap, ConcurrentUpdate) {
+  constexpr int kThreadNum = 8;
+  constexpr int kKeyNum = 64;
+  constexpr int kRoundNum = 10000;
+
+  ShardedMap map;
+  for (int i = 0; i < kKeyNum; i++) map.Emplace(i, 0);
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreadNum; t++) {
+    threads.emplace_back([&map, t] {
+      for (int i = 0; i < kRoundNum; i++) {
+        // Other keys are inserted and removed while the values are updated.
+        int churn_key = kKeyNum + t * kRoundNum + i;
+        map.Emplace(churn_key, i);
+        (*map[i % kKeyNum])++;
+        map.Erase(churn_key);
+      }
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  int64_t sum = 0;
+  int cnt = 0;
+  map.ForEach([&](int, const util::Synchronized<int>& v) {
+    cnt++;
+    sum += *v.GetExclusivePtr();
+  });
+  EXPECT_EQ(cnt, kKeyNum);
+  EXPECT_EQ(sum, kThreadNum * kRoundNum);
+}
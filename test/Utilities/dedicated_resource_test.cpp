@@ -232,3 +232,122 @@ TEST(DEDICATED_RES_NODE, req_map5) {
                req, resourceInNode);
 }
 
+
+namespace {
+
+constexpr std::array fake_slots = {"/dev/fake0", "/dev/fake1", "/dev/fake2",
+                                   "/dev/fake3", "/dev/fake4"};
+
+ResourceView GpuRequest(uint64_t untyped_cnt,
+                        const std::map<std::string, uint64_t>& typed = {}) {
+  crane::grpc::ResourceView grpc_view;
+  auto& type_count_map =
+      (*grpc_view.mutable_device_map()->mutable_name_type_map())["GPU"];
+  type_count_map.set_total(untyped_cnt);
+  for (const auto& [type, cnt] : typed)
+    (*type_count_map.mutable_type_count_map())[type] = cnt;
+  return ResourceView(grpc_view);
+}
+
+// fake0 and fake2 are on NUMA node 0, the others are on NUMA node 1.
+ResourceInNode FakeGpuNode() {
+  ResourceInNode res;
+  res.dedicated_res["GPU"]["A100"].insert(fake_slots.begin(),
+                                          fake_slots.end());
+  for (size_t i = 0; i < fake_slots.size(); i++) {
+    bool on_node0 = i == 0 || i == 2;
+    res.dedicated_res.slot_affinity_map[fake_slots[i]] =
+        on_node0 ? SlotAffinity(0, "0000:01:00.0")
+                 : SlotAffinity(1, "0000:81:00.0");
+  }
+  return res;
+}
+
+std::set<SlotId> AllSlots(const ResourceInNode& res) {
+  std::set<SlotId> slots;
+  for (const auto& [name, type_slots_map] :
+       res.dedicated_res.name_type_slots_map)
+    for (const auto& [type, type_slots] : type_slots_map.type_slots_map)
+      slots.insert(type_slots.begin(), type_slots.end());
+  return slots;
+}
+
+}  // namespace
+
+TEST(DEDICATED_RES_NODE, affinity_smallest_domain) {
+  ResourceInNode feasible;
+  ASSERT_TRUE(GpuRequest(2).GetFeasibleResourceInNode(FakeGpuNode(),
+                                                      &feasible));
+  ASSERT_EQ(AllSlots(feasible), (std::set<SlotId>{fake_slots[0],
+                                                  fake_slots[2]}));
+
+  feasible = {};
+  ASSERT_TRUE(GpuRequest(3).GetFeasibleResourceInNode(FakeGpuNode(),
+                                                      &feasible));
+  ASSERT_EQ(AllSlots(feasible),
+            (std::set<SlotId>{fake_slots[1], fake_slots[3], fake_slots[4]}));
+}
+
+TEST(DEDICATED_RES_NODE, affinity_largest_domain_first) {
+  ResourceInNode feasible;
+  ASSERT_TRUE(GpuRequest(4).GetFeasibleResourceInNode(FakeGpuNode(),
+                                                      &feasible));
+  ASSERT_EQ(AllSlots(feasible),
+            (std::set<SlotId>{fake_slots[0], fake_slots[1], fake_slots[3],
+                              fake_slots[4]}));
+
+  feasible = {};
+  ASSERT_FALSE(GpuRequest(6).GetFeasibleResourceInNode(FakeGpuNode(),
+                                                       &feasible));
+}
+
+TEST(DEDICATED_RES_NODE, affinity_typed_and_untyped) {
+  ResourceInNode avail = FakeGpuNode();
+  avail.dedicated_res["GPU"]["A100"].erase(fake_slots[2]);
+  avail.dedicated_res["GPU"]["H100"].insert(fake_slots[2]);
+
+  // Only NUMA node 1 holds 2 A100 and 1 more slot.
+  ResourceInNode feasible;
+  ASSERT_TRUE(GpuRequest(1, {{"A100", 2}})
+                  .GetFeasibleResourceInNode(avail, &feasible));
+  ASSERT_EQ(AllSlots(feasible),
+            (std::set<SlotId>{fake_slots[1], fake_slots[3], fake_slots[4]}));
+
+  // NUMA node 0 holds 1 A100 and 1 H100.
+  feasible = {};
+  ASSERT_TRUE(GpuRequest(1, {{"A100", 1}})
+                  .GetFeasibleResourceInNode(avail, &feasible));
+  ASSERT_EQ(feasible.dedicated_res.at("GPU").at("A100"),
+            (std::set<SlotId>{fake_slots[0]}));
+  ASSERT_EQ(feasible.dedicated_res.at("GPU").at("H100"),
+            (std::set<SlotId>{fake_slots[2]}));
+}
+
+TEST(DEDICATED_RES_NODE, affinity_unknown) {
+  ResourceInNode avail = FakeGpuNode();
+  avail.dedicated_res.slot_affinity_map.clear();
+
+  // Without affinity the slots are chosen in order.
+  ResourceInNode feasible;
+  ASSERT_TRUE(GpuRequest(2).GetFeasibleResourceInNode(avail, &feasible));
+  ASSERT_EQ(AllSlots(feasible), (std::set<SlotId>{fake_slots[0],
+                                                  fake_slots[1]}));
+}
+
+TEST(DEDICATED_RES_NODE, affinity_kept) {
+  ResourceInNode avail = FakeGpuNode();
+  DedicatedResourceInNode allocated;
+  allocated["GPU"]["A100"].insert(fake_slots[0]);
+
+  avail.dedicated_res -= allocated;
+  ASSERT_EQ(avail.dedicated_res.slot_affinity_map.size(), fake_slots.size());
+
+  DedicatedResourceInNode converted(
+      static_cast<crane::grpc::DedicatedResourceInNode>(avail.dedicated_res));
+  ASSERT_EQ(converted.slot_affinity_map, avail.dedicated_res.slot_affinity_map);
+
+  DedicatedResourceInNode sum;
+  sum += converted;
+  ASSERT_EQ(sum.slot_affinity_map.at(fake_slots[2]),
+            SlotAffinity(0, "0000:01:00.0"));
+}
@@ -0,0 +1,216 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <absl/strings/str_join.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "crane/HostList.h"
+#include "crane/String.h"
+
+// Compares the hostlist encoding used before util::HostList with the new
+// one on 10k-node lists and the cases of the former string tests. Run it
+// manually, e.g.,
+//   ./hostlist_benchmark
+
+namespace {
+
+constexpr int kRoundNum = 20;
+
+// The encoder used before: fold the first number outside brackets of every
+// name by a hash map of "head<tail" keys until no number is left.
+bool FindFirstNumberWithoutBrackets(const std::string& input, int* start,
+                                    int* end) {
+  *start = *end = 0;
+  size_t opens = 0;
+  int i = 0;
+  for (const auto& c : input) {
+    if (c == '[') {
+      opens++;
+    } else if (c == ']') {
+      opens--;
+    } else if (!opens) {
+      if (!(*start) && c >= '0' && c <= '9') {
+        *start = i;
+      } else if (*start && (c < '0' || c > '9')) {
+        *end = i;
+        return true;
+      }
+    }
+    i++;
+  }
+  if (!*start) return false;
+  *end = i;
+  return true;
+}
+
+bool LegacyFoldOnce(std::list<std::string>& host_list,
+                    std::list<std::string>* res_list) {
+  std::unordered_map<std::string, std::vector<std::string>> host_map;
+  bool res = true;
+
+  if (host_list.empty()) return true;
+  if (host_list.size() == 1) {
+    res_list->emplace_back(host_list.front());
+    return true;
+  }
+
+  for (const auto& host : host_list) {
+    int start, end;
+    if (FindFirstNumberWithoutBrackets(host, &start, &end)) {
+      res = false;
+      host_map[fmt::format("{}<{}", host.substr(0, start), host.substr(end))]
+          .emplace_back(host.substr(start, end - start));
+    } else {
+      res_list->emplace_back(host);
+    }
+  }
+  if (res) return true;
+
+  for (auto&& [key, nums] : host_map) {
+    size_t delimiter_pos = key.find('<');
+    std::string str = key.substr(0, delimiter_pos) + "[";
+
+    std::sort(nums.begin(), nums.end(), [](std::string& a, std::string& b) {
+      return a.length() != b.length() ? a.length() < b.length()
+                                      : stoi(a) < stoi(b);
+    });
+    nums.erase(std::unique(nums.begin(), nums.end()), nums.end());
+
+    int first = -1, last = -1;
+    std::string first_str, last_str;
+    auto flush = [&] {
+      str += first_str;
+      if (first != last) str += "-" + last_str;
+    };
+    for (const auto& num_str : nums) {
+      int num = stoi(num_str);
+      if (first >= 0 && num == last + 1) {
+        last = num;
+        last_str = num_str;
+        continue;
+      }
+      if (first >= 0) {
+        flush();
+        str += ",";
+      }
+      first = last = num;
+      first_str = last_str = num_str;
+    }
+    flush();
+    res_list->emplace_back(str + "]" + key.substr(delimiter_pos + 1));
+  }
+  return res;
+}
+
+std::string LegacyHostNameListToStr(const std::list<std::string>& hosts) {
+  std::list<std::string> source_list = hosts;
+  while (true) {
+    std::list<std::string> res_list;
+    if (LegacyFoldOnce(source_list, &res_list)) {
+      res_list.sort();
+      std::string output = absl::StrJoin(res_list, ",");
+      size_t left = 0;
+      while ((left = output.find('[', left)) != std::string::npos) {
+        size_t right = output.find(']', left);
+        if (right == std::string::npos) break;
+        std::string content = output.substr(left + 1, right - left - 1);
+        if (content.find_first_of("-,") == std::string::npos) {
+          output.erase(right, 1);
+          output.erase(left, 1);
+        } else {
+          left = right + 1;
+        }
+      }
+      return output;
+    }
+    source_list = std::move(res_list);
+  }
+}
+
+// The worst case for ranges: "cn[00001,00003,...,19999]".
+std::string EveryOtherNode() {
+  std::vector<std::string> nums;
+  for (int i = 1; i < 20'000; i += 2)
+    nums.emplace_back(fmt::format("{:05}", i));
+  return fmt::format("cn[{}]", absl::StrJoin(nums, ","));
+}
+
+template <typename Fn>
+int64_t AvgMicroseconds(Fn fn) {
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < kRoundNum; i++) fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - begin)
+             .count() /
+         kRoundNum;
+}
+
+}  // namespace
+
+class HostListBenchmark : public testing::TestWithParam<std::string> {};
+
+TEST_P(HostListBenchmark, EncodeAndDecode) {
+  const std::string& expr = GetParam();
+
+  std::list<std::string> hosts;
+  ASSERT_TRUE(util::ParseHostList(expr, &hosts));
+  // The allocated nodes of a task come in no particular order.
+  std::vector<std::string> shuffled(hosts.begin(), hosts.end());
+  std::ranges::reverse(shuffled);
+  std::list<std::string> shuffled_list(shuffled.begin(), shuffled.end());
+
+  std::string legacy = LegacyHostNameListToStr(shuffled_list);
+  std::string encoded = util::HostNameListToStr(shuffled);
+  EXPECT_EQ(encoded, legacy);
+
+  util::HostList host_list;
+  ASSERT_TRUE(host_list.Parse(encoded));
+  EXPECT_EQ(host_list.Size(), hosts.size());
+
+  int64_t legacy_us =
+      AvgMicroseconds([&] { LegacyHostNameListToStr(shuffled_list); });
+  int64_t encode_us =
+      AvgMicroseconds([&] { util::HostNameListToStr(shuffled); });
+  int64_t parse_us = AvgMicroseconds([&] {
+    std::list<std::string> list;
+    util::ParseHostList(encoded, &list);
+  });
+  int64_t host_list_parse_us = AvgMicroseconds([&] {
+    util::HostList parsed;
+    parsed.Parse(encoded);
+  });
+
+  fmt::print("{} hosts, {}\n", hosts.size(), encoded.substr(0, 64));
+  fmt::print("  encode: legacy {} us, HostList {} us\n", legacy_us,
+             encode_us);
+  fmt::print("  decode: into a list {} us, into a HostList {} us\n", parse_us,
+             host_list_parse_us);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    HostLists, HostListBenchmark,
+    testing::Values(
+        "cn[00001-10000]", "cn[1-10000]",
+        "cn[00001-04999,05001-10000]", EveryOtherNode(),
+        "rack[01-50]-cn[001-200]",
+        "a[01-99]s[01-05]c[001-100],a[30-40,501-600]s[03-07]c[201-300]",
+        "aaa[1-2,3],bbb"));
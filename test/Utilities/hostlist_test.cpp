@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "crane/HostList.h"
+
+#include <absl/strings/str_join.h>
+#include <gtest/gtest.h>
+
+#include "crane/String.h"
+
+using util::HostList;
+
+namespace {
+
+std::vector<std::string> Expand(const HostList& hosts) {
+  std::vector<std::string> names;
+  hosts.ForEach([&](std::string_view host) { names.emplace_back(host); });
+  std::ranges::sort(names);
+  return names;
+}
+
+HostList FromExpr(const std::string& expr) {
+  HostList hosts;
+  EXPECT_TRUE(hosts.Parse(expr));
+  return hosts;
+}
+
+}  // namespace
+
+TEST(HostList, ParseHostListKeepsOrder) {
+  std::list<std::string> parsed_list;
+  ASSERT_TRUE(util::ParseHostList("aaa[1-2,3],bbb", &parsed_list));
+  EXPECT_EQ(absl::StrJoin(parsed_list, " "), "aaa1 aaa2 aaa3 bbb");
+
+  parsed_list.clear();
+  ASSERT_TRUE(util::ParseHostList("a[1-2]b[08-10].x", &parsed_list));
+  EXPECT_EQ(absl::StrJoin(parsed_list, " "),
+            "a1b08.x a1b09.x a1b10.x a2b08.x a2b09.x a2b10.x");
+}
+
+TEST(HostList, BadFormat) {
+  HostList hosts;
+  for (const char* expr :
+       {"a[1-2", "a1-2]", "a[[1]]", "a[]", "a[1,]", "a[x]", "a[3-1]"}) {
+    std::list<std::string> parsed_list;
+    EXPECT_FALSE(util::ParseHostList(expr, &parsed_list)) << expr;
+    EXPECT_FALSE(hosts.Parse(expr)) << expr;
+  }
+  EXPECT_TRUE(hosts.Empty());
+}
+
+TEST(HostList, ParseMatchesInsert) {
+  for (const char* expr :
+       {"cn[1-120]", "cn[001-100]-ib", "rack1-cn[01-40]", "cn1[0-9]",
+        "a[01-99]s[01-05]c[001-100]", "a[1-2][3-4]", "login,cn[7-12]"}) {
+    HostList parsed = FromExpr(expr);
+
+    HostList inserted;
+    util::ForEachHostInExpr(
+        expr, [&](std::string_view host) { inserted.Insert(host); });
+    EXPECT_EQ(parsed, inserted) << expr;
+    EXPECT_EQ(parsed.Size(), inserted.Size()) << expr;
+  }
+}
+
+TEST(HostList, EncodeRoundTrip) {
+  for (const char* expr :
+       {"a[01-99]s[01-05]c[001-100],a[30-40,501-600]s[03-07]c[201-300]",
+        "cn[8-10]", "cn[08-10]", "cn[1-3,5,7-9]", "cn1", "login",
+        "/dev/nvidia[0-3]", "gpu[1-2]-ib[0-1]"}) {
+    std::list<std::string> parsed_list;
+    ASSERT_TRUE(util::ParseHostList(expr, &parsed_list));
+    EXPECT_EQ(util::HostNameListToStr(parsed_list), expr);
+  }
+}
+
+TEST(HostList, MixedWidths) {
+  HostList hosts = FromExpr("cn[1-10],cn[007-011]");
+  EXPECT_EQ(hosts.Size(), 15);
+  EXPECT_TRUE(hosts.Contains("cn10"));
+  EXPECT_TRUE(hosts.Contains("cn010"));
+  EXPECT_FALSE(hosts.Contains("cn01"));
+  EXPECT_EQ(hosts.Encode(), "cn[1-10,007-011]");
+}
+
+TEST(HostList, SetOperations) {
+  HostList lhs = FromExpr("cn[01-10],login");
+  HostList rhs = FromExpr("cn[05-15],gpu1");
+
+  HostList hosts = lhs;
+  hosts |= rhs;
+  EXPECT_EQ(hosts.Encode(), "cn[01-15],gpu1,login");
+
+  hosts = lhs;
+  hosts &= rhs;
+  EXPECT_EQ(hosts.Encode(), "cn[05-10]");
+
+  hosts = lhs;
+  hosts -= FromExpr("cn[03-04,07],login");
+  EXPECT_EQ(hosts.Encode(), "cn[01-02,05-06,08-10]");
+  EXPECT_EQ(Expand(hosts).size(), 7);
+
+  hosts -= lhs;
+  EXPECT_TRUE(hosts.Empty());
+}
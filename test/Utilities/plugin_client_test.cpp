@@ -0,0 +1,323 @@
+/**
+ * Copyright (c) 2024 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "crane/PluginClient.h"
+
+#include <absl/synchronization/mutex.h>
+#include <grpcpp/grpcpp.h>
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "crane/Logger.h"
+
+using plugin::PluginClient;
+using HookType = PluginClient::HookType;
+
+namespace {
+
+class FakeTaskSnapshot : public PluginClient::TaskSnapshot {
+ public:
+  explicit FakeTaskSnapshot(task_id_t task_id) : m_task_id_(task_id) {}
+
+  void MoveToTaskInfo(crane::grpc::TaskInfo* task_info) override {
+    task_info->set_task_id(m_task_id_);
+  }
+
+ private:
+  task_id_t m_task_id_;
+};
+
+std::vector<PluginClient::TaskSnapshotPtr> Snapshots(
+    std::vector<task_id_t> const& task_ids) {
+  std::vector<PluginClient::TaskSnapshotPtr> tasks;
+  for (task_id_t task_id : task_ids)
+    tasks.emplace_back(std::make_unique<FakeTaskSnapshot>(task_id));
+  return tasks;
+}
+
+struct HookRpc {
+  HookType type;
+  std::vector<task_id_t> task_ids;
+
+  bool operator==(HookRpc const&) const = default;
+};
+
+/**
+ * Records the hook RPCs in the order of arrival. The RPCs can be held until
+ * Unblock() is called, or be failed with UNAVAILABLE.
+ */
+class FakePlugind : public crane::grpc::plugin::CranePluginD::Service {
+ public:
+  grpc::Status StartHook(
+      grpc::ServerContext* context,
+      const crane::grpc::plugin::StartHookRequest* request,
+      crane::grpc::plugin::StartHookReply* response) override {
+    std::vector<task_id_t> task_ids;
+    for (const auto& task : request->task_info_list())
+      task_ids.emplace_back(task.task_id());
+    return Record_(HookType::START, std::move(task_ids));
+  }
+
+  grpc::Status EndHook(grpc::ServerContext* context,
+                       const crane::grpc::plugin::EndHookRequest* request,
+                       crane::grpc::plugin::EndHookReply* response) override {
+    std::vector<task_id_t> task_ids;
+    for (const auto& task : request->task_info_list())
+      task_ids.emplace_back(task.task_id());
+    return Record_(HookType::END, std::move(task_ids));
+  }
+
+  grpc::Status JobMonitorHook(
+      grpc::ServerContext* context,
+      const crane::grpc::plugin::JobMonitorHookRequest* request,
+      crane::grpc::plugin::JobMonitorHookReply* response) override {
+    return Record_(HookType::JOB_MONITOR, {request->task_id()});
+  }
+
+  void Block() {
+    absl::MutexLock lock(&m_mtx_);
+    m_blocked_ = true;
+  }
+
+  void Unblock() {
+    absl::MutexLock lock(&m_mtx_);
+    m_blocked_ = false;
+  }
+
+  void FailNextRpcs(int num) {
+    absl::MutexLock lock(&m_mtx_);
+    m_unavailable_num_ = num;
+  }
+
+  // Wait until the accepted RPCs carry task_num tasks in total.
+  bool WaitForTaskNum(size_t task_num) {
+    absl::MutexLock lock(&m_mtx_);
+    auto cond = [this, task_num] { return m_accepted_task_num_ >= task_num; };
+    return m_mtx_.AwaitWithTimeout(absl::Condition(&cond), absl::Seconds(10));
+  }
+
+  // Both the accepted and the failed RPCs.
+  std::vector<HookRpc> Rpcs() {
+    absl::MutexLock lock(&m_mtx_);
+    return m_rpcs_;
+  }
+
+ private:
+  grpc::Status Record_(HookType type, std::vector<task_id_t> task_ids) {
+    absl::MutexLock lock(&m_mtx_);
+    m_mtx_.Await(absl::Condition(
+        +[](bool* blocked) { return !*blocked; }, &m_blocked_));
+
+    m_rpcs_.emplace_back(HookRpc{type, task_ids});
+    if (m_unavailable_num_ > 0) {
+      m_unavailable_num_--;
+      return {grpc::StatusCode::UNAVAILABLE, "Not ready"};
+    }
+
+    m_accepted_task_num_ += task_ids.size();
+    return grpc::Status::OK;
+  }
+
+  absl::Mutex m_mtx_;
+  bool m_blocked_ ABSL_GUARDED_BY(m_mtx_){false};
+  int m_unavailable_num_ ABSL_GUARDED_BY(m_mtx_){0};
+  size_t m_accepted_task_num_ ABSL_GUARDED_BY(m_mtx_){0};
+  std::vector<HookRpc> m_rpcs_ ABSL_GUARDED_BY(m_mtx_);
+};
+
+}  // namespace
+
+class PluginClientTest : public testing::Test {
+ public:
+  void SetUp() override {
+    m_endpoint_ = fmt::format(
+        "unix://{}",
+        (std::filesystem::temp_directory_path() /
+         fmt::format("plugin_client_test_{}.sock", getpid()))
+            .string());
+
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(m_endpoint_, grpc::InsecureServerCredentials());
+    builder.RegisterService(&m_plugind_);
+    m_server_ = builder.BuildAndStart();
+    ASSERT_NE(m_server_, nullptr);
+
+    m_client_ = std::make_unique<PluginClient>();
+  }
+
+  void TearDown() override {
+    m_plugind_.Unblock();
+    m_client_.reset();
+    m_server_->Shutdown();
+  }
+
+ protected:
+  void StartClient(PluginClient::Options const& options) {
+    m_client_->InitChannelAndStub(m_endpoint_, options);
+  }
+
+  std::string m_endpoint_;
+  FakePlugind m_plugind_;
+  std::unique_ptr<grpc::Server> m_server_;
+  std::unique_ptr<PluginClient> m_client_;
+};
+
+TEST_F(PluginClientTest, MergeAdjacentEventsIntoBatches) {
+  // The events are queued before the sending thread starts, so they are
+  // dequeued together.
+  m_client_->StartHookAsync(Snapshots({1, 2, 3}));
+  m_client_->StartHookAsync(Snapshots({4, 5, 6}));
+  m_client_->StartHookAsync(Snapshots({7, 8, 9}));
+  m_client_->EndHookAsync(Snapshots({1, 2}));
+  m_client_->StartHookAsync(Snapshots({10}));
+
+  StartClient({.max_queued_tasks = 100,
+               .max_inflight_rpcs = 4,
+               .max_batch_size = 4});
+  ASSERT_TRUE(m_plugind_.WaitForTaskNum(12));
+
+  std::vector<HookRpc> rpcs = m_plugind_.Rpcs();
+  ASSERT_EQ(rpcs.size(), 5);
+
+  // The START batches are in flight together and may arrive in any order,
+  // but never together with the END batch.
+  std::vector<HookRpc> start_rpcs(rpcs.begin(), rpcs.begin() + 3);
+  std::ranges::sort(start_rpcs, {}, [](HookRpc const& rpc) {
+    return rpc.task_ids.front();
+  });
+  EXPECT_EQ(start_rpcs, (std::vector<HookRpc>{
+                            {HookType::START, {1, 2, 3, 4}},
+                            {HookType::START, {5, 6, 7, 8}},
+                            {HookType::START, {9}},
+                        }));
+  EXPECT_EQ(rpcs[3], (HookRpc{HookType::END, {1, 2}}));
+  EXPECT_EQ(rpcs[4], (HookRpc{HookType::START, {10}}));
+}
+
+TEST_F(PluginClientTest, CoalesceJobMonitorEventsOfSameTask) {
+  m_client_->JobMonitorHookAsync(1, "/sys/fs/cgroup/job_1");
+  m_client_->JobMonitorHookAsync(2, "/sys/fs/cgroup/job_2");
+  m_client_->JobMonitorHookAsync(1, "/sys/fs/cgroup/job_1");
+  m_client_->JobMonitorHookAsync(1, "/sys/fs/cgroup/job_1");
+
+  StartClient({.max_queued_tasks = 100,
+               .max_inflight_rpcs = 1,
+               .max_batch_size = 4});
+  ASSERT_TRUE(m_plugind_.WaitForTaskNum(2));
+
+  // A JOB_MONITOR call which is not coalesced would arrive before it.
+  m_client_->StartHookAsync(Snapshots({3}));
+  ASSERT_TRUE(m_plugind_.WaitForTaskNum(3));
+
+  EXPECT_EQ(m_plugind_.Rpcs(), (std::vector<HookRpc>{
+                                   {HookType::JOB_MONITOR, {1}},
+                                   {HookType::JOB_MONITOR, {2}},
+                                   {HookType::START, {3}},
+                               }));
+}
+
+TEST_F(PluginClientTest, DropEventsWhenQueueIsFull) {
+  m_plugind_.Block();
+  StartClient({.max_queued_tasks = 5,
+               .max_inflight_rpcs = 4,
+               .max_batch_size = 100});
+
+  // The tasks of blocked RPCs still count until plugind replies.
+  m_client_->StartHookAsync(Snapshots({1, 2, 3}));
+  m_client_->StartHookAsync(Snapshots({4, 5, 6}));
+  m_client_->StartHookAsync(Snapshots({7, 8}));
+  m_client_->EndHookAsync(Snapshots({1}));
+  EXPECT_EQ(m_client_->DroppedTaskNum(), 4);
+
+  m_plugind_.Unblock();
+  ASSERT_TRUE(m_plugind_.WaitForTaskNum(5));
+
+  // The queue accepts events again once the replies are handled.
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  m_client_->EndHookAsync(Snapshots({1, 2}));
+  ASSERT_TRUE(m_plugind_.WaitForTaskNum(7));
+  EXPECT_EQ(m_client_->DroppedTaskNum(), 4);
+
+  std::vector<task_id_t> started;
+  for (const auto& rpc : m_plugind_.Rpcs())
+    if (rpc.type == HookType::START)
+      started.insert(started.end(), rpc.task_ids.begin(), rpc.task_ids.end());
+  std::ranges::sort(started);
+  EXPECT_EQ(started, (std::vector<task_id_t>{1, 2, 3, 7, 8}));
+}
+
+TEST_F(PluginClientTest, ResendWhenPlugindIsUnavailable) {
+  m_plugind_.FailNextRpcs(2);
+  StartClient({.max_queued_tasks = 100,
+               .max_inflight_rpcs = 4,
+               .max_batch_size = 100});
+
+  m_client_->StartHookAsync(Snapshots({1, 2}));
+  ASSERT_TRUE(m_plugind_.WaitForTaskNum(2));
+
+  // The same request is sent until it is accepted.
+  EXPECT_EQ(m_plugind_.Rpcs(), (std::vector<HookRpc>(
+                                   3, HookRpc{HookType::START, {1, 2}})));
+  EXPECT_EQ(m_client_->DroppedTaskNum(), 0);
+}
+
+TEST_F(PluginClientTest, KeepOrderOfHooksCalledFromDifferentThreads) {
+  constexpr task_id_t kTaskNum = 500;
+
+  StartClient({.max_queued_tasks = 10 * kTaskNum,
+               .max_inflight_rpcs = 4,
+               .max_batch_size = 16});
+
+  // The END hook of a task is called by another thread after its START hook
+  // is called, as the scheduler and the status change handler do.
+  std::atomic<task_id_t> started_task_num{0};
+  std::thread start_thread([&] {
+    for (task_id_t i = 0; i < kTaskNum; i++) {
+      m_client_->StartHookAsync(Snapshots({i}));
+      started_task_num.store(i + 1, std::memory_order_release);
+    }
+  });
+  std::thread end_thread([&] {
+    for (task_id_t i = 0; i < kTaskNum; i++) {
+      while (started_task_num.load(std::memory_order_acquire) <= i)
+        std::this_thread::yield();
+      m_client_->EndHookAsync(Snapshots({i}));
+    }
+  });
+  start_thread.join();
+  end_thread.join();
+
+  ASSERT_TRUE(m_plugind_.WaitForTaskNum(2 * kTaskNum));
+
+  std::vector<bool> started(kTaskNum, false);
+  for (const auto& rpc : m_plugind_.Rpcs()) {
+    for (task_id_t task_id : rpc.task_ids) {
+      if (rpc.type == HookType::START)
+        started[task_id] = true;
+      else
+        EXPECT_TRUE(started[task_id]) << "END before START of " << task_id;
+    }
+  }
+}
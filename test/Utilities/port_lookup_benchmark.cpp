@@ -0,0 +1,177 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include <gtest/gtest.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "crane/Network.h"
+#include "crane/OS.h"
+
+// Compares the port-to-process lookup of QueryTaskIdFromPort before and
+// after NETLINK_SOCK_DIAG and the cgroup.procs-restricted search, with a
+// process holding 50k open fds on the node. Run it manually, e.g.,
+//   ./port_lookup_benchmark
+
+namespace {
+
+constexpr int kOpenFdNum = 50'000;
+constexpr int kRoundNum = 20;
+
+// The pid search used before: stat() every fd of every process.
+pid_t FindPidBySocketInodeInAllProcs(ino_t inode) {
+  for (const auto& entry : std::filesystem::directory_iterator("/proc")) {
+    std::string pid_s = entry.path().filename().string();
+    if (!isdigit(pid_s[0])) continue;
+
+    std::error_code ec;
+    for (const auto& fd_entry : std::filesystem::directory_iterator(
+             fmt::format("/proc/{}/fd", pid_s), ec)) {
+      struct stat statbuf {};
+      if (stat(fd_entry.path().c_str(), &statbuf) != 0) continue;
+      if (statbuf.st_ino == inode) return std::stoi(pid_s);
+    }
+  }
+  return -1;
+}
+
+// Fork a child which runs fn and then waits to be killed.
+// Return -1 on failure.
+template <typename Fn>
+pid_t ForkHolder(Fn fn) {
+  int sync_pipe[2];
+  if (pipe(sync_pipe) != 0) return -1;
+
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(sync_pipe[0]);
+    char ok = fn() ? 1 : 0;
+    write(sync_pipe[1], &ok, 1);
+    while (true) pause();
+  }
+
+  close(sync_pipe[1]);
+  char ok = 0;
+  if (pid == -1 || read(sync_pipe[0], &ok, 1) != 1 || !ok) {
+    if (pid > 0) {
+      kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+    }
+    pid = -1;
+  }
+  close(sync_pipe[0]);
+  return pid;
+}
+
+template <typename Fn>
+int64_t AvgMicroseconds(Fn fn) {
+  auto begin = std::chrono::steady_clock::now();
+  for (int i = 0; i < kRoundNum; i++) fn();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(end - begin)
+             .count() /
+         kRoundNum;
+}
+
+}  // namespace
+
+class PortLookupBenchmark : public testing::Test {
+ public:
+  void SetUp() override {
+    rlimit rlim{};
+    getrlimit(RLIMIT_NOFILE, &rlim);
+    if (rlim.rlim_max < kOpenFdNum + 64)
+      GTEST_SKIP() << "RLIMIT_NOFILE is too small.";
+    rlim.rlim_cur = rlim.rlim_max;
+    ASSERT_EQ(setrlimit(RLIMIT_NOFILE, &rlim), 0);
+
+    // A process which is not in any task, e.g. a daemon, holding many fds.
+    // It is forked first so that the full scan visits it first.
+    m_fd_holder_pid_ = ForkHolder([] {
+      for (int i = 0; i < kOpenFdNum; i++)
+        if (open("/dev/null", O_RDONLY) == -1) return false;
+      return true;
+    });
+    ASSERT_NE(m_fd_holder_pid_, -1);
+
+    int sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(sock_fd, -1);
+    sockaddr_in addr{.sin_family = AF_INET,
+                     .sin_port = 0,
+                     .sin_addr = {htonl(INADDR_LOOPBACK)}};
+    socklen_t addr_len = sizeof(addr);
+    ASSERT_EQ(bind(sock_fd, reinterpret_cast<sockaddr*>(&addr), addr_len), 0);
+    ASSERT_EQ(listen(sock_fd, 1), 0);
+    ASSERT_EQ(
+        getsockname(sock_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len),
+        0);
+    m_port_ = ntohs(addr.sin_port);
+
+    // The task process owning the socket.
+    m_task_pid_ = ForkHolder([] { return true; });
+    close(sock_fd);
+    ASSERT_NE(m_task_pid_, -1);
+  }
+
+  void TearDown() override {
+    for (pid_t pid : {m_fd_holder_pid_, m_task_pid_}) {
+      if (pid <= 0) continue;
+      kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+    }
+  }
+
+ protected:
+  pid_t m_fd_holder_pid_{-1};
+  pid_t m_task_pid_{-1};
+  int m_port_{0};
+};
+
+TEST_F(PortLookupBenchmark, InodeAndPidLookup) {
+  ino_t proc_inode = 0;
+  ino_t netlink_inode = 0;
+  bool netlink_available;
+
+  ASSERT_TRUE(crane::FindTcpInodeByPort("/proc/net/tcp", m_port_,
+                                        &proc_inode));
+  ASSERT_TRUE(crane::FindTcpInodeByPortNetlink(m_port_, &netlink_inode,
+                                               &netlink_available));
+  ASSERT_EQ(proc_inode, netlink_inode);
+
+  ASSERT_EQ(FindPidBySocketInodeInAllProcs(proc_inode), m_task_pid_);
+  ASSERT_TRUE(util::os::ProcessHasSocketInode(m_task_pid_, proc_inode));
+
+  ino_t inode;
+  int64_t proc_net_us = AvgMicroseconds([&] {
+    crane::FindTcpInodeByPort("/proc/net/tcp", m_port_, &inode);
+  });
+  int64_t netlink_us = AvgMicroseconds([&] {
+    crane::FindTcpInodeByPortNetlink(m_port_, &inode, &netlink_available);
+  });
+
+  int64_t all_procs_us = AvgMicroseconds(
+      [&] { FindPidBySocketInodeInAllProcs(proc_inode); });
+  // With cgroup.procs, only the processes of tasks are checked.
+  int64_t task_procs_us = AvgMicroseconds(
+      [&] { util::os::ProcessHasSocketInode(m_task_pid_, proc_inode); });
+
+  fmt::print("inode lookup: /proc/net/tcp {} us, netlink {} us\n",
+             proc_net_us, netlink_us);
+  fmt::print("pid search: all processes {} us, task processes {} us\n",
+             all_procs_us, task_procs_us);
+}
@@ -0,0 +1,247 @@
+/**
+ * Copyright (c) 2023 Peking University and Peking University
+ * Changsha Institute for Computing and Digital Economy
+ *
+ * CraneSched is licensed under Mulan PSL v2.
+ * You can use this software according to the terms and conditions of
+ * the Mulan PSL v2.
+ * You may obtain a copy of Mulan PSL v2 at:
+ *          http://license.coscl.org.cn/MulanPSL2
+ * THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS,
+ * WITHOUT WARRANTIES OF ANY KIND,
+ * EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+ * MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+ * See the Mulan PSL v2 for more details.
+ */
+
+#include "crane/RelayTree.h"
+
+#include <grpcpp/grpcpp.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "crane/Logger.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr uint32_t kFanOut = 4;
+constexpr int kCranedNum = 60;
+
+/**
+ * Acts as a craned on localhost which serves Relay through
+ * RelayTree::ServeRelay(). The payload of the local target is counted instead
+ * of being executed.
+ */
+class FakeCranedService : public crane::grpc::Craned::Service {
+ public:
+  FakeCranedService(std::string craned_id,
+                    crane::RelayTree::CranedStubGetter stub_getter)
+      : m_craned_id_(std::move(craned_id)),
+        m_stub_getter_(std::move(stub_getter)) {}
+
+  grpc::Status Relay(grpc::ServerContext* context,
+                     const crane::grpc::RelayRequest* request,
+                     crane::grpc::RelayReply* response) override {
+    crane::RelayTree relay_tree(request->fan_out(), m_stub_getter_, 1s);
+    return relay_tree.ServeRelay(
+        *context, *request, response, m_craned_id_,
+        [this](const crane::grpc::RelayTarget& target) {
+          EXPECT_TRUE(target.has_terminate_tasks());
+          received_cnt++;
+          std::chrono::milliseconds delay(delay_once_ms.exchange(0));
+          if (delay > 0ms) std::this_thread::sleep_for(delay);
+          return true;
+        });
+  }
+
+  std::atomic_int received_cnt{0};
+  // The delay of the next local handling.
+  std::atomic_int delay_once_ms{0};
+
+ private:
+  std::string m_craned_id_;
+  crane::RelayTree::CranedStubGetter m_stub_getter_;
+};
+
+}  // namespace
+
+class RelayTreeTest : public testing::Test {
+ public:
+  void SetUp() override {
+    auto stub_getter = [this](const std::string& craned_id) {
+      return GetStub(craned_id);
+    };
+
+    for (int i = 0; i < kCranedNum; i++) {
+      std::string craned_id = fmt::format("cn{}", i);
+      auto service =
+          std::make_unique<FakeCranedService>(craned_id, stub_getter);
+
+      int port = 0;
+      grpc::ServerBuilder builder;
+      builder.AddListeningPort("127.0.0.1:0",
+                               grpc::InsecureServerCredentials(), &port);
+      builder.RegisterService(service.get());
+      auto server = builder.BuildAndStart();
+      ASSERT_NE(server, nullptr);
+      ASSERT_NE(port, 0);
+
+      m_stub_map_[craned_id] = crane::grpc::Craned::NewStub(
+          grpc::CreateChannel(fmt::format("127.0.0.1:{}", port),
+                              grpc::InsecureChannelCredentials()));
+      m_craned_ids_.emplace_back(craned_id);
+      m_services_.emplace_back(std::move(service));
+      m_servers_.emplace_back(std::move(server));
+    }
+  }
+
+  void TearDown() override {
+    for (auto& server : m_servers_)
+      if (server) server->Shutdown();
+  }
+
+ protected:
+  std::shared_ptr<crane::grpc::Craned::Stub> GetStub(
+      const std::string& craned_id) {
+    auto it = m_stub_map_.find(craned_id);
+    if (it == m_stub_map_.end()) return nullptr;
+    return it->second;
+  }
+
+  crane::RelayTree NewRelayTree() {
+    return crane::RelayTree(
+        kFanOut, [this](const std::string& id) { return GetStub(id); }, 1s);
+  }
+
+  google::protobuf::RepeatedPtrField<crane::grpc::RelayTarget> AllTargets() {
+    google::protobuf::RepeatedPtrField<crane::grpc::RelayTarget> targets;
+    for (int i = 0; i < kCranedNum; i++) {
+      auto* target = targets.Add();
+      target->set_craned_id(m_craned_ids_[i]);
+      target->mutable_terminate_tasks()->add_task_id_list(i);
+    }
+    return targets;
+  }
+
+  void StopCraned(int index) {
+    m_servers_[index]->Shutdown();
+    m_servers_[index].reset();
+  }
+
+  // Written in SetUp() only and read by the servers afterwards.
+  std::unordered_map<std::string, std::shared_ptr<crane::grpc::Craned::Stub>>
+      m_stub_map_;
+  std::vector<std::string> m_craned_ids_;
+  std::vector<std::unique_ptr<FakeCranedService>> m_services_;
+  std::vector<std::unique_ptr<grpc::Server>> m_servers_;
+};
+
+TEST(RelayTree, Depth) {
+  EXPECT_EQ(crane::RelayTree::Depth(4, 0), 0);
+  EXPECT_EQ(crane::RelayTree::Depth(4, 1), 1);
+  EXPECT_EQ(crane::RelayTree::Depth(4, 5), 2);
+  EXPECT_EQ(crane::RelayTree::Depth(4, 6), 3);
+  EXPECT_EQ(crane::RelayTree::Depth(0, 100), 1);
+}
+
+TEST_F(RelayTreeTest, DeliverToAll) {
+  crane::RelayTree relay_tree = NewRelayTree();
+
+  std::vector<std::string> failed_ids = relay_tree.Broadcast(AllTargets());
+  EXPECT_TRUE(failed_ids.empty());
+  for (const auto& service : m_services_)
+    EXPECT_EQ(service->received_cnt.load(), 1);
+}
+
+TEST_F(RelayTreeTest, FallbackOnRelayFailure) {
+  // With 60 craneds and a fan-out of 4, cn0 is the relay of the first
+  // subtree at the top level, whose members are then sent to directly.
+  // cn20 is a relay at the second level in the subtree of cn15.
+  StopCraned(0);
+  StopCraned(20);
+
+  crane::RelayTree relay_tree = NewRelayTree();
+
+  std::vector<std::string> failed_ids = relay_tree.Broadcast(AllTargets());
+  std::sort(failed_ids.begin(), failed_ids.end());
+  EXPECT_EQ(failed_ids, (std::vector<std::string>{"cn0", "cn20"}));
+
+  for (int i = 0; i < kCranedNum; i++) {
+    if (i == 0 || i == 20) continue;
+    EXPECT_EQ(m_services_[i]->received_cnt.load(), 1) << m_craned_ids_[i];
+  }
+}
+
+TEST_F(RelayTreeTest, UnknownCraned) {
+  auto targets = AllTargets();
+  // A relay at the top level which has no stub.
+  targets[kCranedNum / 2].set_craned_id("unknown");
+
+  crane::RelayTree relay_tree = NewRelayTree();
+
+  std::vector<std::string> failed_ids = relay_tree.Broadcast(targets);
+  EXPECT_EQ(failed_ids, std::vector<std::string>{"unknown"});
+  EXPECT_EQ(m_services_[kCranedNum / 2]->received_cnt.load(), 0);
+}
+
+TEST_F(RelayTreeTest, RetryOnlyUnconfirmedOfSlowSubtree) {
+  // cn4 is a leaf under cn1, which is a relay under cn0. cn1 gives up on cn4
+  // after one hop and replies the rest of its subtree as delivered, so only
+  // cn4 is retried.
+  m_services_[4]->delay_once_ms = 1500;
+
+  crane::RelayTree relay_tree = NewRelayTree();
+
+  std::vector<std::string> failed_ids = relay_tree.Broadcast(AllTargets());
+  EXPECT_TRUE(failed_ids.empty());
+
+  for (int i = 0; i < kCranedNum; i++)
+    EXPECT_EQ(m_services_[i]->received_cnt.load(), i == 4 ? 2 : 1)
+        << m_craned_ids_[i];
+}
+
+TEST_F(RelayTreeTest, RetryTimedOutRelayDirectly) {
+  // cn1 handles its own target but replies after the deadline of cn0, so
+  // nothing of its subtree cn1..cn4 is confirmed. cn0 retries each of them
+  // directly and none is reported as failed.
+  m_services_[1]->delay_once_ms = 2500;
+
+  crane::RelayTree relay_tree = NewRelayTree();
+
+  std::vector<std::string> failed_ids = relay_tree.Broadcast(AllTargets());
+  EXPECT_TRUE(failed_ids.empty());
+
+  EXPECT_EQ(m_services_[1]->received_cnt.load(), 2);
+  for (int i = 0; i < kCranedNum; i++) {
+    if (i == 1) continue;
+    EXPECT_EQ(m_services_[i]->received_cnt.load(), 1) << m_craned_ids_[i];
+  }
+}
+
+TEST_F(RelayTreeTest, RejectMisdirectedRelay) {
+  crane::grpc::RelayRequest request;
+  auto* target = request.add_targets();
+  target->set_craned_id(m_craned_ids_[1]);
+  target->mutable_terminate_tasks()->add_task_id_list(1);
+  target = request.add_targets();
+  target->set_craned_id(m_craned_ids_[2]);
+  target->mutable_terminate_tasks()->add_task_id_list(2);
+
+  grpc::ClientContext context;
+  crane::grpc::RelayReply reply;
+  grpc::Status status =
+      GetStub(m_craned_ids_[0])->Relay(&context, request, &reply);
+
+  EXPECT_EQ(status.error_code(), grpc::StatusCode::INVALID_ARGUMENT);
+  EXPECT_EQ(reply.delivered_craned_ids_size(), 0);
+  for (const auto& service : m_services_)
+    EXPECT_EQ(service->received_cnt.load(), 0);
+}